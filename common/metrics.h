@@ -9,23 +9,23 @@ namespace freezing {
 
 
 template<typename Key>
-static constexpr usize metric_key_count();
+constexpr usize metric_key_count();
 
 template<typename Key>
-static constexpr usize metric_key_index(Key);
+constexpr usize metric_key_index(Key);
 
 template<typename Key>
-static std::string metric_key_unit(Key);
+std::string metric_key_unit(Key);
 
 template<typename Key, typename Value>
-static double metric_key_unit_scale(Key key, Value value);
+double metric_key_unit_scale(Key key, Value value);
 
 template<typename Key>
-static std::string metric_key_name(Key);
+std::string metric_key_name(Key);
 
 // TODO: Should be [function_view]
 template<typename Key>
-static void foreach_key(const std::function<void(Key)>&);
+void foreach_key(const std::function<void(Key)>&);
 
 template<typename Key, typename Value>
 class Metrics {
@@ -40,6 +40,13 @@ public:
     inc(key, 1);
   }
 
+  // Adds the values of [other] to these metrics, e.g. to aggregate metrics of many instances.
+  void add(const Metrics &other) {
+    for (usize i = 0; i < m_values.size(); i++) {
+      m_values[i] += other.m_values[i];
+    }
+  }
+
   Value value(Key key) const {
     return m_values[metric_key_index(key)];
   }
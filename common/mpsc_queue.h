@@ -0,0 +1,111 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_COMMON_MPSC_QUEUE_H
+#define NEPTUN_COMMON_MPSC_QUEUE_H
+
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <vector>
+
+#include "common/types.h"
+#include "common/spsc_queue.h"
+
+namespace freezing {
+
+// Bounded lock-free queue with any number of producer threads and a single consumer thread.
+//
+// Based on Dmitry Vyukov's bounded MPMC queue: producers claim a slot by incrementing the tail
+// with a CAS, and every slot has a sequence number that tells whether it's free for the
+// producer of a given position, or holds the element of a given position for the consumer.
+// A producer that is preempted after claiming a slot delays the consumer until the slot is
+// written, but never blocks the other producers.
+//
+// Like [SpscQueue], elements are written and read in place through callbacks.
+template<typename T>
+class MpscQueue {
+public:
+  // Every slot starts as a copy of [initial]. The capacity is rounded up to a power of two.
+  explicit MpscQueue(usize capacity, const T &initial = T{})
+      : m_slots(std::bit_ceil(capacity)), m_mask{m_slots.size() - 1} {
+    assert(capacity > 0);
+    for (u64 i = 0; i < m_slots.size(); i++) {
+      m_slots[i].sequence.store(i, std::memory_order_relaxed);
+      m_slots[i].value = initial;
+    }
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  // Any thread. Calls [write] with the slot of the new element, unless the queue is full.
+  template<typename WriteFn>
+  bool try_push(WriteFn write) {
+    u64 tail = m_tail.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &m_slots[tail & m_mask];
+      u64 sequence = slot->sequence.load(std::memory_order_acquire);
+      if (sequence == tail) {
+        if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (sequence < tail) {
+        // The slot still holds the element from the previous lap.
+        return false;
+      } else {
+        // Another producer has claimed the slot.
+        tail = m_tail.load(std::memory_order_relaxed);
+      }
+    }
+    write(slot->value);
+    slot->sequence.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. Calls [read] with the oldest element, unless the queue is empty or the
+  // oldest element is still being written.
+  template<typename ReadFn>
+  bool try_pop(ReadFn read) {
+    u64 head = m_head.load(std::memory_order_relaxed);
+    auto &slot = m_slots[head & m_mask];
+    if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+      return false;
+    }
+    read(slot.value);
+    slot.sequence.store(head + m_slots.size(), std::memory_order_release);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Any thread. Number of elements in the queue, including the ones that are being written,
+  // which may be outdated by the time it returns.
+  usize size() const {
+    u64 head = m_head.load(std::memory_order_acquire);
+    u64 tail = m_tail.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+
+  usize capacity() const {
+    return m_slots.size();
+  }
+
+private:
+  struct alignas(kCacheLineSize) Slot {
+    std::atomic<u64> sequence{0};
+    T value{};
+  };
+
+  std::vector<Slot> m_slots;
+  usize m_mask;
+  // Written by the consumer.
+  alignas(kCacheLineSize) std::atomic<u64> m_head{0};
+  // Written by the producers.
+  alignas(kCacheLineSize) std::atomic<u64> m_tail{0};
+};
+
+}
+
+#endif //NEPTUN_COMMON_MPSC_QUEUE_H
@@ -0,0 +1,69 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "common/types.h"
+#include "common/mpsc_queue.h"
+
+using namespace freezing;
+
+TEST(MpscQueueTest, PushAndPopInOrder) {
+  MpscQueue<u32> queue{4};
+  for (u32 i = 0; i < 4; i++) {
+    ASSERT_TRUE(queue.try_push([i](u32 &value) { value = i; }));
+  }
+  ASSERT_FALSE(queue.try_push([](u32 &value) { FAIL(); }));
+  ASSERT_EQ(queue.size(), 4);
+
+  std::vector<u32> values{};
+  while (queue.try_pop([&values](u32 &value) { values.push_back(value); })) {}
+  ASSERT_EQ(values, (std::vector<u32>{0, 1, 2, 3}));
+  ASSERT_EQ(queue.size(), 0);
+
+  // The slots are reused on the next lap.
+  ASSERT_TRUE(queue.try_push([](u32 &value) { value = 4; }));
+  ASSERT_TRUE(queue.try_pop([](u32 &value) { ASSERT_EQ(value, 4); }));
+}
+
+TEST(MpscQueueTest, ManyProducerThreads) {
+  constexpr u32 kProducerCount = 4;
+  constexpr u32 kCountPerProducer = 5'000;
+  struct Element {
+    u32 producer;
+    u32 value;
+  };
+  MpscQueue<Element> queue{64};
+  std::vector<std::thread> producers{};
+  for (u32 producer = 0; producer < kProducerCount; producer++) {
+    producers.emplace_back([&queue, producer]() {
+      for (u32 i = 0; i < kCountPerProducer; i++) {
+        while (!queue.try_push([producer, i](Element &element) { element = {producer, i}; })) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Elements of every producer arrive in the order they were pushed.
+  std::vector<u32> next_values(kProducerCount, 0);
+  u32 count = 0;
+  while (count < kProducerCount * kCountPerProducer) {
+    bool is_popped = queue.try_pop([&](Element &element) {
+      ASSERT_EQ(element.value, next_values[element.producer]);
+      next_values[element.producer]++;
+      count++;
+    });
+    if (!is_popped) {
+      std::this_thread::yield();
+    }
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  ASSERT_EQ(next_values, std::vector<u32>(kProducerCount, kCountPerProducer));
+  ASSERT_EQ(queue.size(), 0);
+}
@@ -0,0 +1,108 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_COMMON_RING_BUFFER_H
+#define NEPTUN_COMMON_RING_BUFFER_H
+
+#include <cassert>
+#include <span>
+#include <vector>
+
+#include "common/types.h"
+
+namespace freezing {
+
+// Ring buffer of contiguous records, which are appended at the end and released from the
+// beginning.
+//
+// Records are addressed by offsets that keep increasing as the buffer wraps around, so an offset
+// stays valid until its record is released and nothing has to be moved or rewritten.
+// A record is never split: if it doesn't fit at the end of the storage, the rest of the
+// storage is skipped and the record starts at the beginning.
+template<typename T>
+class RingBuffer {
+public:
+  explicit RingBuffer(usize capacity) : m_buffer(capacity) {
+    assert(capacity > 0);
+  }
+
+  // The largest contiguous space that the next record can be written to.
+  std::span<T> remaining() {
+    auto position = index(m_end + padding());
+    return std::span(m_buffer.begin() + position, m_buffer.begin() + position + contiguous_free());
+  }
+
+  // Appends the record of [count] elements that has been written to [remaining], and returns
+  // its offset.
+  u64 advance(usize count) {
+    assert(count <= contiguous_free());
+    u64 offset = m_end + padding();
+    m_end = offset + count;
+    return offset;
+  }
+
+  // Releases everything before [offset], i.e. all records that end at or before it.
+  void release(u64 offset) {
+    assert(m_begin <= offset && offset <= m_end);
+    m_begin = offset;
+    if (m_begin == m_end) {
+      // The next record can start at the beginning of the storage.
+      m_begin = m_end = (m_end + capacity() - 1) / capacity() * capacity();
+    }
+  }
+
+  std::span<T> record(u64 offset, usize count) {
+    assert(m_begin <= offset && offset + count <= m_end);
+    auto position = index(offset);
+    assert(position + count <= capacity());
+    return std::span(m_buffer.begin() + position, m_buffer.begin() + position + count);
+  }
+
+  // Number of elements that are taken, including the skipped ones.
+  usize size() const {
+    return m_end - m_begin;
+  }
+
+  usize capacity() const {
+    return m_buffer.size();
+  }
+
+private:
+  std::vector<T> m_buffer;
+  u64 m_begin{0};
+  u64 m_end{0};
+
+  usize index(u64 offset) const {
+    return offset % capacity();
+  }
+
+  // Number of elements at the end of the storage that are skipped if the next record is
+  // written at the beginning, which is done when there's more free space there.
+  usize padding() const {
+    if (size() == capacity()) {
+      return 0;
+    }
+    usize begin = index(m_begin);
+    usize end = index(m_end);
+    if (end < begin || (end == begin && size() > 0)) {
+      // The free space is contiguous already.
+      return 0;
+    }
+    usize free_at_end = capacity() - end;
+    return begin > free_at_end ? free_at_end : 0;
+  }
+
+  usize contiguous_free() const {
+    if (size() == capacity()) {
+      return 0;
+    }
+    usize begin = index(m_begin);
+    usize end = index(m_end + padding());
+    return end < begin ? begin - end : capacity() - end;
+  }
+};
+
+}
+
+#endif //NEPTUN_COMMON_RING_BUFFER_H
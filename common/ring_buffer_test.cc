@@ -0,0 +1,64 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+#include <algorithm>
+
+#include "common/types.h"
+#include "common/ring_buffer.h"
+
+using namespace freezing;
+
+namespace {
+
+// Writes a record of [count] elements with [value], and returns its offset.
+u64 append(RingBuffer<u8> &buffer, usize count, u8 value) {
+  auto remaining = buffer.remaining();
+  EXPECT_GE(remaining.size(), count);
+  std::fill_n(remaining.begin(), count, value);
+  return buffer.advance(count);
+}
+
+}
+
+TEST(RingBufferTest, RecordsKeepTheirOffsetsWhenWrappingAround) {
+  RingBuffer<u8> buffer{10};
+  auto first = append(buffer, 4, 1);
+  auto second = append(buffer, 4, 2);
+  ASSERT_EQ(buffer.remaining().size(), 2);
+
+  buffer.release(first + 4);
+  // There's more free space at the beginning, so the end of the storage is skipped.
+  ASSERT_EQ(buffer.remaining().size(), 4);
+  auto third = append(buffer, 3, 3);
+  ASSERT_EQ(third, 10);
+  ASSERT_EQ(buffer.size(), 9);
+
+  auto second_record = buffer.record(second, 4);
+  ASSERT_TRUE(std::all_of(second_record.begin(), second_record.end(), [](u8 x) { return x == 2; }));
+  auto third_record = buffer.record(third, 3);
+  ASSERT_TRUE(std::all_of(third_record.begin(), third_record.end(), [](u8 x) { return x == 3; }));
+
+  // The skipped elements are released with the third record.
+  buffer.release(second + 4);
+  ASSERT_EQ(buffer.size(), 5);
+  ASSERT_EQ(buffer.remaining().size(), 5);
+}
+
+TEST(RingBufferTest, FullBufferHasNoRemainingSpace) {
+  RingBuffer<u8> buffer{10};
+  auto offset = append(buffer, 10, 1);
+  ASSERT_EQ(buffer.remaining().size(), 0);
+  buffer.release(offset + 5);
+  ASSERT_EQ(buffer.remaining().size(), 5);
+}
+
+TEST(RingBufferTest, EmptyBufferStartsAtTheBeginning) {
+  RingBuffer<u8> buffer{10};
+  auto offset = append(buffer, 6, 1);
+  buffer.release(offset + 6);
+  ASSERT_EQ(buffer.size(), 0);
+  ASSERT_EQ(buffer.remaining().size(), 10);
+  ASSERT_EQ(append(buffer, 10, 2), 10);
+}
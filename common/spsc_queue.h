@@ -0,0 +1,99 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_COMMON_SPSC_QUEUE_H
+#define NEPTUN_COMMON_SPSC_QUEUE_H
+
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <new>
+#include <vector>
+
+#include "common/types.h"
+
+namespace freezing {
+
+// Size of a cache line, to keep the data of different threads apart.
+constexpr usize kCacheLineSize = 64;
+
+// Bounded lock-free queue with a single producer thread and a single consumer thread.
+//
+// Elements are written and read in place through callbacks, so elements that own memory, e.g.
+// a payload buffer, keep it for their slot and nothing is allocated after construction.
+// Each side caches the other side's index and only reloads it when the queue looks full or
+// empty, so the threads rarely touch each other's cache lines.
+template<typename T>
+class SpscQueue {
+public:
+  // Every slot starts as a copy of [initial]. The capacity is rounded up to a power of two.
+  explicit SpscQueue(usize capacity, const T &initial = T{})
+      : m_slots(std::bit_ceil(capacity), initial), m_mask{m_slots.size() - 1} {
+    assert(capacity > 0);
+  }
+
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue &operator=(const SpscQueue &) = delete;
+
+  // Producer only. Calls [write] with the slot of the new element, unless the queue is full.
+  template<typename WriteFn>
+  bool try_push(WriteFn write) {
+    u64 tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_producer.cached_head == m_slots.size()) {
+      m_producer.cached_head = m_head.load(std::memory_order_acquire);
+      if (tail - m_producer.cached_head == m_slots.size()) {
+        return false;
+      }
+    }
+    write(m_slots[tail & m_mask]);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. Calls [read] with the oldest element, unless the queue is empty.
+  template<typename ReadFn>
+  bool try_pop(ReadFn read) {
+    u64 head = m_head.load(std::memory_order_relaxed);
+    if (head == m_consumer.cached_tail) {
+      m_consumer.cached_tail = m_tail.load(std::memory_order_acquire);
+      if (head == m_consumer.cached_tail) {
+        return false;
+      }
+    }
+    read(m_slots[head & m_mask]);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Any thread. Number of elements in the queue, which may be outdated by the time it returns.
+  usize size() const {
+    u64 head = m_head.load(std::memory_order_acquire);
+    u64 tail = m_tail.load(std::memory_order_acquire);
+    return tail - head;
+  }
+
+  usize capacity() const {
+    return m_slots.size();
+  }
+
+private:
+  std::vector<T> m_slots;
+  usize m_mask;
+  // Written by the consumer.
+  alignas(kCacheLineSize) std::atomic<u64> m_head{0};
+  // Written by the producer.
+  alignas(kCacheLineSize) std::atomic<u64> m_tail{0};
+  // Only used by the producer.
+  struct alignas(kCacheLineSize) {
+    u64 cached_head{0};
+  } m_producer;
+  // Only used by the consumer.
+  struct alignas(kCacheLineSize) {
+    u64 cached_tail{0};
+  } m_consumer;
+};
+
+}
+
+#endif //NEPTUN_COMMON_SPSC_QUEUE_H
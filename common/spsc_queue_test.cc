@@ -0,0 +1,63 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "common/types.h"
+#include "common/spsc_queue.h"
+
+using namespace freezing;
+
+TEST(SpscQueueTest, PushAndPopInOrder) {
+  SpscQueue<u32> queue{3};
+  ASSERT_EQ(queue.capacity(), 4);
+  for (u32 i = 0; i < 4; i++) {
+    ASSERT_TRUE(queue.try_push([i](u32 &value) { value = i; }));
+  }
+  ASSERT_FALSE(queue.try_push([](u32 &value) { FAIL(); }));
+  ASSERT_EQ(queue.size(), 4);
+
+  std::vector<u32> values{};
+  while (queue.try_pop([&values](u32 &value) { values.push_back(value); })) {}
+  ASSERT_EQ(values, (std::vector<u32>{0, 1, 2, 3}));
+  ASSERT_EQ(queue.size(), 0);
+  ASSERT_FALSE(queue.try_pop([](u32 &value) { FAIL(); }));
+}
+
+TEST(SpscQueueTest, SlotsStartAsCopiesOfInitialValue) {
+  SpscQueue<std::vector<u8>> queue{2, std::vector<u8>{1, 2}};
+  ASSERT_TRUE(queue.try_push([](std::vector<u8> &payload) {
+    ASSERT_EQ(payload, (std::vector<u8>{1, 2}));
+    payload.push_back(3);
+  }));
+  ASSERT_TRUE(queue.try_pop([](std::vector<u8> &payload) {
+    ASSERT_EQ(payload, (std::vector<u8>{1, 2, 3}));
+  }));
+}
+
+TEST(SpscQueueTest, ProducerAndConsumerThreads) {
+  constexpr u64 kCount = 20'000;
+  SpscQueue<u64> queue{64};
+  std::thread producer([&queue]() {
+    for (u64 i = 0; i < kCount; i++) {
+      while (!queue.try_push([i](u64 &value) { value = i; })) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  u64 expected = 0;
+  while (expected < kCount) {
+    bool is_popped = queue.try_pop([&expected](u64 &value) {
+      ASSERT_EQ(value, expected);
+      expected++;
+    });
+    if (!is_popped) {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  ASSERT_EQ(queue.size(), 0);
+}
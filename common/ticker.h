@@ -5,46 +5,102 @@
 #ifndef NEPTUN_COMMON_TICKER_H
 #define NEPTUN_COMMON_TICKER_H
 
+#include <algorithm>
+#include <cassert>
+#include <optional>
+
 #include "common/types.h"
 
 namespace freezing {
 
+// Fires every tick interval. The interval is either a duration, or a rate of ticks per period,
+// which is exact even if the interval isn't a whole number of nanoseconds, e.g. 3000 ticks per
+// second, so that high tick rates don't drift.
 template<typename Clock>
 class Ticker {
 public:
   explicit Ticker(time_point<Clock> now,
                   std::optional<nanoseconds> tick_interval) :
-      m_last_known_now{std::chrono::time_point_cast<nanoseconds>(now)},
-      m_tick_interval{tick_interval} {}
+      m_last_known_now{std::chrono::time_point_cast<nanoseconds>(now)} {
+    if (tick_interval) {
+      set_tick_interval(*tick_interval);
+    }
+  }
 
   bool tick(time_point<Clock> now) {
+    return tick_count(now, 1) > 0;
+  }
+
+  // Returns the number of tick intervals that have elapsed since the last tick, but at most
+  // [max_count]. The intervals beyond [max_count] are skipped.
+  // Returns 1 if there is no tick interval.
+  u64 tick_count(time_point<Clock> now, u64 max_count) {
+    assert(max_count > 0);
     auto elapsed_time = calc_elapsed_time(now);
     m_last_known_now = now;
 
-    if (!elapsed_time || !m_tick_interval) {
-      m_time_since_last_tick = nanoseconds(0);
-      return true;
+    if (!elapsed_time || !m_rate) {
+      m_scaled_time_since_last_tick = nanoseconds(0);
+      return 1;
+    }
+    // The clock may go backwards, e.g. [FakeClock] in the tests.
+    *elapsed_time = std::max(*elapsed_time, nanoseconds(0));
+    // Whole periods are counted separately, so that the scaled time can't overflow.
+    u64 count = static_cast<u64>(*elapsed_time / m_rate->period * m_rate->ticks);
+    m_scaled_time_since_last_tick += (*elapsed_time % m_rate->period) * m_rate->ticks;
+    count += static_cast<u64>(m_scaled_time_since_last_tick / m_rate->period);
+    m_scaled_time_since_last_tick %= m_rate->period;
+    return std::min(count, max_count);
+  }
+
+  // Returns the earliest time at which [tick] returns true, or nothing if [tick] returns true
+  // whenever it's called.
+  std::optional<time_point<Clock>> next_tick_time() const {
+    if (!m_last_known_now || !m_rate) {
+      return {};
     }
-    m_time_since_last_tick += *elapsed_time;
-    if (m_time_since_last_tick >= *m_tick_interval) {
-      m_time_since_last_tick %= *m_tick_interval;
-      return true;
+    // Rounded up, so that the tick has elapsed by then.
+    auto remaining = m_rate->period - m_scaled_time_since_last_tick;
+    return *m_last_known_now + (remaining + nanoseconds(m_rate->ticks - 1)) / m_rate->ticks;
+  }
+
+  // Rounded down to whole nanoseconds.
+  std::optional<nanoseconds> tick_interval() const {
+    if (!m_rate) {
+      return {};
     }
-    return false;
+    return m_rate->period / m_rate->ticks;
   }
 
   void set_tick_interval(nanoseconds tick_interval) {
-    m_tick_interval = tick_interval;
+    set_tick_rate(1, tick_interval);
+  }
+
+  // Fires [ticks] times per [period].
+  void set_tick_rate(u64 ticks, nanoseconds period = seconds(1)) {
+    assert(ticks > 0 && period > nanoseconds(0));
+    if (m_rate) {
+      // The time since the last tick is carried over to the new rate.
+      m_scaled_time_since_last_tick = m_scaled_time_since_last_tick / m_rate->ticks * ticks;
+    }
+    m_rate = Rate{static_cast<i64>(ticks), period};
+    m_scaled_time_since_last_tick %= period;
   }
 
   void clear_tick_interval() {
-    m_tick_interval.reset();
+    m_rate.reset();
   }
 
 private:
+  struct Rate {
+    i64 ticks;
+    nanoseconds period;
+  };
+
   std::optional<time_point<Clock>> m_last_known_now;
-  std::optional<nanoseconds> m_tick_interval;
-  nanoseconds m_time_since_last_tick{};
+  std::optional<Rate> m_rate{};
+  // Time since the last tick multiplied by [m_rate->ticks], always less than [m_rate->period].
+  nanoseconds m_scaled_time_since_last_tick{};
 
   std::optional<nanoseconds> calc_elapsed_time(time_point<Clock> now) const {
     if (m_last_known_now) {
@@ -0,0 +1,57 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+
+#include "common/types.h"
+#include "common/fake_clock.h"
+#include "common/ticker.h"
+
+using namespace freezing;
+
+namespace {
+const FakeClock::time_point kNow = FakeClock::now();
+}
+
+TEST(TickerTest, NextTickTime) {
+  Ticker<FakeClock> ticker{kNow, milliseconds(10)};
+  ASSERT_EQ(ticker.next_tick_time(), kNow + milliseconds(10));
+
+  ASSERT_FALSE(ticker.tick(kNow + milliseconds(4)));
+  ASSERT_EQ(ticker.next_tick_time(), kNow + milliseconds(10));
+
+  // The remainder carries over to the next tick.
+  ASSERT_TRUE(ticker.tick(kNow + milliseconds(13)));
+  ASSERT_EQ(ticker.next_tick_time(), kNow + milliseconds(20));
+  ASSERT_FALSE(ticker.tick(*ticker.next_tick_time() - nanoseconds(1)));
+  ASSERT_TRUE(ticker.tick(kNow + milliseconds(20)));
+}
+
+TEST(TickerTest, NoNextTickTimeWithoutInterval) {
+  Ticker<FakeClock> ticker{kNow, {}};
+  ASSERT_FALSE(ticker.next_tick_time());
+  ASSERT_TRUE(ticker.tick(kNow));
+}
+
+TEST(TickerTest, TickRateDoesntDrift) {
+  // The interval is 333333.33ns, which would drift by 1ns per tick if it was rounded.
+  Ticker<FakeClock> ticker{kNow, {}};
+  ticker.set_tick_rate(3000);
+  u64 tick_count = 0;
+  for (auto now = kNow; now < kNow + seconds(1); now += microseconds(100)) {
+    tick_count += ticker.tick_count(now + microseconds(100), 1);
+  }
+  ASSERT_EQ(tick_count, 3000);
+  ASSERT_EQ(ticker.next_tick_time(), kNow + seconds(1) + nanoseconds(333334));
+}
+
+TEST(TickerTest, TickCountCatchesUp) {
+  Ticker<FakeClock> ticker{kNow, {}};
+  ticker.set_tick_rate(3000);
+  // 3.5 intervals.
+  ASSERT_EQ(ticker.tick_count(kNow + nanoseconds(1'166'667), 10), 3);
+  // The intervals beyond the maximum are skipped.
+  ASSERT_EQ(ticker.tick_count(kNow + milliseconds(11), 5), 5);
+  ASSERT_EQ(ticker.tick_count(kNow + milliseconds(11), 5), 0);
+}
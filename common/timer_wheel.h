@@ -0,0 +1,308 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_COMMON_TIMER_WHEEL_H
+#define NEPTUN_COMMON_TIMER_WHEEL_H
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <limits>
+#include <vector>
+
+#include "common/types.h"
+
+namespace freezing {
+
+struct TimerId {
+  u32 index;
+  u32 generation;
+
+  bool operator==(const TimerId &other) const = default;
+};
+
+// Hierarchical timer wheel, which expires timers in O(1) amortized time per timer, regardless of
+// how many timers are scheduled.
+//
+// Time is divided into ticks of [resolution], counted from the clock's epoch. Level 0 has a slot
+// per tick, and every next level has a slot per [kSlotCount] slots of the previous level. A timer
+// is stored in the lowest level whose window contains it, and is moved (cascaded) to a lower
+// level when the time reaches its slot. Timers beyond the highest level are kept in an overflow
+// list until the time gets close enough.
+//
+// Deadlines are rounded up to a whole tick, so timers never expire early, but they may expire up
+// to [resolution] late.
+template<typename Clock, typename Value>
+class TimerWheel {
+public:
+  explicit TimerWheel(nanoseconds resolution = milliseconds(1)) : m_resolution{resolution} {
+    assert(resolution.count() > 0);
+    m_heads.fill(kNone);
+  }
+
+  // Schedules [value] to expire at [deadline]. A deadline that has already passed expires on the
+  // next [advance].
+  TimerId schedule(time_point<Clock> deadline, Value value) {
+    u32 index;
+    if (m_free_nodes.empty()) {
+      index = static_cast<u32>(m_nodes.size());
+      m_nodes.emplace_back();
+    } else {
+      index = m_free_nodes.back();
+      m_free_nodes.pop_back();
+    }
+    auto &node = m_nodes[index];
+    node.expiry = to_tick_ceil(deadline);
+    node.value = std::move(value);
+    insert(index);
+    m_size++;
+    return {index, node.generation};
+  }
+
+  // Returns false if the timer has already expired or has been cancelled.
+  bool cancel(TimerId id) {
+    if (!is_scheduled(id)) {
+      return false;
+    }
+    unlink(id.index);
+    release(id.index);
+    return true;
+  }
+
+  bool is_scheduled(TimerId id) const {
+    return id.index < m_nodes.size() && m_nodes[id.index].generation == id.generation
+        && m_nodes[id.index].list != kNone;
+  }
+
+  // Expires all timers whose deadline is at or before [now], and calls [on_expired] with their
+  // values. Timers scheduled by [on_expired] that have already expired are expired by the next
+  // [advance].
+  template<typename OnExpiredFn>
+  void advance(time_point<Clock> now, OnExpiredFn on_expired) {
+    u64 target = to_tick_floor(now);
+    if (m_size == 0) {
+      m_now = std::max(m_now, target);
+      return;
+    }
+    expire_current_slot(on_expired);
+    while (m_now < target) {
+      u64 next = next_event_tick();
+      if (next > target) {
+        // Nothing happens between now and [target].
+        m_now = target;
+        break;
+      }
+      m_now = next;
+      cascade();
+      expire_current_slot(on_expired);
+    }
+  }
+
+  // Returns a lower bound of the earliest deadline, or nothing if no timers are scheduled.
+  // The bound is exact for timers that expire within [kSlotCount] ticks, otherwise it's the time
+  // at which the timer is cascaded, which is when [advance] should be called next.
+  std::optional<time_point<Clock>> next_deadline() const {
+    if (m_size == 0) {
+      return {};
+    }
+    if (m_heads[list_index(0, slot_of(m_now, 0))] != kNone) {
+      return to_time_point(m_now);
+    }
+    return to_time_point(next_event_tick());
+  }
+
+  // Returns the time at which a timer with [deadline] expires, i.e. the deadline rounded up to
+  // the resolution.
+  time_point<Clock> expiry_time(time_point<Clock> deadline) const {
+    return to_time_point(to_tick_ceil(deadline));
+  }
+
+  usize size() const {
+    return m_size;
+  }
+
+  bool empty() const {
+    return m_size == 0;
+  }
+
+  nanoseconds resolution() const {
+    return m_resolution;
+  }
+
+private:
+  static constexpr u32 kSlotBits = 8;
+  static constexpr u32 kSlotCount = 1 << kSlotBits;
+  static constexpr u32 kLevelCount = 4;
+  static constexpr u32 kBitmapWords = kSlotCount / 64;
+  // The overflow list comes after the lists of all slots.
+  static constexpr u32 kOverflowList = kLevelCount * kSlotCount;
+  static constexpr u32 kNone = std::numeric_limits<u32>::max();
+
+  struct Node {
+    u64 expiry{0};
+    Value value{};
+    u32 prev{kNone};
+    u32 next{kNone};
+    // Index of the list that the node is in, or [kNone] if the node is free.
+    u32 list{kNone};
+    u32 generation{0};
+  };
+
+  nanoseconds m_resolution;
+  // Current tick: all timers up to and including it have expired.
+  u64 m_now{0};
+  usize m_size{0};
+  std::vector<Node> m_nodes{};
+  std::vector<u32> m_free_nodes{};
+  // Heads of the doubly-linked lists of timers, one per slot and one for the overflow.
+  std::array<u32, kLevelCount * kSlotCount + 1> m_heads{};
+  // Bitmaps of non-empty slots, used to skip empty slots.
+  std::array<std::array<u64, kBitmapWords>, kLevelCount> m_occupied{};
+
+  static u32 slot_of(u64 tick, u32 level) {
+    return static_cast<u32>(tick >> (kSlotBits * level)) & (kSlotCount - 1);
+  }
+
+  static u32 list_index(u32 level, u32 slot) {
+    return level * kSlotCount + slot;
+  }
+
+  u64 to_tick_floor(time_point<Clock> time) const {
+    return static_cast<u64>(time.time_since_epoch() / m_resolution);
+  }
+
+  u64 to_tick_ceil(time_point<Clock> time) const {
+    auto since_epoch = time.time_since_epoch();
+    u64 tick = static_cast<u64>(since_epoch / m_resolution);
+    return since_epoch % m_resolution == nanoseconds(0) ? tick : tick + 1;
+  }
+
+  time_point<Clock> to_time_point(u64 tick) const {
+    return time_point<Clock>{} + m_resolution * tick;
+  }
+
+  void insert(u32 index) {
+    auto &node = m_nodes[index];
+    u32 list;
+    if (node.expiry <= m_now) {
+      list = list_index(0, slot_of(m_now, 0));
+    } else {
+      // The highest bit in which the expiry differs from the current tick determines the level.
+      u32 level = (std::bit_width(node.expiry ^ m_now) - 1) / kSlotBits;
+      list = level < kLevelCount ? list_index(level, slot_of(node.expiry, level)) : kOverflowList;
+    }
+    node.list = list;
+    node.prev = kNone;
+    node.next = m_heads[list];
+    if (node.next != kNone) {
+      m_nodes[node.next].prev = index;
+    }
+    m_heads[list] = index;
+    if (list != kOverflowList) {
+      m_occupied[list / kSlotCount][(list % kSlotCount) / 64] |= u64(1) << (list % 64);
+    }
+  }
+
+  void unlink(u32 index) {
+    auto &node = m_nodes[index];
+    if (node.prev != kNone) {
+      m_nodes[node.prev].next = node.next;
+    } else {
+      m_heads[node.list] = node.next;
+    }
+    if (node.next != kNone) {
+      m_nodes[node.next].prev = node.prev;
+    }
+    if (m_heads[node.list] == kNone && node.list != kOverflowList) {
+      m_occupied[node.list / kSlotCount][(node.list % kSlotCount) / 64] &=
+          ~(u64(1) << (node.list % 64));
+    }
+    node.list = kNone;
+  }
+
+  void release(u32 index) {
+    m_nodes[index].generation++;
+    m_free_nodes.push_back(index);
+    m_size--;
+  }
+
+  // Detaches the list and returns its first node.
+  u32 take_list(u32 list) {
+    u32 head = m_heads[list];
+    m_heads[list] = kNone;
+    if (list != kOverflowList) {
+      m_occupied[list / kSlotCount][(list % kSlotCount) / 64] &= ~(u64(1) << (list % 64));
+    }
+    return head;
+  }
+
+  template<typename OnExpiredFn>
+  void expire_current_slot(OnExpiredFn &on_expired) {
+    u32 index = take_list(list_index(0, slot_of(m_now, 0)));
+    while (index != kNone) {
+      u32 next = m_nodes[index].next;
+      m_nodes[index].list = kNone;
+      Value value = std::move(m_nodes[index].value);
+      release(index);
+      on_expired(std::move(value));
+      index = next;
+    }
+  }
+
+  // Moves the timers of the slots that have been reached by the current tick to lower levels,
+  // starting from the highest level, because its timers may land in the reached slots of the
+  // lower levels.
+  void cascade() {
+    if (m_now % (u64(1) << (kSlotBits * kLevelCount)) == 0) {
+      reinsert(take_list(kOverflowList));
+    }
+    for (u32 level = kLevelCount - 1; level > 0; level--) {
+      if (m_now % (u64(1) << (kSlotBits * level)) == 0) {
+        reinsert(take_list(list_index(level, slot_of(m_now, level))));
+      }
+    }
+  }
+
+  void reinsert(u32 index) {
+    while (index != kNone) {
+      u32 next = m_nodes[index].next;
+      insert(index);
+      index = next;
+    }
+  }
+
+  // Returns the first occupied slot at [level] after [from], or nothing.
+  std::optional<u32> next_occupied_slot(u32 level, u32 from) const {
+    for (u32 word = from / 64; word < kBitmapWords; word++) {
+      u64 bits = m_occupied[level][word];
+      if (word == from / 64) {
+        bits &= from % 64 == 63 ? 0 : ~u64(0) << (from % 64 + 1);
+      }
+      if (bits != 0) {
+        return word * 64 + std::countr_zero(bits);
+      }
+    }
+    return {};
+  }
+
+  // Returns the earliest tick after the current one at which a timer expires or is cascaded.
+  u64 next_event_tick() const {
+    for (u32 level = 0; level < kLevelCount; level++) {
+      auto slot = next_occupied_slot(level, slot_of(m_now, level));
+      if (slot) {
+        u32 window_bits = kSlotBits * (level + 1);
+        return (m_now >> window_bits << window_bits) | (u64(*slot) << (kSlotBits * level));
+      }
+    }
+    if (m_heads[kOverflowList] != kNone) {
+      u32 window_bits = kSlotBits * kLevelCount;
+      return ((m_now >> window_bits) + 1) << window_bits;
+    }
+    return std::numeric_limits<u64>::max();
+  }
+};
+
+}
+
+#endif //NEPTUN_COMMON_TIMER_WHEEL_H
@@ -0,0 +1,125 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "common/types.h"
+#include "common/fake_clock.h"
+#include "common/timer_wheel.h"
+
+using namespace freezing;
+
+namespace {
+const FakeClock::time_point kNow = FakeClock::now();
+}
+
+TEST(TimerWheelTest, ExpiresTimersAtDeadline) {
+  TimerWheel<FakeClock, u32> timer_wheel{milliseconds(1)};
+  std::vector<u32> expired{};
+  auto on_expired = [&expired](u32 value) { expired.push_back(value); };
+
+  timer_wheel.schedule(kNow + milliseconds(5), 1);
+  // Further than the first level.
+  timer_wheel.schedule(kNow + milliseconds(300), 2);
+  // Further than the second level.
+  timer_wheel.schedule(kNow + seconds(70), 3);
+  ASSERT_EQ(timer_wheel.size(), 3);
+  ASSERT_EQ(timer_wheel.next_deadline(), kNow + milliseconds(5));
+
+  timer_wheel.advance(kNow + milliseconds(4), on_expired);
+  ASSERT_TRUE(expired.empty());
+  timer_wheel.advance(kNow + milliseconds(5), on_expired);
+  ASSERT_EQ(expired, std::vector<u32>{1});
+
+  timer_wheel.advance(kNow + milliseconds(299), on_expired);
+  ASSERT_EQ(expired, std::vector<u32>{1});
+  ASSERT_EQ(timer_wheel.next_deadline(), kNow + milliseconds(300));
+  timer_wheel.advance(kNow + seconds(1), on_expired);
+  ASSERT_EQ(expired, (std::vector<u32>{1, 2}));
+
+  timer_wheel.advance(kNow + seconds(70) - milliseconds(1), on_expired);
+  ASSERT_EQ(expired.size(), 2);
+  timer_wheel.advance(kNow + seconds(70), on_expired);
+  ASSERT_EQ(expired, (std::vector<u32>{1, 2, 3}));
+  ASSERT_TRUE(timer_wheel.empty());
+  ASSERT_FALSE(timer_wheel.next_deadline());
+}
+
+TEST(TimerWheelTest, RoundsDeadlinesUp) {
+  TimerWheel<FakeClock, u32> timer_wheel{milliseconds(1)};
+  usize expired_count = 0;
+  auto on_expired = [&expired_count](u32) { expired_count++; };
+
+  timer_wheel.schedule(kNow + microseconds(5500), 1);
+  timer_wheel.advance(kNow + microseconds(5900), on_expired);
+  ASSERT_EQ(expired_count, 0);
+  timer_wheel.advance(kNow + milliseconds(6), on_expired);
+  ASSERT_EQ(expired_count, 1);
+
+  // Deadlines that have passed expire on the next advance.
+  timer_wheel.schedule(kNow, 2);
+  timer_wheel.advance(kNow + milliseconds(6), on_expired);
+  ASSERT_EQ(expired_count, 2);
+}
+
+TEST(TimerWheelTest, CancelTimer) {
+  TimerWheel<FakeClock, u32> timer_wheel{milliseconds(1)};
+  usize expired_count = 0;
+  auto on_expired = [&expired_count](u32) { expired_count++; };
+
+  auto id = timer_wheel.schedule(kNow + milliseconds(10), 1);
+  auto other_id = timer_wheel.schedule(kNow + milliseconds(10), 2);
+  ASSERT_TRUE(timer_wheel.cancel(id));
+  ASSERT_FALSE(timer_wheel.cancel(id));
+  ASSERT_FALSE(timer_wheel.is_scheduled(id));
+  ASSERT_TRUE(timer_wheel.is_scheduled(other_id));
+
+  // The node is reused, but the cancelled id doesn't refer to the new timer.
+  auto new_id = timer_wheel.schedule(kNow + milliseconds(20), 3);
+  ASSERT_EQ(new_id.index, id.index);
+  ASSERT_FALSE(timer_wheel.cancel(id));
+
+  timer_wheel.advance(kNow + milliseconds(20), on_expired);
+  ASSERT_EQ(expired_count, 2);
+  ASSERT_FALSE(timer_wheel.is_scheduled(other_id));
+}
+
+TEST(TimerWheelTest, MatchesSortedDeadlines) {
+  TimerWheel<FakeClock, u32> timer_wheel{milliseconds(1)};
+  std::mt19937_64 rng{42};
+  std::vector<time_point<FakeClock>> deadlines{};
+  time_point<FakeClock> now = kNow + std::chrono::hours(1000);
+  timer_wheel.advance(now, [](u32) { FAIL(); });
+  for (u32 i = 0; i < 1000; i++) {
+    // Spread the deadlines across all levels and the overflow.
+    auto delay = nanoseconds(rng() % (nanoseconds(milliseconds(1)).count() << (4 + i % 34)));
+    deadlines.push_back(now + delay);
+    timer_wheel.schedule(deadlines.back(), i);
+  }
+
+  std::vector<bool> is_expired(deadlines.size(), false);
+  usize expired_count = 0;
+  while (expired_count < deadlines.size()) {
+    auto next_deadline = timer_wheel.next_deadline();
+    ASSERT_TRUE(next_deadline);
+    ASSERT_GE(*next_deadline, now);
+    now = std::max(now + microseconds(rng() % 100'000), *next_deadline);
+    timer_wheel.advance(now, [&](u32 value) {
+      ASSERT_FALSE(is_expired[value]);
+      ASSERT_LE(deadlines[value], now);
+      is_expired[value] = true;
+      expired_count++;
+    });
+    for (u32 i = 0; i < deadlines.size(); i++) {
+      if (!is_expired[i]) {
+        // Not expired, so the deadline rounded up to a whole millisecond hasn't been reached.
+        ASSERT_GT(std::chrono::ceil<milliseconds>(deadlines[i].time_since_epoch()),
+                  std::chrono::floor<milliseconds>(now.time_since_epoch()));
+      }
+    }
+  }
+  ASSERT_TRUE(timer_wheel.empty());
+}
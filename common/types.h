@@ -7,6 +7,7 @@
 
 #include <chrono>
 #include <cinttypes>
+#include <optional>
 #include <span>
 #include <tl/expected.hpp>
 
@@ -14,7 +14,7 @@ enum class PacketDeliveryStatus {
 
 using PacketId = u32;
 using AckSequenceNumber = u32;
-using AckBitmask = u32;
+using AckBitmask = u64;
 
 }
 
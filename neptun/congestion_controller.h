@@ -0,0 +1,176 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NEPTUN_CONGESTION_CONTROLLER_H
+#define NEPTUN_NEPTUN_CONGESTION_CONTROLLER_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+
+#include "common/types.h"
+#include "neptun/rtt_estimator.h"
+
+namespace freezing::network {
+
+namespace detail {
+
+// How often the send budget is adjusted before the first RTT sample.
+constexpr milliseconds kInitialCongestionUpdateInterval{100};
+
+}
+
+struct CongestionControlConfig {
+  // Without congestion control, packets are sent at the rate and size agreed during the
+  // handshake.
+  bool enabled{true};
+  // The link is considered congested once the smoothed RTT exceeds the minimum RTT by more than
+  // this. Acks are piggybacked on the peer's packets, so it must be larger than the interval
+  // between the peer's packets, otherwise the ack delay alone looks like queueing.
+  milliseconds target_queueing_delay{50};
+  // The send budget is multiplied by these on congestion, at most once per RTT.
+  double delay_decrease_factor{0.85};
+  double loss_decrease_factor{0.7};
+  // Without congestion, the send budget grows by 1 / [increase_steps] of its maximum per RTT.
+  u32 increase_steps{16};
+  // The controller never goes below this packet rate, unless the byte limit is lower.
+  u16 min_packet_rate{10};
+};
+
+// Adapts the send rate and packet size of a peer to the link, within the bandwidth limit agreed
+// during the handshake, from the acks and drops reported by [PacketDeliveryManager].
+//
+// The controller is AIMD on a budget of bytes per second, which only scales the packet rate, down
+// to [min_packet_rate]. Packets stay at the agreed size, since latest states are only accepted
+// if they fit into a packet of that size. Acks without congestion grow the budget additively
+// once per RTT. Drops,
+// and queueing delay beyond [target_queueing_delay], shrink it multiplicatively, also at most
+// once per RTT, so that a single congestion event doesn't collapse the budget.
+//
+// Starts at the agreed limit, which is what game traffic needs right after connecting. Peers
+// without a packet rate or byte limit aren't controlled, since there is nothing to scale down
+// from. A byte limit caps the budget, even if the controller is disabled.
+template<typename Clock>
+class CongestionController {
+public:
+  explicit CongestionController(CongestionControlConfig config = {}) : m_config{config} {}
+
+  // Sets the packet rate, size and bytes per second agreed during the handshake, and resets the
+  // budget to them if they've changed. A zero packet rate or bytes per second means no limit.
+  void set_limit(u16 max_packet_rate, u16 max_packet_size, u32 max_bytes_per_second = 0) {
+    if (max_packet_rate == 0 && max_bytes_per_second != 0) {
+      // The byte limit alone limits the rate of full packets.
+      max_packet_rate = static_cast<u16>(std::clamp<u64>(
+          (max_bytes_per_second + max_packet_size - 1) / max_packet_size,
+          1,
+          std::numeric_limits<u16>::max()));
+    }
+    if (max_packet_rate == m_max_packet_rate && max_packet_size == m_max_packet_size
+        && max_bytes_per_second == m_max_bytes_per_second) {
+      return;
+    }
+    m_max_packet_rate = max_packet_rate;
+    m_max_packet_size = max_packet_size;
+    m_max_bytes_per_second = max_bytes_per_second;
+    m_budget = max_budget();
+    update_rate_and_size();
+  }
+
+  // [rtt] includes the samples of the acked packet.
+  void on_ack(std::optional<RttStats> rtt, time_point<Clock> now) {
+    if (rtt) {
+      m_update_interval = rtt->smoothed;
+    }
+    if (!is_controlled() || !is_update_due(now)) {
+      return;
+    }
+    if (rtt && rtt->smoothed > rtt->min + m_config.target_queueing_delay) {
+      decrease(m_config.delay_decrease_factor, now);
+      return;
+    }
+    m_budget = std::min(max_budget(), m_budget + max_budget() / m_config.increase_steps);
+    update_rate_and_size();
+    m_last_update_time = now;
+  }
+
+  void on_drop(time_point<Clock> now) {
+    if (is_controlled() && is_update_due(now)) {
+      decrease(m_config.loss_decrease_factor, now);
+    }
+  }
+
+  // Zero means no limit.
+  u16 packet_rate() const {
+    return m_packet_rate;
+  }
+
+  u16 packet_size() const {
+    return m_packet_size;
+  }
+
+private:
+  CongestionControlConfig m_config;
+  u16 m_max_packet_rate{0};
+  u16 m_max_packet_size{0};
+  u32 m_max_bytes_per_second{0};
+  // Bytes per second.
+  double m_budget{0};
+  u16 m_packet_rate{0};
+  u16 m_packet_size{0};
+  std::optional<time_point<Clock>> m_last_update_time{};
+  nanoseconds m_update_interval{detail::kInitialCongestionUpdateInterval};
+
+  bool is_controlled() const {
+    return m_config.enabled && m_max_packet_rate != 0;
+  }
+
+  bool is_update_due(time_point<Clock> now) const {
+    return !m_last_update_time || now >= *m_last_update_time + m_update_interval;
+  }
+
+  double max_budget() const {
+    double budget = static_cast<double>(m_max_packet_rate) * m_max_packet_size;
+    if (m_max_bytes_per_second != 0) {
+      budget = std::min(budget, static_cast<double>(m_max_bytes_per_second));
+    }
+    return budget;
+  }
+
+  double min_budget() const {
+    return static_cast<double>(min_packet_rate()) * m_max_packet_size;
+  }
+
+  u16 min_packet_rate() const {
+    // The byte limit may not allow [min_packet_rate] full packets, but at least one is sent.
+    auto budget_rate = std::max(1.0, std::floor(max_budget() / m_max_packet_size));
+    return static_cast<u16>(std::min({static_cast<double>(m_config.min_packet_rate),
+                                      static_cast<double>(m_max_packet_rate),
+                                      budget_rate}));
+  }
+
+  void decrease(double factor, time_point<Clock> now) {
+    m_budget = std::max(min_budget(), m_budget * factor);
+    update_rate_and_size();
+    m_last_update_time = now;
+  }
+
+  void update_rate_and_size() {
+    if (m_max_packet_rate == 0) {
+      m_packet_rate = 0;
+      m_packet_size = m_max_packet_size;
+      return;
+    }
+    // Without congestion control, the budget stays at its maximum.
+    double rate = std::clamp(std::round(m_budget / m_max_packet_size),
+                             static_cast<double>(min_packet_rate()),
+                             static_cast<double>(m_max_packet_rate));
+    m_packet_rate = static_cast<u16>(rate);
+    m_packet_size = m_max_packet_size;
+  }
+};
+
+}
+
+#endif //NEPTUN_NEPTUN_CONGESTION_CONTROLLER_H
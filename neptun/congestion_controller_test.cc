@@ -0,0 +1,132 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+
+#include "common/fake_clock.h"
+#include "common/types.h"
+#include "neptun/congestion_controller.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+
+const FakeClock::time_point kNow = FakeClock::now();
+
+RttStats rtt(milliseconds smoothed, milliseconds min) {
+  return RttStats{smoothed, smoothed, milliseconds(0), min, 10};
+}
+
+}
+
+TEST(CongestionControllerTest, StartsAtLimit) {
+  CongestionController<FakeClock> controller{};
+  ASSERT_EQ(controller.packet_rate(), 0);
+
+  controller.set_limit(100, 1000);
+  ASSERT_EQ(controller.packet_rate(), 100);
+  ASSERT_EQ(controller.packet_size(), 1000);
+}
+
+TEST(CongestionControllerTest, BytesPerSecondLimit) {
+  CongestionController<FakeClock> controller{};
+  // The byte limit allows 20 full packets per second.
+  controller.set_limit(100, 1000, 20'000);
+  ASSERT_EQ(controller.packet_rate(), 20);
+  ASSERT_EQ(controller.packet_size(), 1000);
+
+  // Without a packet rate limit, the byte limit determines the packet rate.
+  controller.set_limit(0, 1000, 50'000);
+  ASSERT_EQ(controller.packet_rate(), 50);
+  ASSERT_EQ(controller.packet_size(), 1000);
+
+  // Packets don't shrink, even below [min_packet_rate] full packets.
+  controller.set_limit(100, 1000, 2'000);
+  ASSERT_EQ(controller.packet_rate(), 2);
+  ASSERT_EQ(controller.packet_size(), 1000);
+  controller.set_limit(100, 1000, 500);
+  ASSERT_EQ(controller.packet_rate(), 1);
+  ASSERT_EQ(controller.packet_size(), 1000);
+}
+
+TEST(CongestionControllerTest, BytesPerSecondLimitWithoutCongestionControl) {
+  CongestionController<FakeClock> controller{CongestionControlConfig{.enabled = false}};
+  controller.set_limit(3000, 1400, 1'400'000);
+  ASSERT_EQ(controller.packet_rate(), 1000);
+  ASSERT_EQ(controller.packet_size(), 1400);
+}
+
+TEST(CongestionControllerTest, SlowsDownOncePerRttOnDrops) {
+  CongestionController<FakeClock> controller{};
+  controller.set_limit(100, 1000);
+  controller.on_ack(rtt(milliseconds(20), milliseconds(20)), kNow);
+
+  controller.on_drop(kNow + milliseconds(20));
+  ASSERT_EQ(controller.packet_rate(), 70);
+  ASSERT_EQ(controller.packet_size(), 1000);
+  // Drops within the same RTT belong to the same congestion event.
+  controller.on_drop(kNow + milliseconds(30));
+  ASSERT_EQ(controller.packet_rate(), 70);
+
+  controller.on_drop(kNow + milliseconds(40));
+  ASSERT_EQ(controller.packet_rate(), 49);
+}
+
+TEST(CongestionControllerTest, SlowsDownOnQueueingDelay) {
+  CongestionController<FakeClock> controller{CongestionControlConfig{.target_queueing_delay = milliseconds(50)}};
+  controller.set_limit(100, 1000);
+
+  controller.on_ack(rtt(milliseconds(70), milliseconds(20)), kNow);
+  ASSERT_EQ(controller.packet_rate(), 100);
+  controller.on_ack(rtt(milliseconds(80), milliseconds(20)), kNow + milliseconds(80));
+  ASSERT_EQ(controller.packet_rate(), 85);
+}
+
+TEST(CongestionControllerTest, KeepsPacketSizeAtMinRate) {
+  CongestionController<FakeClock> controller{CongestionControlConfig{.min_packet_rate = 20}};
+  controller.set_limit(30, 1000);
+  auto now = kNow;
+  for (usize i = 0; i < 10; i++, now += seconds(1)) {
+    controller.on_drop(now);
+  }
+  ASSERT_EQ(controller.packet_rate(), 20);
+  ASSERT_EQ(controller.packet_size(), 1000);
+}
+
+TEST(CongestionControllerTest, RecoversUpToLimit) {
+  CongestionController<FakeClock> controller{};
+  controller.set_limit(100, 1000);
+  auto now = kNow;
+  controller.on_ack(rtt(milliseconds(20), milliseconds(20)), now);
+  now += milliseconds(20);
+  controller.on_drop(now);
+  ASSERT_EQ(controller.packet_rate(), 70);
+
+  // Acks grow the rate once per RTT.
+  now += milliseconds(20);
+  controller.on_ack(rtt(milliseconds(20), milliseconds(20)), now);
+  controller.on_ack(rtt(milliseconds(20), milliseconds(20)), now + milliseconds(1));
+  ASSERT_EQ(controller.packet_rate(), 76);
+
+  for (usize i = 0; i < 100; i++) {
+    now += milliseconds(20);
+    controller.on_ack(rtt(milliseconds(20), milliseconds(20)), now);
+  }
+  ASSERT_EQ(controller.packet_rate(), 100);
+  ASSERT_EQ(controller.packet_size(), 1000);
+}
+
+TEST(CongestionControllerTest, DoesNotControlUnlimitedRateOrWhenDisabled) {
+  CongestionController<FakeClock> unlimited{};
+  unlimited.set_limit(0, 1000);
+  unlimited.on_drop(kNow);
+  ASSERT_EQ(unlimited.packet_rate(), 0);
+  ASSERT_EQ(unlimited.packet_size(), 1000);
+
+  CongestionController<FakeClock> disabled{CongestionControlConfig{.enabled = false}};
+  disabled.set_limit(100, 1000);
+  disabled.on_drop(kNow);
+  ASSERT_EQ(disabled.packet_rate(), 100);
+}
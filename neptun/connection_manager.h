@@ -15,23 +15,39 @@
 #include "neptun/messages/message_header.h"
 #include "neptun/messages/lets_connect.h"
 #include "neptun/messages/reject_lets_connect.h"
+#include "neptun/messages/connect_challenge.h"
+#include "neptun/messages/update_bandwidth_limit.h"
 
 namespace freezing::network {
 
-// 0 packet rate means no limit.
+// 0 packet rate or bytes per second means no limit.
 struct BandwidthLimit {
   // Maximum rate of incoming packets.
-  u8 max_read_packet_rate;
+  u16 max_read_packet_rate;
   // Maximum size of the incoming packet in bytes.
   u16 max_read_packet_size;
   // Maximum rate of outgoing packets.
-  u8 max_send_packet_rate;
+  u16 max_send_packet_rate;
   // Maximum size of the outgoing packet in bytes.
   u16 max_send_packet_size;
+  // Maximum number of incoming and outgoing bytes per second, on top of the packet rate and size,
+  // e.g. to allow many small packets without also allowing as many large ones.
+  u32 max_read_bytes_per_second{0};
+  u32 max_send_bytes_per_second{0};
 
   bool operator<=>(const BandwidthLimit &) const = default;
 };
 
+// Sizes of our per-peer buffers that the peer must not exceed, which are exchanged during the
+// handshake. Zero means that the size isn't advertised.
+struct BufferLimits {
+  // Number of snapshots of the latest state that are kept. See [LatestStateManager].
+  u16 latest_state_history_size{0};
+  // Payload bytes of reliable messages that are held until the gap before them is filled.
+  // See [ReliableStream].
+  u32 reliable_receive_window{0};
+};
+
 struct ConnectionManagerConfig {
   usize num_redundant_packets;
   BandwidthLimit limit;
@@ -47,13 +63,22 @@ struct ConnectionManagerConfig {
 // peer accepting the connection and the peer requesting to connect, even though both server and
 // client peers are equal at the connection layer):
 //   0) The client peer sends the LetsConnect message.
-//   1) The server peer receives the LetsConnect message and decides whether it's okay to establish
+//   1) If the client peer is unknown, the server peer responds with the ConnectChallenge message
+//      instead, without keeping any state for the client peer. The challenge contains a cookie
+//      derived from the client's address with a secret key (like TCP SYN cookies), which the
+//      client echoes in its next LetsConnect messages. This proves that the client owns its
+//      address, so spoofed packets never allocate any per-peer state. See [HandshakeCookies].
+//   2) The server peer receives the LetsConnect message and decides whether it's okay to establish
 //      the connection with the client peer.
 //      The request specifies the maximum bandwidth capacity the client peer can handle.
-//   2) The server peer responds with the LetsConnect message and includes its own bandwidth
+//   3) The server peer responds with the LetsConnect message and includes its own bandwidth
 //      limits.
 //      If the connection should be rejected, the server responds with RejectLetsConnect.
-//   3) At some point in the future, any peer may gracefully disconnect from the other by sending
+//   4) Once connected, any peer may change its bandwidth limit by sending the
+//      UpdateBandwidthLimit message, which is resent until it's acked. Each update has a higher
+//      version than the previous one, so that delayed updates and handshake messages don't
+//      overwrite a newer limit.
+//   5) At some point in the future, any peer may gracefully disconnect from the other by sending
 //      the Bye message. The Bye message is not required, e.g. a peer may crash, so this is only
 //      best-effort. Therefore, the receiving peer doesn't respond to it.
 //
@@ -98,8 +123,8 @@ struct ConnectionManagerConfig {
 // state again.
 class ConnectionManager {
 public:
-  explicit ConnectionManager(ConnectionManagerConfig config)
-      : m_config{config} {}
+  explicit ConnectionManager(ConnectionManagerConfig config, BufferLimits buffer_limits = {})
+      : m_config{config}, m_buffer_limits{buffer_limits} {}
 
   // Next time write() function is called it will include LetsConnect message.
   void connect() {
@@ -115,6 +140,31 @@ public:
     return is_peer_connected() && m_self_is_connected;
   }
 
+  // Changes our bandwidth limit. If the handshake is still in progress, the new limit is sent
+  // in the next LetsConnect messages, and it's sent with UpdateBandwidthLimit once the peer is
+  // connected, until the peer acks it.
+  void update_limit(BandwidthLimit limit) {
+    m_config.limit = limit;
+    m_limit_version++;
+    m_should_send_limit_update = true;
+    // An ack of the previous update doesn't mean that the peer knows this one.
+    m_in_flight_limit_update.reset();
+  }
+
+  BandwidthLimit limit() const {
+    return m_config.limit;
+  }
+
+  // Whether the peer hasn't acked our latest bandwidth limit update yet.
+  bool has_pending_limit_update() const {
+    return m_should_send_limit_update || m_in_flight_limit_update.has_value();
+  }
+
+  // Whether the next write() writes a message.
+  bool has_pending_messages() const {
+    return m_num_lets_connect_to_send > 0 || (m_should_send_limit_update && is_peer_connected());
+  }
+
   void on_packet_status_delivery(PacketId packet_id, PacketDeliveryStatus status) {
     switch (status) {
       case PacketDeliveryStatus::ACK: {
@@ -124,10 +174,12 @@ public:
           while (!m_in_flight_lets_connect.empty()) {
             m_in_flight_lets_connect.pop();
           }
-          m_in_flight_lets_connect.pop();
           // No need to send redundant packets anymore.
           m_num_lets_connect_to_send = 0;
         }
+        if (m_in_flight_limit_update == packet_id) {
+          m_in_flight_limit_update.reset();
+        }
         break;
       }
       case PacketDeliveryStatus::DROP: {
@@ -137,6 +189,10 @@ public:
             m_num_lets_connect_to_send++;
           }
         }
+        if (m_in_flight_limit_update == packet_id) {
+          m_in_flight_limit_update.reset();
+          m_should_send_limit_update = true;
+        }
         break;
       }
     }
@@ -167,7 +223,7 @@ public:
     switch (message_header.message_type()) {
       case LetsConnect::kId: {
         LetsConnect lets_connect(advance(buffer, idx));
-        if (validate(lets_connect)) {
+        if (validate(lets_connect.max_send_packet_size(), lets_connect.max_read_packet_size())) {
           // If we see any invalid requests, all future requests are ignored.
           is_fail = false;
           if (!m_is_initiator) {
@@ -183,6 +239,41 @@ public:
         }
         return idx + LetsConnect::kSerializedSize;
       }
+      case ConnectChallenge::kId: {
+        if (buffer.size() < idx + ConnectChallenge::kSerializedSize) {
+          return make_error(NeptunError::MALFORMED_PACKET);
+        }
+        ConnectChallenge challenge(advance(buffer, idx));
+        // Challenges are only expected in response to our request. A new cookie means that the
+        // previous requests have been ignored, so they are sent again.
+        if (m_is_initiator && !is_peer_connected() && challenge.cookie() != m_cookie) {
+          m_cookie = challenge.cookie();
+          m_num_lets_connect_to_send = m_config.num_redundant_packets + 1;
+        }
+        return idx + ConnectChallenge::kSerializedSize;
+      }
+      case UpdateBandwidthLimit::kId: {
+        if (buffer.size() < idx + UpdateBandwidthLimit::kSerializedSize) {
+          return make_error(NeptunError::MALFORMED_PACKET);
+        }
+        UpdateBandwidthLimit update(advance(buffer, idx));
+        if (!validate(update.max_send_packet_size(), update.max_read_packet_size())) {
+          return make_error(NeptunError::MALFORMED_PACKET);
+        }
+        // Updates are only sent once the handshake is complete, and may arrive out of order.
+        if (is_peer_connected() && update.version() > m_peer_limit_version) {
+          m_peer_limit_version = update.version();
+          m_peer_bandwidth_limit = BandwidthLimit{
+              .max_read_packet_rate = update.max_read_packet_rate(),
+              .max_read_packet_size = update.max_read_packet_size(),
+              .max_send_packet_rate = update.max_send_packet_rate(),
+              .max_send_packet_size = update.max_send_packet_size(),
+              .max_read_bytes_per_second = update.max_read_bytes_per_second(),
+              .max_send_bytes_per_second = update.max_send_bytes_per_second(),
+          };
+        }
+        return idx + UpdateBandwidthLimit::kSerializedSize;
+      }
       case RejectLetsConnect::kId:
         return make_error(NeptunError::LETS_CONNECT_REJECTED);
       default:
@@ -200,7 +291,7 @@ public:
       usize idx = payload.size();
       IoBuffer io{buffer};
       if (is_fail) {
-        MessageHeader::write(advance(buffer, idx), LetsConnect::kId);
+        MessageHeader::write(advance(buffer, idx), RejectLetsConnect::kId);
         RejectLetsConnect::write(advance(buffer, idx + MessageHeader::kSerializedSize));
         idx += MessageHeader::kSerializedSize + RejectLetsConnect::kSerializedSize;
       } else {
@@ -209,13 +300,31 @@ public:
                            m_config.limit.max_send_packet_rate,
                            m_config.limit.max_read_packet_rate,
                            m_config.limit.max_send_packet_size,
-                           m_config.limit.max_read_packet_size);
+                           m_config.limit.max_read_packet_size,
+                           m_config.limit.max_send_bytes_per_second,
+                           m_config.limit.max_read_bytes_per_second,
+                           m_buffer_limits.latest_state_history_size,
+                           m_buffer_limits.reliable_receive_window,
+                           m_cookie);
         idx += MessageHeader::kSerializedSize + LetsConnect::kSerializedSize;
       }
       m_in_flight_lets_connect.push(packet_id);
       assert(idx < buffer.size());
       m_num_lets_connect_to_send--;
       return idx;
+    } else if (m_should_send_limit_update && is_peer_connected()) {
+      usize idx = write_message_header(buffer, UpdateBandwidthLimit::kId);
+      idx += UpdateBandwidthLimit::write(advance(buffer, idx),
+                                         m_limit_version,
+                                         m_config.limit.max_send_packet_rate,
+                                         m_config.limit.max_read_packet_rate,
+                                         m_config.limit.max_send_packet_size,
+                                         m_config.limit.max_read_packet_size,
+                                         m_config.limit.max_send_bytes_per_second,
+                                         m_config.limit.max_read_bytes_per_second).size();
+      m_in_flight_limit_update = packet_id;
+      m_should_send_limit_update = false;
+      return idx;
     } else {
       return 0;
     }
@@ -225,27 +334,86 @@ public:
     return m_peer_bandwidth_limit;
   }
 
+  // Known once the peer is connected.
+  BufferLimits peer_buffer_limits() const {
+    return m_peer_buffer_limits;
+  }
+
+  // The following functions handle the handshake with unknown peers without any per-peer state.
+
+  // Returns the cookie of the LetsConnect message in [buffer], which is a packet without the
+  // packet header, or nothing if the packet doesn't start with a LetsConnect message.
+  static std::optional<u64> read_lets_connect_cookie(byte_span buffer) {
+    constexpr usize kLetsConnectOffset = Segment::kSerializedSize + MessageHeader::kSerializedSize;
+    if (buffer.size() < kLetsConnectOffset + LetsConnect::kSerializedSize) {
+      return {};
+    }
+    Segment segment(buffer);
+    MessageHeader message_header(advance(buffer, Segment::kSerializedSize));
+    if (segment.manager_type() != ManagerType::CONNECTION_MANAGER || segment.message_count() != 1
+        || message_header.message_type() != LetsConnect::kId) {
+      return {};
+    }
+    return LetsConnect(advance(buffer, kLetsConnectOffset)).cookie();
+  }
+
+  static usize write_challenge(byte_span buffer, u64 cookie) {
+    usize idx = write_message_header(buffer, ConnectChallenge::kId);
+    return idx + ConnectChallenge::write(advance(buffer, idx), cookie).size();
+  }
+
+  static usize write_reject(byte_span buffer) {
+    usize idx = write_message_header(buffer, RejectLetsConnect::kId);
+    return idx + RejectLetsConnect::write(advance(buffer, idx)).size();
+  }
+
 private:
   ConnectionManagerConfig m_config;
+  BufferLimits m_buffer_limits;
+  BufferLimits m_peer_buffer_limits{};
   std::queue<PacketId> m_in_flight_lets_connect{};
   usize m_num_lets_connect_to_send{0};
   bool is_fail{false};
   bool m_is_initiator{false};
+  // Cookie from the peer's challenge, echoed in our LetsConnect messages.
+  u64 m_cookie{0};
   bool m_self_is_connected{false};
   std::optional<BandwidthLimit> m_peer_bandwidth_limit{};
+  // Version of our latest bandwidth limit update, 0 if the limit hasn't changed since the
+  // handshake.
+  u32 m_limit_version{0};
+  bool m_should_send_limit_update{false};
+  std::optional<PacketId> m_in_flight_limit_update{};
+  // Version of the latest update received from the peer, 0 if none.
+  u32 m_peer_limit_version{0};
+
+  // Writes the segment and the message header of a single connection manager message.
+  static usize write_message_header(byte_span buffer, u8 message_type) {
+    usize idx = Segment::write(buffer, ManagerType::CONNECTION_MANAGER, 1).size();
+    return idx + MessageHeader::write(advance(buffer, idx), message_type).size();
+  }
 
-  bool validate(LetsConnect lets_connect) {
-    return (lets_connect.max_send_packet_size() >= 100
-        && lets_connect.max_read_packet_size() >= 100);
+  static bool validate(u16 max_send_packet_size, u16 max_read_packet_size) {
+    return max_send_packet_size >= 100 && max_read_packet_size >= 100;
   }
 
   void set_peer_bandwidth_limit(LetsConnect lets_connect) {
+    m_peer_buffer_limits = BufferLimits{
+        .latest_state_history_size = lets_connect.latest_state_history_size(),
+        .reliable_receive_window = lets_connect.reliable_receive_window(),
+    };
+    if (m_peer_limit_version > 0) {
+      // Redundant LetsConnect messages must not revert the limit that the peer has updated.
+      return;
+    }
     m_peer_bandwidth_limit =
         BandwidthLimit{
             .max_read_packet_rate = lets_connect.max_read_packet_rate(),
             .max_read_packet_size = lets_connect.max_read_packet_size(),
             .max_send_packet_rate = lets_connect.max_send_packet_rate(),
             .max_send_packet_size = lets_connect.max_send_packet_size(),
+            .max_read_bytes_per_second = lets_connect.max_read_bytes_per_second(),
+            .max_send_bytes_per_second = lets_connect.max_send_bytes_per_second(),
         };
   }
 };
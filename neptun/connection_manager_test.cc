@@ -22,6 +22,20 @@ std::vector<u8> make_buffer(usize size = 1600) {
   return std::vector<u8>(size);
 }
 
+// Completes the handshake, and acks the handshake packets on both sides.
+void handshake(ConnectionManager &server, ConnectionManager &client) {
+  auto buffer = make_buffer();
+  client.connect();
+  auto count = client.write(kPacketId, buffer);
+  ASSERT_TRUE(server.read(byte_span(buffer).first(count)).has_value());
+  count = server.write(kPacketId, buffer);
+  ASSERT_TRUE(client.read(byte_span(buffer).first(count)).has_value());
+  client.on_packet_status_delivery(kPacketId, PacketDeliveryStatus::ACK);
+  server.on_packet_status_delivery(kPacketId, PacketDeliveryStatus::ACK);
+  ASSERT_TRUE(client.is_fully_connected());
+  ASSERT_TRUE(server.is_fully_connected());
+}
+
 }
 
 namespace freezing::network {
@@ -63,6 +77,35 @@ TEST(ConnectionManagerTest, Handshake) {
   }
 }
 
+TEST(ConnectionManagerTest, HandshakeWithHighPacketRateAndByteLimits) {
+  constexpr BandwidthLimit kServerLimit{
+      .max_read_packet_rate = 20'000,
+      .max_read_packet_size = 1400,
+      .max_send_packet_rate = 5'000,
+      .max_send_packet_size = 1400,
+      .max_read_bytes_per_second = 10'000'000,
+      .max_send_bytes_per_second = 2'000'000,
+  };
+  ConnectionManager server{ConnectionManagerConfig{0 /* num_redundant_packets */, kServerLimit}};
+  ConnectionManager client{ConnectionManagerConfig{0 /* num_redundant_packets */, kClientBandwidthLimit}};
+  handshake(server, client);
+  ASSERT_EQ(client.peer_limit(), std::optional{kServerLimit});
+}
+
+TEST(ConnectionManagerTest, HandshakeExchangesBufferLimits) {
+  ConnectionManager server{ConnectionManagerConfig{0 /* num_redundant_packets */, kServerBandwidthLimit},
+                           BufferLimits{.latest_state_history_size = 32,
+                                        .reliable_receive_window = 1000}};
+  ConnectionManager client{ConnectionManagerConfig{0 /* num_redundant_packets */, kClientBandwidthLimit},
+                           BufferLimits{.latest_state_history_size = 4,
+                                        .reliable_receive_window = 64 * 1024}};
+  handshake(server, client);
+  ASSERT_EQ(server.peer_buffer_limits().latest_state_history_size, 4);
+  ASSERT_EQ(client.peer_buffer_limits().latest_state_history_size, 32);
+  ASSERT_EQ(server.peer_buffer_limits().reliable_receive_window, 64 * 1024);
+  ASSERT_EQ(client.peer_buffer_limits().reliable_receive_window, 1000);
+}
+
 TEST(ConnectionManagerTest, InvalidBandwidthLimit) {
   auto buffer = make_buffer();
   ConnectionManager server{ConnectionManagerConfig{kNumRedundantPackets, kServerBandwidthLimit}};
@@ -133,4 +176,141 @@ TEST(ConnectionManagerTest, DoesNothingIfNoPacketDeliveryStatus) {
     auto count = client.write(kPacketId + 1, buffer);
     ASSERT_EQ(count, 0);
   }
-}
\ No newline at end of file
+}
+TEST(ConnectionManagerTest, EchoesChallengeCookie) {
+  constexpr u64 kCookie = 0x0123456789abcdef;
+  auto buffer = make_buffer();
+  ConnectionManager client{ConnectionManagerConfig{0 /* num_redundant_packets */, kClientBandwidthLimit}};
+
+  client.connect();
+  {
+    auto count = client.write(kPacketId, buffer);
+    ASSERT_EQ(ConnectionManager::read_lets_connect_cookie(byte_span(buffer).first(count)), 0);
+  }
+
+  {
+    // The server doesn't know the client, so it challenges the client without any state.
+    auto count = ConnectionManager::write_challenge(buffer, kCookie);
+    auto read_result = client.read(byte_span(buffer).first(count));
+    ASSERT_EQ(read_result, count);
+    ASSERT_FALSE(client.is_peer_connected());
+  }
+
+  {
+    // The request is sent again, even though the redundant packets have been used up.
+    auto count = client.write(kPacketId + 1, buffer);
+    ASSERT_GT(count, 0);
+    ASSERT_EQ(ConnectionManager::read_lets_connect_cookie(byte_span(buffer).first(count)), kCookie);
+    ASSERT_EQ(client.write(kPacketId + 2, buffer), 0);
+  }
+
+  {
+    auto count = ConnectionManager::write_reject(buffer);
+    auto read_result = client.read(byte_span(buffer).first(count));
+    ASSERT_EQ(read_result, make_error(NeptunError::LETS_CONNECT_REJECTED));
+  }
+}
+
+TEST(ConnectionManagerTest, ReadLetsConnectCookieOfOtherMessages) {
+  auto buffer = make_buffer();
+  ASSERT_FALSE(ConnectionManager::read_lets_connect_cookie(byte_span(buffer).first(0)));
+  auto count = ConnectionManager::write_challenge(buffer, 1);
+  ASSERT_FALSE(ConnectionManager::read_lets_connect_cookie(byte_span(buffer).first(count)));
+
+  ConnectionManager client{ConnectionManagerConfig{0 /* num_redundant_packets */, kClientBandwidthLimit}};
+  client.connect();
+  count = client.write(kPacketId, buffer);
+  // Truncated.
+  ASSERT_FALSE(ConnectionManager::read_lets_connect_cookie(byte_span(buffer).first(count - 1)));
+}
+
+TEST(ConnectionManagerTest, UpdatesBandwidthLimit) {
+  constexpr BandwidthLimit kUpdatedLimit{60, 1000, 30, 500};
+  auto buffer = make_buffer();
+  ConnectionManager server{ConnectionManagerConfig{0 /* num_redundant_packets */, kServerBandwidthLimit}};
+  ConnectionManager client{ConnectionManagerConfig{0 /* num_redundant_packets */, kClientBandwidthLimit}};
+  handshake(server, client);
+  ASSERT_FALSE(server.has_pending_limit_update());
+
+  server.update_limit(kUpdatedLimit);
+  ASSERT_EQ(server.limit(), kUpdatedLimit);
+  ASSERT_TRUE(server.has_pending_limit_update());
+  ASSERT_TRUE(server.has_pending_messages());
+  auto count = server.write(kPacketId + 1, buffer);
+  ASSERT_GT(count, 0);
+  ASSERT_FALSE(server.has_pending_messages());
+  // The update is only sent once.
+  auto scratch = make_buffer();
+  ASSERT_EQ(server.write(kPacketId + 2, scratch), 0);
+
+  auto read_result = client.read(byte_span(buffer).first(count));
+  ASSERT_EQ(read_result, count);
+  ASSERT_EQ(client.peer_limit(), std::optional{kUpdatedLimit});
+
+  // Waits for the ack.
+  ASSERT_TRUE(server.has_pending_limit_update());
+  server.on_packet_status_delivery(kPacketId + 1, PacketDeliveryStatus::ACK);
+  ASSERT_FALSE(server.has_pending_limit_update());
+}
+
+TEST(ConnectionManagerTest, ResendsDroppedBandwidthLimitUpdate) {
+  constexpr BandwidthLimit kUpdatedLimit{60, 1000, 30, 500};
+  auto buffer = make_buffer();
+  ConnectionManager server{ConnectionManagerConfig{0 /* num_redundant_packets */, kServerBandwidthLimit}};
+  ConnectionManager client{ConnectionManagerConfig{0 /* num_redundant_packets */, kClientBandwidthLimit}};
+  handshake(server, client);
+
+  server.update_limit(kUpdatedLimit);
+  ASSERT_GT(server.write(kPacketId + 1, buffer), 0);
+  server.on_packet_status_delivery(kPacketId + 1, PacketDeliveryStatus::DROP);
+  ASSERT_TRUE(server.has_pending_limit_update());
+
+  auto count = server.write(kPacketId + 2, buffer);
+  ASSERT_GT(count, 0);
+  ASSERT_TRUE(client.read(byte_span(buffer).first(count)).has_value());
+  ASSERT_EQ(client.peer_limit(), std::optional{kUpdatedLimit});
+  server.on_packet_status_delivery(kPacketId + 2, PacketDeliveryStatus::ACK);
+  ASSERT_FALSE(server.has_pending_limit_update());
+}
+
+TEST(ConnectionManagerTest, IgnoresOutdatedBandwidthLimits) {
+  constexpr BandwidthLimit kFirstLimit{60, 1000, 30, 500};
+  constexpr BandwidthLimit kSecondLimit{90, 1200, 45, 600};
+  auto buffer = make_buffer();
+  ConnectionManager server{ConnectionManagerConfig{0 /* num_redundant_packets */, kServerBandwidthLimit}};
+  ConnectionManager client{ConnectionManagerConfig{0 /* num_redundant_packets */, kClientBandwidthLimit}};
+  handshake(server, client);
+
+  server.update_limit(kFirstLimit);
+  auto first = make_buffer();
+  auto first_count = server.write(kPacketId + 1, first);
+  server.update_limit(kSecondLimit);
+  auto second_count = server.write(kPacketId + 2, buffer);
+  // An ack of the first update doesn't ack the second one.
+  server.on_packet_status_delivery(kPacketId + 1, PacketDeliveryStatus::ACK);
+  ASSERT_TRUE(server.has_pending_limit_update());
+
+  // The first update arrives after the second one.
+  ASSERT_TRUE(client.read(byte_span(buffer).first(second_count)).has_value());
+  ASSERT_TRUE(client.read(byte_span(first).first(first_count)).has_value());
+  ASSERT_EQ(client.peer_limit(), std::optional{kSecondLimit});
+
+  // A delayed LetsConnect from the handshake doesn't revert the update either.
+  ConnectionManager stale{ConnectionManagerConfig{0 /* num_redundant_packets */, kServerBandwidthLimit}};
+  stale.connect();
+  auto count = stale.write(kPacketId, buffer);
+  ASSERT_TRUE(client.read(byte_span(buffer).first(count)).has_value());
+  ASSERT_EQ(client.peer_limit(), std::optional{kSecondLimit});
+}
+
+TEST(ConnectionManagerTest, RejectsInvalidBandwidthLimitUpdate) {
+  auto buffer = make_buffer();
+  ConnectionManager server{ConnectionManagerConfig{0 /* num_redundant_packets */, kServerBandwidthLimit}};
+  ConnectionManager client{ConnectionManagerConfig{0 /* num_redundant_packets */, kClientBandwidthLimit}};
+  handshake(server, client);
+
+  server.update_limit(kInvalidBandwidthLimit);
+  auto count = server.write(kPacketId + 1, buffer);
+  ASSERT_EQ(client.read(byte_span(buffer).first(count)), make_error(NeptunError::MALFORMED_PACKET));
+  ASSERT_EQ(client.peer_limit(), std::optional{kServerBandwidthLimit});
+}
@@ -13,6 +13,7 @@ enum class NeptunError {
   MALFORMED_PACKET = 0,
   PEER_NOT_RESPONDING = 1,
   LETS_CONNECT_REJECTED = 2,
+  RECEIVE_WINDOW_FULL = 3,
 };
 
 }
@@ -5,6 +5,7 @@
 
 #include "common/ticker.h"
 #include "neptun/format.h"
+#include "network/event_loop.h"
 #include "network/udp_socket.h"
 #include "network/message.h"
 #include "neptun.h"
@@ -42,15 +43,19 @@ int main(int argc, char **argv) {
   ConnectionManagerConfig config{5, BandwidthLimit{120, 1400, 120, 1400}};
   Neptun<OsNetwork, system_clock> neptun{OS_NETWORK, ip, config};
   neptun.connect(peer_ip, system_clock::now());
+  // Sleeps until there is something to read or Neptun (or one of the tickers below) has work to do,
+  // instead of busy-polling.
+  EventLoop<system_clock> event_loop{neptun.socket_fd()};
 
+  std::cout << "Waiting to connect..." << std::endl;
   while (!neptun.is_connected(peer_ip)) {
-    std::cout << "Waiting to connect..." << std::endl;
     neptun.tick(system_clock::now());
-    this_thread::sleep_for(milliseconds(1000));
+    event_loop.wait(neptun.next_deadline());
   }
   std::cout << "Successfully connected." << std::endl;
 
-  Ticker reliable_ticker(chrono::system_clock::now(), chrono::milliseconds(0));
+  // A zero interval would fire on every iteration and keep the loop busy.
+  Ticker reliable_ticker(chrono::system_clock::now(), chrono::milliseconds(10));
   Ticker unreliable_ticker(chrono::system_clock::now(), chrono::milliseconds(30));
   Ticker print_metrics_ticker(chrono::system_clock::now(), chrono::seconds(5));
 
@@ -62,7 +67,7 @@ int main(int argc, char **argv) {
   NetworkMetrics last_network_metrics{"Network Rate"};
   std::chrono::sys_time<std::chrono::nanoseconds> last_print_metrics_time{};
   while (true) {
-    auto now = time_point_cast<milliseconds>(system_clock::now());
+    auto now = system_clock::now();
 
     if (reliable_ticker.tick(now)) {
       for (usize i = 0; i < kNumReliableMsgsPerBatch; i++) {
@@ -144,7 +149,13 @@ int main(int argc, char **argv) {
                 print_string,
                 print_string);
 
-    // Run this loop ~100 times a second.
-//    this_thread::sleep_for(chrono::milliseconds(10));
+    auto deadline = neptun.next_deadline();
+    for (const auto &ticker : {reliable_ticker, unreliable_ticker, print_metrics_ticker}) {
+      auto tick_time = ticker.next_tick_time();
+      if (!deadline || (tick_time && *tick_time < *deadline)) {
+        deadline = tick_time;
+      }
+    }
+    event_loop.wait(deadline);
   }
 }
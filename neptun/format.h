@@ -12,10 +12,13 @@
 #include "neptun/messages/message_header.h"
 #include "neptun/messages/lets_connect.h"
 #include "neptun/messages/reject_lets_connect.h"
+#include "neptun/messages/connect_challenge.h"
+#include "neptun/messages/update_bandwidth_limit.h"
 #include "neptun/messages/segment.h"
 #include "neptun/messages/reliable_message.h"
 #include "neptun/messages/packet_header.h"
 #include "neptun/messages/unreliable_message.h"
+#include "neptun/messages/latest_state_message.h"
 
 namespace freezing::network {
 
@@ -44,6 +47,10 @@ inline std::string format_neptun_payload(byte_span payload) {
       switch (manager_type) {
         case ManagerType::CONNECTION_MANAGER:
           return "ConnectionManager";
+        case ManagerType::MOVE_MANAGER:
+          return "Move";
+        case ManagerType::LATEST_STATE_MANAGER:
+          return "LatestState";
         case ManagerType::RELIABLE_STREAM:
           return "Reliable";
         case ManagerType::UNRELIABLE_STREAM:
@@ -60,11 +67,16 @@ inline std::string format_neptun_payload(byte_span payload) {
         case LetsConnect::kId: {
           auto lets_connect = LetsConnect(payload);
           payload = advance(payload, LetsConnect::kSerializedSize);
-          ss << "[max_read_packet_rate=" << (int) lets_connect.max_read_packet_rate()
+          ss << "[max_read_packet_rate=" << lets_connect.max_read_packet_rate()
              << ", max_read_packet_size="
              << lets_connect.max_read_packet_size() << ", max_send_packet_rate="
-             << (int) lets_connect.max_send_packet_rate() << ", max_send_packet_size="
-             << lets_connect.max_send_packet_size() << "]";
+             << lets_connect.max_send_packet_rate() << ", max_send_packet_size="
+             << lets_connect.max_send_packet_size() << ", max_read_bytes_per_second="
+             << lets_connect.max_read_bytes_per_second() << ", max_send_bytes_per_second="
+             << lets_connect.max_send_bytes_per_second() << ", latest_state_history_size="
+             << lets_connect.latest_state_history_size() << ", reliable_receive_window="
+             << lets_connect.reliable_receive_window() << ", cookie=" << lets_connect.cookie()
+             << "]";
           return;
         }
         case RejectLetsConnect::kId: {
@@ -73,6 +85,24 @@ inline std::string format_neptun_payload(byte_span payload) {
           ss << "[RejectLetsConnect]";
           return;
         }
+        case ConnectChallenge::kId: {
+          auto challenge = ConnectChallenge(payload);
+          payload = advance(payload, ConnectChallenge::kSerializedSize);
+          ss << "[ConnectChallenge, cookie=" << challenge.cookie() << "]";
+          return;
+        }
+        case UpdateBandwidthLimit::kId: {
+          auto update = UpdateBandwidthLimit(payload);
+          payload = advance(payload, UpdateBandwidthLimit::kSerializedSize);
+          ss << "[UpdateBandwidthLimit, version=" << update.version() << ", max_read_packet_rate="
+             << update.max_read_packet_rate() << ", max_read_packet_size="
+             << update.max_read_packet_size() << ", max_send_packet_rate="
+             << update.max_send_packet_rate() << ", max_send_packet_size="
+             << update.max_send_packet_size() << ", max_read_bytes_per_second="
+             << update.max_read_bytes_per_second() << ", max_send_bytes_per_second="
+             << update.max_send_bytes_per_second() << "]";
+          return;
+        }
       }
     };
 
@@ -85,6 +115,18 @@ inline std::string format_neptun_payload(byte_span payload) {
       }
     };
 
+    auto append_latest_state_segment = [&ss, &payload]() {
+      auto msg = LatestStateMessage(payload);
+      payload = advance(payload, LatestStateMessage::kHeaderSize);
+      ss << "[snapshot_id=" << msg.snapshot_id() << ", baseline_id=" << msg.baseline_id()
+         << ", state_size=" << msg.state_size() << "]";
+      for (usize idx = 0; idx < msg.run_count(); idx++) {
+        auto run = DeltaRun(payload);
+        payload = advance(payload, DeltaRun::serialized_size(run.length()));
+        ss << "[offset=" << run.offset() << ", payload=" << to_hex(run.payload()) << "]";
+      }
+    };
+
     auto append_unreliable_segment = [&ss, &payload](usize msg_count) {
       for (usize idx = 0; idx < msg_count; idx++) {
         auto msg = UnreliableMessage(payload);
@@ -103,6 +145,13 @@ inline std::string format_neptun_payload(byte_span payload) {
         assert(segment.message_count() == 1);
         append_connection_manager_segment();
         break;
+      case ManagerType::MOVE_MANAGER:
+        // Moves are encoded as reliable messages.
+        append_reliable_segment(segment.message_count());
+        break;
+      case ManagerType::LATEST_STATE_MANAGER:
+        append_latest_state_segment();
+        break;
       case ManagerType::RELIABLE_STREAM:
         append_reliable_segment(segment.message_count());
         break;
@@ -118,6 +167,10 @@ inline std::string format_neptun_payload(byte_span payload) {
   while (!payload.empty()) {
     ss << sep;
     auto segment = Segment(payload);
+    if (segment.manager_type() == ManagerType::PADDING) {
+      ss << "[Padding, length=" << payload.size() << "]";
+      break;
+    }
     append_segment(segment);
     sep = " ";
   }
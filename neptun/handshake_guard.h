@@ -0,0 +1,162 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NEPTUN_HANDSHAKE_GUARD_H
+#define NEPTUN_NEPTUN_HANDSHAKE_GUARD_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "common/types.h"
+#include "network/ip_address.h"
+
+namespace freezing::network {
+
+namespace detail {
+
+using SipHashKey = std::array<u64, 2>;
+
+// SipHash-2-4 of [words], i.e. of the message with [words] in little-endian byte order.
+// See https://www.aumasson.jp/siphash/siphash.pdf
+inline u64 siphash24(const SipHashKey &key, std::span<const u64> words) {
+  u64 v0 = key[0] ^ 0x736f6d6570736575ULL;
+  u64 v1 = key[1] ^ 0x646f72616e646f6dULL;
+  u64 v2 = key[0] ^ 0x6c7967656e657261ULL;
+  u64 v3 = key[1] ^ 0x7465646279746573ULL;
+  auto round = [&]() {
+    v0 += v1;
+    v1 = std::rotl(v1, 13);
+    v1 ^= v0;
+    v0 = std::rotl(v0, 32);
+    v2 += v3;
+    v3 = std::rotl(v3, 16);
+    v3 ^= v2;
+    v0 += v3;
+    v3 = std::rotl(v3, 21);
+    v3 ^= v0;
+    v2 += v1;
+    v1 = std::rotl(v1, 17);
+    v1 ^= v2;
+    v2 = std::rotl(v2, 32);
+  };
+  auto compress = [&](u64 block) {
+    v3 ^= block;
+    round();
+    round();
+    v0 ^= block;
+  };
+  for (u64 word : words) {
+    compress(word);
+  }
+  // The last block only has the message length, since the message is a multiple of 8 bytes.
+  compress(static_cast<u64>(words.size() * sizeof(u64)) << 56);
+  v2 ^= 0xff;
+  for (usize i = 0; i < 4; i++) {
+    round();
+  }
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+inline SipHashKey random_siphash_key() {
+  std::random_device random_device{};
+  auto random_u64 = [&random_device]() {
+    return (static_cast<u64>(random_device()) << 32) | random_device();
+  };
+  return {random_u64(), random_u64()};
+}
+
+}
+
+// Stateless handshake cookies, similar to TCP SYN cookies.
+// A cookie is a MAC of the peer's address and the current period of [lifetime], keyed with a
+// secret that is chosen at random when the cookies are created. Only a peer that receives
+// packets sent to its address can echo the cookie, so the cookie proves that the address isn't
+// spoofed without storing anything per peer.
+// A cookie is valid for the period in which it's made and the next one, i.e. for at least
+// [lifetime].
+template<typename Clock>
+class HandshakeCookies {
+public:
+  explicit HandshakeCookies(milliseconds lifetime = seconds(5))
+      : m_lifetime{lifetime}, m_key{detail::random_siphash_key()} {
+    assert(lifetime.count() > 0);
+  }
+
+  // Never returns 0, which means that there is no cookie.
+  u64 make(IpAddress ip, time_point<Clock> now) const {
+    return make_for_period(ip, period(now));
+  }
+
+  bool verify(IpAddress ip, u64 cookie, time_point<Clock> now) const {
+    u64 current_period = period(now);
+    return cookie == make_for_period(ip, current_period)
+        || (current_period > 0 && cookie == make_for_period(ip, current_period - 1));
+  }
+
+private:
+  milliseconds m_lifetime;
+  detail::SipHashKey m_key;
+
+  u64 period(time_point<Clock> now) const {
+    return static_cast<u64>(now.time_since_epoch() / m_lifetime);
+  }
+
+  u64 make_for_period(IpAddress ip, u64 period) const {
+    std::array<u64, 2> words{ip.packed(), period};
+    return std::max<u64>(detail::siphash24(m_key, words), 1);
+  }
+};
+
+// Rate limit per source address, which limits how often the handshake packets from a source
+// are answered. The port isn't part of the source, since a host can send from any number of
+// ports. It's a token bucket implemented as GCRA (generic cell rate algorithm), which only
+// needs to remember when the bucket becomes full again.
+// Sources are hashed into a fixed number of buckets, so the memory doesn't grow with the number
+// of (spoofed) sources. Sources that hash to the same bucket share its limit, so that a source
+// can't reset its limit by sending from another address that collides with it. The hash is
+// keyed, so the sources can't choose their buckets.
+template<typename Clock>
+class HandshakeRateLimiter {
+public:
+  // [rate] is the number of handshake packets per second that are answered on average, and
+  // [burst] is the number of packets that are answered back to back.
+  HandshakeRateLimiter(u32 rate, u32 burst, usize bucket_count = 4096)
+      : m_interval{nanoseconds(seconds(1)) / rate},
+        m_tolerance{m_interval * (burst - 1)},
+        m_theoretical_arrival_times(std::bit_ceil(bucket_count)),
+        m_key{detail::random_siphash_key()} {
+    assert(rate > 0 && burst > 0 && bucket_count > 0);
+  }
+
+  // Returns whether a handshake packet from [ip] can be answered at [now], and takes a token
+  // if it can.
+  bool try_acquire(IpAddress ip, time_point<Clock> now) {
+    std::array<u64, 1> words{ip.address()};
+    usize bucket = detail::siphash24(m_key, words) & (m_theoretical_arrival_times.size() - 1);
+    auto &theoretical_arrival_time = m_theoretical_arrival_times[bucket];
+    // The time at which the token would be taken if the packets arrived exactly at the rate.
+    auto arrival_time = std::max(theoretical_arrival_time, now);
+    if (arrival_time - now > m_tolerance) {
+      return false;
+    }
+    theoretical_arrival_time = arrival_time + m_interval;
+    return true;
+  }
+
+private:
+  nanoseconds m_interval;
+  nanoseconds m_tolerance;
+  // Per bucket. A bucket is full once its theoretical arrival time has passed.
+  std::vector<time_point<Clock>> m_theoretical_arrival_times;
+  detail::SipHashKey m_key;
+};
+
+}
+
+#endif //NEPTUN_NEPTUN_HANDSHAKE_GUARD_H
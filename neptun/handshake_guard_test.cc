@@ -0,0 +1,83 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+#include <array>
+
+#include "common/types.h"
+#include "common/fake_clock.h"
+#include "neptun/handshake_guard.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+const IpAddress kIp = IpAddress::from_ipv4("192.168.0.10", 1000);
+// Same IP, different port.
+const IpAddress kOtherPortIp = IpAddress::from_ipv4("192.168.0.10", 1001);
+const IpAddress kOtherIp = IpAddress::from_ipv4("192.168.0.11", 1000);
+const FakeClock::time_point kNow = FakeClock::now();
+}
+
+TEST(HandshakeGuardTest, SipHashTestVectors) {
+  // Test vectors from the reference implementation, with the key 00 01 .. 0f and the message
+  // 00 01 .. of the given length.
+  detail::SipHashKey key{0x0706050403020100, 0x0f0e0d0c0b0a0908};
+  std::array<u64, 2> words{0x0706050403020100, 0x0f0e0d0c0b0a0908};
+  ASSERT_EQ(detail::siphash24(key, std::span<const u64>{}), 0x726fdb47dd0e0e31);
+  ASSERT_EQ(detail::siphash24(key, std::span<const u64>(words).first(1)), 0x93f5f5799a932462);
+  ASSERT_EQ(detail::siphash24(key, words), 0x3f2acc7f57c29bdb);
+}
+
+TEST(HandshakeGuardTest, CookiesExpire) {
+  HandshakeCookies<FakeClock> cookies{seconds(5)};
+  auto now = kNow + seconds(100);
+  auto cookie = cookies.make(kIp, now);
+  ASSERT_NE(cookie, 0);
+  ASSERT_TRUE(cookies.verify(kIp, cookie, now));
+  ASSERT_FALSE(cookies.verify(kOtherPortIp, cookie, now));
+  ASSERT_FALSE(cookies.verify(kIp, cookie + 1, now));
+  ASSERT_FALSE(cookies.verify(kIp, 0, now));
+
+  // Valid for the rest of the period and the next one.
+  ASSERT_TRUE(cookies.verify(kIp, cookie, now + seconds(5) + milliseconds(4999)));
+  ASSERT_FALSE(cookies.verify(kIp, cookie, now + seconds(10)));
+
+  // Each instance has its own key.
+  HandshakeCookies<FakeClock> other_cookies{seconds(5)};
+  ASSERT_FALSE(other_cookies.verify(kIp, cookie, now));
+}
+
+TEST(HandshakeGuardTest, RateLimitPerSource) {
+  HandshakeRateLimiter<FakeClock> rate_limiter{10 /* rate */, 3 /* burst */};
+  for (usize i = 0; i < 3; i++) {
+    ASSERT_TRUE(rate_limiter.try_acquire(kIp, kNow));
+  }
+  ASSERT_FALSE(rate_limiter.try_acquire(kIp, kNow));
+  // Other ports of the same address share the limit, but other addresses have their own.
+  ASSERT_FALSE(rate_limiter.try_acquire(kOtherPortIp, kNow));
+  ASSERT_TRUE(rate_limiter.try_acquire(kOtherIp, kNow));
+
+  // A token is added every 100ms.
+  ASSERT_FALSE(rate_limiter.try_acquire(kIp, kNow + milliseconds(99)));
+  ASSERT_TRUE(rate_limiter.try_acquire(kIp, kNow + milliseconds(100)));
+  ASSERT_FALSE(rate_limiter.try_acquire(kIp, kNow + milliseconds(100)));
+
+  // Up to the burst.
+  for (usize i = 0; i < 3; i++) {
+    ASSERT_TRUE(rate_limiter.try_acquire(kIp, kNow + seconds(10)));
+  }
+  ASSERT_FALSE(rate_limiter.try_acquire(kIp, kNow + seconds(10)));
+}
+
+TEST(HandshakeGuardTest, CollidingSourcesShareLimit) {
+  // All sources hash to the only bucket.
+  HandshakeRateLimiter<FakeClock> rate_limiter{10 /* rate */, 3 /* burst */, 1 /* bucket_count */};
+  for (usize i = 0; i < 3; i++) {
+    ASSERT_TRUE(rate_limiter.try_acquire(kIp, kNow));
+  }
+  ASSERT_FALSE(rate_limiter.try_acquire(kOtherIp, kNow));
+  ASSERT_FALSE(rate_limiter.try_acquire(kIp, kNow));
+  ASSERT_TRUE(rate_limiter.try_acquire(kOtherIp, kNow + milliseconds(100)));
+}
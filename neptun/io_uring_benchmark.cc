@@ -0,0 +1,153 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+// Compares [IoUringNetwork] with [OsNetwork] on loopback: first by sending batches of datagrams
+// between two sockets, and then by running two [Neptun] peers that exchange reliable messages.
+// Reports the number of syscalls per datagram and the throughput.
+// Usage: bin_io_uring_benchmark [datagram_count]
+
+#include <chrono>
+#include <optional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "network/io_uring_network.h"
+#include "network/network.h"
+#include "network/udp_socket.h"
+#include "neptun/neptun.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+
+constexpr usize kDatagramSize = 1200;
+constexpr usize kBatchSize = 32;
+constexpr usize kMessageSize = 100;
+constexpr usize kNeptunMessageCount = 20'000;
+
+const IpAddress kSenderIp = IpAddress::from_ipv4("127.0.0.1", 47201);
+const IpAddress kReceiverIp = IpAddress::from_ipv4("127.0.0.1", 47202);
+// [Neptun] doesn't close its socket, so every run needs its own ports.
+const IpAddress kOsNeptunClientIp = IpAddress::from_ipv4("127.0.0.1", 47203);
+const IpAddress kOsNeptunServerIp = IpAddress::from_ipv4("127.0.0.1", 47204);
+const IpAddress kIoUringNeptunClientIp = IpAddress::from_ipv4("127.0.0.1", 47205);
+const IpAddress kIoUringNeptunServerIp = IpAddress::from_ipv4("127.0.0.1", 47206);
+
+void print(const std::string &name,
+           usize datagram_count,
+           u64 syscall_count,
+           std::chrono::nanoseconds elapsed) {
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  std::cout << name << ": " << datagram_count << " datagrams in " << seconds * 1000.0 << " ms ("
+            << static_cast<double>(datagram_count) / seconds << " datagrams/s, "
+            << static_cast<double>(syscall_count) / static_cast<double>(datagram_count)
+            << " syscalls per datagram)" << std::endl;
+}
+
+// Sends [datagram_count] datagrams in batches of [kBatchSize], and reads them on the other
+// socket after every batch. Datagrams that are dropped by the kernel are sent again.
+template<typename Network>
+void run_loopback(const std::string &name, Network &network, usize datagram_count) {
+  auto sender = UdpSocket<Network>::bind(kSenderIp, network);
+  auto receiver = UdpSocket<Network>::bind(kReceiverIp, network);
+  std::vector<u8> payload(kDatagramSize, 0xAB);
+  std::vector<SendPacketInfo> packets(kBatchSize, {kReceiverIp, const_byte_span(payload)});
+  std::vector<u8> read_buffer_pool(kBatchSize * 2048);
+  std::vector<byte_span> read_buffers{};
+  for (usize i = 0; i < kBatchSize; i++) {
+    read_buffers.push_back(byte_span(read_buffer_pool).subspan(i * 2048, 2048));
+  }
+  std::vector<ReadPacketInfo> read_packets{};
+  read_packets.reserve(kBatchSize);
+
+  u64 syscalls_before = OS_NETWORK_METRICS.value(NetworkMetricKey::SYSCALLS);
+  auto start = std::chrono::steady_clock::now();
+  usize read_count = 0;
+  while (read_count < datagram_count) {
+    usize sent_count = sender.send_batch(packets);
+    for (usize attempt = 0; attempt < 100 && sent_count > 0; attempt++) {
+      read_packets.clear();
+      usize count = receiver.read_batch(read_buffers, read_packets);
+      read_count += count;
+      sent_count -= std::min(sent_count, count);
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  print(name, read_count, OS_NETWORK_METRICS.value(NetworkMetricKey::SYSCALLS) - syscalls_before,
+        elapsed);
+
+  network.close_socket(sender.fd());
+  network.close_socket(receiver.fd());
+}
+
+// The client sends [kNeptunMessageCount] reliable messages to the server as fast as the
+// reliable stream accepts them.
+template<typename Network>
+void run_neptun(const std::string &name,
+                Network &network,
+                IpAddress client_ip,
+                IpAddress server_ip) {
+  ConnectionManagerConfig config{5, BandwidthLimit{250, 1400, 250, 1400}};
+  Neptun<Network, system_clock> client{network, client_ip, config};
+  Neptun<Network, system_clock> server{network, server_ip, config};
+  client.connect(server_ip, system_clock::now());
+  while (!client.is_connected(server_ip)) {
+    client.tick(system_clock::now());
+    server.tick(system_clock::now());
+  }
+
+  u64 syscalls_before = OS_NETWORK_METRICS.value(NetworkMetricKey::SYSCALLS);
+  u64 packets_before = OS_NETWORK_METRICS.value(NetworkMetricKey::PACKETS_SENT);
+  auto start = std::chrono::steady_clock::now();
+  usize sent_count = 0;
+  usize received_count = 0;
+  auto write_message = [&sent_count](byte_span buffer) {
+    if (sent_count == kNeptunMessageCount || buffer.size() < kMessageSize) {
+      return byte_span{};
+    }
+    std::fill_n(buffer.begin(), kMessageSize, 42);
+    sent_count++;
+    return buffer.first(kMessageSize);
+  };
+  while (received_count < kNeptunMessageCount) {
+    auto now = system_clock::now();
+    for (usize i = 0; i < kBatchSize; i++) {
+      client.send_reliable_to(server_ip, write_message, now);
+    }
+    client.tick(now);
+    server.tick(now, [&received_count](byte_span) { received_count++; });
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  u64 packet_count = OS_NETWORK_METRICS.value(NetworkMetricKey::PACKETS_SENT) - packets_before;
+  u64 syscall_count = OS_NETWORK_METRICS.value(NetworkMetricKey::SYSCALLS) - syscalls_before;
+  std::cout << name << ": " << received_count << " reliable messages in " << seconds * 1000.0
+            << " ms (" << static_cast<double>(received_count) / seconds << " messages/s, "
+            << packet_count << " packets, " << syscall_count << " syscalls)" << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+  usize datagram_count = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+
+  run_loopback("OsNetwork", OS_NETWORK, datagram_count);
+  std::optional<IoUringNetwork> io_uring_network{};
+  try {
+    io_uring_network.emplace();
+    run_loopback("IoUringNetwork", *io_uring_network, datagram_count);
+  } catch (const std::runtime_error &error) {
+    std::cout << "io_uring isn't available: " << error.what() << std::endl;
+    return 0;
+  }
+
+  run_neptun("Neptun on OsNetwork", OS_NETWORK, kOsNeptunClientIp, kOsNeptunServerIp);
+  run_neptun("Neptun on IoUringNetwork",
+             *io_uring_network,
+             kIoUringNeptunClientIp,
+             kIoUringNeptunServerIp);
+  return 0;
+}
@@ -0,0 +1,337 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NEPTUN_LATEST_STATE_MANAGER_H
+#define NEPTUN_NEPTUN_LATEST_STATE_MANAGER_H
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "neptun/common.h"
+#include "neptun/error.h"
+#include "neptun/messages/segment.h"
+#include "neptun/messages/latest_state_message.h"
+
+namespace freezing::network {
+
+namespace detail {
+constexpr usize kDefaultLatestStateHistorySize = 32;
+}
+
+// Delivers the latest version of a state blob, e.g. a snapshot of the entities that a player
+// sees, where only the latest version matters and older versions don't need to be delivered.
+//
+// Every packet carries the latest state, until a packet with it is acked. The state is encoded
+// as a delta against the most recent snapshot that has been acked (the baseline), which the peer
+// is guaranteed to have, so only the bytes that have changed since the baseline are sent. The
+// receiver rebuilds the full state from its copy of the baseline, and reports it if it's newer
+// than the latest state that it has reported.
+//
+// Snapshots are only adopted as the baseline if they are encoded against the current baseline.
+// The receiver discards the snapshots older than the newest baseline that it has seen, so a
+// snapshot that has been reordered behind a newer baseline may not have been decoded, even if
+// it has been acked. As a result, the baseline advances at most once per RTT.
+//
+// Both sides keep up to [history_size] snapshots. The receiver must keep at least as many as
+// the sender, otherwise it may discard the snapshot that the sender adopts as the baseline, and
+// it can't decode any delta after that. [Neptun] uses the smaller history size of both sides.
+class LatestStateManager {
+public:
+  static constexpr usize kMaxStateSize = std::numeric_limits<u16>::max();
+
+  explicit LatestStateManager(usize history_size = detail::kDefaultLatestStateHistorySize)
+      : m_history_size{history_size} {
+    assert(history_size > 0);
+  }
+
+  // Changes the number of snapshots that are kept, e.g. to the peer's history size if it's
+  // smaller than ours.
+  void set_history_size(usize history_size) {
+    assert(history_size > 0);
+    if (history_size == m_history_size) {
+      return;
+    }
+    m_history_size = history_size;
+    while (m_in_flight.size() > m_history_size) {
+      m_in_flight.pop_front();
+    }
+    release_snapshots();
+    evict_received();
+  }
+
+  // Largest state that is always written to a buffer of [buffer_size] bytes, whatever the
+  // baseline. Runs are only split by more equal bytes than the header of a run, so the delta is
+  // never larger than the whole state in a single run.
+  static constexpr usize max_state_size(usize buffer_size) {
+    constexpr usize overhead = Segment::kSerializedSize + LatestStateMessage::kHeaderSize
+        + DeltaRun::kHeaderSize;
+    return std::min(kMaxStateSize, buffer_size > overhead ? buffer_size - overhead : 0);
+  }
+
+  // Replaces the state that is sent to the peer. Throws if the state is larger than
+  // [kMaxStateSize]. A state that is larger than [max_state_size] of the buffers that it's
+  // written to may never be written, so the caller is expected to reject it.
+  void set_state(const_byte_span state) {
+    if (state.size() > kMaxStateSize) {
+      throw std::runtime_error("Latest state is too large: " + std::to_string(state.size()));
+    }
+    m_state.assign(state.begin(), state.end());
+    m_state_id++;
+  }
+
+  // Whether the peer hasn't acked the latest state yet.
+  bool has_pending_state() const {
+    return m_state_id != m_baseline.id;
+  }
+
+  // Returns 0 if there is no pending state, or if its delta doesn't fit into [buffer].
+  usize write(PacketId packet_id, byte_span buffer) {
+    if (!has_pending_state()) {
+      return 0;
+    }
+    usize header_size = Segment::kSerializedSize + LatestStateMessage::kHeaderSize;
+    if (buffer.size() < header_size) {
+      return 0;
+    }
+    auto run_count = encode_delta(m_baseline.data, m_state, advance(buffer, header_size));
+    if (!run_count) {
+      return 0;
+    }
+    usize idx = Segment::write(buffer, ManagerType::LATEST_STATE_MANAGER, 1).size();
+    idx += LatestStateMessage::write_header(advance(buffer, idx),
+                                            m_state_id,
+                                            m_baseline.id,
+                                            static_cast<u16>(m_state.size()),
+                                            run_count->first).size();
+    idx += run_count->second;
+
+    if (m_snapshots.empty() || m_snapshots.back().id != m_state_id) {
+      m_snapshots.push_back({m_state_id, m_state});
+    }
+    m_in_flight.push_back({packet_id, m_state_id, m_baseline.id});
+    if (m_in_flight.size() > m_history_size) {
+      m_in_flight.pop_front();
+      release_snapshots();
+    }
+    m_written_bytes += idx;
+    m_written_state_bytes += m_state.size();
+    return idx;
+  }
+
+  void on_packet_delivery_status(PacketId packet_id, PacketDeliveryStatus status) {
+    auto it = std::find_if(m_in_flight.begin(), m_in_flight.end(), [packet_id](const auto &entry) {
+      return entry.packet_id == packet_id;
+    });
+    if (it == m_in_flight.end()) {
+      return;
+    }
+    auto entry = *it;
+    m_in_flight.erase(it);
+    if (status == PacketDeliveryStatus::ACK && entry.snapshot_id > m_baseline.id
+        && entry.baseline_id == m_baseline.id) {
+      auto snapshot = std::find_if(m_snapshots.begin(), m_snapshots.end(), [&entry](const auto &s) {
+        return s.id == entry.snapshot_id;
+      });
+      assert(snapshot != m_snapshots.end());
+      m_baseline = std::move(*snapshot);
+      // Packets with older snapshots can't advance the baseline anymore.
+      std::erase_if(m_in_flight, [this](const auto &e) { return e.snapshot_id <= m_baseline.id; });
+    }
+    release_snapshots();
+  }
+
+  // Calls [on_state] with the rebuilt state, if the packet has a state that is newer than the
+  // latest one.
+  template<typename OnStateFn>
+  expected<usize, NeptunError> read(byte_span buffer, OnStateFn on_state) {
+    if (buffer.size() < Segment::kSerializedSize) {
+      return 0;
+    }
+    Segment segment(buffer);
+    if (segment.manager_type() != ManagerType::LATEST_STATE_MANAGER) {
+      return 0;
+    }
+    if (segment.message_count() != 1
+        || buffer.size() < Segment::kSerializedSize + LatestStateMessage::kHeaderSize) {
+      return make_error(NeptunError::MALFORMED_PACKET);
+    }
+    usize idx = Segment::kSerializedSize;
+    LatestStateMessage message(advance(buffer, idx));
+    idx += LatestStateMessage::kHeaderSize;
+    // The runs are validated before the baseline is looked up, since their size is needed to
+    // skip the message anyway.
+    usize runs_offset = idx;
+    usize previous_end = 0;
+    for (usize i = 0; i < message.run_count(); i++) {
+      if (buffer.size() < idx + DeltaRun::kHeaderSize) {
+        return make_error(NeptunError::MALFORMED_PACKET);
+      }
+      DeltaRun run(advance(buffer, idx));
+      usize end = usize{run.offset()} + run.length();
+      if (run.length() == 0 || run.offset() < previous_end || end > message.state_size()
+          || buffer.size() < idx + DeltaRun::serialized_size(run.length())) {
+        return make_error(NeptunError::MALFORMED_PACKET);
+      }
+      previous_end = end;
+      idx += DeltaRun::serialized_size(run.length());
+    }
+    if (message.snapshot_id() == 0) {
+      return make_error(NeptunError::MALFORMED_PACKET);
+    }
+
+    auto snapshot_id = message.snapshot_id();
+    if (snapshot_id <= m_max_baseline_id || find_received(snapshot_id) != m_received.end()) {
+      // Already received, or too old to be used as the baseline.
+      return idx;
+    }
+    std::vector<u8> state(message.state_size());
+    if (message.baseline_id() != 0) {
+      auto baseline = find_received(message.baseline_id());
+      if (baseline == m_received.end()) {
+        // The baseline has been discarded, because the packet has been reordered.
+        return idx;
+      }
+      std::copy_n(baseline->data.begin(),
+                  std::min(baseline->data.size(), state.size()),
+                  state.begin());
+    }
+    for (usize i = 0, offset = runs_offset; i < message.run_count(); i++) {
+      DeltaRun run(advance(buffer, offset));
+      std::copy(run.payload().begin(), run.payload().end(), state.begin() + run.offset());
+      offset += DeltaRun::serialized_size(run.length());
+    }
+
+    auto position = std::find_if(m_received.begin(), m_received.end(), [snapshot_id](const auto &s) {
+      return s.id > snapshot_id;
+    });
+    auto &snapshot = *m_received.insert(position, {snapshot_id, std::move(state)});
+    if (snapshot_id > m_latest_received_id) {
+      m_latest_received_id = snapshot_id;
+      on_state(byte_span(snapshot.data));
+    }
+    m_max_baseline_id = std::max(m_max_baseline_id, message.baseline_id());
+    evict_received();
+    return idx;
+  }
+
+  // Total size of the latest state messages that have been written, and of the states that they
+  // encode, e.g. to measure how well the deltas compress.
+  u64 written_bytes() const {
+    return m_written_bytes;
+  }
+
+  u64 written_state_bytes() const {
+    return m_written_state_bytes;
+  }
+
+private:
+  struct Snapshot {
+    u32 id;
+    std::vector<u8> data;
+  };
+
+  struct InFlightSnapshot {
+    PacketId packet_id;
+    u32 snapshot_id;
+    u32 baseline_id;
+  };
+
+  usize m_history_size;
+
+  // Sender side.
+  std::vector<u8> m_state{};
+  // Incremented on every [set_state], 0 means no state.
+  u32 m_state_id{0};
+  Snapshot m_baseline{0, {}};
+  // Snapshots that have been written and may still become the baseline, in the order of ids.
+  std::deque<Snapshot> m_snapshots{};
+  std::deque<InFlightSnapshot> m_in_flight{};
+  u64 m_written_bytes{0};
+  u64 m_written_state_bytes{0};
+
+  // Receiver side.
+  // Snapshots that the peer may use as the baseline, in the order of ids.
+  std::deque<Snapshot> m_received{};
+  u32 m_latest_received_id{0};
+  // The peer's baseline only moves forward, so the older snapshots are never needed again.
+  u32 m_max_baseline_id{0};
+
+  // Writes the runs of bytes of [state] that differ from [baseline] to [buffer].
+  // Returns the number of runs and their size, or nothing if they don't fit into [buffer].
+  static std::optional<std::pair<u16, usize>> encode_delta(const std::vector<u8> &baseline,
+                                                           const std::vector<u8> &state,
+                                                           byte_span buffer) {
+    auto baseline_at = [&baseline](usize i) -> u8 { return i < baseline.size() ? baseline[i] : 0; };
+    u16 run_count = 0;
+    usize idx = 0;
+    usize i = 0;
+    while (i < state.size()) {
+      if (state[i] == baseline_at(i)) {
+        i++;
+        continue;
+      }
+      // Equal bytes are included in the run, unless there are more of them than the header of
+      // a new run.
+      usize start = i;
+      usize end = i + 1;
+      for (usize j = end; j < state.size() && j - end <= DeltaRun::kHeaderSize; j++) {
+        if (state[j] != baseline_at(j)) {
+          end = j + 1;
+        }
+      }
+      if (idx + DeltaRun::serialized_size(end - start) > buffer.size()
+          || run_count == std::numeric_limits<u16>::max()) {
+        return {};
+      }
+      idx += DeltaRun::write(advance(buffer, idx),
+                             static_cast<u16>(start),
+                             byte_span((u8 *) state.data() + start, end - start)).size();
+      run_count++;
+      i = end;
+    }
+    return std::pair{run_count, idx};
+  }
+
+  std::deque<Snapshot>::iterator find_received(u32 id) {
+    return std::find_if(m_received.begin(), m_received.end(), [id](const auto &s) {
+      return s.id == id;
+    });
+  }
+
+  void evict_received() {
+    while (!m_received.empty() && m_received.front().id < m_max_baseline_id) {
+      m_received.pop_front();
+    }
+    // The newest baseline is kept, since the peer may still use it.
+    while (m_received.size() > m_history_size + 1) {
+      auto oldest = m_received.begin();
+      if (oldest->id == m_max_baseline_id) {
+        oldest++;
+      }
+      m_received.erase(oldest);
+    }
+  }
+
+  // Releases the snapshots that aren't in flight anymore.
+  void release_snapshots() {
+    while (!m_snapshots.empty() && !std::any_of(m_in_flight.begin(), m_in_flight.end(),
+                                                [this](const auto &entry) {
+                                                  return entry.snapshot_id
+                                                      == m_snapshots.front().id;
+                                                })) {
+      m_snapshots.pop_front();
+    }
+  }
+};
+
+}
+
+#endif //NEPTUN_NEPTUN_LATEST_STATE_MANAGER_H
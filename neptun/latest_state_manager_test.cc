@@ -0,0 +1,215 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <vector>
+
+#include "common/types.h"
+#include "neptun/latest_state_manager.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+
+std::vector<u8> make_buffer(usize size = 1400) {
+  return std::vector<u8>(size);
+}
+
+// An entity snapshot where only a few bytes change between the states.
+std::vector<u8> make_state(u8 position) {
+  std::vector<u8> state(1000);
+  for (usize i = 0; i < state.size(); i++) {
+    state[i] = static_cast<u8>(i);
+  }
+  state[100] = position;
+  state[500] = position;
+  return state;
+}
+
+void set_state(LatestStateManager &sender, std::vector<u8> state) {
+  sender.set_state(state);
+}
+
+// Returns the state that [receiver] has reported for the packet, if any.
+std::optional<std::vector<u8>> deliver(LatestStateManager &receiver, byte_span packet) {
+  std::optional<std::vector<u8>> received{};
+  auto result = receiver.read(packet, [&received](byte_span state) {
+    received.emplace(state.begin(), state.end());
+  });
+  EXPECT_EQ(result, packet.size());
+  return received;
+}
+
+}
+
+TEST(LatestStateManagerTest, SendsFullStateWithoutBaseline) {
+  LatestStateManager sender{};
+  LatestStateManager receiver{};
+  auto buffer = make_buffer();
+  ASSERT_FALSE(sender.has_pending_state());
+  ASSERT_EQ(sender.write(0, buffer), 0);
+
+  auto state = make_state(1);
+  sender.set_state(state);
+  ASSERT_TRUE(sender.has_pending_state());
+  auto count = sender.write(0, buffer);
+  ASSERT_GT(count, state.size());
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), state);
+
+  sender.on_packet_delivery_status(0, PacketDeliveryStatus::ACK);
+  ASSERT_FALSE(sender.has_pending_state());
+  ASSERT_EQ(sender.write(1, buffer), 0);
+}
+
+TEST(LatestStateManagerTest, SendsDeltaAgainstAckedBaseline) {
+  LatestStateManager sender{};
+  LatestStateManager receiver{};
+  auto buffer = make_buffer();
+  set_state(sender, make_state(1));
+  auto count = sender.write(0, buffer);
+  deliver(receiver, byte_span(buffer).first(count));
+  sender.on_packet_delivery_status(0, PacketDeliveryStatus::ACK);
+
+  auto state = make_state(2);
+  sender.set_state(state);
+  count = sender.write(1, buffer);
+  // Two runs of a single byte.
+  ASSERT_EQ(count, Segment::kSerializedSize + LatestStateMessage::kHeaderSize
+      + 2 * DeltaRun::serialized_size(1));
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), state);
+}
+
+TEST(LatestStateManagerTest, KeepsBaselineUntilNewerSnapshotIsAcked) {
+  LatestStateManager sender{};
+  LatestStateManager receiver{};
+  auto buffer = make_buffer();
+  set_state(sender, make_state(1));
+  auto count = sender.write(0, buffer);
+  deliver(receiver, byte_span(buffer).first(count));
+  sender.on_packet_delivery_status(0, PacketDeliveryStatus::ACK);
+
+  // The packet with the second state is lost, so the third one is encoded against the first.
+  set_state(sender, make_state(2));
+  sender.write(1, buffer);
+  sender.on_packet_delivery_status(1, PacketDeliveryStatus::DROP);
+  auto state = make_state(3);
+  sender.set_state(state);
+  count = sender.write(2, buffer);
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), state);
+}
+
+TEST(LatestStateManagerTest, ResendsUntilAcked) {
+  LatestStateManager sender{};
+  LatestStateManager receiver{};
+  auto buffer = make_buffer();
+  auto state = make_state(1);
+  sender.set_state(state);
+  sender.write(0, buffer);
+  sender.on_packet_delivery_status(0, PacketDeliveryStatus::DROP);
+  ASSERT_TRUE(sender.has_pending_state());
+
+  auto count = sender.write(1, buffer);
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), state);
+  // The same state in a later packet isn't reported again.
+  count = sender.write(2, buffer);
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), std::nullopt);
+}
+
+TEST(LatestStateManagerTest, IgnoresOlderStates) {
+  LatestStateManager sender{};
+  LatestStateManager receiver{};
+  auto first = make_buffer();
+  auto second = make_buffer();
+  set_state(sender, make_state(1));
+  auto first_count = sender.write(0, first);
+  auto state = make_state(2);
+  sender.set_state(state);
+  auto second_count = sender.write(1, second);
+
+  ASSERT_EQ(deliver(receiver, byte_span(second).first(second_count)), state);
+  ASSERT_EQ(deliver(receiver, byte_span(first).first(first_count)), std::nullopt);
+}
+
+TEST(LatestStateManagerTest, AdoptsOnlySnapshotsEncodedAgainstCurrentBaseline) {
+  LatestStateManager sender{};
+  LatestStateManager receiver{};
+  auto buffer = make_buffer();
+  set_state(sender, make_state(1));
+  auto count = sender.write(0, buffer);
+  deliver(receiver, byte_span(buffer).first(count));
+  set_state(sender, make_state(2));
+  count = sender.write(1, buffer);
+  deliver(receiver, byte_span(buffer).first(count));
+
+  sender.on_packet_delivery_status(0, PacketDeliveryStatus::ACK);
+  // The second snapshot has been encoded against the empty state, not against the first one.
+  sender.on_packet_delivery_status(1, PacketDeliveryStatus::ACK);
+  ASSERT_TRUE(sender.has_pending_state());
+
+  auto state = make_state(3);
+  sender.set_state(state);
+  count = sender.write(2, buffer);
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), state);
+}
+
+TEST(LatestStateManagerTest, StateShrinks) {
+  LatestStateManager sender{};
+  LatestStateManager receiver{};
+  auto buffer = make_buffer();
+  set_state(sender, make_state(1));
+  auto count = sender.write(0, buffer);
+  deliver(receiver, byte_span(buffer).first(count));
+  sender.on_packet_delivery_status(0, PacketDeliveryStatus::ACK);
+
+  std::vector<u8> state{1, 2, 3};
+  sender.set_state(state);
+  count = sender.write(1, buffer);
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), state);
+}
+
+TEST(LatestStateManagerTest, DoesntWriteStateThatDoesntFit) {
+  LatestStateManager sender{};
+  auto buffer = make_buffer(100);
+  set_state(sender, make_state(1));
+  ASSERT_EQ(sender.write(0, buffer), 0);
+  ASSERT_TRUE(sender.has_pending_state());
+}
+
+TEST(LatestStateManagerTest, MaxStateSizeAlwaysFits) {
+  LatestStateManager sender{};
+  LatestStateManager receiver{};
+  auto buffer = make_buffer(100);
+  // Every byte differs from the baseline, with runs that are split by as many equal bytes as
+  // possible.
+  std::vector<u8> state(LatestStateManager::max_state_size(buffer.size()), 1);
+  for (usize i = 1; i < state.size(); i += 6) {
+    for (usize j = i; j < std::min(i + 5, state.size()); j++) {
+      state[j] = 0;
+    }
+  }
+  sender.set_state(state);
+  auto count = sender.write(0, buffer);
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), state);
+
+  std::fill(state.begin(), state.end(), 2);
+  sender.set_state(state);
+  count = sender.write(1, buffer);
+  ASSERT_EQ(count, buffer.size());
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), state);
+  ASSERT_EQ(LatestStateManager::max_state_size(10), 0);
+}
+
+TEST(LatestStateManagerTest, MalformedRuns) {
+  LatestStateManager sender{};
+  LatestStateManager receiver{};
+  auto buffer = make_buffer();
+  set_state(sender, make_state(1));
+  auto count = sender.write(0, buffer);
+  // Truncated in the middle of a run.
+  auto result = receiver.read(byte_span(buffer).first(count - 1), [](byte_span) {});
+  ASSERT_EQ(result, make_error(NeptunError::MALFORMED_PACKET));
+}
@@ -0,0 +1,39 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NEPTUN_MESSAGES_CONNECT_CHALLENGE_H
+#define NEPTUN_NEPTUN_MESSAGES_CONNECT_CHALLENGE_H
+
+#include "common/types.h"
+#include "network/io_buffer.h"
+
+namespace freezing::network {
+
+// Response to a LetsConnect without a valid cookie. The peer must echo [cookie] in its next
+// LetsConnect to prove that it owns its address.
+class ConnectChallenge {
+public:
+  static constexpr u8 kId = 2;
+  static constexpr usize kSerializedSize = sizeof(u64);
+  static constexpr usize kCookie = 0;
+
+  static byte_span write(byte_span buffer, u64 cookie) {
+    auto io = IoBuffer(buffer);
+    usize count = io.write_u64(cookie, kCookie);
+    return buffer.first(count);
+  }
+
+  explicit ConnectChallenge(byte_span buffer) : m_buffer{buffer} {}
+
+  u64 cookie() const {
+    return m_buffer.read_u64(kCookie);
+  }
+
+private:
+  IoBuffer m_buffer;
+};
+
+}
+
+#endif //NEPTUN_NEPTUN_MESSAGES_CONNECT_CHALLENGE_H
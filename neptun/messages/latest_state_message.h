@@ -0,0 +1,104 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NEPTUN_MESSAGES_LATEST_STATE_MESSAGE_H
+#define NEPTUN_NEPTUN_MESSAGES_LATEST_STATE_MESSAGE_H
+
+#include "common/types.h"
+#include "network/io_buffer.h"
+
+namespace freezing::network {
+
+// A snapshot of the latest state, encoded as a delta against an earlier snapshot (the baseline)
+// that the receiver already has. The header is followed by [run_count] runs of the bytes that
+// differ from the baseline. Snapshot id 0 is the empty state, and is the baseline of the first
+// snapshot.
+class LatestStateMessage {
+public:
+  static constexpr usize kSnapshotIdOffset = 0;
+  static constexpr usize kBaselineIdOffset = kSnapshotIdOffset + sizeof(u32);
+  static constexpr usize kStateSizeOffset = kBaselineIdOffset + sizeof(u32);
+  static constexpr usize kRunCountOffset = kStateSizeOffset + sizeof(u16);
+
+  static constexpr usize kHeaderSize = sizeof(u32) + sizeof(u32) + sizeof(u16) + sizeof(u16);
+
+  static byte_span write_header(byte_span buffer,
+                                u32 snapshot_id,
+                                u32 baseline_id,
+                                u16 state_size,
+                                u16 run_count) {
+    auto io = IoBuffer(buffer);
+    usize count = 0;
+    count += io.write_u32(snapshot_id, kSnapshotIdOffset);
+    count += io.write_u32(baseline_id, kBaselineIdOffset);
+    count += io.write_u16(state_size, kStateSizeOffset);
+    count += io.write_u16(run_count, kRunCountOffset);
+    return buffer.first(count);
+  }
+
+  explicit LatestStateMessage(byte_span buffer) : m_buffer{buffer} {}
+
+  u32 snapshot_id() const {
+    return m_buffer.read_u32(kSnapshotIdOffset);
+  }
+
+  u32 baseline_id() const {
+    return m_buffer.read_u32(kBaselineIdOffset);
+  }
+
+  u16 state_size() const {
+    return m_buffer.read_u16(kStateSizeOffset);
+  }
+
+  u16 run_count() const {
+    return m_buffer.read_u16(kRunCountOffset);
+  }
+
+private:
+  IoBuffer m_buffer;
+};
+
+// Bytes of the state at [offset] that differ from the baseline.
+class DeltaRun {
+public:
+  static constexpr usize kOffsetOffset = 0;
+  static constexpr usize kLengthOffset = kOffsetOffset + sizeof(u16);
+  static constexpr usize kPayloadOffset = kLengthOffset + sizeof(u16);
+
+  static constexpr usize kHeaderSize = sizeof(u16) + sizeof(u16);
+
+  static constexpr usize serialized_size(usize payload_size) {
+    return kHeaderSize + payload_size;
+  }
+
+  static byte_span write(byte_span buffer, u16 offset, byte_span payload) {
+    auto io = IoBuffer(buffer);
+    usize count = 0;
+    count += io.write_u16(offset, kOffsetOffset);
+    count += io.write_u16(static_cast<u16>(payload.size()), kLengthOffset);
+    count += io.write_byte_array(payload, kPayloadOffset);
+    return buffer.first(count);
+  }
+
+  explicit DeltaRun(byte_span buffer) : m_buffer{buffer} {}
+
+  u16 offset() const {
+    return m_buffer.read_u16(kOffsetOffset);
+  }
+
+  u16 length() const {
+    return m_buffer.read_u16(kLengthOffset);
+  }
+
+  byte_span payload() const {
+    return m_buffer.read_byte_array(kPayloadOffset, length());
+  }
+
+private:
+  IoBuffer m_buffer;
+};
+
+}
+
+#endif //NEPTUN_NEPTUN_MESSAGES_LATEST_STATE_MESSAGE_H
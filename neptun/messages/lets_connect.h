@@ -13,34 +13,54 @@ namespace freezing::network {
 class LetsConnect {
 public:
   static constexpr u8 kId = 0;
-  static constexpr usize kSerializedSize = sizeof(u8) + sizeof(u8) + sizeof(u16) + sizeof(u16);
+  static constexpr usize kSerializedSize =
+      sizeof(u16) + sizeof(u16) + sizeof(u16) + sizeof(u16)
+          + sizeof(u32) + sizeof(u32) + sizeof(u16) + sizeof(u32) + sizeof(u64);
   static constexpr usize kMaxSendPacketRate = 0;
-  static constexpr usize kMaxReadPacketRate = kMaxSendPacketRate + sizeof(u8);
+  static constexpr usize kMaxReadPacketRate = kMaxSendPacketRate + sizeof(u16);
   static constexpr usize kMaxSendPacketSize = kMaxReadPacketRate + sizeof(u16);
   static constexpr usize kMaxReadPacketSize = kMaxSendPacketSize + sizeof(u16);
+  static constexpr usize kMaxSendBytesPerSecond = kMaxReadPacketSize + sizeof(u16);
+  static constexpr usize kMaxReadBytesPerSecond = kMaxSendBytesPerSecond + sizeof(u32);
+  static constexpr usize kLatestStateHistorySize = kMaxReadBytesPerSecond + sizeof(u32);
+  static constexpr usize kReliableReceiveWindow = kLatestStateHistorySize + sizeof(u16);
+  static constexpr usize kCookie = kReliableReceiveWindow + sizeof(u32);
 
+  // [cookie] echoes the cookie from the peer's [ConnectChallenge], or is 0 if the peer hasn't
+  // challenged us (yet). [latest_state_history_size] and [reliable_receive_window] are 0 if they
+  // aren't advertised.
   static byte_span write(byte_span buffer,
-                         u8 max_send_packet_rate,
-                         u8 max_read_packet_rate,
+                         u16 max_send_packet_rate,
+                         u16 max_read_packet_rate,
                          u16 max_send_packet_size,
-                         u16 max_read_packet_size) {
+                         u16 max_read_packet_size,
+                         u32 max_send_bytes_per_second,
+                         u32 max_read_bytes_per_second,
+                         u16 latest_state_history_size,
+                         u32 reliable_receive_window,
+                         u64 cookie = 0) {
     auto io = IoBuffer(buffer);
     usize count = 0;
-    count += io.write_u8(max_send_packet_rate, kMaxSendPacketRate);
-    count += io.write_u8(max_read_packet_rate, kMaxReadPacketRate);
+    count += io.write_u16(max_send_packet_rate, kMaxSendPacketRate);
+    count += io.write_u16(max_read_packet_rate, kMaxReadPacketRate);
     count += io.write_u16(max_send_packet_size, kMaxSendPacketSize);
     count += io.write_u16(max_read_packet_size, kMaxReadPacketSize);
+    count += io.write_u32(max_send_bytes_per_second, kMaxSendBytesPerSecond);
+    count += io.write_u32(max_read_bytes_per_second, kMaxReadBytesPerSecond);
+    count += io.write_u16(latest_state_history_size, kLatestStateHistorySize);
+    count += io.write_u32(reliable_receive_window, kReliableReceiveWindow);
+    count += io.write_u64(cookie, kCookie);
     return buffer.first(count);
   }
 
   explicit LetsConnect(byte_span buffer) : m_buffer{buffer} {}
 
-  u8 max_send_packet_rate() const {
-    return m_buffer.read_u8(kMaxSendPacketRate);
+  u16 max_send_packet_rate() const {
+    return m_buffer.read_u16(kMaxSendPacketRate);
   }
 
-  u8 max_read_packet_rate() const {
-    return m_buffer.read_u8(kMaxReadPacketRate);
+  u16 max_read_packet_rate() const {
+    return m_buffer.read_u16(kMaxReadPacketRate);
   }
 
   u16 max_send_packet_size() const {
@@ -51,6 +71,26 @@ public:
     return m_buffer.read_u16(kMaxReadPacketSize);
   }
 
+  u32 max_send_bytes_per_second() const {
+    return m_buffer.read_u32(kMaxSendBytesPerSecond);
+  }
+
+  u32 max_read_bytes_per_second() const {
+    return m_buffer.read_u32(kMaxReadBytesPerSecond);
+  }
+
+  u16 latest_state_history_size() const {
+    return m_buffer.read_u16(kLatestStateHistorySize);
+  }
+
+  u32 reliable_receive_window() const {
+    return m_buffer.read_u32(kReliableReceiveWindow);
+  }
+
+  u64 cookie() const {
+    return m_buffer.read_u64(kCookie);
+  }
+
 private:
   IoBuffer m_buffer;
 };
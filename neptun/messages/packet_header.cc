@@ -12,7 +12,7 @@ namespace {
 
 constexpr std::uint32_t kPacketId = 13;
 constexpr std::uint32_t kAckSequenceNumber = 11;
-constexpr std::uint32_t kAckBitmask = 0b10101100;
+constexpr std::uint64_t kAckBitmask = (std::uint64_t{1} << 63) | 0b10101100;
 
 }
 
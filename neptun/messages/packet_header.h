@@ -11,6 +11,8 @@
 
 namespace freezing::network {
 
+// Acks the packets [ack_sequence_number, ack_sequence_number + kAckWindowSize): bit [i] of the
+// ack bitmask acks packet [ack_sequence_number + i].
 class PacketHeader {
 public:
   static constexpr usize kIdOffset = 0;
@@ -18,13 +20,14 @@ public:
   static constexpr usize kAckBitmaskOffset = kAckSequenceNumberOffset + sizeof(AckSequenceNumber);
 
   static constexpr usize kSerializedSize = sizeof(PacketId) + sizeof(AckSequenceNumber) + sizeof(AckBitmask);
+  static constexpr usize kAckWindowSize = sizeof(AckBitmask) * 8;
 
-  static byte_span write(byte_span buffer, u32 id, u32 ack_sequence_number, u32 ack_bitmask) {
+  static byte_span write(byte_span buffer, u32 id, u32 ack_sequence_number, AckBitmask ack_bitmask) {
     auto io = IoBuffer(buffer);
     usize count = 0;
     count += io.write_u32(id, kIdOffset);
     count += io.write_u32(ack_sequence_number, kAckSequenceNumberOffset);
-    count += io.write_u32(ack_bitmask, kAckBitmaskOffset);
+    count += io.write_u64(ack_bitmask, kAckBitmaskOffset);
     return buffer.first(count);
   }
 
@@ -39,7 +42,7 @@ public:
   }
 
   AckBitmask ack_bitmask() const {
-    return m_buffer.read_u32(kAckBitmaskOffset);
+    return m_buffer.read_u64(kAckBitmaskOffset);
   }
 
 private:
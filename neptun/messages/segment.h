@@ -17,6 +17,9 @@ enum ManagerType {
   // TODO: Rename to STREAM -> MANAGER
   RELIABLE_STREAM = 3,
   UNRELIABLE_STREAM = 4,
+  // Fills the rest of a packet that is sent as a GSO segment, since all segments except the
+  // last one must have the same size. Padding is always the last segment in a packet.
+  PADDING = 0xFF,
 };
 
 class Segment {
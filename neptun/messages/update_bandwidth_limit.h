@@ -0,0 +1,86 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NEPTUN_MESSAGES_UPDATE_BANDWIDTH_LIMIT_H
+#define NEPTUN_NEPTUN_MESSAGES_UPDATE_BANDWIDTH_LIMIT_H
+
+#include "common/types.h"
+#include "network/io_buffer.h"
+
+namespace freezing::network {
+
+// Replaces the bandwidth limit that the peer has sent in its LetsConnect, once the connection
+// has been established. Every update has a higher [version] than the previous one, so that an
+// update that is delayed behind a newer one is ignored.
+class UpdateBandwidthLimit {
+public:
+  static constexpr u8 kId = 3;
+  static constexpr usize kSerializedSize =
+      sizeof(u32) + sizeof(u16) + sizeof(u16) + sizeof(u16) + sizeof(u16)
+          + sizeof(u32) + sizeof(u32);
+  static constexpr usize kVersion = 0;
+  static constexpr usize kMaxSendPacketRate = kVersion + sizeof(u32);
+  static constexpr usize kMaxReadPacketRate = kMaxSendPacketRate + sizeof(u16);
+  static constexpr usize kMaxSendPacketSize = kMaxReadPacketRate + sizeof(u16);
+  static constexpr usize kMaxReadPacketSize = kMaxSendPacketSize + sizeof(u16);
+  static constexpr usize kMaxSendBytesPerSecond = kMaxReadPacketSize + sizeof(u16);
+  static constexpr usize kMaxReadBytesPerSecond = kMaxSendBytesPerSecond + sizeof(u32);
+
+  static byte_span write(byte_span buffer,
+                         u32 version,
+                         u16 max_send_packet_rate,
+                         u16 max_read_packet_rate,
+                         u16 max_send_packet_size,
+                         u16 max_read_packet_size,
+                         u32 max_send_bytes_per_second,
+                         u32 max_read_bytes_per_second) {
+    auto io = IoBuffer(buffer);
+    usize count = 0;
+    count += io.write_u32(version, kVersion);
+    count += io.write_u16(max_send_packet_rate, kMaxSendPacketRate);
+    count += io.write_u16(max_read_packet_rate, kMaxReadPacketRate);
+    count += io.write_u16(max_send_packet_size, kMaxSendPacketSize);
+    count += io.write_u16(max_read_packet_size, kMaxReadPacketSize);
+    count += io.write_u32(max_send_bytes_per_second, kMaxSendBytesPerSecond);
+    count += io.write_u32(max_read_bytes_per_second, kMaxReadBytesPerSecond);
+    return buffer.first(count);
+  }
+
+  explicit UpdateBandwidthLimit(byte_span buffer) : m_buffer{buffer} {}
+
+  u32 version() const {
+    return m_buffer.read_u32(kVersion);
+  }
+
+  u16 max_send_packet_rate() const {
+    return m_buffer.read_u16(kMaxSendPacketRate);
+  }
+
+  u16 max_read_packet_rate() const {
+    return m_buffer.read_u16(kMaxReadPacketRate);
+  }
+
+  u16 max_send_packet_size() const {
+    return m_buffer.read_u16(kMaxSendPacketSize);
+  }
+
+  u16 max_read_packet_size() const {
+    return m_buffer.read_u16(kMaxReadPacketSize);
+  }
+
+  u32 max_send_bytes_per_second() const {
+    return m_buffer.read_u32(kMaxSendBytesPerSecond);
+  }
+
+  u32 max_read_bytes_per_second() const {
+    return m_buffer.read_u32(kMaxReadBytesPerSecond);
+  }
+
+private:
+  IoBuffer m_buffer;
+};
+
+}
+
+#endif //NEPTUN_NEPTUN_MESSAGES_UPDATE_BANDWIDTH_LIMIT_H
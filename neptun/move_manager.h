@@ -0,0 +1,250 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NEPTUN_MOVE_MANAGER_H
+#define NEPTUN_NEPTUN_MOVE_MANAGER_H
+
+#include <cassert>
+#include <deque>
+#include <limits>
+
+#include "common/ring_buffer.h"
+#include "common/types.h"
+#include "neptun/common.h"
+#include "neptun/error.h"
+#include "neptun/messages/reliable_message.h"
+#include "neptun/messages/segment.h"
+
+namespace freezing::network {
+
+namespace detail {
+constexpr usize kDefaultMaxUnackedMoves = 16;
+constexpr usize kDefaultMaxMoveSize = 128;
+}
+
+// Delivers player inputs (moves) redundantly: every packet carries the latest unacked moves, so
+// a move that has been lost with one packet usually arrives with the next one, without waiting
+// for a timeout and a resend like [ReliableStream]. A move is dropped as soon as a packet that
+// carries it is acked.
+//
+// Only the latest [max_unacked_moves] moves are kept. Older moves are given up on, since they
+// have already been sent with many packets, and a late move is useless anyway. If not all moves
+// fit into a packet, the newest ones are written.
+//
+// The receiver reports each move once, in the order in which they are received, and discards
+// moves that are more than [kReceiveWindowSize] older than the newest received move.
+// Moves use the same encoding as reliable messages.
+class MoveManager {
+public:
+  static constexpr usize kReceiveWindowSize = 64;
+
+  explicit MoveManager(usize max_unacked_moves = detail::kDefaultMaxUnackedMoves,
+                       usize max_move_size = detail::kDefaultMaxMoveSize)
+  // With at most [max_unacked_moves] - 1 moves in the buffer when a move is written, there is
+  // always space for a contiguous [max_move_size] bytes, even if the free space wraps around.
+      : m_buffer((max_unacked_moves + 1) * max_move_size),
+        m_max_unacked_moves{max_unacked_moves},
+        m_max_move_size{max_move_size} {
+    assert(max_unacked_moves > 0 && max_unacked_moves <= std::numeric_limits<u8>::max());
+    assert(max_move_size > 0 && max_move_size <= std::numeric_limits<u16>::max());
+  }
+
+  // [write_to_buffer] is given at most [max_move_size] bytes. Empty moves aren't sent.
+  template<typename WriteToBufferFn>
+  void send(WriteToBufferFn write_to_buffer) {
+    while (m_moves.size() >= m_max_unacked_moves) {
+      // The oldest move is given up on, whether or not it has been delivered.
+      release_front();
+    }
+    auto remaining = m_buffer.remaining();
+    assert(remaining.size() >= m_max_move_size);
+    auto payload = write_to_buffer(remaining.first(m_max_move_size));
+    if (payload.empty()) {
+      return;
+    }
+    assert(payload.size() <= m_max_move_size);
+    auto offset = m_buffer.advance(payload.size());
+    m_moves.push_back({offset, payload.size(), m_next_outgoing_sequence_number++, false});
+    m_has_unwritten_moves = true;
+  }
+
+  // Whether there are unacked moves that haven't been written since they've been sent, or since
+  // a packet that carried them has been dropped.
+  bool has_pending_moves() const {
+    return m_has_unwritten_moves;
+  }
+
+  // Number of moves that haven't been acked yet.
+  usize unacked_move_count() const {
+    usize count = 0;
+    for (const auto &move : m_moves) {
+      count += !move.is_acked;
+    }
+    return count;
+  }
+
+  // Writes the newest unacked moves that fit into [buffer], in sequence order.
+  usize write(PacketId packet_id, byte_span buffer) {
+    usize total_size = Segment::kSerializedSize;
+    usize message_count = 0;
+    // Index of the oldest move that is written.
+    usize first = m_moves.size();
+    while (first > 0) {
+      const auto &move = m_moves[first - 1];
+      if (!move.is_acked) {
+        const usize msg_size = ReliableMessage::serialized_size(move.size);
+        if (total_size + msg_size > buffer.size()) {
+          break;
+        }
+        total_size += msg_size;
+        message_count++;
+      }
+      first--;
+    }
+
+    if (message_count == 0) {
+      return 0;
+    }
+
+    usize idx = Segment::write(buffer, ManagerType::MOVE_MANAGER, message_count).size();
+    for (usize i = first; i < m_moves.size(); i++) {
+      const auto &move = m_moves[i];
+      if (move.is_acked) {
+        continue;
+      }
+      auto payload = m_buffer.record(move.offset, move.size);
+      idx += ReliableMessage::write(advance(buffer, idx),
+                                    move.sequence_number,
+                                    static_cast<u16>(payload.size()),
+                                    payload).size();
+    }
+    assert(idx == total_size);
+    m_in_flight_packets.push_back({packet_id,
+                                   m_moves[first].sequence_number,
+                                   m_moves.back().sequence_number});
+    m_has_unwritten_moves = first > 0 && has_unacked_move_before(first);
+    return total_size;
+  }
+
+  // Statuses must be reported in packet order, which [PacketDeliveryManager] guarantees.
+  void on_packet_delivery_status(PacketId packet_id, PacketDeliveryStatus status) {
+    while (!m_in_flight_packets.empty() && m_in_flight_packets.front().packet_id <= packet_id) {
+      auto in_flight = m_in_flight_packets.front();
+      m_in_flight_packets.pop_front();
+      // A packet that is older than [packet_id] and still in flight won't get a status anymore,
+      // so it's treated as dropped.
+      if (in_flight.packet_id == packet_id && status == PacketDeliveryStatus::ACK) {
+        for (auto &move : m_moves) {
+          if (move.sequence_number >= in_flight.first_sequence_number
+              && move.sequence_number <= in_flight.last_sequence_number) {
+            move.is_acked = true;
+          }
+        }
+      } else {
+        m_has_unwritten_moves = true;
+      }
+    }
+    while (!m_moves.empty() && m_moves.front().is_acked) {
+      release_front();
+    }
+    if (m_has_unwritten_moves && !has_unacked_move_before(m_moves.size())) {
+      m_has_unwritten_moves = false;
+    }
+  }
+
+  // Calls [on_move] with each move that hasn't been received before.
+  template<typename OnMoveFn>
+  expected<usize, NeptunError> read(byte_span buffer, OnMoveFn on_move) {
+    if (Segment::kSerializedSize > buffer.size()) {
+      return 0;
+    }
+    auto segment = Segment(buffer);
+    if (segment.manager_type() != ManagerType::MOVE_MANAGER) {
+      return 0;
+    }
+    usize idx = Segment::kSerializedSize;
+    for (int i = 0; i < segment.message_count(); i++) {
+      ReliableMessage message(advance(buffer, idx));
+      const auto msg_size = message.validate_size();
+      if (!msg_size) {
+        return make_error(NeptunError::MALFORMED_PACKET);
+      }
+      idx += *msg_size;
+      if (mark_received(message.sequence_number())) {
+        on_move(message.payload());
+      }
+    }
+    return idx;
+  }
+
+private:
+  struct Move {
+    u64 offset;
+    usize size;
+    u32 sequence_number;
+    bool is_acked;
+  };
+
+  struct InFlightPacket {
+    PacketId packet_id;
+    // Range of the moves that the packet carries, without the moves that have been acked
+    // before it's been written.
+    u32 first_sequence_number;
+    u32 last_sequence_number;
+  };
+
+  // Sender side.
+  // Payloads of [m_moves].
+  RingBuffer<u8> m_buffer;
+  usize m_max_unacked_moves;
+  usize m_max_move_size;
+  // In sequence order, without gaps.
+  std::deque<Move> m_moves{};
+  // In packet order.
+  std::deque<InFlightPacket> m_in_flight_packets{};
+  u32 m_next_outgoing_sequence_number{0};
+  bool m_has_unwritten_moves{false};
+
+  // Receiver side.
+  // One past the newest received sequence number.
+  u32 m_received_end{0};
+  // Bit [i] is set if move [m_received_end - 1 - i] has been received.
+  u64 m_received_mask{0};
+
+  void release_front() {
+    const auto &move = m_moves.front();
+    m_buffer.release(move.offset + move.size);
+    m_moves.pop_front();
+  }
+
+  bool has_unacked_move_before(usize end) const {
+    for (usize i = 0; i < end; i++) {
+      if (!m_moves[i].is_acked) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns whether the move hasn't been received before.
+  bool mark_received(u32 sequence_number) {
+    if (sequence_number >= m_received_end) {
+      u32 shift = sequence_number + 1 - m_received_end;
+      m_received_mask = shift >= kReceiveWindowSize ? 0 : m_received_mask << shift;
+      m_received_mask |= 1;
+      m_received_end = sequence_number + 1;
+      return true;
+    }
+    u32 distance = m_received_end - 1 - sequence_number;
+    if (distance >= kReceiveWindowSize || (m_received_mask >> distance) & 1) {
+      return false;
+    }
+    m_received_mask |= u64{1} << distance;
+    return true;
+  }
+};
+
+}
+
+#endif //NEPTUN_NEPTUN_MOVE_MANAGER_H
@@ -0,0 +1,178 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "common/types.h"
+#include "neptun/move_manager.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+
+std::vector<u8> make_buffer(usize size = 1400) {
+  return std::vector<u8>(size);
+}
+
+void send_move(MoveManager &sender, u8 move, usize size = 1) {
+  sender.send([move, size](byte_span buffer) {
+    std::fill_n(buffer.begin(), size, move);
+    return buffer.first(size);
+  });
+}
+
+// Returns the first byte of each move that [receiver] has reported for the packet.
+std::vector<u8> deliver(MoveManager &receiver, byte_span packet) {
+  std::vector<u8> received{};
+  auto result = receiver.read(packet, [&received](byte_span move) {
+    received.push_back(move[0]);
+  });
+  EXPECT_EQ(result, packet.size());
+  return received;
+}
+
+}
+
+TEST(MoveManagerTest, WritesUnackedMovesToEveryPacket) {
+  MoveManager sender{};
+  MoveManager receiver{};
+  auto buffer = make_buffer();
+  ASSERT_EQ(sender.write(0, buffer), 0);
+
+  send_move(sender, 1);
+  ASSERT_TRUE(sender.has_pending_moves());
+  auto count = sender.write(0, buffer);
+  ASSERT_FALSE(sender.has_pending_moves());
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), std::vector<u8>{1});
+
+  // The first move isn't acked yet, so it's written again.
+  send_move(sender, 2);
+  count = sender.write(1, buffer);
+  ASSERT_EQ(count, Segment::kSerializedSize + 2 * ReliableMessage::serialized_size(1));
+  // The first move isn't reported again.
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), std::vector<u8>{2});
+}
+
+TEST(MoveManagerTest, DropsMovesOnceCarryingPacketIsAcked) {
+  MoveManager sender{};
+  auto buffer = make_buffer();
+  send_move(sender, 1);
+  sender.write(0, buffer);
+  send_move(sender, 2);
+  sender.write(1, buffer);
+  send_move(sender, 3);
+  ASSERT_EQ(sender.unacked_move_count(), 3);
+
+  // The first packet carries only the first move.
+  sender.on_packet_delivery_status(0, PacketDeliveryStatus::ACK);
+  ASSERT_EQ(sender.unacked_move_count(), 2);
+  sender.on_packet_delivery_status(1, PacketDeliveryStatus::ACK);
+  ASSERT_EQ(sender.unacked_move_count(), 1);
+  ASSERT_EQ(sender.write(2, buffer), Segment::kSerializedSize + ReliableMessage::serialized_size(1));
+  sender.on_packet_delivery_status(2, PacketDeliveryStatus::ACK);
+  ASSERT_EQ(sender.unacked_move_count(), 0);
+  ASSERT_FALSE(sender.has_pending_moves());
+  ASSERT_EQ(sender.write(3, buffer), 0);
+}
+
+TEST(MoveManagerTest, LostMoveArrivesWithNextPacket) {
+  MoveManager sender{};
+  MoveManager receiver{};
+  auto buffer = make_buffer();
+  send_move(sender, 1);
+  // The packet is lost.
+  sender.write(0, buffer);
+
+  send_move(sender, 2);
+  auto count = sender.write(1, buffer);
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), (std::vector<u8>{1, 2}));
+  sender.on_packet_delivery_status(0, PacketDeliveryStatus::DROP);
+  sender.on_packet_delivery_status(1, PacketDeliveryStatus::ACK);
+  ASSERT_EQ(sender.unacked_move_count(), 0);
+  ASSERT_FALSE(sender.has_pending_moves());
+}
+
+TEST(MoveManagerTest, DroppedPacketMakesMovesPending) {
+  MoveManager sender{};
+  auto buffer = make_buffer();
+  send_move(sender, 1);
+  sender.write(0, buffer);
+  ASSERT_FALSE(sender.has_pending_moves());
+  sender.on_packet_delivery_status(0, PacketDeliveryStatus::DROP);
+  ASSERT_TRUE(sender.has_pending_moves());
+}
+
+TEST(MoveManagerTest, KeepsOnlyLatestMoves) {
+  MoveManager sender{3};
+  MoveManager receiver{3};
+  auto buffer = make_buffer();
+  for (u8 move = 1; move <= 5; move++) {
+    send_move(sender, move);
+  }
+  ASSERT_EQ(sender.unacked_move_count(), 3);
+  auto count = sender.write(0, buffer);
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), (std::vector<u8>{3, 4, 5}));
+}
+
+TEST(MoveManagerTest, WritesNewestMovesThatFit) {
+  MoveManager sender{};
+  MoveManager receiver{};
+  for (u8 move = 1; move <= 3; move++) {
+    send_move(sender, move, 10);
+  }
+  auto buffer = make_buffer(Segment::kSerializedSize + 2 * ReliableMessage::serialized_size(10));
+  auto count = sender.write(0, buffer);
+  ASSERT_EQ(count, buffer.size());
+  ASSERT_EQ(deliver(receiver, buffer), (std::vector<u8>{2, 3}));
+  ASSERT_TRUE(sender.has_pending_moves());
+
+  // The oldest move is written once the newer ones are acked.
+  sender.on_packet_delivery_status(0, PacketDeliveryStatus::ACK);
+  count = sender.write(1, buffer);
+  ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), std::vector<u8>{1});
+}
+
+TEST(MoveManagerTest, DeduplicatesReorderedMoves) {
+  MoveManager sender{};
+  MoveManager receiver{};
+  auto first = make_buffer();
+  auto second = make_buffer();
+  send_move(sender, 1);
+  auto first_count = sender.write(0, first);
+  send_move(sender, 2);
+  auto second_count = sender.write(1, second);
+
+  ASSERT_EQ(deliver(receiver, byte_span(second).first(second_count)), (std::vector<u8>{1, 2}));
+  ASSERT_EQ(deliver(receiver, byte_span(first).first(first_count)), std::vector<u8>{});
+}
+
+TEST(MoveManagerTest, DiscardsMovesOlderThanReceiveWindow) {
+  MoveManager sender{};
+  MoveManager receiver{};
+  auto old = make_buffer();
+  send_move(sender, 0);
+  auto old_count = sender.write(0, old);
+  sender.on_packet_delivery_status(0, PacketDeliveryStatus::ACK);
+  for (usize i = 1; i <= MoveManager::kReceiveWindowSize; i++) {
+    send_move(sender, static_cast<u8>(i));
+    auto buffer = make_buffer();
+    auto count = sender.write(i, buffer);
+    sender.on_packet_delivery_status(i, PacketDeliveryStatus::ACK);
+    ASSERT_EQ(deliver(receiver, byte_span(buffer).first(count)), std::vector<u8>{static_cast<u8>(i)});
+  }
+  ASSERT_EQ(deliver(receiver, byte_span(old).first(old_count)), std::vector<u8>{});
+}
+
+TEST(MoveManagerTest, MalformedMove) {
+  MoveManager sender{};
+  MoveManager receiver{};
+  auto buffer = make_buffer();
+  send_move(sender, 1, 10);
+  auto count = sender.write(0, buffer);
+  auto result = receiver.read(byte_span(buffer).first(count - 1), [](byte_span) {});
+  ASSERT_EQ(result, make_error(NeptunError::MALFORMED_PACKET));
+}
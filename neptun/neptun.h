@@ -5,21 +5,31 @@
 #ifndef NEPTUN_NEPTUN_NEPTUN_H
 #define NEPTUN_NEPTUN_NEPTUN_H
 
-#include <map>
 #include <stack>
 #include <queue>
+#include <deque>
 #include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <type_traits>
 
 #include "common/types.h"
 #include "common/ticker.h"
+#include "common/timer_wheel.h"
 #include "network/network.h"
 #include "network/udp_socket.h"
 #include "neptun/messages/packet_header.h"
 #include "neptun/packet_delivery_manager.h"
 #include "neptun/reliable_stream.h"
 #include "neptun/unreliable_stream.h"
+#include "neptun/latest_state_manager.h"
+#include "neptun/move_manager.h"
 #include "neptun/neptun_metrics.h"
+#include "neptun/congestion_controller.h"
 #include "neptun/connection_manager.h"
+#include "neptun/handshake_guard.h"
+#include "neptun/peer_table.h"
 
 namespace freezing::network {
 
@@ -29,6 +39,47 @@ constexpr usize kJustAboveMtu = 1600;
 // JKust below is used for writing.
 constexpr u16 kJustBelowMtu = 1400;
 
+// Message callbacks take either the payload, or the sender and the payload.
+template<typename MessageFn>
+void invoke_message_callback(MessageFn &callback, IpAddress sender, byte_span payload) {
+  if constexpr (std::is_invocable_v<MessageFn &, IpAddress, byte_span>) {
+    callback(sender, payload);
+  } else {
+    callback(payload);
+  }
+}
+
+// Returns a write-to-buffer function for [Neptun::send_reliable_to] and
+// [Neptun::send_unreliable_to] that copies [payload], e.g. of a message queued by another
+// thread. Nothing is written if the payload doesn't fit, and [is_written] tells whether it did.
+inline auto copy_payload(const_byte_span payload, bool &is_written) {
+  return [payload, &is_written](byte_span buffer) {
+    if (payload.size() > buffer.size()) {
+      return buffer.first(0);
+    }
+    std::copy(payload.begin(), payload.end(), buffer.begin());
+    is_written = true;
+    return buffer.first(payload.size());
+  };
+}
+
+// Id of the packets that are sent to unknown peers, without any per-peer state, e.g. handshake
+// challenges. Such packets aren't acked, and they bypass [PacketDeliveryManager].
+constexpr PacketId kStatelessPacketId = std::numeric_limits<PacketId>::max();
+
+// Linux sends at most 64 segments (UDP_MAX_SEGMENTS) with a single GSO send.
+constexpr usize kMaxGsoSegments = 64;
+
+// A packet that has been written to the send buffer pool, but hasn't been sent yet.
+// If [segment_size] is non-zero, it's a burst of packets for the same recipient, each
+// [segment_size] bytes long except the last one, and it's sent with a single GSO send.
+struct EgressPacket {
+  IpAddress recipient;
+  usize offset;
+  usize size;
+  u16 segment_size{0};
+};
+
 template<typename Clock>
 struct Peer {
   Ticker<Clock> send_packet_ticker;
@@ -36,136 +87,700 @@ struct Peer {
   ConnectionManager connection_manager;
   ReliableStream reliable_stream;
   UnreliableStream unreliable_stream;
+  CongestionController<Clock> congestion_controller;
+  LatestStateManager latest_state_manager;
+  MoveManager move_manager;
+  // Number of send ticks to skip, because they have already been used by a burst.
+  usize burst_debt{0};
+  std::optional<time_point<Clock>> last_write_time{};
+  // Whether a packet with messages has been received since the last packet was sent to the peer,
+  // i.e. whether the peer waits for an ack. Packets without messages are acked when the next
+  // packet is sent, otherwise two idle peers would keep acking each other's acks.
+  bool has_unacked_messages{false};
+  // Time at which the first reliable message since the last packet sent to the peer has been
+  // received. See [NeptunConfig::immediate_acks].
+  std::optional<time_point<Clock>> reliable_received_time{};
+  // Packets in flight that carry messages, in packet order. The peer acks them on its next send
+  // tick, so only their drops are a sign of congestion. A header-only packet, e.g. a keepalive or
+  // an ack, isn't acked until the peer has something to send itself, so it may time out.
+  std::deque<PacketId> in_flight_message_packets{};
+  // Timer of the next send tick at which the peer has something to send, unless the peer is
+  // polled on every tick.
+  std::optional<TimerId> send_timer{};
+  time_point<Clock> send_timer_deadline{};
+  // Timer that expires no later than the oldest in-flight packet times out, if any.
+  std::optional<TimerId> timeout_timer{};
+  time_point<Clock> timeout_timer_deadline{};
+  bool is_polled{false};
+  // Time at which the last valid packet has been received from the peer, or at which the peer
+  // has been created.
+  time_point<Clock> last_read_time{};
+  // Timer that expires no later than the peer becomes idle.
+  std::optional<TimerId> idle_timer{};
 
-  void update_send_rate(u8 rate) {
-    if (rate == 0) {
-      send_packet_ticker.clear_tick_interval();
+  // Packets per second that [send_packet_ticker] fires at, zero if it fires on every tick.
+  u16 send_rate{0};
+
+  // Returns whether the send rate has changed.
+  bool update_send_rate(u16 rate) {
+    if (rate == send_rate) {
+      return false;
+    }
+    send_rate = rate;
+    if (rate != 0) {
+      send_packet_ticker.set_tick_rate(rate);
     } else {
-      nanoseconds tick_interval = nanoseconds(seconds(1)) / rate;
-      send_packet_ticker.set_tick_interval(tick_interval);
+      send_packet_ticker.clear_tick_interval();
     }
+    return true;
   }
 };
 
 }
 
+struct PeerStats {
+  // Round-trip time of the packets sent to the peer, measured from the peer's acks.
+  // Nothing until a packet has been acked.
+  std::optional<RttStats> rtt;
+  // Time after which an in-flight packet is considered dropped, which adapts to the RTT.
+  nanoseconds packet_timeout;
+  // Bytes of the reliable messages that have been received ahead of a lost one, and are held
+  // until it's resent.
+  usize reliable_receive_window_size;
+  // Current packet rate and size towards the peer, set by its congestion controller within the
+  // bandwidth limit. Zero packet rate means no limit.
+  u16 send_packet_rate;
+  u16 send_packet_size;
+  // Whether the peer hasn't acked our latest bandwidth limit yet.
+  bool is_bandwidth_limit_update_pending;
+};
+
+struct NeptunConfig {
+  // Maximum number of datagrams read from the socket with a single batched read.
+  usize read_batch_size{32};
+  // Maximum number of datagrams read from the socket on each tick.
+  // Bounds the time spent reading, so that writing isn't starved when the socket is flooded.
+  usize max_read_packets_per_tick{256};
+  // Maximum number of packets that have been written, but not sent yet because the socket's
+  // send buffer is full. No new packets are written while the limit is reached.
+  usize max_unsent_packets{1024};
+  // Opts into UDP GSO and GRO, if the network supports them.
+  // With GSO, a peer with a reliable backlog is sent a burst of up to [max_gso_segments] packets
+  // with one send. Packets sent in a burst are taken from the peer's future send ticks, so the
+  // send rate agreed during the handshake is still respected on average.
+  // With GRO, coalesced datagrams are split back into packets before they are processed.
+  bool udp_offload{false};
+  usize max_gso_segments{16};
+  // Handshake packets are resent at this interval until the connection is established.
+  // Packets are resent on every tick, but [Neptun::next_deadline] doesn't ask to be ticked
+  // more often than this.
+  milliseconds handshake_resend_interval{50};
+  // Binds the socket with SO_REUSEPORT, so that multiple instances can share the same IP address.
+  // See [ShardedNeptun].
+  bool reuse_port{false};
+  // Resolution of the timers that wake up peers on their send ticks and packet timeouts.
+  // Timers expire on the first tick at or after their deadline rounded up to the resolution.
+  nanoseconds timer_resolution{milliseconds(1)};
+  // Peers that haven't sent a valid packet for this long are evicted, which also releases the
+  // memory of peers created by stray datagrams. Connected peers keep each other alive, because
+  // they send packets at least at their agreed send rate, or at least every third of
+  // [idle_timeout] with [skip_idle_send_ticks].
+  milliseconds idle_timeout{seconds(30)};
+  // Opts out of sending a packet to a connected peer on every send tick when there is nothing
+  // to send and no ack is owed. Such peers aren't woken up until they have something to send,
+  // and are only sent a keepalive every third of [idle_timeout], which saves work with many
+  // idle peers. The peer then learns about its drops later, from timeouts.
+  bool skip_idle_send_ticks{false};
+  // Bytes of reliable messages that each peer can have unacked, which is also the size of the
+  // peer's receive window for reliable messages. The window is exchanged during the handshake,
+  // and messages are only written ahead of a lost one while they fit into the peer's window.
+  usize reliable_stream_capacity{detail::kDefaultReliableStreamCapacity};
+  // Maximum number of peers. Handshakes from new peers are rejected while the limit is reached.
+  usize max_peers{65536};
+  // Unknown peers are only created once they echo the cookie from our challenge, so datagrams
+  // from spoofed addresses never allocate any state. See [HandshakeCookies].
+  // Cookies are valid for at least [handshake_cookie_lifetime].
+  milliseconds handshake_cookie_lifetime{seconds(5)};
+  // Maximum number of handshake packets per second from a single unknown address, on any port,
+  // that are answered, and the number of such packets that are answered back to back.
+  u32 handshake_rate_limit{10};
+  u32 handshake_burst{20};
+  // Lower bound of the packet timeout, which adapts to the measured RTT. The upper bound is
+  // Neptun's [packet_timeout].
+  milliseconds min_packet_timeout{detail::kDefaultMinPacketTimeout};
+  // Packets that arrive out of order, at most this many packets behind the newest packet
+  // received from the peer, are still processed. Must be less than 64. Likewise, a sent packet
+  // isn't considered dropped until the peer acks a packet that is more than this many packets
+  // newer, or until it times out. See [PacketDeliveryManager].
+  u32 max_packet_reorder_distance{detail::kDefaultMaxReorderDistance};
+  // Send ticks that a peer has missed, e.g. because its send interval is shorter than the
+  // interval at which Neptun is ticked or than [timer_resolution], are caught up with several
+  // packets in one tick, as long as they have been missed within this long. Older send ticks
+  // are skipped, so that a stalled tick doesn't cause a burst.
+  milliseconds max_send_catch_up{10};
+  // Number of snapshots of the latest state that each peer keeps for the deltas. It's exchanged
+  // during the handshake, and both sides use the smaller one. See [LatestStateManager].
+  usize latest_state_history_size{detail::kDefaultLatestStateHistorySize};
+  // Number of the latest unacked moves that are written to every packet, and the maximum size
+  // of a move. See [MoveManager].
+  usize max_unacked_moves{detail::kDefaultMaxUnackedMoves};
+  usize max_move_size{detail::kDefaultMaxMoveSize};
+  // Adapts each peer's send rate and packet size to drops and queueing delay.
+  // See [CongestionController].
+  CongestionControlConfig congestion_control{};
+  // Reliable messages are acked by a packet sent [immediate_ack_delay] after they've been
+  // received, unless the next send tick comes within [immediate_ack_delay] after that anyway.
+  // Otherwise, the acks wait for the next send tick, which at low packet rates makes the peer
+  // resend messages that have been delivered. The packet is header-only unless there are
+  // pending messages, and it's taken from the peer's future send ticks like a GSO burst, so that
+  // the bandwidth limit is still respected on average.
+  bool immediate_acks{true};
+  milliseconds immediate_ack_delay{5};
+};
+
 template<typename Network, typename Clock>
 class Neptun {
 public:
+  // [packet_timeout] is the upper bound of the packet timeout, which adapts to each peer's RTT.
   explicit Neptun(Network &network,
                   IpAddress ip,
                   ConnectionManagerConfig connection_manager_config,
-                  milliseconds packet_timeout = detail::kDefaultPacketTimeout) : m_udp_socket{
-      UdpSocket<Network>::bind(ip, network)}, m_network_buffer(kJustAboveMtu),
+                  milliseconds packet_timeout = detail::kDefaultPacketTimeout,
+                  NeptunConfig config = {}) : m_udp_socket{
+      UdpSocket<Network>::bind(ip, network, config.reuse_port)},
                                                                             m_connection_manager_config{
                                                                                 connection_manager_config},
                                                                             m_packet_timeout{
-                                                                                packet_timeout} {}
+                                                                                packet_timeout},
+                                                                            m_config{config},
+                                                                            m_send_timers{
+                                                                                config.timer_resolution},
+                                                                            m_timeout_timers{
+                                                                                config.timer_resolution},
+                                                                            m_idle_timers{
+                                                                                config.timer_resolution},
+                                                                            m_handshake_cookies{
+                                                                                config.handshake_cookie_lifetime},
+                                                                            m_handshake_rate_limiter{
+                                                                                config.handshake_rate_limit,
+                                                                                config.handshake_burst} {
+    assert(config.read_batch_size > 0);
+    assert(config.max_peers > 0);
+    assert(config.max_gso_segments > 0 && config.max_gso_segments <= kMaxGsoSegments);
+    if (config.udp_offload) {
+      m_udp_offload = m_udp_socket.enable_udp_offload({true, true});
+    }
+    // With GRO, a single read may return many coalesced packets.
+    usize read_buffer_size = m_udp_offload.receive_coalescing ? kMaxUdpPayloadSize : kJustAboveMtu;
+    m_read_buffer_pool.resize(config.read_batch_size * read_buffer_size);
+    for (usize i = 0; i < config.read_batch_size; i++) {
+      m_read_buffers.emplace_back(m_read_buffer_pool.begin() + i * read_buffer_size,
+                                  m_read_buffer_pool.begin() + (i + 1) * read_buffer_size);
+    }
+    m_read_packets.reserve(config.read_batch_size);
+  }
 
   template<typename OnReliableFn = std::function<void(byte_span)>, typename OnUnreliableFn = std::function<
       void(byte_span)>>
   void tick(time_point<Clock> now,
             OnReliableFn on_reliable = [](byte_span) {},
             OnUnreliableFn on_unreliable = [](byte_span) {}) {
-    for (auto&[ip, peer] : m_peers) {
+    evict_idle_peers(now);
+    // Only peers with a packet that may have timed out are visited.
+    m_timeout_timers.advance(now, [this](PeerHandle handle) { m_due_peers.push_back(handle); });
+    for (auto handle : m_due_peers) {
+      if (!m_peers.contains(handle)) {
+        continue;
+      }
+      auto &peer = m_peers.get(handle);
+      peer.timeout_timer.reset();
       auto delivery_statuses = peer.packet_delivery_manager.drop_old_packets(now);
-      process_delivery_statuses(peer, delivery_statuses);
+      process_delivery_statuses(handle, peer, delivery_statuses, now);
+      schedule_timeout(handle, peer);
+      // Dropped packets may have left messages to resend.
+      schedule_send(handle, peer);
     }
+    m_due_peers.clear();
     read(now, on_reliable, on_unreliable);
     write(now);
+    m_last_tick_time = now;
   }
 
+  // Returns the earliest time at which [tick] may have work to do, even if no packets are
+  // received: a peer's send ticker firing, a keepalive, an in-flight packet timing out, a
+  // handshake packet being resent, or a peer becoming idle. Returns nothing if there are no
+  // peers.
+  // The deadline may be in the past, which means that [tick] should be called immediately.
+  // It's a lower bound: timers far in the future are only bounded by the time at which their
+  // wheel needs to be advanced, so [tick] may have nothing to do yet.
+  // Only the polled peers are visited, so the cost doesn't grow with the number of connected
+  // peers.
+  std::optional<time_point<Clock>> next_deadline() const {
+    std::optional<time_point<Clock>> deadline{};
+    auto consider = [&deadline](std::optional<time_point<Clock>> candidate) {
+      if (candidate && (!deadline || *candidate < *deadline)) {
+        deadline = candidate;
+      }
+    };
+    consider(m_send_timers.next_deadline());
+    consider(m_timeout_timers.next_deadline());
+    consider(m_idle_timers.next_deadline());
+    for (auto handle : m_polled_peers) {
+      if (!m_peers.contains(handle)) {
+        continue;
+      }
+      const auto &peer = m_peers.get(handle);
+      if (!peer.connection_manager.is_fully_connected()) {
+        consider(peer.last_write_time
+                 ? *peer.last_write_time + m_config.handshake_resend_interval
+                 : m_last_tick_time);
+      } else if (needs_send(peer)) {
+        // Without a tick interval, the ticker fires whenever it's ticked.
+        consider(m_last_tick_time);
+      }
+    }
+    return deadline;
+  }
+
+  // The socket that Neptun reads from, e.g. to wait until it's readable.
+  FileDescriptor socket_fd() const {
+    return m_udp_socket.fd();
+  }
+
+  // Throws if the peer limit has been reached.
   void connect(IpAddress ip, time_point<Clock> now) {
-    auto &connection_manager =
-        find_or_create_peer(0 /* next_expected_packet_id */, ip, now).connection_manager;
-    connection_manager.connect();
+    auto handle = find_or_create_peer(0 /* next_expected_packet_id */, ip, now);
+    if (!handle) {
+      throw std::runtime_error("Cannot connect to " + ip.to_string() + ": too many peers");
+    }
+    m_peers.get(*handle).connection_manager.connect();
   }
 
   bool is_connected(IpAddress ip) const {
-    auto it = m_peers.find(ip);
-    return it != m_peers.end() && it->second.connection_manager.is_peer_connected();
+    auto handle = m_peers.find(ip);
+    return handle && m_peers.get(*handle).connection_manager.is_peer_connected();
+  }
+
+  // Returns the handle of a known peer, which can be used instead of the IP address to send
+  // messages to the peer without a lookup. The handle is invalidated when the peer is evicted.
+  std::optional<PeerHandle> find_peer(IpAddress ip) const {
+    return m_peers.find(ip);
   }
 
   template<typename WriteToBufferFn>
   // TODO(nikola): Remove now from here and other APIs. It's currently only used to initialize peer, but that is not required anymore.
   void send_reliable_to(IpAddress ip, WriteToBufferFn write_to_buffer, time_point<Clock> now) {
-    assert(is_connected(ip));
-    auto
-        &reliable_stream =
-        find_or_create_peer(0 /* next_expected_packet_id */, ip, now).reliable_stream;
-    reliable_stream.template send(write_to_buffer);
+    send_reliable_to(find_connected_peer(ip), write_to_buffer);
+  }
+
+  template<typename WriteToBufferFn>
+  void send_reliable_to(PeerHandle handle, WriteToBufferFn write_to_buffer) {
+    auto &peer = m_peers.get(handle);
+    assert(peer.connection_manager.is_peer_connected());
+    peer.reliable_stream.template send(write_to_buffer);
+    schedule_send(handle, peer);
   }
 
   template<typename WriteToBufferFn>
   void send_unreliable_to(IpAddress ip, WriteToBufferFn write_to_buffer, time_point<Clock> now) {
-    assert(is_connected(ip));
-    auto &unreliable_stream =
-        find_or_create_peer(0 /* next_expected_packet_id */, ip, now).unreliable_stream;
-    unreliable_stream.template send(write_to_buffer);
+    send_unreliable_to(find_connected_peer(ip), write_to_buffer);
+  }
+
+  template<typename WriteToBufferFn>
+  void send_unreliable_to(PeerHandle handle, WriteToBufferFn write_to_buffer) {
+    auto &peer = m_peers.get(handle);
+    assert(peer.connection_manager.is_peer_connected());
+    peer.unreliable_stream.template send(write_to_buffer);
+    schedule_send(handle, peer);
+  }
+
+  // Replaces the latest state that is sent to the peer, e.g. a snapshot of the world that the
+  // peer sees. Only the latest state is delivered, as a delta against a state that the peer has
+  // acked. The state must fit into a single packet to the peer, so throws if it's larger than
+  // [LatestStateManager::max_state_size] of the packet size that the peer accepts (at most
+  // [kJustBelowMtu]), without the packet header. The state shares the packet with the other
+  // messages, so it may be delayed while they, or congestion control, leave it less space.
+  void send_latest_state_to(IpAddress ip, const_byte_span state) {
+    send_latest_state_to(find_connected_peer(ip), state);
+  }
+
+  void send_latest_state_to(PeerHandle handle, const_byte_span state) {
+    auto &peer = m_peers.get(handle);
+    assert(peer.connection_manager.is_peer_connected());
+    usize packet_size = std::min(kJustBelowMtu, max_packet_size(peer));
+    usize max_state_size =
+        LatestStateManager::max_state_size(packet_size - PacketHeader::kSerializedSize);
+    if (state.size() > max_state_size) {
+      throw std::runtime_error("Latest state of " + std::to_string(state.size())
+                                   + " bytes doesn't fit into a packet, the limit is "
+                                   + std::to_string(max_state_size));
+    }
+    peer.latest_state_manager.set_state(state);
+    schedule_send(handle, peer);
+  }
+
+  // Called with the full state, whenever a newer state than the previous one is received.
+  void set_latest_state_callback(std::function<void(IpAddress, byte_span)> on_latest_state) {
+    m_on_latest_state = std::move(on_latest_state);
+  }
+
+  // Sends a player input to the peer. The latest unacked moves are written to every packet, so
+  // a lost move doesn't wait for a resend. Moves older than the latest [max_unacked_moves] are
+  // given up on. [write_to_buffer] is given at most [max_move_size] bytes.
+  template<typename WriteToBufferFn>
+  void send_move_to(IpAddress ip, WriteToBufferFn write_to_buffer) {
+    send_move_to(find_connected_peer(ip), write_to_buffer);
+  }
+
+  template<typename WriteToBufferFn>
+  void send_move_to(PeerHandle handle, WriteToBufferFn write_to_buffer) {
+    auto &peer = m_peers.get(handle);
+    assert(peer.connection_manager.is_peer_connected());
+    peer.move_manager.template send(write_to_buffer);
+    schedule_send(handle, peer);
+  }
+
+  // Called once for each move received from a peer, in the order in which the moves arrive.
+  void set_move_callback(std::function<void(IpAddress, byte_span)> on_move) {
+    m_on_move = std::move(on_move);
+  }
+
+  // Changes our bandwidth limit towards a known peer, e.g. to give more bandwidth to the peers
+  // that need it. The peer is sent the new limit, which it applies once it receives it.
+  // Throws if the peer is unknown.
+  void update_bandwidth_limit(IpAddress ip, BandwidthLimit limit) {
+    auto handle = m_peers.find(ip);
+    if (!handle) {
+      throw std::runtime_error("Unknown peer: " + ip.to_string());
+    }
+    update_bandwidth_limit(*handle, m_peers.get(*handle), limit);
+  }
+
+  // Changes our bandwidth limit towards all peers, including the peers that connect later.
+  void update_bandwidth_limit(BandwidthLimit limit) {
+    m_connection_manager_config.limit = limit;
+    for (auto&[ip, peer] : m_peers) {
+      update_bandwidth_limit(*m_peers.find(ip), peer, limit);
+    }
+  }
+
+  // Returns nothing if the peer is unknown.
+  std::optional<PeerStats> peer_stats(IpAddress ip) const {
+    auto handle = m_peers.find(ip);
+    if (!handle) {
+      return {};
+    }
+    const auto &peer = m_peers.get(*handle);
+    return PeerStats{.rtt = peer.packet_delivery_manager.rtt_stats(),
+        .packet_timeout = peer.packet_delivery_manager.packet_timeout(),
+        .reliable_receive_window_size = peer.reliable_stream.receive_window_size(),
+        .send_packet_rate = peer.congestion_controller.packet_rate(),
+        .send_packet_size = peer.congestion_controller.packet_size(),
+        .is_bandwidth_limit_update_pending = peer.connection_manager.has_pending_limit_update()};
   }
 
   const NeptunMetrics &metrics() const {
     return m_metrics;
   }
 
+  // Called when a packet from a new peer is received, or when connecting to a new peer.
+  void set_new_peer_callback(std::function<void(IpAddress)> on_new_peer) {
+    m_on_new_peer = std::move(on_new_peer);
+  }
+
+  // Called when an idle peer is evicted, or a peer that has violated the protocol is
+  // disconnected, after its state has been removed.
+  void set_peer_evicted_callback(std::function<void(IpAddress)> on_peer_evicted) {
+    m_on_peer_evicted = std::move(on_peer_evicted);
+  }
+
+  usize peer_count() const {
+    return m_peers.size();
+  }
+
 private:
   // These can be organized into a single network handler (but i need a good name).
   // e.g. std::map<IpAddress, SingleClientHandler> handlers, where SingleClientHandler has
   // DeliveryStatusNotification, ReliableStream, etc.
-  std::map<IpAddress, Peer<Clock>> m_peers;
+  PeerTable<Peer<Clock>> m_peers{};
   UdpSocket<Network> m_udp_socket;
-  std::vector<u8> m_network_buffer{};
   milliseconds m_packet_timeout;
   ConnectionManagerConfig m_connection_manager_config;
+  NeptunConfig m_config;
+  UdpOffload m_udp_offload{};
+  // Receive buffers for the batched reads, [kJustAboveMtu] bytes each, or large enough for a
+  // coalesced GRO buffer if GRO is enabled.
+  std::vector<u8> m_read_buffer_pool{};
+  std::vector<byte_span> m_read_buffers{};
+  std::vector<ReadPacketInfo> m_read_packets{};
+  // Packets written during the tick are stored back to back in [m_send_buffer_pool] and sent
+  // in one batch at the end of the tick. Packets that couldn't be sent are kept at the front
+  // of the pool and sent first on the next tick.
+  std::vector<u8> m_send_buffer_pool{};
+  std::vector<EgressPacket> m_egress_packets{};
+  std::vector<SendPacketInfo> m_send_batch{};
   NeptunMetrics m_metrics{"Neptun metrics"};
+  std::function<void(IpAddress)> m_on_new_peer{};
+  std::function<void(IpAddress)> m_on_peer_evicted{};
+  std::function<void(IpAddress, byte_span)> m_on_latest_state{};
+  std::function<void(IpAddress, byte_span)> m_on_move{};
+  time_point<Clock> m_last_tick_time{};
+  // Peers are only visited on a tick when they have something due, so that the cost of a tick
+  // doesn't grow with the number of idle peers: connected peers are woken up by their send
+  // timers, and in-flight packets are checked for timeouts by the timeout timers.
+  TimerWheel<Clock, PeerHandle> m_send_timers;
+  TimerWheel<Clock, PeerHandle> m_timeout_timers;
+  TimerWheel<Clock, PeerHandle> m_idle_timers;
+  // Peers that are written to on every tick: peers that are still connecting, and peers without
+  // a send rate limit.
+  std::vector<PeerHandle> m_polled_peers{};
+  std::vector<PeerHandle> m_due_peers{};
+  HandshakeCookies<Clock> m_handshake_cookies;
+  HandshakeRateLimiter<Clock> m_handshake_rate_limiter;
 
-  Peer<Clock> &find_or_create_peer(PacketId next_expected_packet_id,
-                                   IpAddress peer_ip,
-                                   time_point<Clock> now) {
-    if (!m_peers.contains(peer_ip)) {
+  // Returns nothing if the peer doesn't exist and the peer limit has been reached.
+  std::optional<PeerHandle> find_or_create_peer(PacketId next_expected_packet_id,
+                                                IpAddress peer_ip,
+                                                time_point<Clock> now) {
+    if (m_peers.size() >= m_config.max_peers) {
+      auto handle = m_peers.find(peer_ip);
+      if (!handle) {
+        m_metrics.inc(NeptunMetricKey::PEERS_REJECTED);
+      }
+      return handle;
+    }
+    auto[handle, inserted] = m_peers.find_or_insert(peer_ip, [&]() {
       Ticker send_packet_ticker{now, {}};
       PacketDeliveryManager<Clock>
-          packet_delivery_manager{next_expected_packet_id, m_packet_timeout};
-      ConnectionManager connection_manager{m_connection_manager_config};
-      ReliableStream reliable_stream{};
+          packet_delivery_manager{next_expected_packet_id,
+                                  m_packet_timeout,
+                                  m_config.min_packet_timeout,
+                                  m_config.max_packet_reorder_distance};
+      ConnectionManager connection_manager{m_connection_manager_config, buffer_limits()};
+      ReliableStream reliable_stream{m_config.reliable_stream_capacity};
       UnreliableStream unreliable_stream{};
-      m_peers.insert({peer_ip,
-                      Peer<Clock>{std::move(send_packet_ticker),
-                                  std::move(packet_delivery_manager),
-                                  std::move(connection_manager),
-                                  std::move(reliable_stream),
-                                  std::move(unreliable_stream)}});
+      CongestionController<Clock> congestion_controller{m_config.congestion_control};
+      LatestStateManager latest_state_manager{m_config.latest_state_history_size};
+      MoveManager move_manager{m_config.max_unacked_moves, m_config.max_move_size};
+      return Peer<Clock>{std::move(send_packet_ticker),
+                         std::move(packet_delivery_manager),
+                         std::move(connection_manager),
+                         std::move(reliable_stream),
+                         std::move(unreliable_stream),
+                         congestion_controller,
+                         std::move(latest_state_manager),
+                         std::move(move_manager)};
+    });
+    if (inserted) {
+      auto &peer = m_peers.get(handle);
+      peer.last_read_time = now;
+      peer.idle_timer = m_idle_timers.schedule(now + m_config.idle_timeout, handle);
+      schedule_send(handle, peer);
+      if (m_on_new_peer) {
+        m_on_new_peer(peer_ip);
+      }
+    }
+    return handle;
+  }
+
+  PeerHandle find_connected_peer(IpAddress ip) const {
+    auto handle = m_peers.find(ip);
+    if (!handle) {
+      throw std::runtime_error("Unknown peer: " + ip.to_string());
     }
-    return m_peers.find(peer_ip)->second;
+    assert(m_peers.get(*handle).connection_manager.is_peer_connected());
+    return *handle;
+  }
+
+  void evict_idle_peers(time_point<Clock> now) {
+    m_idle_timers.advance(now, [this](PeerHandle handle) { m_due_peers.push_back(handle); });
+    for (auto handle : m_due_peers) {
+      if (!m_peers.contains(handle)) {
+        continue;
+      }
+      auto &peer = m_peers.get(handle);
+      peer.idle_timer.reset();
+      auto idle_deadline = peer.last_read_time + m_config.idle_timeout;
+      if (idle_deadline > now) {
+        // A packet has been received since the timer was scheduled.
+        peer.idle_timer = m_idle_timers.schedule(idle_deadline, handle);
+        continue;
+      }
+      evict_peer(handle, NeptunMetricKey::PEERS_EVICTED);
+    }
+    m_due_peers.clear();
+  }
+
+  // [reason] is the metric that counts the removed peer.
+  void evict_peer(PeerHandle handle, NeptunMetricKey reason) {
+    auto &peer = m_peers.get(handle);
+    if (peer.send_timer) {
+      m_send_timers.cancel(*peer.send_timer);
+    }
+    if (peer.timeout_timer) {
+      m_timeout_timers.cancel(*peer.timeout_timer);
+    }
+    if (peer.idle_timer) {
+      m_idle_timers.cancel(*peer.idle_timer);
+    }
+    // Polled peers are removed from [m_polled_peers] on the next write, once their handle is
+    // found to be invalid.
+    IpAddress ip = m_peers.ip(handle);
+    m_peers.erase(ip);
+    m_metrics.inc(reason);
+    if (m_on_peer_evicted) {
+      m_on_peer_evicted(ip);
+    }
+  }
+
+  // Drains up to [max_read_packets_per_tick] datagrams from the socket, in batches of
+  // [read_batch_size] datagrams.
+  template<typename OnReliableFn, typename OnUnreliableFn>
+  void read(time_point<Clock> now, OnReliableFn on_reliable, OnUnreliableFn on_unreliable) {
+    usize read_count = 0;
+    while (read_count < m_config.max_read_packets_per_tick) {
+      usize batch_size =
+          std::min(m_read_buffers.size(), m_config.max_read_packets_per_tick - read_count);
+      m_read_packets.clear();
+      usize batch_read_count =
+          m_udp_socket.read_batch(std::span(m_read_buffers).first(batch_size), m_read_packets);
+      if (batch_read_count == 0) {
+        // There are no packets in the stream.
+        return;
+      }
+      m_metrics.inc(NeptunMetricKey::READ_BATCHES);
+      m_metrics.inc(NeptunMetricKey::READ_BATCH_PACKETS, batch_read_count);
+      // Consecutive packets usually come from the same peer (e.g. a burst), so the peer is
+      // only looked up when the sender changes.
+      std::optional<std::pair<IpAddress, std::optional<PeerHandle>>> last_sender{};
+      auto read_from_sender = [&](const ReadPacketInfo &packet_info) {
+        auto &handle = last_sender->second;
+        if (!handle) {
+          handle = accept_handshake(now, packet_info);
+          if (!handle) {
+            return;
+          }
+        }
+        read_packet(now, *handle, packet_info, on_reliable, on_unreliable);
+        if (!m_peers.contains(*handle)) {
+          // The peer has been disconnected, so its next packets are from an unknown peer.
+          handle.reset();
+          return;
+        }
+        // The packet may have to be acked, or its acks and drops may have left messages to send.
+        schedule_send(*handle, m_peers.get(*handle));
+      };
+      for (const auto &packet_info : m_read_packets) {
+        if (!last_sender || last_sender->first != packet_info.sender) {
+          last_sender.emplace(packet_info.sender, m_peers.find(packet_info.sender));
+        }
+        if (packet_info.segment_size == 0) {
+          read_from_sender(packet_info);
+          continue;
+        }
+        // Split the GRO buffer into the packets that have been coalesced.
+        for (usize offset = 0; offset < packet_info.payload.size();
+             offset += packet_info.segment_size) {
+          usize size = std::min<usize>(packet_info.segment_size,
+                                       packet_info.payload.size() - offset);
+          m_metrics.inc(NeptunMetricKey::COALESCED_PACKETS);
+          read_from_sender(ReadPacketInfo{packet_info.sender,
+                                          packet_info.payload.subspan(offset, size)});
+        }
+      }
+      read_count += batch_read_count;
+      if (batch_read_count < batch_size) {
+        // The socket's receive queue has been drained.
+        return;
+      }
+    }
+  }
+
+  // Handles a packet from an unknown peer without allocating any state for the peer, unless the
+  // packet is a handshake with a valid cookie. Returns the new peer, if any.
+  // Handshakes without a valid cookie are answered with a challenge, and other packets are
+  // ignored. Replies are never larger than the packet, and are rate limited per source address,
+  // so they can't be used to amplify a flood towards a spoofed address.
+  std::optional<PeerHandle> accept_handshake(time_point<Clock> now,
+                                             const ReadPacketInfo &packet_info) {
+    auto buffer = packet_info.payload;
+    std::optional<u64> cookie{};
+    if (buffer.size() >= PacketHeader::kSerializedSize) {
+      cookie = ConnectionManager::read_lets_connect_cookie(advance(buffer,
+                                                                   PacketHeader::kSerializedSize));
+    }
+    if (!cookie) {
+      m_metrics.inc(NeptunMetricKey::UNKNOWN_PEER_PACKETS);
+      return {};
+    }
+    bool is_cookie_valid = m_handshake_cookies.verify(packet_info.sender, *cookie, now);
+    if (is_cookie_valid && m_peers.size() < m_config.max_peers) {
+      // The packet is processed as the peer's first packet.
+      return find_or_create_peer(PacketHeader(buffer).id(), packet_info.sender, now);
+    }
+    if (!m_handshake_rate_limiter.try_acquire(packet_info.sender, now)) {
+      m_metrics.inc(NeptunMetricKey::HANDSHAKES_RATE_LIMITED);
+      return {};
+    }
+    usize offset = m_egress_packets.empty() ? 0
+                                            : m_egress_packets.back().offset
+                                                + m_egress_packets.back().size;
+    auto reply = reserve_send_buffer(offset, kJustBelowMtu);
+    usize size = PacketHeader::write(reply, kStatelessPacketId, 0, 0).size();
+    if (is_cookie_valid) {
+      m_metrics.inc(NeptunMetricKey::PEERS_REJECTED);
+      size += ConnectionManager::write_reject(advance(reply, size));
+    } else {
+      m_metrics.inc(NeptunMetricKey::HANDSHAKE_CHALLENGES);
+      size += ConnectionManager::write_challenge(advance(reply, size),
+                                                 m_handshake_cookies.make(packet_info.sender, now));
+    }
+    assert(size <= buffer.size());
+    m_egress_packets.push_back({packet_info.sender, offset, size});
+    return {};
   }
 
   template<typename OnReliableFn, typename OnUnreliableFn>
-  void read(time_point<Clock> now,
-            OnReliableFn on_reliable,
-            OnUnreliableFn on_unreliable = [](byte_span payload) {}) {
-    byte_span network_buffer(m_network_buffer.begin(), m_network_buffer.begin() + kJustAboveMtu);
-    std::optional<ReadPacketInfo> packet_info = m_udp_socket.read(network_buffer);
-    if (!packet_info) {
-      // There are no packets in the stream.
+  void read_packet(time_point<Clock> now,
+                   PeerHandle handle,
+                   const ReadPacketInfo &packet_info,
+                   OnReliableFn &on_reliable,
+                   OnUnreliableFn &on_unreliable) {
+    auto &peer = m_peers.get(handle);
+    auto buffer = packet_info.payload;
+
+    if (buffer.size() >= PacketHeader::kSerializedSize
+        && PacketHeader(buffer).id() == kStatelessPacketId) {
+      // A reply to our handshake, which only the connection manager handles.
+      if (!peer.connection_manager.read(advance(buffer, PacketHeader::kSerializedSize))) {
+        std::cerr << "Handshake rejected by the peer: " << packet_info.sender.to_string()
+                  << std::endl;
+      }
       return;
     }
-    auto buffer = packet_info->payload;
-    auto &peer = find_or_create_peer(0 /* next_expected_packet_id */, packet_info->sender, now);
 
     // Packet Delivery Manager stage.
     auto[read_count, delivery_statuses, packet_id] = peer.packet_delivery_manager.process_read(
-        buffer);
+        buffer, now);
+    // The acks are processed even if the packet itself is too old, since the packets that they
+    // ack or drop are no longer in flight.
+    process_delivery_statuses(handle, peer, delivery_statuses, now);
+    // Acks update the packet timeout.
+    schedule_timeout(handle, peer);
     if (read_count == 0) {
       return;
     }
+    peer.last_read_time = now;
     buffer = advance(buffer, read_count);
-    process_delivery_statuses(peer, delivery_statuses);
+    if (!buffer.empty()) {
+      peer.has_unacked_messages = true;
+    }
 
     // Connection Manager Stage.
     auto connection_manager_result = peer.connection_manager.read(buffer);
     if (!connection_manager_result) {
       // TODO: Drop connection.
-      std::cerr << "Malformed packet received from the peer: " << packet_info->sender.to_string()
+      std::cerr << "Malformed packet received from the peer: " << packet_info.sender.to_string()
                 << std::endl;
       // Ignore the rest of the data.
       return;
@@ -180,38 +795,78 @@ private:
     // it more obvious that this doesn't change every tick.
     // I should change the ConnectionManager::on_packet API to return the read info.
     // Furthermore, this would mean I don't need [is_handshake_successful] function.
-    auto peer_max_read_packet_rate = peer.connection_manager.peer_limit()->max_read_packet_rate;
-    auto self_max_send_packet_rate = m_connection_manager_config.limit.max_send_packet_rate;
+    update_send_limit(handle, peer);
+    update_buffer_limits(peer);
 
-    if (peer_max_read_packet_rate == 0) {
-      peer.update_send_rate(self_max_send_packet_rate);
-    } else if (self_max_send_packet_rate == 0) {
-      peer.update_send_rate(peer_max_read_packet_rate);
-    } else {
-      peer.update_send_rate(std::min(peer_max_read_packet_rate, self_max_send_packet_rate));
+    // Move Manager stage.
+    auto move_result = peer.move_manager.read(buffer, [this, &packet_info](byte_span move) {
+      if (m_on_move) {
+        m_on_move(packet_info.sender, move);
+      }
+    });
+    if (!move_result) {
+      std::cerr << "Malformed packet received from the peer: " << packet_info.sender.to_string()
+                << std::endl;
+      // Ignore the rest of the data.
+      return;
     }
+    buffer = advance(buffer, *move_result);
+
+    // Latest State Manager stage.
+    auto latest_state_result =
+        peer.latest_state_manager.read(buffer, [this, &packet_info](byte_span state) {
+          if (m_on_latest_state) {
+            m_on_latest_state(packet_info.sender, state);
+          }
+        });
+    if (!latest_state_result) {
+      std::cerr << "Malformed packet received from the peer: " << packet_info.sender.to_string()
+                << std::endl;
+      // Ignore the rest of the data.
+      return;
+    }
+    buffer = advance(buffer, *latest_state_result);
 
     // Reliable Stream stage.
     auto
-        reliable_stream_result = peer.reliable_stream.template read(packet_id, buffer, on_reliable);
+        reliable_stream_result = peer.reliable_stream.template read(
+        packet_id, buffer, [&on_reliable, &packet_info](byte_span payload) {
+          invoke_message_callback(on_reliable, packet_info.sender, payload);
+        });
+    if (!reliable_stream_result && reliable_stream_result.error() == NeptunError::RECEIVE_WINDOW_FULL) {
+      // The peer has more reliable messages in flight than the receive window that we have
+      // advertised can hold, so it misbehaves. The packet is already going to be acked, so the
+      // peer would consider the messages that haven't been stored as delivered, and the stream
+      // would stall forever. The peer is disconnected instead.
+      std::cerr << "Reliable receive window overflowed by the peer, disconnecting: "
+                << packet_info.sender.to_string() << std::endl;
+      evict_peer(handle, NeptunMetricKey::PEERS_DISCONNECTED);
+      return;
+    }
     if (!reliable_stream_result) {
       // Packet is malformed, ignore the rest of it and drop connection to the peer.
       // TODO: What does it mean to drop the connection? We can't prevent them from sending
       // us packets.
       // For now, we are just logging it.
       // TODO: Use proper logging.
-      std::cerr << "Malformed packet received from the peer: " << packet_info->sender.to_string()
+      std::cerr << "Malformed packet received from the peer: " << packet_info.sender.to_string()
                 << std::endl;
       // Ignore the rest of the data.
       return;
     }
     buffer = advance(buffer, *reliable_stream_result);
+    if (*reliable_stream_result > 0 && !peer.reliable_received_time) {
+      // The ack may be due before the next send tick, which [schedule_send] takes care of.
+      peer.reliable_received_time = now;
+    }
 
     // Unreliable Stream stage.
     auto unreliable_stream_result =
-        peer.unreliable_stream.template read(buffer, on_unreliable);
+        peer.unreliable_stream.template read(buffer, [&on_unreliable, &packet_info](byte_span payload) {
+          invoke_message_callback(on_unreliable, packet_info.sender, payload);
+        });
     if (!unreliable_stream_result) {
-      std::cerr << "Malformed packet received from the peer: " << packet_info->sender.to_string()
+      std::cerr << "Malformed packet received from the peer: " << packet_info.sender.to_string()
                 << std::endl;
       // Ignore the rest of the data.
       return;
@@ -220,32 +875,259 @@ private:
   }
 
   void write(time_point<Clock> now) {
-    for (auto&[ip, peer] : m_peers) {
-      auto bandwidth_limit = peer.connection_manager.peer_limit();
-      u16 max_send_packet_size = m_connection_manager_config.limit.max_send_packet_size;
-      if (bandwidth_limit) {
-        max_send_packet_size = std::min(bandwidth_limit->max_read_packet_size, max_send_packet_size);
+    bool is_backlog_full = false;
+    auto check_backlog = [this, &is_backlog_full]() {
+      if (!is_backlog_full && m_egress_packets.size() >= m_config.max_unsent_packets) {
+        // The socket can't keep up. Stop writing new packets until the backlog is sent, so that
+        // the packets aren't accounted for in [PacketDeliveryManager] for longer than needed.
+        m_metrics.inc(NeptunMetricKey::SEND_BACKLOG_FULL);
+        is_backlog_full = true;
       }
-      // TODO: Cleanup this. I want to give priority to connection manager sending packets and not
-      // having to wait.
-      // I probably want to start rate limitting packets when both sides agree that the
-      // connection has been established.
-      // This means that the server has seen ACK for its response.
-      // Otherwise, it makes no sense to send any other messages since the client wouldn't know
-      // what's the acceptable limit.
-      if (peer.send_packet_ticker.tick(now) || !peer.connection_manager.is_fully_connected()) {
-        write_to_peer(now, ip, peer, max_send_packet_size);
+      return is_backlog_full;
+    };
+
+    for (usize i = 0; i < m_polled_peers.size() && !check_backlog();) {
+      auto handle = m_polled_peers[i];
+      if (!m_peers.contains(handle)) {
+        m_polled_peers[i] = m_polled_peers.back();
+        m_polled_peers.pop_back();
+        continue;
       }
+      auto &peer = m_peers.get(handle);
+      write_if_due(now, handle, peer);
+      if (should_poll(peer)) {
+        i++;
+        continue;
+      }
+      // The connection has been established, so the peer is woken up by its send timer.
+      peer.is_polled = false;
+      m_polled_peers[i] = m_polled_peers.back();
+      m_polled_peers.pop_back();
+      schedule_send(handle, peer);
     }
+
+    m_send_timers.advance(now, [this](PeerHandle handle) { m_due_peers.push_back(handle); });
+    for (auto handle : m_due_peers) {
+      if (!m_peers.contains(handle)) {
+        continue;
+      }
+      auto &peer = m_peers.get(handle);
+      peer.send_timer.reset();
+      if (check_backlog()) {
+        // Retry on the next tick.
+        peer.send_timer = m_send_timers.schedule(now, handle);
+        peer.send_timer_deadline = now;
+        continue;
+      }
+      write_if_due(now, handle, peer);
+      schedule_send(handle, peer);
+    }
+    m_due_peers.clear();
+    flush();
+  }
+
+  // Peers are polled until both sides agree that the connection has been established, because
+  // until then the peer's bandwidth limit isn't known, and the handshake shouldn't wait.
+  // Peers without a send rate limit are written to on every tick.
+  static bool should_poll(const Peer<Clock> &peer) {
+    return !peer.connection_manager.is_fully_connected()
+        || !peer.send_packet_ticker.tick_interval();
+  }
+
+  // Makes sure that the peer is either polled, or has a send timer that expires no later than
+  // the peer has something to send. Called whenever that may have become earlier, e.g. when a
+  // message is sent or a packet is received.
+  void schedule_send(PeerHandle handle, Peer<Clock> &peer) {
+    if (should_poll(peer)) {
+      if (peer.send_timer) {
+        m_send_timers.cancel(*peer.send_timer);
+        peer.send_timer.reset();
+      }
+      if (!peer.is_polled) {
+        peer.is_polled = true;
+        m_polled_peers.push_back(handle);
+      }
+      return;
+    }
+    if (peer.is_polled) {
+      // The peer gets its send timer once it's removed from [m_polled_peers].
+      return;
+    }
+    auto deadline = send_deadline(peer);
+    if (peer.send_timer) {
+      if (peer.send_timer_deadline <= deadline) {
+        return;
+      }
+      m_send_timers.cancel(*peer.send_timer);
+    }
+    peer.send_timer = m_send_timers.schedule(deadline, handle);
+    peer.send_timer_deadline = deadline;
+  }
+
+  // Returns the next send tick, or the time of the next keepalive if the peer has nothing to send
+  // and [NeptunConfig::skip_idle_send_ticks] is set.
+  time_point<Clock> send_deadline(const Peer<Clock> &peer) const {
+    auto next_tick_time = *peer.send_packet_ticker.next_tick_time();
+    if (m_config.skip_idle_send_ticks && !needs_send(peer)) {
+      if (!peer.last_write_time) {
+        return next_tick_time;
+      }
+      return std::max(next_tick_time, *peer.last_write_time + m_config.idle_timeout / 3);
+    }
+    if (auto ack = ack_deadline(peer)) {
+      return std::min(next_tick_time, *ack);
+    }
+    return next_tick_time;
+  }
+
+  static bool needs_send(const Peer<Clock> &peer) {
+    return has_pending_messages(peer) || peer.has_unacked_messages;
+  }
+
+  // Returns the time at which an ack-only packet is due, if the peer is owed an ack for reliable
+  // messages that the next send tick doesn't carry soon enough.
+  std::optional<time_point<Clock>> ack_deadline(const Peer<Clock> &peer) const {
+    if (!m_config.immediate_acks || !peer.reliable_received_time || peer.burst_debt > 0
+        || !peer.connection_manager.is_fully_connected()) {
+      return {};
+    }
+    auto deadline = *peer.reliable_received_time + m_config.immediate_ack_delay;
+    auto next_tick_time = peer.send_packet_ticker.next_tick_time();
+    if (!next_tick_time || *next_tick_time <= deadline + m_config.immediate_ack_delay) {
+      // A packet is sent soon anyway.
+      return {};
+    }
+    return deadline;
+  }
+
+  void schedule_timeout(PeerHandle handle, Peer<Clock> &peer) {
+    auto timeout = peer.packet_delivery_manager.next_timeout();
+    if (!timeout) {
+      // The timer is early at worst, so it's left to expire.
+      return;
+    }
+    if (peer.timeout_timer) {
+      if (peer.timeout_timer_deadline <= *timeout) {
+        // The timer is early, and it's rescheduled when it expires.
+        return;
+      }
+      // The packet timeout has shrunk with the RTT.
+      m_timeout_timers.cancel(*peer.timeout_timer);
+    }
+    peer.timeout_timer = m_timeout_timers.schedule(*timeout, handle);
+    peer.timeout_timer_deadline = *timeout;
+  }
+
+  // Writes a packet to the peer if it's still connecting, or if its send ticker fires.
+  void write_if_due(time_point<Clock> now, PeerHandle handle, Peer<Clock> &peer) {
+    // Congestion control only scales the packet rate, so that the packets can always carry a
+    // latest state that [send_latest_state_to] has accepted.
+    u16 max_send_packet_size = max_packet_size(peer);
+    // TODO: Cleanup this. I want to give priority to connection manager sending packets and not
+    // having to wait.
+    // I probably want to start rate limitting packets when both sides agree that the
+    // connection has been established.
+    // This means that the server has seen ACK for its response.
+    // Otherwise, it makes no sense to send any other messages since the client wouldn't know
+    // what's the acceptable limit.
+    if (!peer.connection_manager.is_fully_connected()) {
+      write_to_peer(now, handle, peer, max_send_packet_size);
+      return;
+    }
+    auto max_tick_count = std::max<u64>(1, peer.send_rate * m_config.max_send_catch_up / seconds(1));
+    auto tick_count = peer.send_packet_ticker.tick_count(now, max_tick_count);
+    for (u64 i = 0; i < tick_count; i++) {
+      // Missed send ticks are only caught up with if there is something to send.
+      if (i > 0 && !has_pending_messages(peer)) {
+        return;
+      }
+      if (peer.burst_debt > 0) {
+        peer.burst_debt--;
+        continue;
+      }
+      write_to_peer(now, handle, peer, max_send_packet_size);
+    }
+    if (auto ack = ack_deadline(peer); ack && *ack <= now) {
+      // The packet is taken from the next send tick, so the packet rate stays within the limit.
+      peer.burst_debt++;
+      m_metrics.inc(NeptunMetricKey::IMMEDIATE_ACK_PACKETS);
+      write_to_peer(now, handle, peer, max_send_packet_size);
+    }
+  }
+
+  // Largest packet that both our limit and the peer's limit allow, ignoring congestion control.
+  static u16 max_packet_size(const Peer<Clock> &peer) {
+    auto bandwidth_limit = peer.connection_manager.peer_limit();
+    u16 max_send_packet_size = peer.connection_manager.limit().max_send_packet_size;
+    if (bandwidth_limit) {
+      max_send_packet_size = std::min(bandwidth_limit->max_read_packet_size, max_send_packet_size);
+    }
+    return max_send_packet_size;
+  }
+
+  static bool has_pending_messages(const Peer<Clock> &peer) {
+    return peer.connection_manager.has_pending_messages()
+        || peer.move_manager.has_pending_moves()
+        || peer.latest_state_manager.has_pending_state()
+        || peer.reliable_stream.has_pending_messages()
+        || peer.unreliable_stream.has_pending_messages();
   }
 
   void write_to_peer(time_point<Clock> now,
-                     IpAddress ip,
+                     PeerHandle handle,
                      Peer<Clock> &peer,
                      u16 max_send_packet_size) {
-    byte_span buffer(m_network_buffer.begin(),
-                     m_network_buffer.begin() + std::min(kJustBelowMtu, max_send_packet_size));
+    IpAddress ip = m_peers.ip(handle);
+    usize offset = m_egress_packets.empty() ? 0
+                                            : m_egress_packets.back().offset
+                                                + m_egress_packets.back().size;
+    u16 segment_size = std::min(kJustBelowMtu, max_send_packet_size);
+    usize size = write_packet(now, peer, reserve_send_buffer(offset, segment_size));
+    peer.last_write_time = now;
+    peer.has_unacked_messages = false;
+    peer.reliable_received_time.reset();
+
+    // Keep writing packets to a peer with a reliable backlog and send them as a single burst.
+    // A segment is only added if the next reliable message fits into it, otherwise it would only
+    // carry the packet header.
+    usize segment_count = 1;
+    while (m_udp_offload.segmentation && peer.connection_manager.is_fully_connected()
+        && peer.reliable_stream.has_pending_messages()
+        && PacketHeader::kSerializedSize + peer.reliable_stream.next_write_size() <= segment_size
+        && segment_count < m_config.max_gso_segments
+        && (segment_count + 1) * segment_size <= kMaxUdpPayloadSize) {
+      // All segments except the last one must be [segment_size] bytes long.
+      auto padding = reserve_send_buffer(offset, segment_count * segment_size)
+          .subspan(size, segment_count * segment_size - size);
+      std::memset(padding.data(), ManagerType::PADDING, padding.size());
+      size = segment_count * segment_size;
+      usize packet_size = write_packet(now, peer, reserve_send_buffer(offset + size, segment_size));
+      size += packet_size;
+      segment_count++;
+    }
+    if (segment_count > 1) {
+      // Burst packets are taken from the peer's future send ticks.
+      peer.burst_debt += segment_count - 1;
+      m_metrics.inc(NeptunMetricKey::GSO_BURSTS);
+      m_metrics.inc(NeptunMetricKey::GSO_BURST_PACKETS, segment_count);
+      m_egress_packets.push_back({ip, offset, size, segment_size});
+    } else {
+      m_egress_packets.push_back({ip, offset, size});
+    }
+    schedule_timeout(handle, peer);
+  }
+
+  // Returns a buffer of [size] bytes at [offset] in the send buffer pool, growing the pool
+  // if needed. Growing the pool invalidates the previously returned buffers.
+  byte_span reserve_send_buffer(usize offset, usize size) {
+    if (m_send_buffer_pool.size() < offset + size) {
+      m_send_buffer_pool.resize(std::max(2 * m_send_buffer_pool.size(), offset + size));
+    }
+    return {m_send_buffer_pool.begin() + offset, m_send_buffer_pool.begin() + offset + size};
+  }
 
+  // Writes a single packet to [buffer] and returns its size.
+  usize write_packet(time_point<Clock> now, Peer<Clock> &peer, byte_span buffer) {
     // Packet Delivery Manager stage.
     auto packet_header_count = peer.packet_delivery_manager.write(buffer, now);
     // TODO: Write should return packet header (or at least id).
@@ -256,6 +1138,20 @@ private:
     auto connection_manager_count = peer.connection_manager.write(packet_header.id(), buffer);
     buffer = advance(buffer, connection_manager_count);
 
+    // Move Manager stage.
+    auto move_count = peer.move_manager.write(packet_header.id(), buffer);
+    buffer = advance(buffer, move_count);
+
+    // Latest State Manager stage.
+    u64 latest_state_bytes = peer.latest_state_manager.written_bytes();
+    u64 latest_state_full_bytes = peer.latest_state_manager.written_state_bytes();
+    auto latest_state_count = peer.latest_state_manager.write(packet_header.id(), buffer);
+    buffer = advance(buffer, latest_state_count);
+    m_metrics.inc(NeptunMetricKey::LATEST_STATE_BYTES,
+                  peer.latest_state_manager.written_bytes() - latest_state_bytes);
+    m_metrics.inc(NeptunMetricKey::LATEST_STATE_FULL_BYTES,
+                  peer.latest_state_manager.written_state_bytes() - latest_state_full_bytes);
+
     // Reliable Stream stage.
     auto reliable_stream_count = peer.reliable_stream.write(packet_header.id(), buffer);
     buffer = advance(buffer, reliable_stream_count);
@@ -264,32 +1160,151 @@ private:
     auto unreliable_stream_count = peer.unreliable_stream.write(buffer);
     buffer = advance(buffer, unreliable_stream_count);
 
-    // Send to the peer. For many peers, we can buffer all packets and send them in one go with
-    // "send to many" syscall (at least on Linux).
-    byte_span payload(m_network_buffer.data(),
-        // TODO: I always forget to add count here. Make this less error prone.
-                      packet_header_count + connection_manager_count + reliable_stream_count
-                          + unreliable_stream_count);
-    auto sent_count = m_udp_socket.send_to(ip, payload);
-    assert(sent_count == payload.size());
+    if (connection_manager_count + move_count + latest_state_count + reliable_stream_count
+        + unreliable_stream_count > 0) {
+      peer.in_flight_message_packets.push_back(packet_header.id());
+    }
+
+    // The packet is sent together with packets for other peers at the end of the tick.
+    // TODO: I always forget to add count here. Make this less error prone.
+    return packet_header_count + connection_manager_count + move_count + latest_state_count
+        + reliable_stream_count + unreliable_stream_count;
+  }
+
+  // Sends all written packets with as few syscalls as possible.
+  // Packets that can't be sent because the socket's send buffer is full are kept for the next
+  // tick rather than dropped: [PacketDeliveryManager] already considers them in-flight.
+  void flush() {
+    if (m_egress_packets.empty()) {
+      return;
+    }
+    m_send_batch.clear();
+    for (const auto &packet : m_egress_packets) {
+      m_send_batch.push_back({packet.recipient,
+                              byte_span(m_send_buffer_pool.begin() + packet.offset,
+                                        m_send_buffer_pool.begin() + packet.offset
+                                            + packet.size),
+                              packet.segment_size});
+    }
+    usize sent_count = m_udp_socket.send_batch(m_send_batch);
+    assert(sent_count <= m_egress_packets.size());
+    if (sent_count > 0) {
+      m_metrics.inc(NeptunMetricKey::SEND_BATCHES);
+      m_metrics.inc(NeptunMetricKey::SEND_BATCH_PACKETS, sent_count);
+    }
+    if (sent_count == m_egress_packets.size()) {
+      m_egress_packets.clear();
+      return;
+    }
+
+    // Move unsent packets to the front of the pool.
+    m_metrics.inc(NeptunMetricKey::UNSENT_PACKETS, m_egress_packets.size() - sent_count);
+    usize first_unsent_offset = m_egress_packets[sent_count].offset;
+    usize end_offset = m_egress_packets.back().offset + m_egress_packets.back().size;
+    std::memmove(m_send_buffer_pool.data(),
+                 m_send_buffer_pool.data() + first_unsent_offset,
+                 end_offset - first_unsent_offset);
+    m_egress_packets.erase(m_egress_packets.begin(), m_egress_packets.begin() + sent_count);
+    for (auto &packet : m_egress_packets) {
+      packet.offset -= first_unsent_offset;
+    }
   }
 
-  void process_delivery_statuses(Peer<Clock> &peer, DeliveryStatuses delivery_statuses) {
-    delivery_statuses.template for_each([this, &peer](PacketId packet_id,
-                                                      PacketDeliveryStatus status) {
+  void process_delivery_statuses(PeerHandle handle,
+                                 Peer<Clock> &peer,
+                                 DeliveryStatuses delivery_statuses,
+                                 time_point<Clock> now) {
+    if (delivery_statuses.empty()) {
+      return;
+    }
+    delivery_statuses.template for_each([this, &peer, now](PacketId packet_id,
+                                                           PacketDeliveryStatus status) {
+      // Statuses are reported in packet order.
+      auto &message_packets = peer.in_flight_message_packets;
+      while (!message_packets.empty() && message_packets.front() < packet_id) {
+        message_packets.pop_front();
+      }
+      bool has_messages = !message_packets.empty() && message_packets.front() == packet_id;
+      if (has_messages) {
+        message_packets.pop_front();
+      }
       peer.connection_manager.on_packet_status_delivery(packet_id, status);
+      peer.move_manager.on_packet_delivery_status(packet_id, status);
+      peer.latest_state_manager.on_packet_delivery_status(packet_id, status);
       peer.reliable_stream.on_packet_delivery_status(packet_id, status);
       switch (status) {
         case PacketDeliveryStatus::ACK:
           m_metrics.inc(NeptunMetricKey::PACKET_ACKS);
+          peer.congestion_controller.on_ack(peer.packet_delivery_manager.rtt_stats(), now);
           break;
         case PacketDeliveryStatus::DROP:
           m_metrics.inc(NeptunMetricKey::PACKET_DROPS);
+          if (has_messages) {
+            peer.congestion_controller.on_drop(now);
+          }
           break;
         default:
           throw std::runtime_error("Unknown PacketDeliveryStatus");
       }
     });
+    apply_send_rate(handle, peer);
+  }
+
+  void update_bandwidth_limit(PeerHandle handle, Peer<Clock> &peer, BandwidthLimit limit) {
+    peer.connection_manager.update_limit(limit);
+    if (peer.connection_manager.is_peer_connected()) {
+      update_send_limit(handle, peer);
+    }
+    // The new limit has to be sent to the peer.
+    schedule_send(handle, peer);
+  }
+
+  // Sets the limits of the peer's congestion controller to the lower of our send limits and the
+  // peer's read limits.
+  void update_send_limit(PeerHandle handle, Peer<Clock> &peer) {
+    auto peer_limit = *peer.connection_manager.peer_limit();
+    auto self_limit = peer.connection_manager.limit();
+    // Zero means no limit.
+    auto min_limit = []<typename T>(T a, T b) {
+      return a == 0 ? b : b == 0 ? a : std::min(a, b);
+    };
+    peer.congestion_controller.set_limit(min_limit(peer_limit.max_read_packet_rate,
+                                                   self_limit.max_send_packet_rate),
+                                         std::min(peer_limit.max_read_packet_size,
+                                                  self_limit.max_send_packet_size),
+                                         min_limit(peer_limit.max_read_bytes_per_second,
+                                                   self_limit.max_send_bytes_per_second));
+    apply_send_rate(handle, peer);
+  }
+
+  BufferLimits buffer_limits() const {
+    return BufferLimits{
+        .latest_state_history_size = static_cast<u16>(std::min<usize>(
+            m_config.latest_state_history_size, std::numeric_limits<u16>::max())),
+        .reliable_receive_window = static_cast<u32>(std::min<usize>(
+            m_config.reliable_stream_capacity, std::numeric_limits<u32>::max())),
+    };
+  }
+
+  // Applies the peer's buffer limits that are smaller than ours.
+  void update_buffer_limits(Peer<Clock> &peer) {
+    auto peer_limits = peer.connection_manager.peer_buffer_limits();
+    if (peer_limits.latest_state_history_size != 0) {
+      peer.latest_state_manager.set_history_size(std::min<usize>(
+          m_config.latest_state_history_size, peer_limits.latest_state_history_size));
+    }
+    if (peer_limits.reliable_receive_window != 0) {
+      peer.reliable_stream.set_peer_receive_window(peer_limits.reliable_receive_window);
+    }
+  }
+
+  // Makes the peer's send ticker follow the rate of its congestion controller.
+  void apply_send_rate(PeerHandle handle, Peer<Clock> &peer) {
+    if (peer.update_send_rate(peer.congestion_controller.packet_rate()) && peer.send_timer) {
+      m_send_timers.cancel(*peer.send_timer);
+      peer.send_timer.reset();
+      schedule_send(handle, peer);
+    }
   }
 };
 
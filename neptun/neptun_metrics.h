@@ -16,6 +16,55 @@ namespace freezing::network {
 enum NeptunMetricKey {
   PACKET_ACKS,
   PACKET_DROPS,
+  // Number of non-empty batched reads from the socket.
+  READ_BATCHES,
+  // Total number of datagrams returned by the batched reads.
+  // Divided by [READ_BATCHES], it's the average number of datagrams per batch.
+  READ_BATCH_PACKETS,
+  // Number of non-empty batched sends to the socket.
+  SEND_BATCHES,
+  // Total number of datagrams sent by the batched sends.
+  SEND_BATCH_PACKETS,
+  // Number of times a packet couldn't be sent because the socket's send buffer was full.
+  // Such packets are retried on the next tick.
+  UNSENT_PACKETS,
+  // Number of ticks that stopped writing packets because of too many unsent packets.
+  SEND_BACKLOG_FULL,
+  // Number of packets split from the coalesced GRO buffers.
+  COALESCED_PACKETS,
+  // Number of bursts of packets sent to a single peer with GSO.
+  GSO_BURSTS,
+  // Total number of packets sent in the GSO bursts.
+  GSO_BURST_PACKETS,
+  // Number of peers removed because they haven't sent us a packet for the idle timeout.
+  PEERS_EVICTED,
+  // Number of times a new peer wasn't created because the peer limit was reached.
+  PEERS_REJECTED,
+  // Number of peers removed because they've violated the protocol, e.g. overflowed their
+  // reliable receive window.
+  PEERS_DISCONNECTED,
+  // Number of handshakes from unknown peers that have been answered with a challenge.
+  HANDSHAKE_CHALLENGES,
+  // Number of handshakes from unknown peers that haven't been answered because of the rate limit.
+  HANDSHAKES_RATE_LIMITED,
+  // Number of packets from unknown peers that have been ignored, because they aren't handshakes.
+  UNKNOWN_PEER_PACKETS,
+  // Number of messages queued for the network thread of [ThreadedNeptun], when the metrics
+  // were taken.
+  OUTGOING_QUEUE_DEPTH,
+  // Number of received messages queued by the network thread of [ThreadedNeptun], when the
+  // metrics were taken.
+  INCOMING_QUEUE_DEPTH,
+  // Number of messages that couldn't be queued for the network thread, because the queue was full.
+  OUTGOING_QUEUE_FULL,
+  // Number of received messages that have been dropped, because the queue was full.
+  INCOMING_QUEUE_FULL,
+  // Bytes of the latest state messages that have been sent, which encode the deltas of states
+  // of [LATEST_STATE_FULL_BYTES] bytes.
+  LATEST_STATE_BYTES,
+  LATEST_STATE_FULL_BYTES,
+  // Number of packets sent ahead of a send tick to ack reliable messages.
+  IMMEDIATE_ACK_PACKETS,
 };
 
 using NeptunMetrics = Metrics<NeptunMetricKey, u64>;
@@ -25,40 +74,84 @@ using NeptunMetrics = Metrics<NeptunMetricKey, u64>;
 namespace freezing {
 
 template<>
-static constexpr usize metric_key_count<network::NeptunMetricKey>() {
-  return 2;
+constexpr usize metric_key_count<network::NeptunMetricKey>() {
+  return 24;
 }
 
 template<>
-static constexpr usize metric_key_index<network::NeptunMetricKey>(network::NeptunMetricKey key) {
+constexpr usize metric_key_index<network::NeptunMetricKey>(network::NeptunMetricKey key) {
   return key;
 }
 
 template<>
-static std::string metric_key_name<network::NeptunMetricKey>(network::NeptunMetricKey key) {
+inline std::string metric_key_name<network::NeptunMetricKey>(network::NeptunMetricKey key) {
   switch (key) {
   case network::PACKET_ACKS:
     return "packet_acks";
   case network::PACKET_DROPS:
     return "packet_drops";
+  case network::READ_BATCHES:
+    return "read_batches";
+  case network::READ_BATCH_PACKETS:
+    return "read_batch_packets";
+  case network::SEND_BATCHES:
+    return "send_batches";
+  case network::SEND_BATCH_PACKETS:
+    return "send_batch_packets";
+  case network::UNSENT_PACKETS:
+    return "unsent_packets";
+  case network::SEND_BACKLOG_FULL:
+    return "send_backlog_full";
+  case network::COALESCED_PACKETS:
+    return "coalesced_packets";
+  case network::GSO_BURSTS:
+    return "gso_bursts";
+  case network::GSO_BURST_PACKETS:
+    return "gso_burst_packets";
+  case network::PEERS_EVICTED:
+    return "peers_evicted";
+  case network::PEERS_REJECTED:
+    return "peers_rejected";
+  case network::PEERS_DISCONNECTED:
+    return "peers_disconnected";
+  case network::HANDSHAKE_CHALLENGES:
+    return "handshake_challenges";
+  case network::HANDSHAKES_RATE_LIMITED:
+    return "handshakes_rate_limited";
+  case network::UNKNOWN_PEER_PACKETS:
+    return "unknown_peer_packets";
+  case network::OUTGOING_QUEUE_DEPTH:
+    return "outgoing_queue_depth";
+  case network::INCOMING_QUEUE_DEPTH:
+    return "incoming_queue_depth";
+  case network::OUTGOING_QUEUE_FULL:
+    return "outgoing_queue_full";
+  case network::INCOMING_QUEUE_FULL:
+    return "incoming_queue_full";
+  case network::LATEST_STATE_BYTES:
+    return "latest_state_bytes";
+  case network::LATEST_STATE_FULL_BYTES:
+    return "latest_state_full_bytes";
+  case network::IMMEDIATE_ACK_PACKETS:
+    return "immediate_ack_packets";
   default:
     throw std::runtime_error("unknown key: " + std::to_string(key));
   }
 }
 
 template<>
-static std::string metric_key_unit<network::NeptunMetricKey>(network::NeptunMetricKey key) {
+inline std::string metric_key_unit<network::NeptunMetricKey>(network::NeptunMetricKey key) {
   return "";
 }
 
 template<>
-static double metric_key_unit_scale<network::NeptunMetricKey, double>(network::NeptunMetricKey key, double value) {
+inline double metric_key_unit_scale<network::NeptunMetricKey, double>(network::NeptunMetricKey key, double value) {
   return static_cast<double>(value);
 }
 
 
 template<>
-static void foreach_key<network::NeptunMetricKey>(const std::function<void(network::NeptunMetricKey)>& fn) {
+inline void foreach_key<network::NeptunMetricKey>(const std::function<void(network::NeptunMetricKey)>& fn) {
   for (usize i = 0; i < metric_key_count<network::NeptunMetricKey>(); i++) {
     auto key = static_cast<network::NeptunMetricKey>(i);
     fn(key);
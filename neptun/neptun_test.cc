@@ -62,8 +62,13 @@ TEST(NeptunTest, PacketRateLimit) {
       .max_send_packet_rate = 30,
       .max_send_packet_size = 400,
   };
-  TestNeptun server{fake_network, kServerIp, ConnectionManagerConfig{0, server_limit}};
-  TestNeptun client{fake_network, kClientIp, ConnectionManagerConfig{0, client_limit}};
+  // The handshake packets time out while the peers aren't ticked, which would slow the peers down
+  // with congestion control.
+  NeptunConfig config{.congestion_control = {.enabled = false}};
+  TestNeptun server{fake_network, kServerIp, ConnectionManagerConfig{0, server_limit},
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  TestNeptun client{fake_network, kClientIp, ConnectionManagerConfig{0, client_limit},
+                    freezing::network::detail::kDefaultPacketTimeout, config};
   connect(server, client, fake_network);
 
   // Let's call tick once every millisecond, which results in 1000 calls.
@@ -87,6 +92,68 @@ TEST(NeptunTest, PacketRateLimit) {
   ASSERT_EQ(client_stats.num_sent_packets, 30);
 }
 
+TEST(NeptunTest, PacketRateAboveTickRate) {
+  FakeNetwork fake_network{};
+  auto limit = BandwidthLimit{
+      .max_read_packet_rate = 3000,
+      .max_read_packet_size = 1400,
+      .max_send_packet_rate = 3000,
+      .max_send_packet_size = 1400,
+  };
+  // Room for the messages that are in flight for the RTT.
+  NeptunConfig config{.reliable_stream_capacity = 64 * 1024, .congestion_control = {.enabled = false}};
+  TestNeptun server{fake_network, kServerIp, ConnectionManagerConfig{0, limit},
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  TestNeptun client{fake_network, kClientIp, ConnectionManagerConfig{0, limit},
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  connect(server, client, fake_network);
+  auto write_message = [](byte_span buffer) {
+    if (buffer.size() < 800) {
+      return buffer.first(0);
+    }
+    std::fill_n(buffer.begin(), 800, 42);
+    return buffer.first(800);
+  };
+
+  // Three messages that don't fit into the same packet are sent every millisecond, and the
+  // client writes them in three packets, even though it's ticked once per millisecond.
+  fake_network.clear_stats();
+  auto now = kNow + seconds(1);
+  for (usize ms = 0; ms < 1000; ms++, now += milliseconds(1)) {
+    for (usize i = 0; i < 3; i++) {
+      client.send_reliable_to(kServerIp, write_message, now);
+    }
+    client.tick(now);
+    server.tick(now);
+  }
+  ASSERT_EQ(client.peer_stats(kServerIp)->send_packet_rate, 3000);
+  ASSERT_NEAR(fake_network.stats(kClientIp).num_sent_packets, 3000, 3);
+}
+
+TEST(NeptunTest, BytesPerSecondLimit) {
+  FakeNetwork fake_network{};
+  auto server_limit = BandwidthLimit{
+      .max_read_packet_rate = 100,
+      .max_read_packet_size = 1000,
+      .max_send_packet_rate = 100,
+      .max_send_packet_size = 1000,
+      .max_read_bytes_per_second = 20'000,
+  };
+  auto client_limit = server_limit;
+  client_limit.max_read_bytes_per_second = 0;
+  NeptunConfig config{.congestion_control = {.enabled = false}};
+  TestNeptun server{fake_network, kServerIp, ConnectionManagerConfig{0, server_limit},
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  TestNeptun client{fake_network, kClientIp, ConnectionManagerConfig{0, client_limit},
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  connect(server, client, fake_network);
+  auto now = kNow + seconds(1);
+  client.tick(now);
+  server.tick(now);
+  ASSERT_EQ(client.peer_stats(kServerIp)->send_packet_rate, 20);
+  ASSERT_EQ(server.peer_stats(kClientIp)->send_packet_rate, 100);
+}
+
 TEST(NeptunTest, PacketSizeLimit) {
   FakeNetwork fake_network{};
   auto server_limit = BandwidthLimit{
@@ -134,10 +201,11 @@ TEST(NeptunTest, PacketSizeLimit) {
 
   auto server_stats = fake_network.stats(kServerIp);
   auto client_stats = fake_network.stats(kClientIp);
-  ASSERT_EQ(server_stats.num_sent_bytes, 766);
-  ASSERT_EQ(client_stats.num_read_bytes, 778);
-  ASSERT_EQ(server_stats.num_read_bytes, 398);
-  ASSERT_EQ(client_stats.num_sent_bytes, 398);
+  // The server's packet is limited by the client's max_read_packet_size of 800 bytes.
+  ASSERT_EQ(server_stats.num_sent_bytes, 794);
+  ASSERT_EQ(client_stats.num_read_bytes, 810);
+  ASSERT_EQ(server_stats.num_read_bytes, 394);
+  ASSERT_EQ(client_stats.num_sent_bytes, 394);
 }
 
 TEST(NeptunTest, DropConnectionIfPacketLimitIsViolated) {
@@ -169,8 +237,11 @@ TEST(NeptunTest, ReadAndWriteSingleReliableMessage) {
 
 TEST(NeptunTest, ReadAndWriteSingleReliableMessage_DropPackets) {
   FakeNetwork fake_network{};
+  // Without the reorder window, the client learns about the drops from the next ack.
+  NeptunConfig config{.max_packet_reorder_distance = 0};
   TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
-  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout, config};
   connect(server, client, fake_network);
 
   client.send_reliable_to(kServerIp, [](byte_span buffer) {
@@ -276,8 +347,11 @@ TEST(NeptunTest, Timeouts) {
 
 TEST(NeptunTest, ReliableMessageAfterDroppingMultiplePackets) {
   FakeNetwork fake_network{};
+  // Without the reorder window, the client learns about the drops from the next ack.
+  NeptunConfig config{.max_packet_reorder_distance = 0};
   TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
-  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout, config};
   connect(server, client, fake_network);
 
   auto send_to_server = [&client](usize sequence_number) {
@@ -340,6 +414,804 @@ TEST(NeptunTest, UnreliableMessage) {
   ASSERT_EQ(msg_count, 1);
 }
 
+TEST(NeptunTest, ReadsAllQueuedPacketsInOneTick) {
+  constexpr usize kNumPackets = 5;
+
+  FakeNetwork fake_network{};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  connect(server, client, fake_network);
+
+  // The client sends one packet per tick, while the server isn't ticking.
+  for (usize i = 0; i < kNumPackets; i++) {
+    client.send_unreliable_to(kServerIp, [i](byte_span buffer) {
+      IoBuffer io{buffer};
+      auto count = io.write_string("unreliable value " + std::to_string(i), 0);
+      return buffer.first(count);
+    }, kNow);
+    client.tick(kNow);
+  }
+
+  auto read_batches = server.metrics().value(NeptunMetricKey::READ_BATCHES);
+  auto read_batch_packets = server.metrics().value(NeptunMetricKey::READ_BATCH_PACKETS);
+  usize msg_count = 0;
+  server.tick(kNow, unexpected_reliable_msgs, [&msg_count](byte_span buffer) {
+    IoBuffer io{buffer};
+    ASSERT_EQ(io.read_string(0), "unreliable value " + std::to_string(msg_count));
+    msg_count++;
+  });
+  ASSERT_EQ(msg_count, kNumPackets);
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::READ_BATCHES), read_batches + 1);
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::READ_BATCH_PACKETS),
+            read_batch_packets + kNumPackets);
+}
+
+TEST(NeptunTest, ReadBudgetPerTick) {
+  constexpr usize kNumPackets = 5;
+
+  FakeNetwork fake_network{};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout,
+                    NeptunConfig{.read_batch_size = 2, .max_read_packets_per_tick = 3}};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  connect(server, client, fake_network);
+
+  for (usize i = 0; i < kNumPackets; i++) {
+    client.send_unreliable_to(kServerIp, [](byte_span buffer) {
+      IoBuffer io{buffer};
+      auto count = io.write_string("unreliable value", 0);
+      return buffer.first(count);
+    }, kNow);
+    client.tick(kNow);
+  }
+
+  usize msg_count = 0;
+  auto count_msgs = [&msg_count](byte_span) { msg_count++; };
+  auto read_batch_packets = server.metrics().value(NeptunMetricKey::READ_BATCH_PACKETS);
+  server.tick(kNow, unexpected_reliable_msgs, count_msgs);
+  // The budget is 3 packets per tick, read in batches of 2 and 1.
+  ASSERT_EQ(msg_count, 3);
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::READ_BATCH_PACKETS), read_batch_packets + 3);
+
+  server.tick(kNow, unexpected_reliable_msgs, count_msgs);
+  ASSERT_EQ(msg_count, kNumPackets);
+}
+
+TEST(NeptunTest, KeepsUnsentPacketsWhenSocketSendBufferIsFull) {
+  constexpr usize kNumPackets = 3;
+
+  FakeNetwork fake_network{};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  connect(server, client, fake_network);
+
+  // No packets can be sent, so they are kept for later.
+  fake_network.set_max_packets_per_send_batch(0);
+  for (usize i = 0; i < kNumPackets; i++) {
+    client.send_unreliable_to(kServerIp, [i](byte_span buffer) {
+      IoBuffer io{buffer};
+      auto count = io.write_string("unreliable value " + std::to_string(i), 0);
+      return buffer.first(count);
+    }, kNow);
+    client.tick(kNow);
+  }
+  server.tick(kNow, unexpected_reliable_msgs, [](byte_span) { FAIL(); });
+  ASSERT_GT(client.metrics().value(NeptunMetricKey::UNSENT_PACKETS), 0);
+
+  // Once the socket is writable, the unsent packets are sent in order.
+  fake_network.set_max_packets_per_send_batch({});
+  client.tick(kNow);
+  usize msg_count = 0;
+  server.tick(kNow, unexpected_reliable_msgs, [&msg_count](byte_span buffer) {
+    IoBuffer io{buffer};
+    ASSERT_EQ(io.read_string(0), "unreliable value " + std::to_string(msg_count));
+    msg_count++;
+  });
+  ASSERT_EQ(msg_count, kNumPackets);
+}
+
+TEST(NeptunTest, SendsReliableBacklogInGsoBurst) {
+  constexpr usize kNumMessages = 10;
+  const std::string kMessage(200, 'x');
+
+  FakeNetwork fake_network{};
+  NeptunConfig config{.udp_offload = true};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  connect(server, client, fake_network);
+
+  for (usize i = 0; i < kNumMessages; i++) {
+    client.send_reliable_to(kServerIp, [&kMessage, i](byte_span buffer) {
+      IoBuffer io{buffer};
+      auto count = io.write_string(kMessage + std::to_string(i), 0);
+      return buffer.first(count);
+    }, kNow);
+  }
+  // The messages don't fit in a single packet, so they are sent in one burst.
+  fake_network.clear_stats();
+  client.tick(kNow, unexpected_reliable_msgs);
+  ASSERT_EQ(client.metrics().value(NeptunMetricKey::GSO_BURSTS), 1);
+  ASSERT_GT(client.metrics().value(NeptunMetricKey::GSO_BURST_PACKETS), 1);
+  ASSERT_EQ(fake_network.stats(kClientIp).num_sent_packets,
+            client.metrics().value(NeptunMetricKey::GSO_BURST_PACKETS));
+
+  // The server reads the burst as a single coalesced buffer and splits it into packets.
+  auto read_packets_before = server.metrics().value(NeptunMetricKey::READ_BATCH_PACKETS);
+  auto coalesced_packets_before = server.metrics().value(NeptunMetricKey::COALESCED_PACKETS);
+  usize msg_count = 0;
+  server.tick(kNow, [&](byte_span payload) {
+    IoBuffer io{payload};
+    ASSERT_EQ(io.read_string(0), kMessage + std::to_string(msg_count));
+    msg_count++;
+  });
+  ASSERT_EQ(msg_count, kNumMessages);
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::READ_BATCH_PACKETS) - read_packets_before, 1);
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::COALESCED_PACKETS) - coalesced_packets_before,
+            client.metrics().value(NeptunMetricKey::GSO_BURST_PACKETS));
+}
+
+TEST(NeptunTest, GsoBurstSkipsMessagesThatDontFitIntoSegment) {
+  FakeNetwork fake_network{};
+  NeptunConfig config{.udp_offload = true};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  connect(server, client, fake_network);
+
+  // The second message is larger than a packet.
+  for (usize size : {200, 1400}) {
+    client.send_reliable_to(kServerIp, [size](byte_span buffer) {
+      std::fill_n(buffer.begin(), size, 42);
+      return buffer.first(size);
+    }, kNow);
+  }
+  fake_network.clear_stats();
+  client.tick(kNow, unexpected_reliable_msgs);
+  // No segment with only the packet header is added after the first packet.
+  ASSERT_EQ(client.metrics().value(NeptunMetricKey::GSO_BURSTS), 0);
+  ASSERT_EQ(fake_network.stats(kClientIp).num_sent_packets, 1);
+}
+
+TEST(NeptunTest, NextDeadline) {
+  FakeNetwork fake_network{};
+  auto limit = BandwidthLimit{
+      .max_read_packet_rate = 100,
+      .max_read_packet_size = 1400,
+      .max_send_packet_rate = 100,
+      .max_send_packet_size = 1400,
+  };
+  constexpr milliseconds kPacketTimeout{500};
+  // The handshake packets time out while the peers aren't ticked, which would slow the peers down
+  // with congestion control.
+  NeptunConfig config{.skip_idle_send_ticks = true, .congestion_control = {.enabled = false}};
+  TestNeptun server{fake_network, kServerIp, ConnectionManagerConfig{0, limit}, kPacketTimeout, config};
+  TestNeptun client{fake_network, kClientIp, ConnectionManagerConfig{0, limit}, kPacketTimeout, config};
+  ASSERT_FALSE(client.next_deadline());
+
+  // The handshake must be sent right away, and resent until the peer responds.
+  client.connect(kServerIp, kNow);
+  ASSERT_LE(client.next_deadline(), kNow);
+  client.tick(kNow);
+  ASSERT_EQ(client.next_deadline(), kNow + NeptunConfig{}.handshake_resend_interval);
+  connect(server, client, fake_network);
+
+  // Deadlines far in the future are only lower bounds. Ticks the peer at its deadlines until
+  // one of them is at or after [time], checks that nothing is sent until then, and returns it.
+  auto tick_until = [&fake_network](TestNeptun &neptun, IpAddress ip, time_point<FakeClock> time) {
+    auto sent_packets = fake_network.stats(ip).num_sent_packets;
+    auto deadline = neptun.next_deadline();
+    while (deadline && *deadline < time) {
+      neptun.tick(*deadline);
+      EXPECT_EQ(fake_network.stats(ip).num_sent_packets, sent_packets);
+      auto next_deadline = neptun.next_deadline();
+      EXPECT_GT(next_deadline, deadline);
+      deadline = next_deadline;
+    }
+    return deadline;
+  };
+
+  // Once connected and idle, the peers aren't woken up on their send ticks.
+  auto now = kNow + seconds(1);
+  client.tick(now);
+  server.tick(now);
+  client.tick(now);
+  ASSERT_GT(client.next_deadline(), now + milliseconds(10));
+
+  // A pending message is sent on the next send tick.
+  client.send_unreliable_to(kServerIp, [](byte_span buffer) {
+    IoBuffer io{buffer};
+    return buffer.first(io.write_string("hello", 0));
+  }, now);
+  auto send_deadline = client.next_deadline();
+  ASSERT_TRUE(send_deadline);
+  ASSERT_LE(*send_deadline, now + milliseconds(10));
+  client.tick(*send_deadline);
+  usize msg_count = 0;
+  server.tick(*send_deadline, unexpected_reliable_msgs, [&msg_count](byte_span) { msg_count++; });
+  ASSERT_EQ(msg_count, 1);
+  // The server's send ticker has fired too, so the message is acked in the same tick.
+  client.tick(*send_deadline);
+
+  // The server's packet only acks the client's packet, so it isn't acked back, and it times out.
+  auto timeout = *send_deadline + server.peer_stats(kClientIp)->packet_timeout;
+  ASSERT_EQ(tick_until(server, kServerIp, timeout), timeout);
+
+  // An idle peer is sent a keepalive before the peer considers it idle.
+  auto keepalive_time = *send_deadline + NeptunConfig{}.idle_timeout / 3;
+  ASSERT_EQ(tick_until(client, kClientIp, keepalive_time), keepalive_time);
+  auto sent_packets = fake_network.stats(kClientIp).num_sent_packets;
+  client.tick(keepalive_time);
+  ASSERT_EQ(fake_network.stats(kClientIp).num_sent_packets, sent_packets + 1);
+}
+
+TEST(NeptunTest, EvictsIdlePeers) {
+  FakeNetwork fake_network{};
+  NeptunConfig config{.idle_timeout = seconds(1)};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  std::vector<IpAddress> evicted_peers{};
+  server.set_peer_evicted_callback([&evicted_peers](IpAddress ip) { evicted_peers.push_back(ip); });
+  connect(server, client, fake_network);
+
+  // Peers that keep sending packets stay connected.
+  for (usize ms = 0; ms <= 2000; ms += 10) {
+    auto now = kNow + milliseconds(ms);
+    client.tick(now);
+    server.tick(now);
+  }
+  ASSERT_TRUE(server.is_connected(kClientIp));
+  ASSERT_TRUE(evicted_peers.empty());
+
+  // The client stops sending packets.
+  auto last_read_time = kNow + milliseconds(2000);
+  server.tick(last_read_time + milliseconds(999));
+  ASSERT_EQ(server.peer_count(), 1);
+  server.tick(last_read_time + seconds(1));
+  ASSERT_EQ(server.peer_count(), 0);
+  ASSERT_FALSE(server.is_connected(kClientIp));
+  ASSERT_FALSE(server.find_peer(kClientIp));
+  ASSERT_EQ(evicted_peers, std::vector<IpAddress>{kClientIp});
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::PEERS_EVICTED), 1);
+}
+
+TEST(NeptunTest, PeerWithLargerCapacityDoesntOverflowReceiveWindow) {
+  FakeNetwork fake_network{};
+  // The client can have more reliable bytes unacked than the server's receive window holds.
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout,
+                    NeptunConfig{.reliable_stream_capacity = 1000}};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout,
+                    NeptunConfig{.reliable_stream_capacity = 64 * 1024}};
+  std::vector<IpAddress> evicted_peers{};
+  server.set_peer_evicted_callback([&evicted_peers](IpAddress ip) { evicted_peers.push_back(ip); });
+  connect(server, client, fake_network);
+  auto write_message = [](byte_span buffer) {
+    std::fill_n(buffer.begin(), 600, 42);
+    return buffer.first(600);
+  };
+
+  // The first message is lost, so the next ones are held by the server until it's resent.
+  auto now = kNow + seconds(1);
+  client.send_reliable_to(kServerIp, write_message, now);
+  fake_network.drop_packets(true);
+  client.tick(now);
+  fake_network.drop_packets(false);
+  // Each message takes a packet of its own, but only the second one fits into the server's
+  // window, so the third one waits for the first one to be acked.
+  for (usize i = 0; i < 2; i++) {
+    now += milliseconds(1);
+    client.send_reliable_to(kServerIp, write_message, now);
+    client.tick(now);
+  }
+  usize message_count = 0;
+  auto on_reliable = [&message_count](IpAddress ip, byte_span payload) {
+    ASSERT_EQ(ip, kClientIp);
+    ASSERT_EQ(payload.size(), 600);
+    message_count++;
+  };
+  server.tick(now, on_reliable);
+  ASSERT_TRUE(server.is_connected(kClientIp));
+  ASSERT_EQ(message_count, 0);
+
+  // The lost message is resent after the timeout, and then the third one.
+  for (usize ms = 10; ms <= 2000; ms += 10) {
+    client.tick(now + milliseconds(ms));
+    server.tick(now + milliseconds(ms), on_reliable);
+  }
+  ASSERT_EQ(message_count, 3);
+  ASSERT_TRUE(server.is_connected(kClientIp));
+  ASSERT_TRUE(evicted_peers.empty());
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::PEERS_DISCONNECTED), 0);
+}
+
+TEST(NeptunTest, RejectsNewPeersOverLimit) {
+  const IpAddress kOtherClientIp = IpAddress::from_ipv4("192.168.0.12", 2000);
+
+  FakeNetwork fake_network{};
+  NeptunConfig server_config{.max_peers = 1};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout, server_config};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  TestNeptun other_client{fake_network, kOtherClientIp, kConnectionManagerConfig};
+  connect(server, client, fake_network);
+
+  other_client.connect(kServerIp, kNow);
+  for (usize ms = 0; ms <= 200; ms += 100) {
+    other_client.tick(kNow + milliseconds(ms));
+    server.tick(kNow + milliseconds(ms));
+  }
+  ASSERT_EQ(server.peer_count(), 1);
+  ASSERT_TRUE(server.is_connected(kClientIp));
+  ASSERT_FALSE(server.find_peer(kOtherClientIp));
+  ASSERT_FALSE(other_client.is_connected(kServerIp));
+  ASSERT_GT(server.metrics().value(NeptunMetricKey::PEERS_REJECTED), 0);
+  ASSERT_THROW(server.connect(kOtherClientIp, kNow), std::runtime_error);
+}
+
+TEST(NeptunTest, PeerStats) {
+  FakeNetwork fake_network{};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  ASSERT_FALSE(server.peer_stats(kClientIp));
+  connect(server, client, fake_network);
+  ASSERT_TRUE(server.peer_stats(kClientIp));
+
+  // The client acks the server's packet 30ms after it has been sent.
+  auto now = kNow + seconds(1);
+  server.tick(now);
+  client.tick(now + milliseconds(30));
+  server.tick(now + milliseconds(30));
+  auto rtt = server.peer_stats(kClientIp)->rtt;
+  ASSERT_TRUE(rtt);
+  ASSERT_EQ(rtt->latest, milliseconds(30));
+  ASSERT_LE(rtt->min, milliseconds(30));
+  ASSERT_GE(rtt->sample_count, 2);  ASSERT_EQ(server.peer_stats(kClientIp)->reliable_receive_window_size, 0);
+}
+
+TEST(NeptunTest, CongestionControlSlowsDownOnDrops) {
+  FakeNetwork fake_network{};
+  auto limit = BandwidthLimit{
+      .max_read_packet_rate = 100,
+      .max_read_packet_size = 1400,
+      .max_send_packet_rate = 100,
+      .max_send_packet_size = 1400,
+  };
+  TestNeptun server{fake_network, kServerIp, ConnectionManagerConfig{0, limit}};
+  TestNeptun client{fake_network, kClientIp, ConnectionManagerConfig{0, limit}};
+  connect(server, client, fake_network);
+  // The handshake packets that time out while the peers aren't ticked slow the peers down too.
+  auto now = kNow + seconds(1);
+  for (usize i = 0; i < 1000; i++, now += milliseconds(1)) {
+    client.tick(now);
+    server.tick(now);
+  }
+  ASSERT_EQ(client.peer_stats(kServerIp)->send_packet_rate, 100);
+  ASSERT_EQ(client.peer_stats(kServerIp)->send_packet_size, 1400);
+
+  // The link goes down for a second, and the client's packets time out. Only the drops of
+  // packets with messages are a sign of congestion.
+  fake_network.drop_packets(true);
+  for (usize i = 0; i < 1000; i++, now += milliseconds(1)) {
+    client.send_unreliable_to(kServerIp, [](byte_span buffer) {
+      IoBuffer io{buffer};
+      return buffer.first(io.write_string("state", 0));
+    }, now);
+    client.tick(now);
+    server.tick(now);
+  }
+  fake_network.drop_packets(false);
+  ASSERT_LT(client.peer_stats(kServerIp)->send_packet_rate, 50);
+
+  // Once the link is back, the rate recovers.
+  for (usize i = 0; i < 2000; i++, now += milliseconds(1)) {
+    client.tick(now);
+    server.tick(now);
+  }
+  ASSERT_EQ(client.peer_stats(kServerIp)->send_packet_rate, 100);
+}
+
+TEST(NeptunTest, IdleGapsDontSlowDownPeers) {
+  FakeNetwork fake_network{};
+  auto limit = BandwidthLimit{
+      .max_read_packet_rate = 100,
+      .max_read_packet_size = 1400,
+      .max_send_packet_rate = 100,
+      .max_send_packet_size = 1400,
+  };
+  // Idle peers only send keepalives, so the packets that only ack the peer's messages are never
+  // acked, and they time out.
+  NeptunConfig config{.skip_idle_send_ticks = true};
+  TestNeptun server{fake_network, kServerIp, ConnectionManagerConfig{0, limit},
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  TestNeptun client{fake_network, kClientIp, ConnectionManagerConfig{0, limit},
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  std::vector<u8> received_state{};
+  server.set_latest_state_callback([&received_state](IpAddress, byte_span state) {
+    received_state.assign(state.begin(), state.end());
+  });
+  connect(server, client, fake_network);
+
+  // The client sends a message every 2 seconds, and the server replies.
+  auto now = kNow + seconds(1);
+  for (usize exchange = 0; exchange < 20; exchange++) {
+    client.send_reliable_to(kServerIp, [](byte_span buffer) {
+      IoBuffer io{buffer};
+      return buffer.first(io.write_string("ping", 0));
+    }, now);
+    for (usize i = 0; i < 2000; i++, now += milliseconds(1)) {
+      client.tick(now);
+      bool is_pinged = false;
+      server.tick(now, [&is_pinged](byte_span) { is_pinged = true; });
+      if (is_pinged) {
+        server.send_reliable_to(kClientIp, [](byte_span buffer) {
+          IoBuffer io{buffer};
+          return buffer.first(io.write_string("pong", 0));
+        }, now);
+      }
+    }
+  }
+  // The client's packets that ack the server's replies time out.
+  ASSERT_GT(client.metrics().value(NeptunMetricKey::PACKET_DROPS), 0);
+  ASSERT_EQ(client.peer_stats(kServerIp)->send_packet_rate, 100);
+  ASSERT_EQ(client.peer_stats(kServerIp)->send_packet_size, 1400);
+
+  // A state that only fits into a packet of the agreed size is delivered.
+  std::vector<u8> state(1300, 1);
+  client.send_latest_state_to(kServerIp, state);
+  for (usize i = 0; i < 100; i++, now += milliseconds(1)) {
+    client.tick(now);
+    server.tick(now);
+  }
+  ASSERT_EQ(received_state, state);
+}
+
+TEST(NeptunTest, UpdatesBandwidthLimitAtRuntime) {
+  FakeNetwork fake_network{};
+  auto limit = BandwidthLimit{
+      .max_read_packet_rate = 60,
+      .max_read_packet_size = 1000,
+      .max_send_packet_rate = 60,
+      .max_send_packet_size = 1000,
+  };
+  // The rates are exact without congestion control.
+  NeptunConfig config{.congestion_control = {.enabled = false}};
+  TestNeptun server{fake_network, kServerIp, ConnectionManagerConfig{0, limit},
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  TestNeptun client{fake_network, kClientIp, ConnectionManagerConfig{0, limit},
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  connect(server, client, fake_network);
+  auto run = [&](FakeClock::time_point &now) {
+    for (usize i = 0; i < 200; i++, now += milliseconds(1)) {
+      client.tick(now);
+      server.tick(now);
+    }
+  };
+  auto now = kNow + seconds(1);
+  run(now);
+  ASSERT_EQ(client.peer_stats(kServerIp)->send_packet_rate, 60);
+
+  // The server halves the rate at which the client may send to it.
+  auto reduced_limit = limit;
+  reduced_limit.max_read_packet_rate = 30;
+  reduced_limit.max_read_packet_size = 500;
+  server.update_bandwidth_limit(kClientIp, reduced_limit);
+  ASSERT_TRUE(server.peer_stats(kClientIp)->is_bandwidth_limit_update_pending);
+  run(now);
+  ASSERT_FALSE(server.peer_stats(kClientIp)->is_bandwidth_limit_update_pending);
+  ASSERT_EQ(client.peer_stats(kServerIp)->send_packet_rate, 30);
+  ASSERT_EQ(client.peer_stats(kServerIp)->send_packet_size, 500);
+
+  // Limits of all peers, which also apply to our own sends.
+  reduced_limit.max_send_packet_rate = 20;
+  server.update_bandwidth_limit(reduced_limit);
+  ASSERT_EQ(server.peer_stats(kClientIp)->send_packet_rate, 20);
+  run(now);
+  ASSERT_FALSE(server.peer_stats(kClientIp)->is_bandwidth_limit_update_pending);
+  ASSERT_EQ(client.peer_stats(kServerIp)->send_packet_rate, 30);
+  ASSERT_THROW(server.update_bandwidth_limit(IpAddress::from_ipv4("192.168.0.99", 2000), limit),
+               std::runtime_error);
+}
+
+TEST(NeptunTest, LatestStateIsSentAsDelta) {
+  FakeNetwork fake_network{};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  std::vector<u8> received_state{};
+  client.set_latest_state_callback([&received_state](IpAddress sender, byte_span state) {
+    ASSERT_EQ(sender, kServerIp);
+    received_state.assign(state.begin(), state.end());
+  });
+  connect(server, client, fake_network);
+
+  // A world of 90 entities of 8 bytes, where one entity moves on every tick. The state must fit
+  // into a packet of 800 bytes.
+  std::vector<u8> state(720);
+  auto now = kNow + seconds(1);
+  for (usize i = 0; i < 200; i++, now += milliseconds(10)) {
+    state[(i % 90) * 8] = static_cast<u8>(i);
+    server.send_latest_state_to(kClientIp, state);
+    server.tick(now);
+    client.tick(now);
+  }
+  ASSERT_EQ(received_state, state);
+  auto delta_bytes = server.metrics().value(NeptunMetricKey::LATEST_STATE_BYTES);
+  auto full_bytes = server.metrics().value(NeptunMetricKey::LATEST_STATE_FULL_BYTES);
+  ASSERT_LT(delta_bytes * 10, full_bytes);
+}
+
+TEST(NeptunTest, LatestStateHistoryIsTheSmallerOfBothSides) {
+  FakeNetwork fake_network{};
+  // The client keeps fewer snapshots than the server has in flight.
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout,
+                    NeptunConfig{.latest_state_history_size = 32}};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout,
+                    NeptunConfig{.latest_state_history_size = 4}};
+  usize received_count = 0;
+  std::vector<u8> received_state{};
+  client.set_latest_state_callback([&](IpAddress, byte_span state) {
+    received_count++;
+    received_state.assign(state.begin(), state.end());
+  });
+  connect(server, client, fake_network);
+
+  // The client only reads every 10 ms, so that many of the server's packets are in flight.
+  std::vector<u8> state(100);
+  auto now = kNow + seconds(1);
+  for (usize i = 0; i < 3000; i++, now += milliseconds(1)) {
+    state[i % state.size()] = static_cast<u8>(i);
+    server.send_latest_state_to(kClientIp, state);
+    server.tick(now);
+    if (i % 10 == 0) {
+      client.tick(now);
+    }
+  }
+  for (usize i = 0; i < 100; i++, now += milliseconds(1)) {
+    server.tick(now);
+    client.tick(now);
+  }
+  ASSERT_EQ(received_state, state);
+  ASSERT_GT(received_count, 200);
+}
+
+TEST(NeptunTest, RejectsLatestStateThatDoesntFitIntoPacket) {
+  FakeNetwork fake_network{};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  std::vector<u8> received_state{};
+  client.set_latest_state_callback([&received_state](IpAddress, byte_span state) {
+    received_state.assign(state.begin(), state.end());
+  });
+  connect(server, client, fake_network);
+
+  // The server sends packets of at most 800 bytes.
+  auto max_state_size = LatestStateManager::max_state_size(800 - PacketHeader::kSerializedSize);
+  std::vector<u8> state(max_state_size + 1, 1);
+  ASSERT_THROW(server.send_latest_state_to(kClientIp, state), std::runtime_error);
+
+  state.pop_back();
+  server.send_latest_state_to(kClientIp, state);
+  auto now = kNow + seconds(1);
+  server.tick(now);
+  client.tick(now);
+  ASSERT_EQ(received_state, state);
+}
+
+TEST(NeptunTest, MovesArriveDespiteLostPackets) {
+  FakeNetwork fake_network{};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  std::vector<u8> received_moves{};
+  server.set_move_callback([&received_moves](IpAddress sender, byte_span move) {
+    ASSERT_EQ(sender, kClientIp);
+    received_moves.push_back(move[0]);
+  });
+  connect(server, client, fake_network);
+
+  // Every third packet from the client is lost. The lost moves arrive with the next packet,
+  // without waiting for the lost packet to time out.
+  std::vector<u8> sent_moves{};
+  auto now = kNow + seconds(1);
+  for (usize i = 0; i < 30; i++, now += milliseconds(10)) {
+    auto move = static_cast<u8>(i);
+    client.send_move_to(kServerIp, [move](byte_span buffer) {
+      buffer[0] = move;
+      return buffer.first(1);
+    });
+    sent_moves.push_back(move);
+    bool is_lost = i % 3 == 0;
+    fake_network.drop_packets(is_lost);
+    client.tick(now);
+    fake_network.drop_packets(false);
+    server.tick(now);
+    ASSERT_EQ(received_moves.size(), is_lost ? i : i + 1);
+  }
+  ASSERT_EQ(received_moves, sent_moves);
+}
+
+TEST(NeptunTest, ReliableMessagesAreAckedBeforeNextSendTick) {
+  FakeNetwork fake_network{};
+  // The server sends 10 packets per second, and the client 30, so most of the client's packets
+  // arrive long before the server's next send tick.
+  auto server_limit = BandwidthLimit{
+      .max_read_packet_rate = 30,
+      .max_read_packet_size = 1000,
+      .max_send_packet_rate = 10,
+      .max_send_packet_size = 1000,
+  };
+  auto client_limit = BandwidthLimit{
+      .max_read_packet_rate = 10,
+      .max_read_packet_size = 1000,
+      .max_send_packet_rate = 30,
+      .max_send_packet_size = 1000,
+  };
+  NeptunConfig config{.congestion_control = {.enabled = false}};
+  TestNeptun server{fake_network, kServerIp, ConnectionManagerConfig{0, server_limit},
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  TestNeptun client{fake_network, kClientIp, ConnectionManagerConfig{0, client_limit},
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  connect(server, client, fake_network);
+  auto now = kNow + seconds(1);
+  for (usize i = 0; i < 100; i++, now += milliseconds(1)) {
+    client.tick(now);
+    server.tick(now);
+  }
+
+  fake_network.clear_stats();
+  std::vector<FakeClock::time_point> received_times{};
+  for (usize i = 0; i < 1000; i++, now += milliseconds(1)) {
+    client.send_reliable_to(kServerIp, [](byte_span buffer) {
+      IoBuffer io{buffer};
+      return buffer.first(io.write_string("hello", 0));
+    }, now);
+    auto acks = client.metrics().value(NeptunMetricKey::PACKET_ACKS);
+    client.tick(now);
+    server.tick(now, [&received_times, now](byte_span) {
+      received_times.push_back(now);
+    });
+    if (client.metrics().value(NeptunMetricKey::PACKET_ACKS) > acks) {
+      // Acked within the ack delay, instead of up to 100ms later on the server's send tick.
+      ASSERT_FALSE(received_times.empty());
+      ASSERT_LE(now - received_times.back(), config.immediate_ack_delay + milliseconds(1));
+    }
+  }
+  ASSERT_GE(server.metrics().value(NeptunMetricKey::IMMEDIATE_ACK_PACKETS), 5);
+  // The ack-only packets are taken from the send ticks.
+  ASSERT_LE(fake_network.stats(kServerIp).num_sent_packets, 11);
+}
+
+TEST(NeptunTest, ResendsLostReliableMessageWithinRtt) {
+  FakeNetwork fake_network{};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  connect(server, client, fake_network);
+
+  // Measure the RTT, with packets delivered every 10ms.
+  auto now = kNow + seconds(1);
+  for (usize i = 0; i < 20; i++, now += milliseconds(10)) {
+    client.tick(now);
+    server.tick(now);
+  }
+  auto packet_timeout = client.peer_stats(kServerIp)->packet_timeout;
+  ASSERT_LT(packet_timeout, milliseconds(100));
+
+  // The packet with the message is lost.
+  client.send_reliable_to(kServerIp, [](byte_span buffer) {
+    IoBuffer io{buffer};
+    return buffer.first(io.write_string("hello", 0));
+  }, now);
+  fake_network.drop_packets(true);
+  client.tick(now);
+  fake_network.drop_packets(false);
+
+  usize msg_count = 0;
+  auto lost_time = now;
+  while (msg_count == 0 && now < lost_time + seconds(5)) {
+    now += milliseconds(10);
+    client.tick(now);
+    server.tick(now, [&msg_count](byte_span) { msg_count++; });
+  }
+  ASSERT_EQ(msg_count, 1);
+  // Resent once the packet times out, i.e. at most one tick after the timeout.
+  ASSERT_LE(now - lost_time, packet_timeout + milliseconds(10));
+}
+
+// Writes a packet with a LetsConnect message from an unknown peer.
+byte_span write_lets_connect(byte_span buffer, u64 cookie) {
+  usize idx = PacketHeader::write(buffer, 0, 0, 0).size();
+  idx += Segment::write(advance(buffer, idx), ManagerType::CONNECTION_MANAGER, 1).size();
+  idx += MessageHeader::write(advance(buffer, idx), LetsConnect::kId).size();
+  idx += LetsConnect::write(advance(buffer, idx), 0, 0, 1400, 1400, 0, 0, 0, 0, cookie).size();
+  return buffer.first(idx);
+}
+
+TEST(NeptunTest, SpoofedPacketsDontAllocatePeers) {
+  constexpr usize kSpoofedSourceCount = 1000;
+
+  FakeNetwork fake_network{};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
+  std::vector<u8> buffer(kJustAboveMtu);
+  std::vector<u8> garbage(100, 0xAB);
+  for (usize i = 0; i < kSpoofedSourceCount; i++) {
+    auto socket = UdpSocket<FakeNetwork>::bind(IpAddress::from_u32(0x0B000000 + i, 3000), fake_network);
+    (void) socket.send_to(kServerIp, write_lets_connect(buffer, 0));
+    // A forged cookie.
+    (void) socket.send_to(kServerIp, write_lets_connect(buffer, 42));
+    (void) socket.send_to(kServerIp, garbage);
+  }
+  for (usize ms = 0; ms < 3 * kSpoofedSourceCount; ms += NeptunConfig{}.max_read_packets_per_tick) {
+    server.tick(kNow + milliseconds(ms));
+  }
+
+  ASSERT_EQ(server.peer_count(), 0);
+  ASSERT_FALSE(server.next_deadline());
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::READ_BATCH_PACKETS), 3 * kSpoofedSourceCount);
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::HANDSHAKE_CHALLENGES), 2 * kSpoofedSourceCount);
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::UNKNOWN_PEER_PACKETS), kSpoofedSourceCount);
+  // The challenges are smaller than the requests, so they can't amplify a flood.
+  ASSERT_LT(fake_network.stats(kServerIp).num_sent_bytes, fake_network.stats(kServerIp).num_read_bytes);
+}
+
+TEST(NeptunTest, RateLimitsHandshakesPerSource) {
+  const IpAddress kSpoofedIp = IpAddress::from_ipv4("10.0.0.1", 3000);
+  constexpr usize kRequestCount = 100;
+
+  FakeNetwork fake_network{};
+  NeptunConfig config{.handshake_rate_limit = 10, .handshake_burst = 20};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig,
+                    freezing::network::detail::kDefaultPacketTimeout, config};
+  std::vector<u8> buffer(kJustAboveMtu);
+  auto socket = UdpSocket<FakeNetwork>::bind(kSpoofedIp, fake_network);
+  for (usize i = 0; i < kRequestCount; i++) {
+    (void) socket.send_to(kServerIp, write_lets_connect(buffer, 0));
+  }
+  server.tick(kNow);
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::HANDSHAKE_CHALLENGES), config.handshake_burst);
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::HANDSHAKES_RATE_LIMITED),
+            kRequestCount - config.handshake_burst);
+  ASSERT_EQ(fake_network.stats(kServerIp).num_sent_packets, config.handshake_burst);
+
+  // The source gets [handshake_rate_limit] more answers per second.
+  for (usize i = 0; i < kRequestCount; i++) {
+    (void) socket.send_to(kServerIp, write_lets_connect(buffer, 0));
+  }
+  server.tick(kNow + seconds(1));
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::HANDSHAKE_CHALLENGES),
+            config.handshake_burst + config.handshake_rate_limit);
+
+  // Other sources are not affected.
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  connect(server, client, fake_network);
+  ASSERT_TRUE(server.is_connected(kClientIp));
+  ASSERT_EQ(server.peer_count(), 1);
+}
+
+TEST(NeptunTest, FailingDestinationDoesntBlockSends) {
+  // The kernel refuses to send to port 0, so the challenge for this handshake fails.
+  const IpAddress kFailingIp = IpAddress::from_ipv4("127.0.0.1", 0);
+
+  FakeNetwork fake_network{};
+  fake_network.fail_sends_to(kFailingIp);
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
+  std::vector<u8> buffer(kJustAboveMtu);
+  auto socket = UdpSocket<FakeNetwork>::bind(kFailingIp, fake_network);
+  (void) socket.send_to(kServerIp, write_lets_connect(buffer, 0));
+  server.tick(kNow);
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::HANDSHAKE_CHALLENGES), 1);
+  ASSERT_EQ(fake_network.stats(kServerIp).num_sent_packets, 0);
+
+  TestNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  connect(server, client, fake_network);
+  ASSERT_TRUE(server.is_connected(kClientIp));
+}
+
 TEST(NeptunTest, IgnoresPacketsForUnrelatedProtocol) {
   FAIL();
 }
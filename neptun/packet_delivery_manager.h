@@ -6,36 +6,41 @@
 #define NEPTUN_NEPTUN_PACKET_DELIVERY_MANAGER_H
 
 #include <algorithm>
+#include <bit>
+#include <deque>
+#include <functional>
 #include <tuple>
 #include <queue>
 
 #include "neptun/messages/packet_header.h"
 #include "neptun/common.h"
+#include "neptun/rtt_estimator.h"
 
 // TODO: Use PacketId instead of u32 for packet id.
 namespace freezing::network {
 
 namespace detail {
 
+// Bounds of the packet timeout, which adapts to the measured RTT.
 static const seconds kDefaultPacketTimeout = seconds(5);
+static const milliseconds kDefaultMinPacketTimeout = milliseconds(50);
+// Packet timeout until the RTT has been measured (RFC 6298, section 2.1).
+static const seconds kInitialPacketTimeout = seconds(1);
+// Lower bound of the RTT variance term, so that a stable RTT doesn't lead to spurious timeouts.
+static const milliseconds kRttVarianceGranularity = milliseconds(1);
+// Packets that arrive at most this many positions behind the newest received packet are still
+// processed, unless they are duplicates.
+constexpr u32 kDefaultMaxReorderDistance = 32;
 
 template<typename Clock>
 struct InFlightPacket {
   u32 id;
   time_point<Clock> time_dispatched;
+  // Acked packets stay in flight until all older packets have been acked or dropped, so that
+  // the statuses are reported in packet order.
+  bool is_acked;
 };
 
-static std::optional<u32> most_significant_bit(u32 value) {
-  std::optional<u32> msb{};
-  for (u32 bit = 0; bit < sizeof(u32) * 8; bit++) {
-    u32 mask = 1 << bit;
-    if ((mask & value) > 0) {
-      msb = bit;
-    }
-  }
-  return msb;
-}
-
 }
 
 class DeliveryStatuses {
@@ -60,6 +65,10 @@ public:
     return m_statuses;
   }
 
+  bool empty() const {
+    return m_statuses.empty();
+  }
+
 private:
   std::vector<std::pair<PacketId, PacketDeliveryStatus>> m_statuses;
 
@@ -68,60 +77,106 @@ private:
 template<typename Clock>
 class PacketDeliveryManager {
 public:
+  // The packet timeout adapts to the RTT within [min_packet_timeout, max_packet_timeout].
+  // See [packet_timeout].
+  // Packets that arrive up to [max_reorder_distance] positions late are processed, see
+  // [process_read]. Zero processes only packets that are newer than all received packets.
+  // The peer acks such packets late, so a sent packet that hasn't been acked is only considered
+  // dropped once a packet more than [max_reorder_distance] positions newer has been acked, or
+  // once it times out.
   explicit PacketDeliveryManager(
       PacketId next_expected_packet_id,
-      milliseconds packet_timeout = detail::kDefaultPacketTimeout) : m_next_expected_packet_id{
-      next_expected_packet_id}, m_packet_timeout{
-      packet_timeout} {}
+      milliseconds max_packet_timeout = detail::kDefaultPacketTimeout,
+      milliseconds min_packet_timeout = detail::kDefaultMinPacketTimeout,
+      u32 max_reorder_distance = detail::kDefaultMaxReorderDistance) : m_min_packet_timeout{
+      min_packet_timeout}, m_max_packet_timeout{max_packet_timeout}, m_next_expected_packet_id{
+      next_expected_packet_id}, m_max_reorder_distance{max_reorder_distance} {
+    assert(min_packet_timeout <= max_packet_timeout);
+    assert(max_reorder_distance < sizeof(m_received_bitmask) * 8);
+    update_packet_timeout();
+  }
 
   // TODO: API should be clearer. I get confused by what is what.
   // If the returned usize is 0, then the packet should not be processed.
-  // It's either a duplicate or it is assumed to be dropped.
-  std::tuple<usize, DeliveryStatuses, PacketId> process_read(byte_span buffer) {
+  // It's either a duplicate or it's older than the reorder window. Packets that arrive late,
+  // but within the reorder window, are processed and acked like any other packet.
+  // [now] is the time at which the packet has been received, which is used to measure the RTT.
+  std::tuple<usize, DeliveryStatuses, PacketId> process_read(byte_span buffer,
+                                                             time_point<Clock> now) {
     auto header = PacketHeader(buffer);
-    DeliveryStatuses statuses = process_acks(header.ack_sequence_number(), header.ack_bitmask());
+    DeliveryStatuses statuses =
+        process_acks(header.ack_sequence_number(), header.ack_bitmask(), now);
     usize processed_byte_count = process_packet_header(header, buffer);
     return {processed_byte_count, statuses, header.id()};
   }
 
   DeliveryStatuses drop_old_packets(time_point<Clock> now) {
     DeliveryStatuses statuses{};
+    bool has_timed_out = false;
     while (!m_in_flight_packets.empty()) {
-      auto in_flight = m_in_flight_packets.front();
-      if (in_flight.time_dispatched + m_packet_timeout <= now) {
+      const auto &in_flight = m_in_flight_packets.front();
+      if (in_flight.is_acked) {
+        // Acked while an older packet was still in flight.
+        statuses.add_ack(in_flight.id);
+      } else if (in_flight.time_dispatched + m_packet_timeout <= now) {
         statuses.add_drop(in_flight.id);
-        m_in_flight_packets.pop();
+        has_timed_out = true;
       } else {
         break;
       }
+      m_in_flight_packets.pop_front();
+    }
+    if (has_timed_out) {
+      // The RTT may have grown, so back off until the next ack (RFC 6298, section 5.5).
+      m_timeout_backoff = std::min(m_timeout_backoff + 1, kMaxTimeoutBackoff);
+      update_packet_timeout();
     }
     return statuses;
   }
 
+  // Time after which an in-flight packet is considered dropped, unless it's acked:
+  // smoothed RTT + 4 * RTT variance (RFC 6298, section 2), doubled for every timeout since the
+  // last RTT sample, and clamped to the bounds.
+  nanoseconds packet_timeout() const {
+    return m_packet_timeout;
+  }
+
+  // Returns the time at which the oldest in-flight packet is considered dropped by
+  // [drop_old_packets], or nothing if there are no packets in flight.
+  std::optional<time_point<Clock>> next_timeout() const {
+    if (m_in_flight_packets.empty()) {
+      return {};
+    }
+    return m_in_flight_packets.front().time_dispatched + m_packet_timeout;
+  }
+
+  // Returns nothing until a packet has been acked.
+  std::optional<RttStats> rtt_stats() const {
+    return m_rtt_estimator.stats();
+  }
+
   usize write(byte_span buffer, time_point<Clock> now) {
     auto packet_id = m_next_outgoing_packet_id++;
-    m_in_flight_packets.push({packet_id, now});
+    m_in_flight_packets.push_back({packet_id, now, false});
     if (m_pending_acks.empty()) {
-      auto ack_sequence_number = 0;
-      auto ack_bitmask = 0;
+      AckSequenceNumber ack_sequence_number = 0;
+      AckBitmask ack_bitmask = 0;
       auto write_count =
           PacketHeader::write(buffer, packet_id, ack_sequence_number, ack_bitmask).size();
       assert(write_count == PacketHeader::kSerializedSize);
       return write_count;
     } else {
-      auto ack_sequence_number = m_pending_acks.front();
-      auto ack_bitmask = 0;
+      AckSequenceNumber ack_sequence_number = m_pending_acks.top();
+      AckBitmask ack_bitmask = 0;
       while (!m_pending_acks.empty()) {
-        auto pending_packet_id_ack = m_pending_acks.front();
-        // TODO: A helper function to check if [ack] can be described for [ack_sequence_number].
+        auto pending_packet_id_ack = m_pending_acks.top();
         assert(pending_packet_id_ack >= ack_sequence_number);
         auto bit_position = pending_packet_id_ack - ack_sequence_number;
-        if (bit_position >= sizeof(u32) * 8) {
+        if (bit_position >= PacketHeader::kAckWindowSize) {
           // If ack can't fit in the bitmask, it must be sent via some future packet.
           break;
-        } else {
-          ack_bitmask = ack_bitmask | (1 << bit_position);
         }
+        ack_bitmask |= AckBitmask{1} << bit_position;
         m_pending_acks.pop();
       }
       PacketHeader::write(buffer, packet_id, ack_sequence_number, ack_bitmask);
@@ -130,69 +185,128 @@ public:
   }
 
 private:
-  milliseconds m_packet_timeout;
+  static constexpr u32 kMaxTimeoutBackoff = 16;
+
+  milliseconds m_min_packet_timeout;
+  milliseconds m_max_packet_timeout;
+  nanoseconds m_packet_timeout{};
+  u32 m_timeout_backoff{0};
   u32 m_next_outgoing_packet_id{0};
+  // One past the newest received packet.
   u32 m_next_expected_packet_id;
-  std::queue<u32> m_pending_acks{};
-  std::queue<detail::InFlightPacket<Clock>> m_in_flight_packets{};
+  // Bit [i] is set if packet [m_next_expected_packet_id - 1 - i] has been received. Packets
+  // before [next_expected_packet_id] that the manager has been created with are never
+  // processed, so they are considered received.
+  u64 m_received_bitmask{~u64{0}};
+  u32 m_max_reorder_distance;
+  // One past the newest packet that the peer has acked.
+  u32 m_acked_packet_end{0};
+  // Lowest first, since late packets are acked after newer ones have been received.
+  std::priority_queue<u32, std::vector<u32>, std::greater<>> m_pending_acks{};
+  // In packet order, without gaps. The oldest packet is never acked, since acked packets are
+  // released as soon as all older packets have been acked or dropped.
+  std::deque<detail::InFlightPacket<Clock>> m_in_flight_packets{};
+  RttEstimator m_rtt_estimator{};
 
-  DeliveryStatuses process_acks(u32 ack_sequence_number, u32 ack_bitmask) {
+  // Only the highest acked packet is sampled, and only when it's acked for the first time,
+  // because that's when the peer's ack was sent the earliest after the packet's arrival.
+  // Older packets in the same ack have waited at the peer for longer, and would overestimate
+  // the RTT.
+  // Samples include the time the peer waited before sending the ack, which is up to the peer's
+  // send tick interval, since acks are sent with the next packet.
+  DeliveryStatuses process_acks(AckSequenceNumber ack_sequence_number,
+                                AckBitmask ack_bitmask,
+                                time_point<Clock> now) {
     // All 0 after the highest set bit are ignored because it's possible that the other host
     // hasn't received the corresponding packets yet.
-    auto msb = detail::most_significant_bit(ack_bitmask);
-    if (!msb) {
-      // All bits are 0.
+    if (ack_bitmask == 0) {
       return DeliveryStatuses{};
-    } else {
-      u32 highest_acked_packet_id = ack_sequence_number + *msb;
-      DeliveryStatuses statuses{};
-      while (!m_in_flight_packets.empty()) {
-        auto in_flight_packet = m_in_flight_packets.front();
+    }
+    u32 highest_acked_packet_id = ack_sequence_number + std::bit_width(ack_bitmask) - 1;
+    // The peer never acks the packets before the first one that it has received, e.g. the
+    // handshakes that it has answered without keeping any state. Those are older than the
+    // packets in the peer's first ack, since the lowest pending acks are written first.
+    PacketId never_acked_end = 0;
+    if (m_acked_packet_end == 0) {
+      never_acked_end = ack_sequence_number + std::countr_zero(ack_bitmask);
+    }
+    for (AckBitmask bits = ack_bitmask; bits != 0; bits &= bits - 1) {
+      u32 packet_id = ack_sequence_number + std::countr_zero(bits);
+      auto *in_flight_packet = find_in_flight_packet(packet_id);
+      if (in_flight_packet == nullptr || in_flight_packet->is_acked) {
+        // Already acked, already considered dropped, or never sent.
+        continue;
+      }
+      in_flight_packet->is_acked = true;
+      m_acked_packet_end = std::max(m_acked_packet_end, packet_id + 1);
+      if (packet_id == highest_acked_packet_id && now >= in_flight_packet->time_dispatched) {
+        m_rtt_estimator.add_sample(now - in_flight_packet->time_dispatched);
+        m_timeout_backoff = 0;
+        update_packet_timeout();
+      }
+    }
 
-        if (in_flight_packet.id > highest_acked_packet_id) {
-          // We are yet to receive any information about the in-flight packets.
-          break;
-        } else {
-          if (in_flight_packet.id < ack_sequence_number) {
-            // If in-flight packet is too far in the past, drop it.
-            statuses.add_drop(in_flight_packet.id);
-          } else {
-            u32 delta = in_flight_packet.id - ack_sequence_number;
-            assert(delta <= sizeof(u32) * 8);
-            u32 in_flight_packet_bitmask = 1 << delta;
-            bool is_in_flight_packet_acked = (in_flight_packet_bitmask & ack_bitmask) > 0;
-            if (is_in_flight_packet_acked) {
-              statuses.add_ack(in_flight_packet.id);
-            } else {
-              statuses.add_drop(in_flight_packet.id);
-            }
-          }
-          // Packet is not in-flight anymore if [in_flight_packet.id <= ack_sequence_number].
-          m_in_flight_packets.pop();
-        }
+    DeliveryStatuses statuses{};
+    while (!m_in_flight_packets.empty()) {
+      const auto &in_flight_packet = m_in_flight_packets.front();
+      if (in_flight_packet.is_acked) {
+        statuses.add_ack(in_flight_packet.id);
+      } else if (in_flight_packet.id < never_acked_end
+          || in_flight_packet.id + m_max_reorder_distance + 1 < m_acked_packet_end) {
+        // The peer doesn't process packets that are this late, so it won't ack it anymore.
+        statuses.add_drop(in_flight_packet.id);
+      } else {
+        // It may still be acked, once it arrives after the newer packets. Otherwise, it's
+        // dropped once it falls out of the reorder window or it times out.
+        break;
       }
-      return statuses;
+      m_in_flight_packets.pop_front();
+    }
+    return statuses;
+  }
+
+  detail::InFlightPacket<Clock> *find_in_flight_packet(PacketId packet_id) {
+    if (m_in_flight_packets.empty() || packet_id < m_in_flight_packets.front().id) {
+      return nullptr;
+    }
+    usize index = packet_id - m_in_flight_packets.front().id;
+    return index < m_in_flight_packets.size() ? &m_in_flight_packets[index] : nullptr;
+  }
+
+  void update_packet_timeout() {
+    nanoseconds timeout = detail::kInitialPacketTimeout;
+    if (auto rtt = m_rtt_estimator.stats()) {
+      timeout = rtt->smoothed + std::max<nanoseconds>(4 * rtt->variance,
+                                                      detail::kRttVarianceGranularity);
+    }
+    // Doubling stops mattering once the timeout is clamped, so it doesn't overflow.
+    for (u32 i = 0; i < m_timeout_backoff && timeout < m_max_packet_timeout; i++) {
+      timeout *= 2;
     }
+    m_packet_timeout = std::clamp<nanoseconds>(timeout, m_min_packet_timeout, m_max_packet_timeout);
   }
 
   usize process_packet_header(const PacketHeader &header, byte_span buffer) {
-    if (header.id() == m_next_expected_packet_id) {
+    if (header.id() >= m_next_expected_packet_id) {
+      // The packets in [m_next_expected_packet_id, header.id()) haven't been received yet, but
+      // they may still arrive within the reorder window.
+      u32 shift = header.id() + 1 - m_next_expected_packet_id;
+      m_received_bitmask = shift >= sizeof(m_received_bitmask) * 8 ? 0
+                                                                   : m_received_bitmask << shift;
+      m_received_bitmask |= 1;
       add_pending_ack(header.id());
       m_next_expected_packet_id = header.id() + 1;
       return PacketHeader::kSerializedSize;
-    } else if (header.id() < m_next_expected_packet_id) {
-      // The packet is too old. If it's a duplicate, then we have already processed it.
-      // If not, we drop it!
+    }
+    u32 distance = m_next_expected_packet_id - 1 - header.id();
+    u64 bit = u64{1} << std::min<u32>(distance, sizeof(m_received_bitmask) * 8 - 1);
+    if (distance > m_max_reorder_distance || (m_received_bitmask & bit) != 0) {
+      // The packet is a duplicate, or it's too old and has been treated as dropped.
       return 0;
-    } else {
-      assert(header.id() > m_next_expected_packet_id);
-      // Even though we may receive some packets with lower ids in the future, i.e. from range
-      // [m_next_expected_packet_id, header.id()), we treat them as dropped because we are not
-      // going to wait for them.
-      add_pending_ack(header.id());
-      m_next_expected_packet_id = header.id() + 1;
-      return PacketHeader::kSerializedSize;
     }
+    m_received_bitmask |= bit;
+    add_pending_ack(header.id());
+    return PacketHeader::kSerializedSize;
   }
 
   void add_pending_ack(PacketId packet_id) {
@@ -54,7 +54,9 @@ TEST(PacketDeliveryManagerTest, SentPacketIdsAreContinuouslyIncreasing) {
 TEST(PacketDeliveryManagerTest, AcksAndDropsSentPackets) {
   // Irrelevant for the test.
   constexpr u32 kInitialExpectedPacketId = 10;
-  PacketDeliveryManager<FakeClock> manager{kInitialExpectedPacketId};
+  // Without the reorder window, unacked packets older than an acked one are dropped right away.
+  PacketDeliveryManager<FakeClock> manager{kInitialExpectedPacketId, detail::kDefaultPacketTimeout,
+                                           detail::kDefaultMinPacketTimeout, 0};
 
   // Send 30 packets.
   for (PacketId packet_id = 0; packet_id < 30; packet_id++) {
@@ -68,7 +70,7 @@ TEST(PacketDeliveryManagerTest, AcksAndDropsSentPackets) {
   // Packets 15(15+0), 16(15+1), 20(15+5), 23(15+8) and 25(15+10) are acked.
   constexpr u32 kAckBitmask = (1 << 0) | (1 << 1) | (1 << 5) | (1 << 8) | (1 << 10);
   PacketHeader::write(read_buffer, kPacketId, kAckSequenceNumber, kAckBitmask);
-  auto[read_count, delivery_statuses, packet_id] = manager.process_read(read_buffer);
+  auto[read_count, delivery_statuses, packet_id] = manager.process_read(read_buffer, kNow);
   // It doesn't matter if we were able to read the packet(returned [read_count = 0],
   // e.g. if it's too old. We still process the acks.
   ASSERT_THAT(delivery_statuses.to_vector(), ElementsAre(
@@ -104,7 +106,8 @@ TEST(PacketDeliveryManagerTest, AcksAndDropsSentPackets) {
 TEST(PacketDeliveryManagerTest, BoundaryAck) {
   // Irrelevant for the test.
   constexpr PacketId kInitialExpectedPacketId = 10;
-  PacketDeliveryManager<FakeClock> manager{kInitialExpectedPacketId};
+  PacketDeliveryManager<FakeClock> manager{kInitialExpectedPacketId, detail::kDefaultPacketTimeout,
+                                           detail::kDefaultMinPacketTimeout, 0};
 
   // Send 34 packets.
   for (PacketId packet_id = 0; packet_id < 34; packet_id++) {
@@ -118,7 +121,7 @@ TEST(PacketDeliveryManagerTest, BoundaryAck) {
   // Packets 32(0+32).
   constexpr u32 kAckBitmask = (1 << 31);
   PacketHeader::write(read_buffer, kPacketId, kAckSequenceNumber, kAckBitmask);
-  auto[read_count, delivery_statuses, packet_id] = manager.process_read(read_buffer);
+  auto[read_count, delivery_statuses, packet_id] = manager.process_read(read_buffer, kNow);
 
   ASSERT_THAT(delivery_statuses.to_vector(), ElementsAre(
       std::make_pair(0, PacketDeliveryStatus::DROP),
@@ -156,11 +159,50 @@ TEST(PacketDeliveryManagerTest, BoundaryAck) {
   ));
 }
 
+TEST(PacketDeliveryManagerTest, AcksWholeWindow) {
+  PacketDeliveryManager<FakeClock> manager{0, detail::kDefaultPacketTimeout,
+                                           detail::kDefaultMinPacketTimeout, 0};
+  for (PacketId packet_id = 0; packet_id < 70; packet_id++) {
+    auto write_buffer = make_buffer();
+    manager.write(write_buffer, kNow);
+  }
+
+  // Packets 5 and 68(5+63) are acked.
+  auto read_buffer = make_buffer();
+  PacketHeader::write(read_buffer, kPacketId, 5, (AckBitmask{1} << 63) | 1);
+  auto[read_count, delivery_statuses, packet_id] = manager.process_read(read_buffer, kNow);
+  auto statuses = delivery_statuses.to_vector();
+  ASSERT_EQ(statuses.size(), 69);
+  for (PacketId id = 0; id <= 68; id++) {
+    auto expected_status = id == 5 || id == 68 ? PacketDeliveryStatus::ACK
+                                               : PacketDeliveryStatus::DROP;
+    ASSERT_EQ(statuses[id], std::make_pair(id, expected_status));
+  }
+}
+
+TEST(PacketDeliveryManagerTest, PendingAcksBeyondWindowAreWrittenLater) {
+  PacketDeliveryManager<FakeClock> manager{0};
+  for (PacketId packet_id : {0u, 63u, 64u}) {
+    auto buffer = make_buffer();
+    PacketHeader::write(buffer, packet_id, 0, 0);
+    manager.process_read(buffer, kNow);
+  }
+
+  auto buffer = make_buffer();
+  manager.write(buffer, kNow);
+  ASSERT_EQ(PacketHeader(buffer).ack_sequence_number(), 0);
+  ASSERT_EQ(PacketHeader(buffer).ack_bitmask(), (AckBitmask{1} << 63) | 1);
+  manager.write(buffer, kNow);
+  ASSERT_EQ(PacketHeader(buffer).ack_sequence_number(), 64);
+  ASSERT_EQ(PacketHeader(buffer).ack_bitmask(), 1);
+}
+
 TEST(PacketDeliveryManagerTest, PacketsAreDroppedIfNotAckedForSomeTime) {
   // Irrelevant for the test.
   constexpr PacketId kInitialExpectedPacketId = 10;
   const seconds kPacketTimeout = seconds(5);
-  PacketDeliveryManager<FakeClock> manager{kInitialExpectedPacketId, kPacketTimeout};
+  // The timeout is fixed, since the bounds are equal.
+  PacketDeliveryManager<FakeClock> manager{kInitialExpectedPacketId, kPacketTimeout, kPacketTimeout};
 
   // Send 34 packets.
   for (PacketId packet_id = 0; packet_id < 34; packet_id++) {
@@ -191,7 +233,7 @@ TEST(PacketDeliveryManagerTest, ReadsExpectedPackets) {
     auto ack_sequence_number = 0;
     auto ack_bitmask = 0;
     PacketHeader::write(buffer, packet_id, ack_sequence_number, ack_bitmask);
-    auto[read_byte_count, delivery_status_ignored, actual_packet_id] = manager.process_read(buffer);
+    auto[read_byte_count, delivery_status_ignored, actual_packet_id] = manager.process_read(buffer, kNow);
     ASSERT_EQ(read_byte_count, PacketHeader::kSerializedSize);
     ASSERT_EQ(actual_packet_id, packet_id);
   }
@@ -207,7 +249,7 @@ TEST(PacketDeliveryManagerTest, ReadsPacketsAfterExpected) {
   auto ack_sequence_number = 0;
   auto ack_bitmask = 0;
   PacketHeader::write(buffer, packet_id, ack_sequence_number, ack_bitmask);
-  auto[read_byte_count, delivery_status_ignored, actual_packet_id] = manager.process_read(buffer);
+  auto[read_byte_count, delivery_status_ignored, actual_packet_id] = manager.process_read(buffer, kNow);
   ASSERT_EQ(read_byte_count, PacketHeader::kSerializedSize);
   ASSERT_EQ(actual_packet_id, packet_id);
 }
@@ -222,16 +264,151 @@ TEST(PacketDeliveryManagerTest, IgnoresPacketsBeforeExpected) {
   auto ack_sequence_number = 0;
   auto ack_bitmask = 0;
   PacketHeader::write(buffer, packet_id, ack_sequence_number, ack_bitmask);
-  auto[read_byte_count, delivery_status_ignored, actual_packet_id] = manager.process_read(buffer);
+  auto[read_byte_count, delivery_status_ignored, actual_packet_id] = manager.process_read(buffer, kNow);
   ASSERT_EQ(read_byte_count, 0);
   ASSERT_EQ(packet_id, actual_packet_id);
 }
 
-TEST(PacketDeliveryManagerTest, WriteAndReadPacketWithAcks) {
+TEST(PacketDeliveryManagerTest, ReadsLatePacketsWithinReorderWindow) {
+  constexpr PacketId kExpectedPacketId = 10;
+  PacketDeliveryManager<FakeClock> manager{kExpectedPacketId, detail::kDefaultPacketTimeout,
+                                           detail::kDefaultMinPacketTimeout, 4};
+
+  auto read = [&manager](PacketId packet_id) {
+    auto buffer = make_buffer();
+    PacketHeader::write(buffer, packet_id, 0, 0);
+    return std::get<0>(manager.process_read(buffer, kNow));
+  };
+  ASSERT_EQ(read(15), PacketHeader::kSerializedSize);
+  // Late, but within the reorder window.
+  ASSERT_EQ(read(12), PacketHeader::kSerializedSize);
+  ASSERT_EQ(read(11), PacketHeader::kSerializedSize);
+  // Duplicates.
+  ASSERT_EQ(read(12), 0);
+  ASSERT_EQ(read(15), 0);
+  // Too late.
+  ASSERT_EQ(read(10), 0);
+  // Before the first expected packet.
+  ASSERT_EQ(read(9), 0);
+}
+
+TEST(PacketDeliveryManagerTest, LatePacketsAreNotReadWithoutReorderWindow) {
+  constexpr PacketId kExpectedPacketId = 10;
+  PacketDeliveryManager<FakeClock> manager{kExpectedPacketId, detail::kDefaultPacketTimeout,
+                                           detail::kDefaultMinPacketTimeout, 0};
+
+  auto buffer = make_buffer();
+  PacketHeader::write(buffer, 12, 0, 0);
+  ASSERT_EQ(std::get<0>(manager.process_read(buffer, kNow)), PacketHeader::kSerializedSize);
+  PacketHeader::write(buffer, 11, 0, 0);
+  ASSERT_EQ(std::get<0>(manager.process_read(buffer, kNow)), 0);
+}
+
+TEST(PacketDeliveryManagerTest, AcksLatePackets) {
+  auto buffer = make_buffer();
+  PacketDeliveryManager<FakeClock> server{0};
+  PacketDeliveryManager<FakeClock> client{0};
+
+  // Packets 1 and 2 are received before packet 0.
+  std::vector<std::vector<u8>> packets{};
+  for (usize i = 0; i < 3; i++) {
+    packets.push_back(make_buffer());
+    server.write(packets.back(), kNow);
+  }
+  for (auto index : {1, 2, 0}) {
+    auto[read_count, delivery_statuses, packet_id] = client.process_read(packets[index], kNow);
+    ASSERT_EQ(read_count, PacketHeader::kSerializedSize);
+  }
+
+  client.write(buffer, kNow);
+  PacketHeader header{buffer};
+  ASSERT_EQ(header.ack_sequence_number(), 0);
+  ASSERT_EQ(header.ack_bitmask(), 0b111);
+  auto[read_count, delivery_statuses, packet_id] = server.process_read(buffer, kNow);
+  ASSERT_THAT(delivery_statuses.to_vector(),
+              ElementsAre(std::make_pair(0, PacketDeliveryStatus::ACK),
+                          std::make_pair(1, PacketDeliveryStatus::ACK),
+                          std::make_pair(2, PacketDeliveryStatus::ACK)));
+}
+
+TEST(PacketDeliveryManagerTest, ReorderedPacketsAreNotDropped) {
   auto buffer = make_buffer();
   PacketDeliveryManager<FakeClock> server{0};
   PacketDeliveryManager<FakeClock> client{0};
 
+  std::vector<std::vector<u8>> packets{};
+  for (usize i = 0; i < 3; i++) {
+    packets.push_back(make_buffer());
+    server.write(packets.back(), kNow);
+  }
+  // Packets arrive in order 0, 2, 1, and the client acks each of them as it arrives.
+  std::vector<std::pair<PacketId, PacketDeliveryStatus>> statuses{};
+  for (auto index : {0, 2, 1}) {
+    client.process_read(packets[index], kNow);
+    client.write(buffer, kNow);
+    auto[read_count, delivery_statuses, packet_id] = server.process_read(buffer, kNow);
+    for (auto status : delivery_statuses.to_vector()) {
+      statuses.push_back(status);
+    }
+    if (index == 2) {
+      // Packet 2 is only reported once packet 1 is acked, so that the statuses stay in order.
+      ASSERT_THAT(statuses, ElementsAre(std::make_pair(0, PacketDeliveryStatus::ACK)));
+    }
+  }
+  ASSERT_THAT(statuses, ElementsAre(std::make_pair(0, PacketDeliveryStatus::ACK),
+                                    std::make_pair(1, PacketDeliveryStatus::ACK),
+                                    std::make_pair(2, PacketDeliveryStatus::ACK)));
+  ASSERT_FALSE(server.next_timeout());
+}
+
+TEST(PacketDeliveryManagerTest, DropsPacketsOutsideOfReorderWindow) {
+  constexpr u32 kMaxReorderDistance = 2;
+  auto buffer = make_buffer();
+  PacketDeliveryManager<FakeClock> manager{0, detail::kDefaultPacketTimeout,
+                                           detail::kDefaultMinPacketTimeout, kMaxReorderDistance};
+  for (PacketId packet_id = 0; packet_id < 6; packet_id++) {
+    manager.write(buffer, kNow);
+  }
+  PacketHeader::write(buffer, kPacketId, 0, 0b1);
+  ASSERT_THAT(std::get<1>(manager.process_read(buffer, kNow)).to_vector(),
+              ElementsAre(std::make_pair(0, PacketDeliveryStatus::ACK)));
+
+  // Packet 1 is within the reorder window of packet 3.
+  PacketHeader::write(buffer, kPacketId + 1, 3, 0b1);
+  ASSERT_THAT(std::get<1>(manager.process_read(buffer, kNow)).to_vector(), IsEmpty());
+  // But not of packet 4, while packet 2 still is.
+  PacketHeader::write(buffer, kPacketId + 2, 4, 0b1);
+  ASSERT_THAT(std::get<1>(manager.process_read(buffer, kNow)).to_vector(),
+              ElementsAre(std::make_pair(1, PacketDeliveryStatus::DROP)));
+
+  // Timed out packets are dropped, and the acked packets behind them are reported.
+  ASSERT_THAT(manager.drop_old_packets(kNow + detail::kInitialPacketTimeout).to_vector(),
+              ElementsAre(std::make_pair(2, PacketDeliveryStatus::DROP),
+                          std::make_pair(3, PacketDeliveryStatus::ACK),
+                          std::make_pair(4, PacketDeliveryStatus::ACK),
+                          std::make_pair(5, PacketDeliveryStatus::DROP)));
+}
+
+TEST(PacketDeliveryManagerTest, DropsPacketsBeforePeersFirstAck) {
+  auto buffer = make_buffer();
+  PacketDeliveryManager<FakeClock> manager{0};
+  for (PacketId packet_id = 0; packet_id < 3; packet_id++) {
+    manager.write(buffer, kNow);
+  }
+  // The peer has only received packet 1 and newer, e.g. because it has answered packet 0
+  // without keeping any state, so it will never ack packet 0.
+  PacketHeader::write(buffer, kPacketId, 1, 0b1);
+  ASSERT_THAT(std::get<1>(manager.process_read(buffer, kNow)).to_vector(),
+              ElementsAre(std::make_pair(0, PacketDeliveryStatus::DROP),
+                          std::make_pair(1, PacketDeliveryStatus::ACK)));
+}
+
+TEST(PacketDeliveryManagerTest, WriteAndReadPacketWithAcks) {
+  auto buffer = make_buffer();
+  PacketDeliveryManager<FakeClock> server{0, detail::kDefaultPacketTimeout,
+                                          detail::kDefaultMinPacketTimeout, 0};
+  PacketDeliveryManager<FakeClock> client{0};
+
   {
     auto write_count = server.write(buffer, kNow);
     ASSERT_GT(write_count, 0);
@@ -241,7 +418,7 @@ TEST(PacketDeliveryManagerTest, WriteAndReadPacketWithAcks) {
     // Pretend the packet is dropped, and send a new one.
     server.write(buffer, kNow);
     {
-      auto[read_count, delivery_statuses, packet_id] = client.process_read(buffer);
+      auto[read_count, delivery_statuses, packet_id] = client.process_read(buffer, kNow);
       ASSERT_THAT(delivery_statuses.to_vector(), IsEmpty());
       ASSERT_EQ(packet_id, 1);
     }
@@ -249,7 +426,7 @@ TEST(PacketDeliveryManagerTest, WriteAndReadPacketWithAcks) {
     // Client drops packet 0, and acks packet 1.
     client.write(buffer, kNow);
     {
-      auto[write_count, delivery_statuses, packet_id] = server.process_read(buffer);
+      auto[write_count, delivery_statuses, packet_id] = server.process_read(buffer, kNow);
       ASSERT_THAT(delivery_statuses.to_vector(),
                   ElementsAre(std::make_pair(0, PacketDeliveryStatus::DROP),
                               std::make_pair(1, PacketDeliveryStatus::ACK)));
@@ -264,4 +441,92 @@ TEST(PacketDeliveryManagerTest, PeerAcksPacketThatWeHaventSent) {
   // Let's say client acks packet 10.
   // Malicious client.
   FAIL();
-}
\ No newline at end of file
+}
+
+TEST(PacketDeliveryManagerTest, NextTimeoutIsOldestInFlightPacket) {
+  constexpr milliseconds kPacketTimeout{100};
+  auto buffer = make_buffer();
+  PacketDeliveryManager<FakeClock> manager{kPacketId, kPacketTimeout};
+  ASSERT_FALSE(manager.next_timeout());
+
+  manager.write(buffer, kNow);
+  manager.write(buffer, kNow + milliseconds(30));
+  ASSERT_EQ(manager.next_timeout(), kNow + kPacketTimeout);
+
+  manager.drop_old_packets(kNow + kPacketTimeout);
+  ASSERT_EQ(manager.next_timeout(), kNow + milliseconds(30) + kPacketTimeout);
+
+  manager.drop_old_packets(kNow + milliseconds(30) + kPacketTimeout);
+  ASSERT_FALSE(manager.next_timeout());
+}
+
+TEST(PacketDeliveryManagerTest, MeasuresRttOfHighestAckedPacket) {
+  auto buffer = make_buffer();
+  PacketDeliveryManager<FakeClock> manager{kPacketId};
+  ASSERT_FALSE(manager.rtt_stats());
+
+  manager.write(buffer, kNow);
+  manager.write(buffer, kNow + milliseconds(10));
+  // Both packets are acked, but packet 0 has waited at the peer for longer.
+  PacketHeader::write(buffer, kPacketId, 0, 0b11);
+  manager.process_read(buffer, kNow + milliseconds(50));
+  auto rtt_stats = manager.rtt_stats();
+  ASSERT_TRUE(rtt_stats);
+  ASSERT_EQ(rtt_stats->latest, milliseconds(40));
+  ASSERT_EQ(rtt_stats->sample_count, 1);
+
+  // Acks that have already been processed are not sampled again.
+  PacketHeader::write(buffer, kPacketId + 1, 0, 0b11);
+  manager.process_read(buffer, kNow + milliseconds(80));
+  ASSERT_EQ(manager.rtt_stats()->sample_count, 1);
+
+  manager.write(buffer, kNow + milliseconds(100));
+  PacketHeader::write(buffer, kPacketId + 2, 2, 0b1);
+  manager.process_read(buffer, kNow + milliseconds(120));
+  rtt_stats = manager.rtt_stats();
+  ASSERT_EQ(rtt_stats->latest, milliseconds(20));
+  ASSERT_EQ(rtt_stats->min, milliseconds(20));
+  ASSERT_EQ(rtt_stats->sample_count, 2);
+}
+
+TEST(PacketDeliveryManagerTest, PacketTimeoutAdaptsToRtt) {
+  auto buffer = make_buffer();
+  PacketDeliveryManager<FakeClock> manager{kPacketId, seconds(5), milliseconds(50)};
+  ASSERT_EQ(manager.packet_timeout(), freezing::network::detail::kInitialPacketTimeout);
+
+  // RTT of 100ms: the timeout is 100ms + 4 * 50ms.
+  manager.write(buffer, kNow);
+  PacketHeader::write(buffer, kPacketId, 0, 0b1);
+  manager.process_read(buffer, kNow + milliseconds(100));
+  ASSERT_EQ(manager.packet_timeout(), milliseconds(300));
+
+  manager.write(buffer, kNow + seconds(1));
+  ASSERT_EQ(manager.next_timeout(), kNow + seconds(1) + milliseconds(300));
+  ASSERT_THAT(manager.drop_old_packets(kNow + seconds(1) + milliseconds(299)).to_vector(), IsEmpty());
+  ASSERT_THAT(manager.drop_old_packets(kNow + seconds(1) + milliseconds(300)).to_vector(),
+              ElementsAre(std::make_pair(1, PacketDeliveryStatus::DROP)));
+
+  // Every timeout doubles the timeout, up to the upper bound.
+  ASSERT_EQ(manager.packet_timeout(), milliseconds(600));
+  for (u32 packet_id = 2; packet_id < 10; packet_id++) {
+    manager.write(buffer, kNow + seconds(10 * packet_id));
+    manager.drop_old_packets(kNow + seconds(10 * packet_id + 5));
+  }
+  ASSERT_EQ(manager.packet_timeout(), seconds(5));
+
+  // The next ack resets the backoff.
+  manager.write(buffer, kNow + seconds(100));
+  PacketHeader::write(buffer, kPacketId + 1, 10, 0b1);
+  manager.process_read(buffer, kNow + seconds(100) + milliseconds(100));
+  ASSERT_LT(manager.packet_timeout(), milliseconds(300));
+  ASSERT_GE(manager.packet_timeout(), milliseconds(100));
+}
+
+TEST(PacketDeliveryManagerTest, PacketTimeoutLowerBound) {
+  auto buffer = make_buffer();
+  PacketDeliveryManager<FakeClock> manager{kPacketId, seconds(5), milliseconds(50)};
+  manager.write(buffer, kNow);
+  PacketHeader::write(buffer, kPacketId, 0, 0b1);
+  manager.process_read(buffer, kNow + milliseconds(1));
+  ASSERT_EQ(manager.packet_timeout(), milliseconds(50));
+}
@@ -0,0 +1,255 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NEPTUN_PEER_TABLE_H
+#define NEPTUN_NEPTUN_PEER_TABLE_H
+
+#include <cassert>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "common/types.h"
+#include "network/ip_address.h"
+
+namespace freezing::network {
+
+// Refers to a peer in [PeerTable]. Unlike references, handles remain valid when the table
+// grows, and a handle to a removed peer is detected instead of referring to another peer.
+struct PeerHandle {
+  u32 index;
+  u32 generation;
+
+  bool operator==(const PeerHandle &) const = default;
+};
+
+// Open addressing hash table from the peer's IP address to [Value].
+// Peers are stored densely in insertion slots, and the hash table only stores the packed
+// IP address and the slot index, so lookups touch a single cache line in the common case.
+// Iteration order is the slot order, which isn't sorted by IP address.
+template<typename Value>
+class PeerTable {
+  using Entry = std::pair<const IpAddress, Value>;
+
+public:
+  class Iterator {
+  public:
+    Iterator(std::vector<std::optional<Entry>> &entries, usize index)
+        : m_entries{entries}, m_index{index} {
+      skip_removed();
+    }
+
+    Entry &operator*() const {
+      return *m_entries[m_index];
+    }
+
+    Entry *operator->() const {
+      return &*m_entries[m_index];
+    }
+
+    Iterator &operator++() {
+      m_index++;
+      skip_removed();
+      return *this;
+    }
+
+    bool operator==(const Iterator &other) const {
+      return m_index == other.m_index;
+    }
+
+  private:
+    std::vector<std::optional<Entry>> &m_entries;
+    usize m_index;
+
+    void skip_removed() {
+      while (m_index < m_entries.size() && !m_entries[m_index]) {
+        m_index++;
+      }
+    }
+  };
+
+  explicit PeerTable(usize initial_capacity = 16) : m_buckets(bucket_count_for(initial_capacity)) {}
+
+  [[nodiscard]] std::optional<PeerHandle> find(IpAddress ip) const {
+    u64 key = ip.packed();
+    for (usize i = bucket_index(key);; i = (i + 1) & (m_buckets.size() - 1)) {
+      const auto &bucket = m_buckets[i];
+      if (bucket.slot == kEmptySlot) {
+        return {};
+      }
+      if (bucket.slot != kRemovedSlot && bucket.key == key) {
+        return {PeerHandle{bucket.slot, m_generations[bucket.slot]}};
+      }
+    }
+  }
+
+  // Returns the handle to the peer with the given [ip], inserting [make_value()] if there is
+  // no such peer. The second element is true if the peer has been inserted.
+  template<typename MakeValueFn>
+  std::pair<PeerHandle, bool> find_or_insert(IpAddress ip, MakeValueFn make_value) {
+    u64 key = ip.packed();
+    std::optional<usize> first_removed{};
+    usize i = bucket_index(key);
+    for (;; i = (i + 1) & (m_buckets.size() - 1)) {
+      const auto &bucket = m_buckets[i];
+      if (bucket.slot == kEmptySlot) {
+        break;
+      }
+      if (bucket.slot == kRemovedSlot) {
+        if (!first_removed) {
+          first_removed = i;
+        }
+      } else if (bucket.key == key) {
+        return {PeerHandle{bucket.slot, m_generations[bucket.slot]}, false};
+      }
+    }
+
+    u32 slot = allocate_slot(ip, make_value());
+    if (first_removed) {
+      // Reuse the tombstone, which doesn't change the number of used buckets.
+      m_buckets[*first_removed] = {key, slot};
+      m_removed_count--;
+    } else {
+      m_buckets[i] = {key, slot};
+    }
+    m_size++;
+    if ((m_size + m_removed_count) * kMaxLoadDenominator
+        > m_buckets.size() * kMaxLoadNumerator) {
+      rehash(bucket_count_for(m_size));
+    }
+    return {PeerHandle{slot, m_generations[slot]}, true};
+  }
+
+  [[nodiscard]] bool contains(PeerHandle handle) const {
+    return handle.index < m_entries.size() && m_entries[handle.index]
+        && m_generations[handle.index] == handle.generation;
+  }
+
+  // Returns the peer for a valid [handle].
+  Value &get(PeerHandle handle) {
+    assert(contains(handle));
+    return m_entries[handle.index]->second;
+  }
+
+  const Value &get(PeerHandle handle) const {
+    assert(contains(handle));
+    return m_entries[handle.index]->second;
+  }
+
+  [[nodiscard]] IpAddress ip(PeerHandle handle) const {
+    assert(contains(handle));
+    return m_entries[handle.index]->first;
+  }
+
+  // Removes the peer and invalidates all of its handles.
+  // Returns false if there is no such peer.
+  bool erase(IpAddress ip) {
+    u64 key = ip.packed();
+    for (usize i = bucket_index(key);; i = (i + 1) & (m_buckets.size() - 1)) {
+      auto &bucket = m_buckets[i];
+      if (bucket.slot == kEmptySlot) {
+        return false;
+      }
+      if (bucket.slot != kRemovedSlot && bucket.key == key) {
+        u32 slot = bucket.slot;
+        m_entries[slot].reset();
+        m_generations[slot]++;
+        m_free_slots.push_back(slot);
+        bucket.slot = kRemovedSlot;
+        m_removed_count++;
+        m_size--;
+        return true;
+      }
+    }
+  }
+
+  [[nodiscard]] usize size() const {
+    return m_size;
+  }
+
+  [[nodiscard]] bool empty() const {
+    return m_size == 0;
+  }
+
+  Iterator begin() {
+    return Iterator{m_entries, 0};
+  }
+
+  Iterator end() {
+    return Iterator{m_entries, m_entries.size()};
+  }
+
+private:
+  static constexpr u32 kEmptySlot = std::numeric_limits<u32>::max();
+  static constexpr u32 kRemovedSlot = kEmptySlot - 1;
+  // Buckets are rehashed when more than 3/4 of them are used (including the removed ones).
+  static constexpr usize kMaxLoadNumerator = 3;
+  static constexpr usize kMaxLoadDenominator = 4;
+
+  struct Bucket {
+    u64 key{0};
+    u32 slot{kEmptySlot};
+  };
+
+  std::vector<Bucket> m_buckets;
+  std::vector<std::optional<Entry>> m_entries{};
+  // Incremented every time a slot is freed, so that stale handles can be detected.
+  std::vector<u32> m_generations{};
+  std::vector<u32> m_free_slots{};
+  usize m_size{0};
+  usize m_removed_count{0};
+
+  // Power of two number of buckets that keeps [size] peers below half of the max load.
+  static usize bucket_count_for(usize size) {
+    usize bucket_count = 16;
+    while (size * kMaxLoadDenominator * 2 > bucket_count * kMaxLoadNumerator) {
+      bucket_count *= 2;
+    }
+    return bucket_count;
+  }
+
+  static usize bucket_index(u64 key, usize bucket_count) {
+    // Fibonacci hashing: the multiplication mixes all bits of the key into the high bits, which
+    // also spreads ports of the same IP address across the table.
+    return static_cast<usize>((key * 0x9E3779B97F4A7C15ull) >> 32) & (bucket_count - 1);
+  }
+
+  usize bucket_index(u64 key) const {
+    return bucket_index(key, m_buckets.size());
+  }
+
+  u32 allocate_slot(IpAddress ip, Value value) {
+    if (!m_free_slots.empty()) {
+      u32 slot = m_free_slots.back();
+      m_free_slots.pop_back();
+      m_entries[slot].emplace(ip, std::move(value));
+      return slot;
+    }
+    assert(m_entries.size() < kRemovedSlot);
+    m_entries.emplace_back(std::in_place, ip, std::move(value));
+    m_generations.push_back(0);
+    return static_cast<u32>(m_entries.size() - 1);
+  }
+
+  void rehash(usize bucket_count) {
+    std::vector<Bucket> buckets(bucket_count);
+    for (const auto &bucket : m_buckets) {
+      if (bucket.slot == kEmptySlot || bucket.slot == kRemovedSlot) {
+        continue;
+      }
+      usize i = bucket_index(bucket.key, bucket_count);
+      while (buckets[i].slot != kEmptySlot) {
+        i = (i + 1) & (bucket_count - 1);
+      }
+      buckets[i] = bucket;
+    }
+    m_buckets = std::move(buckets);
+    m_removed_count = 0;
+  }
+};
+
+}
+
+#endif //NEPTUN_NEPTUN_PEER_TABLE_H
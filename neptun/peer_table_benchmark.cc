@@ -0,0 +1,143 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+// Compares the peer table with the std::map it replaced, for the two operations Neptun does on
+// every tick: a lookup per received packet and a pass over all peers.
+// Peers are stand-ins of roughly the size of the per-peer state that is touched on every tick,
+// because real peers carry multi-kilobyte stream buffers.
+// Usage: bin_peer_table_benchmark
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "neptun/peer_table.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+
+constexpr usize kLookupCount = 2'000'000;
+constexpr usize kTickPeerVisits = 20'000'000;
+
+struct BenchmarkPeer {
+  u64 ticks{0};
+  std::array<u8, 184> state{};
+};
+
+struct Result {
+  double lookup_ns;
+  double tick_ns;
+};
+
+std::vector<IpAddress> make_ips(usize peer_count) {
+  std::vector<IpAddress> ips{};
+  std::mt19937 rng{42};
+  for (usize i = 0; i < peer_count; i++) {
+    // Clients behind the same NAT share the IP address, but not the port.
+    ips.push_back(IpAddress::from_u32(0x0A000000 + static_cast<u32>(rng() % (peer_count / 4 + 1)),
+                                      static_cast<u16>(10000 + i)));
+  }
+  return ips;
+}
+
+// Sequence of senders of the received packets.
+std::vector<IpAddress> make_lookups(const std::vector<IpAddress> &ips) {
+  std::vector<IpAddress> lookups{};
+  std::mt19937 rng{7};
+  for (usize i = 0; i < kLookupCount; i++) {
+    lookups.push_back(ips[rng() % ips.size()]);
+  }
+  return lookups;
+}
+
+template<typename Fn>
+double elapsed_ns(Fn fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+Result run_map(const std::vector<IpAddress> &ips, const std::vector<IpAddress> &lookups) {
+  std::map<IpAddress, BenchmarkPeer> peers{};
+  for (auto ip : ips) {
+    peers.insert({ip, BenchmarkPeer{}});
+  }
+  u64 checksum = 0;
+  // The old [find_or_create_peer] did [contains] followed by [find].
+  double lookup_ns = elapsed_ns([&]() {
+    for (auto ip : lookups) {
+      if (!peers.contains(ip)) {
+        peers.insert({ip, BenchmarkPeer{}});
+      }
+      checksum += ++peers.find(ip)->second.ticks;
+    }
+  });
+  usize tick_count = std::max<usize>(1, kTickPeerVisits / ips.size());
+  double tick_ns = elapsed_ns([&]() {
+    for (usize i = 0; i < tick_count; i++) {
+      for (auto&[ip, peer] : peers) {
+        checksum += ++peer.ticks;
+      }
+    }
+  });
+  // Prevents the compiler from optimizing the loops away.
+  if (checksum == 0) {
+    std::cout << "unexpected checksum" << std::endl;
+  }
+  return {lookup_ns / static_cast<double>(lookups.size()),
+          tick_ns / static_cast<double>(tick_count)};
+}
+
+Result run_peer_table(const std::vector<IpAddress> &ips, const std::vector<IpAddress> &lookups) {
+  PeerTable<BenchmarkPeer> peers{};
+  for (auto ip : ips) {
+    peers.find_or_insert(ip, []() { return BenchmarkPeer{}; });
+  }
+  u64 checksum = 0;
+  double lookup_ns = elapsed_ns([&]() {
+    for (auto ip : lookups) {
+      auto handle = peers.find_or_insert(ip, []() { return BenchmarkPeer{}; }).first;
+      checksum += ++peers.get(handle).ticks;
+    }
+  });
+  usize tick_count = std::max<usize>(1, kTickPeerVisits / ips.size());
+  double tick_ns = elapsed_ns([&]() {
+    for (usize i = 0; i < tick_count; i++) {
+      for (auto&[ip, peer] : peers) {
+        checksum += ++peer.ticks;
+      }
+    }
+  });
+  if (checksum == 0) {
+    std::cout << "unexpected checksum" << std::endl;
+  }
+  return {lookup_ns / static_cast<double>(lookups.size()),
+          tick_ns / static_cast<double>(tick_count)};
+}
+
+}
+
+int main() {
+  for (usize peer_count : {100, 10'000, 100'000}) {
+    auto ips = make_ips(peer_count);
+    auto lookups = make_lookups(ips);
+    auto map_result = run_map(ips, lookups);
+    auto table_result = run_peer_table(ips, lookups);
+    std::cout << peer_count << " peers:" << std::endl;
+    std::cout << "  std::map    lookup " << map_result.lookup_ns << " ns, tick "
+              << map_result.tick_ns / 1000.0 << " us" << std::endl;
+    std::cout << "  PeerTable   lookup " << table_result.lookup_ns << " ns, tick "
+              << table_result.tick_ns / 1000.0 << " us" << std::endl;
+  }
+  return 0;
+}
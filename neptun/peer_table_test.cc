@@ -0,0 +1,100 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+
+#include "common/types.h"
+#include "neptun/peer_table.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+const IpAddress kIp = IpAddress::from_ipv4("192.168.0.10", 1000);
+// Same IP, different port.
+const IpAddress kOtherPortIp = IpAddress::from_ipv4("192.168.0.10", 1001);
+}
+
+TEST(PeerTableTest, FindOrInsert) {
+  PeerTable<std::string> peers{};
+  ASSERT_FALSE(peers.find(kIp));
+
+  auto[handle, inserted] = peers.find_or_insert(kIp, []() { return "first"; });
+  ASSERT_TRUE(inserted);
+  ASSERT_EQ(peers.get(handle), "first");
+  ASSERT_EQ(peers.ip(handle), kIp);
+
+  auto[same_handle, inserted_again] = peers.find_or_insert(kIp, []() { return "second"; });
+  ASSERT_FALSE(inserted_again);
+  ASSERT_EQ(same_handle, handle);
+  ASSERT_EQ(peers.get(same_handle), "first");
+
+  ASSERT_FALSE(peers.find(kOtherPortIp));
+  ASSERT_EQ(peers.find(kIp), handle);
+  ASSERT_EQ(peers.size(), 1);
+}
+
+TEST(PeerTableTest, HandlesAreStableWhenTableGrows) {
+  constexpr u32 kNumPeers = 10000;
+
+  PeerTable<u32> peers{};
+  std::vector<PeerHandle> handles{};
+  for (u32 i = 0; i < kNumPeers; i++) {
+    handles.push_back(peers.find_or_insert(IpAddress::from_u32(i / 4, 1000 + i % 4),
+                                           [i]() { return i; }).first);
+  }
+  ASSERT_EQ(peers.size(), kNumPeers);
+  for (u32 i = 0; i < kNumPeers; i++) {
+    ASSERT_TRUE(peers.contains(handles[i]));
+    ASSERT_EQ(peers.get(handles[i]), i);
+    ASSERT_EQ(peers.find(IpAddress::from_u32(i / 4, 1000 + i % 4)), handles[i]);
+  }
+}
+
+TEST(PeerTableTest, EraseInvalidatesHandles) {
+  PeerTable<std::string> peers{};
+  auto handle = peers.find_or_insert(kIp, []() { return "first"; }).first;
+  auto other_handle = peers.find_or_insert(kOtherPortIp, []() { return "other"; }).first;
+
+  ASSERT_TRUE(peers.erase(kIp));
+  ASSERT_FALSE(peers.erase(kIp));
+  ASSERT_FALSE(peers.contains(handle));
+  ASSERT_FALSE(peers.find(kIp));
+  ASSERT_EQ(peers.find(kOtherPortIp), other_handle);
+
+  // The slot is reused, but the old handle still doesn't refer to the new peer.
+  auto new_handle = peers.find_or_insert(kIp, []() { return "second"; }).first;
+  ASSERT_EQ(new_handle.index, handle.index);
+  ASSERT_FALSE(peers.contains(handle));
+  ASSERT_EQ(peers.get(new_handle), "second");
+  ASSERT_EQ(peers.size(), 2);
+}
+
+TEST(PeerTableTest, IterateSkipsErasedPeers) {
+  PeerTable<u32> peers{};
+  for (u32 i = 0; i < 100; i++) {
+    peers.find_or_insert(IpAddress::from_u32(i, 1000), [i]() { return i; });
+  }
+  // Insert and erase enough peers to leave tombstones and trigger a rehash.
+  for (u32 i = 0; i < 1000; i++) {
+    peers.find_or_insert(IpAddress::from_u32(1000 + i, 1000), [i]() { return i; });
+    ASSERT_TRUE(peers.erase(IpAddress::from_u32(1000 + i, 1000)));
+  }
+  for (u32 i = 0; i < 100; i += 2) {
+    ASSERT_TRUE(peers.erase(IpAddress::from_u32(i, 1000)));
+  }
+
+  std::set<u32> values{};
+  for (auto&[ip, value] : peers) {
+    ASSERT_EQ(ip, IpAddress::from_u32(value, 1000));
+    values.insert(value);
+  }
+  ASSERT_EQ(values.size(), 50);
+  ASSERT_EQ(peers.size(), 50);
+  for (u32 value : values) {
+    ASSERT_EQ(value % 2, 1);
+  }
+}
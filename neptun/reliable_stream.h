@@ -5,13 +5,14 @@
 #ifndef NEPTUN_NEPTUN_MESSAGES_RELIABLE_STREAM_H
 #define NEPTUN_NEPTUN_MESSAGES_RELIABLE_STREAM_H
 
+#include <algorithm>
+#include <deque>
+#include <limits>
 #include <map>
-#include <stack>
-#include <queue>
 #include <vector>
 
 #include "common/types.h"
-#include "common/flip_buffer.h"
+#include "common/ring_buffer.h"
 #include "neptun/common.h"
 #include "network/network.h"
 #include "network/udp_socket.h"
@@ -22,66 +23,69 @@
 
 namespace freezing::network {
 
-struct BufferRange {
-  usize begin;
-  usize end;
-
-  BufferRange &operator-=(usize value) {
-    assert(begin >= value);
-    assert(end >= value);
-    begin -= value;
-    end -= value;
-    return *this;
-  }
-
-  usize size() const {
-    assert(begin <= end);
-    return end - begin;
-  }
-};
+namespace detail {
+constexpr usize kDefaultReliableStreamCapacity = 3200;
+}
 
-struct PendingMessage {
-  BufferRange range;
+// A message that has been sent by the user, but hasn't been acked by the peer yet.
+struct UnackedMessage {
+  // Offset of the payload in the [RingBuffer].
+  u64 offset;
+  usize size;
   u32 sequence_number;
+  // Payload bytes of all messages up to and including this one, which bounds how many bytes of
+  // the messages after an unacked message the receiver may have to hold.
+  u64 stream_offset;
+  // Acked messages are kept until all previous messages are acked, because their buffer can
+  // only be released in order.
+  bool is_acked{false};
 };
 
 struct InFlightMessage {
   PacketId packet_id;
-  PendingMessage message;
+  u32 sequence_number;
 };
 
-// TODO: Can handle dropped messages more efficiently, e.g. by having a window of reliable messages
-// that are acked and only resending the ones that are dropped.
-// This is required on the sender and on the receiver side.
+// Delivers messages reliably and in order.
+// Each message is tracked by the packet that carries it, and only the messages of a dropped
+// packet are resent, in sequence order. The receiver holds messages that arrive ahead of a gap
+// in a receive window until the gap is filled, since the sender doesn't resend them.
+// The messages held by the receiver are never acked by the sender's peer in order, so they are
+// all still in the sender's buffer. A receive window of at least the peer's buffer capacity is
+// therefore never full, unless the peer misbehaves.
+// A sender that knows the peer's receive window only writes the messages that still fit into it
+// if the oldest unacked message is lost, see [set_peer_receive_window].
 class ReliableStream {
 public:
-  explicit ReliableStream(usize buffer_capacity = 3200) : m_buffer(buffer_capacity) {}
+  explicit ReliableStream(usize buffer_capacity = detail::kDefaultReliableStreamCapacity)
+      : ReliableStream(buffer_capacity, buffer_capacity) {}
 
+  ReliableStream(usize buffer_capacity, usize receive_window_capacity)
+      : m_buffer(buffer_capacity), m_receive_window_capacity{receive_window_capacity} {}
+
+  // Statuses must be reported in packet order, which [PacketDeliveryManager] guarantees.
   void on_packet_delivery_status(PacketId packet_id, PacketDeliveryStatus status) {
-    switch (status) {
-    case PacketDeliveryStatus::ACK:
-      while (!in_flight_messages.empty() && in_flight_messages.front().packet_id == packet_id) {
-        m_buffer.consume(in_flight_messages.front().message.range.size());
-        in_flight_messages.pop();
-      }
-      assert(in_flight_messages.empty() || in_flight_messages.front().packet_id > packet_id);
-      break;
-    case PacketDeliveryStatus::DROP:
-      // TODO: This assertion happens when a few processes run for a very long time.
-      assert(in_flight_messages.empty() || in_flight_messages.front().packet_id >= packet_id);
-      std::stack<PendingMessage> reversed_messages;
-      while (!in_flight_messages.empty()) {
-        reversed_messages.push(in_flight_messages.front().message);
-        in_flight_messages.pop();
+    while (!m_in_flight_messages.empty() && m_in_flight_messages.front().packet_id <= packet_id) {
+      auto in_flight_message = m_in_flight_messages.front();
+      m_in_flight_messages.pop_front();
+      // A packet that is older than [packet_id] and still in flight won't get a status anymore,
+      // so it's treated as dropped.
+      if (in_flight_message.packet_id == packet_id && status == PacketDeliveryStatus::ACK) {
+        unacked_message(in_flight_message.sequence_number).is_acked = true;
+      } else {
+        m_requeued_messages.push_back(in_flight_message.sequence_number);
       }
-      while (!reversed_messages.empty()) {
-        pending_messages.push_front(reversed_messages.top());
-        reversed_messages.pop();
-      }
-      break;
+    }
+    requeue_dropped_messages();
+    while (!m_unacked_messages.empty() && m_unacked_messages.front().is_acked) {
+      auto &message = m_unacked_messages.front();
+      m_buffer.release(message.offset + message.size);
+      m_unacked_messages.pop_front();
     }
   }
 
+  // Returns [NeptunError::RECEIVE_WINDOW_FULL] if a message ahead of a gap doesn't fit the
+  // receive window. The messages before it have been read.
   template<typename ReliableMessageCallback>
   // TODO: Instead of a callback, maybe return a list of spans that represent reliable messages?
   expected<usize, NeptunError> read(PacketId packet_id, byte_span buffer, ReliableMessageCallback callback) {
@@ -113,9 +117,23 @@ public:
 
       // It's important that we process all messages so that the buffer pointer is updated
       // correctly.
-      if (reliable_message.sequence_number() == m_next_expected_sequence_number) {
+      auto sequence_number = reliable_message.sequence_number();
+      if (sequence_number == m_next_expected_sequence_number) {
         m_next_expected_sequence_number++;
         callback(reliable_message.payload());
+        deliver_early_messages(callback);
+      } else if (sequence_number > m_next_expected_sequence_number
+          && !m_early_messages.contains(sequence_number)) {
+        // Held until the gap before it is filled.
+        auto payload = reliable_message.payload();
+        // Every message has a payload, so a well-behaved peer can't be further ahead than the
+        // window's capacity either.
+        if (sequence_number - m_next_expected_sequence_number > m_receive_window_capacity
+            || m_receive_window_size + payload.size() > m_receive_window_capacity) {
+          return make_error(NeptunError::RECEIVE_WINDOW_FULL);
+        }
+        m_early_messages.try_emplace(sequence_number, payload.begin(), payload.end());
+        m_receive_window_size += payload.size();
       }
     }
     return idx;
@@ -125,8 +143,13 @@ public:
     // Figure out how many messages can we write.
     usize total_size = Segment::kSerializedSize;
     usize message_count = 0;
-    for (auto pending_msg : pending_messages) {
-      auto payload = buffer_span(pending_msg.range);
+    for (auto sequence_number : m_pending_messages) {
+      auto &message = unacked_message(sequence_number);
+      if (!fits_peer_receive_window(message)) {
+        // Pending messages are in sequence order, so none of the later ones fit either.
+        break;
+      }
+      auto payload = payload_of(message);
       const usize msg_size = ReliableMessage::serialized_size(payload.size());
       if (total_size + msg_size > buffer.size()) {
         break;
@@ -144,13 +167,13 @@ public:
 
     usize idx = segment.size();
     for (usize i = 0; i < message_count; i++) {
-      auto pending_msg = pending_messages.front();
-      auto payload = buffer_span(pending_msg.range);
-      pending_messages.pop_front();
-      in_flight_messages.push({packet_id, pending_msg});
+      auto sequence_number = m_pending_messages.front();
+      auto payload = payload_of(unacked_message(sequence_number));
+      m_pending_messages.pop_front();
+      m_in_flight_messages.push_back({packet_id, sequence_number});
 
       auto reliable_message_buffer = ReliableMessage::write(advance(buffer, idx),
-                             pending_msg.sequence_number,
+                             sequence_number,
                              payload.size(),
                              payload);
 
@@ -164,49 +187,117 @@ public:
 
   template<typename WriteToBufferFn>
   void send(WriteToBufferFn write_to_buffer) {
-    maybe_flip();
     // TODO: It's a nicer API for the user if [write_to_buffer] returns [usize].
     auto payload = write_to_buffer(m_buffer.remaining());
     if (!payload.empty()) {
       auto sequence_number = m_next_outgoing_sequence_number++;
-      pending_messages.push_back({m_buffer.end_index(), m_buffer.end_index() + payload.size(),
-                                  sequence_number});
-      m_buffer.advance(payload.size());
+      auto offset = m_buffer.advance(payload.size());
+      m_stream_offset += payload.size();
+      m_unacked_messages.push_back({offset, payload.size(), sequence_number, m_stream_offset});
+      m_pending_messages.push_back(sequence_number);
     }
   }
 
+  // Whether there are messages that haven't been written to a packet yet, either because they
+  // didn't fit or because they have been dropped and must be resent.
+  // Messages that wait for the peer's receive window to open up aren't pending.
+  bool has_pending_messages() const {
+    return !m_pending_messages.empty()
+        && fits_peer_receive_window(unacked_message(m_pending_messages.front()));
+  }
+
+  // Bytes that [write] needs to write the next pending message, or 0 if there is none.
+  usize next_write_size() const {
+    if (!has_pending_messages()) {
+      return 0;
+    }
+    const auto &message = unacked_message(m_pending_messages.front());
+    return Segment::kSerializedSize + ReliableMessage::serialized_size(message.size);
+  }
+
+  // Limits the messages that are written ahead of the oldest unacked message to the peer's
+  // receive window of [capacity] bytes, so that the peer can hold all of them if the oldest
+  // one is lost.
+  void set_peer_receive_window(usize capacity) {
+    m_peer_receive_window_capacity = capacity;
+  }
+
+  // Number of payload bytes held in the receive window.
+  usize receive_window_size() const {
+    return m_receive_window_size;
+  }
+
 private:
-  FlipBuffer<u8> m_buffer;
-  std::queue<InFlightMessage> in_flight_messages;
-  std::deque<PendingMessage> pending_messages;
+  // Payloads of the unacked messages.
+  RingBuffer<u8> m_buffer;
+  // In sequence order, without gaps.
+  std::deque<UnackedMessage> m_unacked_messages;
+  // Sequence numbers of the messages to write, in sequence order.
+  std::deque<u32> m_pending_messages;
+  // In packet order.
+  std::deque<InFlightMessage> m_in_flight_messages;
+  // Sequence numbers of the dropped messages, kept to avoid allocating on every drop.
+  std::vector<u32> m_requeued_messages;
   u32 m_next_outgoing_sequence_number{0};
   u32 m_next_expected_sequence_number{0};
+  // Receive window of the messages received ahead of [m_next_expected_sequence_number].
+  std::map<u32, std::vector<u8>> m_early_messages;
+  usize m_receive_window_capacity;
+  usize m_receive_window_size{0};
+  usize m_peer_receive_window_capacity{std::numeric_limits<usize>::max()};
+  u64 m_stream_offset{0};
 
-  byte_span buffer_span(BufferRange range) {
-    return {m_buffer.begin() + range.begin, m_buffer.begin() + range.end};
+  UnackedMessage &unacked_message(u32 sequence_number) {
+    assert(!m_unacked_messages.empty());
+    usize index = sequence_number - m_unacked_messages.front().sequence_number;
+    assert(index < m_unacked_messages.size());
+    return m_unacked_messages[index];
   }
 
-  void maybe_flip() {
-    if (m_buffer.begin_index() > 0) {
-      // A "creative" solution:
-      // Pop each element from the queue and put it back.
-      // Repeat that queue.size() times, and we have effectively iterated over the elements in the
-      // queue.
-      for (usize i = 0; i < in_flight_messages.size(); i++) {
-        auto in_flight_msg = in_flight_messages.front();
-        in_flight_messages.pop();
-        in_flight_msg.message.range -= m_buffer.begin_index();
-        in_flight_messages.push(in_flight_msg);
-      }
+  const UnackedMessage &unacked_message(u32 sequence_number) const {
+    return const_cast<ReliableStream *>(this)->unacked_message(sequence_number);
+  }
 
-      for (auto &pending_msg : pending_messages) {
-        pending_msg.range -= m_buffer.begin_index();
-      }
+  // The peer holds at most the messages after the oldest unacked one, because it has either
+  // delivered the oldest one already or waits for it.
+  bool fits_peer_receive_window(const UnackedMessage &message) const {
+    const auto &oldest = m_unacked_messages.front();
+    return message.sequence_number - oldest.sequence_number <= m_peer_receive_window_capacity
+        && message.stream_offset - oldest.stream_offset <= m_peer_receive_window_capacity;
+  }
+
+  // Merges [m_requeued_messages] into the pending messages, so that the dropped messages are
+  // written before any later message.
+  void requeue_dropped_messages() {
+    if (m_requeued_messages.empty()) {
+      return;
+    }
+    std::sort(m_requeued_messages.begin(), m_requeued_messages.end());
+    usize middle = m_pending_messages.size();
+    m_pending_messages.insert(m_pending_messages.end(),
+                              m_requeued_messages.begin(),
+                              m_requeued_messages.end());
+    std::inplace_merge(m_pending_messages.begin(),
+                       m_pending_messages.begin() + middle,
+                       m_pending_messages.end());
+    m_requeued_messages.clear();
+  }
 
-      m_buffer.flip();
+  template<typename ReliableMessageCallback>
+  void deliver_early_messages(ReliableMessageCallback &callback) {
+    auto it = m_early_messages.begin();
+    while (it != m_early_messages.end() && it->first == m_next_expected_sequence_number) {
+      m_next_expected_sequence_number++;
+      m_receive_window_size -= it->second.size();
+      callback(byte_span(it->second));
+      it = m_early_messages.erase(it);
     }
   }
 
+  byte_span payload_of(const UnackedMessage &message) {
+    return m_buffer.record(message.offset, message.size);
+  }
+
 };
 
 }
@@ -0,0 +1,181 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+// Measures the send/ack throughput of [ReliableStream] for a sender with a backlog of unacked
+// messages: on every step a message is sent and written to a packet, and the oldest in-flight
+// packet is acked. The stream is compared to its previous version, which kept the payloads in a
+// [FlipBuffer] and moved the unacked ones to the front of the buffer on every send.
+// Usage: bin_reliable_stream_benchmark [message_size]
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "common/flip_buffer.h"
+#include "neptun/reliable_stream.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+
+constexpr usize kDefaultMessageSize = 32;
+constexpr usize kStepCount = 1'000'000;
+constexpr usize kPacketSize = 1400;
+
+// The sender side of [ReliableStream] before it switched to [RingBuffer], as the baseline.
+// Dropped packets aren't handled, since the benchmark only acks.
+class FlipBufferReliableStream {
+public:
+  explicit FlipBufferReliableStream(usize buffer_capacity) : m_buffer(buffer_capacity) {}
+
+  void on_packet_delivery_status(PacketId packet_id, PacketDeliveryStatus status) {
+    assert(status == PacketDeliveryStatus::ACK);
+    while (!m_in_flight_messages.empty() && m_in_flight_messages.front().packet_id <= packet_id) {
+      unacked_message(m_in_flight_messages.front().sequence_number).is_acked = true;
+      m_in_flight_messages.pop_front();
+    }
+    while (!m_unacked_messages.empty() && m_unacked_messages.front().is_acked) {
+      m_buffer.consume(m_unacked_messages.front().end - m_unacked_messages.front().begin);
+      m_unacked_messages.pop_front();
+    }
+  }
+
+  usize write(PacketId packet_id, byte_span buffer) {
+    usize total_size = Segment::kSerializedSize;
+    usize message_count = 0;
+    for (auto sequence_number : m_pending_messages) {
+      const usize msg_size =
+          ReliableMessage::serialized_size(buffer_span(unacked_message(sequence_number)).size());
+      if (total_size + msg_size > buffer.size()) {
+        break;
+      }
+      total_size += msg_size;
+      message_count++;
+    }
+    if (message_count == 0) {
+      return 0;
+    }
+    usize idx = Segment::write(buffer, ManagerType::RELIABLE_STREAM, message_count).size();
+    for (usize i = 0; i < message_count; i++) {
+      auto sequence_number = m_pending_messages.front();
+      auto payload = buffer_span(unacked_message(sequence_number));
+      m_pending_messages.pop_front();
+      m_in_flight_messages.push_back({packet_id, sequence_number});
+      idx += ReliableMessage::write(advance(buffer, idx),
+                                    sequence_number,
+                                    static_cast<u16>(payload.size()),
+                                    payload).size();
+    }
+    assert(idx == total_size);
+    return total_size;
+  }
+
+  template<typename WriteToBufferFn>
+  void send(WriteToBufferFn write_to_buffer) {
+    maybe_flip();
+    auto payload = write_to_buffer(m_buffer.remaining());
+    if (!payload.empty()) {
+      auto sequence_number = m_next_outgoing_sequence_number++;
+      m_unacked_messages.push_back({m_buffer.end_index(),
+                                    m_buffer.end_index() + payload.size(),
+                                    sequence_number});
+      m_pending_messages.push_back(sequence_number);
+      m_buffer.advance(payload.size());
+    }
+  }
+
+private:
+  struct Message {
+    usize begin;
+    usize end;
+    u32 sequence_number;
+    bool is_acked{false};
+  };
+
+  struct InFlight {
+    PacketId packet_id;
+    u32 sequence_number;
+  };
+
+  FlipBuffer<u8> m_buffer;
+  std::deque<Message> m_unacked_messages{};
+  std::deque<u32> m_pending_messages{};
+  std::deque<InFlight> m_in_flight_messages{};
+  u32 m_next_outgoing_sequence_number{0};
+
+  Message &unacked_message(u32 sequence_number) {
+    return m_unacked_messages[sequence_number - m_unacked_messages.front().sequence_number];
+  }
+
+  byte_span buffer_span(const Message &message) {
+    return {m_buffer.begin() + message.begin, m_buffer.begin() + message.end};
+  }
+
+  // Moves the unacked payloads to the front of the buffer, which costs O(backlog).
+  void maybe_flip() {
+    if (m_buffer.begin_index() > 0) {
+      for (auto &message : m_unacked_messages) {
+        message.begin -= m_buffer.begin_index();
+        message.end -= m_buffer.begin_index();
+      }
+      m_buffer.flip();
+    }
+  }
+};
+
+template<typename Stream>
+void run(const std::string &name, usize backlog, usize message_size) {
+  Stream stream{(backlog + 2) * message_size};
+  std::vector<u8> packet(kPacketSize);
+  usize full_count = 0;
+  auto write_message = [message_size, &full_count](byte_span buffer) {
+    if (buffer.size() < message_size) {
+      full_count++;
+      return byte_span{};
+    }
+    std::fill_n(buffer.begin(), message_size, 42);
+    return buffer.first(message_size);
+  };
+  PacketId packet_id = 0;
+  auto step = [&]() {
+    stream.send(write_message);
+    if (stream.write(packet_id, packet) > 0) {
+      packet_id++;
+    }
+  };
+  for (usize i = 0; i < backlog; i++) {
+    step();
+  }
+
+  PacketId oldest_in_flight = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (usize i = 0; i < kStepCount; i++) {
+    step();
+    stream.on_packet_delivery_status(oldest_in_flight++, PacketDeliveryStatus::ACK);
+  }
+  auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+  std::cout << name << ", backlog of " << backlog << " messages of " << message_size << " bytes: "
+            << elapsed.count() / kStepCount << " ns per message";
+  if (full_count > 0) {
+    std::cout << " (the buffer was full " << full_count << " times)";
+  }
+  std::cout << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+  usize message_size = argc > 1 ? std::stoul(argv[1]) : kDefaultMessageSize;
+  for (usize backlog : {1, 10, 100, 1000}) {
+    run<FlipBufferReliableStream>("FlipBuffer", backlog, message_size);
+    run<ReliableStream>("RingBuffer", backlog, message_size);
+  }
+  return 0;
+}
@@ -243,6 +243,168 @@ TEST(ReliableStreamTest, ReadsDuplicateMessageOnlyOnce) {
   ASSERT_EQ(msg_count, 1);
 }
 
+TEST(ReliableStreamTest, ResendsOnlyMessagesOfDroppedPacket) {
+  ReliableStream client{};
+  std::vector<std::vector<u8>> packets{};
+  for (u32 i = 0; i < 3; i++) {
+    client.send([i](byte_span buffer) {
+      auto count = IoBuffer(buffer).write_byte_array(span_of_string("msg " + std::to_string(i)), 0);
+      return buffer.first(count);
+    });
+    packets.push_back(make_buffer());
+    ASSERT_GT(client.write(kPacketId + i, packets.back()), 0);
+  }
+
+  // The first packet is dropped, but the later ones are delivered.
+  client.on_packet_delivery_status(kPacketId, PacketDeliveryStatus::DROP);
+  client.on_packet_delivery_status(kPacketId + 1, PacketDeliveryStatus::ACK);
+  client.on_packet_delivery_status(kPacketId + 2, PacketDeliveryStatus::ACK);
+
+  ReliableStream server{};
+  std::vector<std::string> messages{};
+  auto on_message = [&messages](byte_span payload) {
+    messages.push_back(string_of_span(payload));
+  };
+  server.read(kPacketId + 1, packets[1], on_message);
+  server.read(kPacketId + 2, packets[2], on_message);
+  // The later messages are held until the dropped one arrives.
+  ASSERT_TRUE(messages.empty());
+
+  auto resend_buffer = make_buffer();
+  ASSERT_GT(client.write(kPacketId + 3, resend_buffer), 0);
+  ASSERT_EQ(Segment(resend_buffer).message_count(), 1);
+  server.read(kPacketId + 3, resend_buffer, on_message);
+  ASSERT_EQ(messages, (std::vector<std::string>{"msg 0", "msg 1", "msg 2"}));
+
+  client.on_packet_delivery_status(kPacketId + 3, PacketDeliveryStatus::ACK);
+  ASSERT_FALSE(client.has_pending_messages());
+  auto after_ack_buffer = make_buffer();
+  ASSERT_EQ(client.write(kPacketId + 4, after_ack_buffer), 0);
+}
+
+TEST(ReliableStreamTest, ResendsDroppedMessagesInSequenceOrder) {
+  ReliableStream client{};
+  auto send = [&client](u32 i) {
+    client.send([i](byte_span buffer) {
+      auto count = IoBuffer(buffer).write_byte_array(span_of_string("msg " + std::to_string(i)), 0);
+      return buffer.first(count);
+    });
+  };
+  send(0);
+  auto buffer0 = make_buffer();
+  client.write(kPacketId, buffer0);
+  send(1);
+  auto buffer1 = make_buffer();
+  client.write(kPacketId + 1, buffer1);
+  send(2);
+
+  // The status of the first packet is never reported, so it's dropped together with the second.
+  client.on_packet_delivery_status(kPacketId + 1, PacketDeliveryStatus::DROP);
+
+  ReliableStream server{};
+  std::vector<std::string> messages{};
+  auto buffer = make_buffer();
+  client.write(kPacketId + 2, buffer);
+  server.read(kPacketId + 2, buffer, [&messages](byte_span payload) {
+    messages.push_back(string_of_span(payload));
+  });
+  ASSERT_EQ(messages, (std::vector<std::string>{"msg 0", "msg 1", "msg 2"}));
+}
+
+TEST(ReliableStreamTest, ReceiveWindowIsBounded) {
+  ReliableStream client{};
+  std::vector<std::vector<u8>> packets{};
+  for (u32 i = 0; i < 3; i++) {
+    client.send([i](byte_span buffer) {
+      auto count = IoBuffer(buffer).write_byte_array(span_of_string("msg " + std::to_string(i)), 0);
+      return buffer.first(count);
+    });
+    packets.push_back(make_buffer());
+    client.write(kPacketId + i, packets.back());
+  }
+
+  // The window only fits one of the messages.
+  ReliableStream server{3200, 8};
+  std::vector<std::string> messages{};
+  auto on_message = [&messages](byte_span payload) {
+    messages.push_back(string_of_span(payload));
+  };
+  ASSERT_TRUE(server.read(kPacketId + 1, packets[1], on_message));
+  ASSERT_EQ(server.receive_window_size(), 5);
+  // A duplicate doesn't take more space.
+  ASSERT_TRUE(server.read(kPacketId + 1, packets[1], on_message));
+  ASSERT_EQ(server.receive_window_size(), 5);
+  ASSERT_EQ(server.read(kPacketId + 2, packets[2], on_message),
+            make_error(NeptunError::RECEIVE_WINDOW_FULL));
+
+  ASSERT_TRUE(server.read(kPacketId, packets[0], on_message));
+  ASSERT_EQ(messages, (std::vector<std::string>{"msg 0", "msg 1"}));
+  ASSERT_EQ(server.receive_window_size(), 0);
+}
+
+TEST(ReliableStreamTest, WritesOnlyMessagesThatFitPeerReceiveWindow) {
+  ReliableStream client{};
+  // The peer's window only fits one of the messages after the oldest unacked one.
+  client.set_peer_receive_window(8);
+  std::vector<std::vector<u8>> packets{};
+  std::vector<usize> packet_sizes{};
+  for (u32 i = 0; i < 3; i++) {
+    client.send([i](byte_span buffer) {
+      auto count = IoBuffer(buffer).write_byte_array(span_of_string("msg " + std::to_string(i)), 0);
+      return buffer.first(count);
+    });
+    packets.push_back(make_buffer());
+    packet_sizes.push_back(client.write(kPacketId + i, packets.back()));
+  }
+  ASSERT_GT(packet_sizes[1], 0);
+  ASSERT_EQ(packet_sizes[2], 0);
+  ASSERT_FALSE(client.has_pending_messages());
+
+  ReliableStream server{3200, 8};
+  std::vector<std::string> messages{};
+  auto on_message = [&messages](byte_span payload) {
+    messages.push_back(string_of_span(payload));
+  };
+  ASSERT_TRUE(server.read(kPacketId + 1, packets[1], on_message));
+  ASSERT_TRUE(server.read(kPacketId, packets[0], on_message));
+
+  // The window opens up once the oldest message is acked, even though the second one isn't.
+  client.on_packet_delivery_status(kPacketId, PacketDeliveryStatus::ACK);
+  ASSERT_TRUE(client.has_pending_messages());
+  auto buffer = make_buffer();
+  ASSERT_GT(client.write(kPacketId + 3, buffer), 0);
+  ASSERT_TRUE(server.read(kPacketId + 3, buffer, on_message));
+  ASSERT_EQ(messages, (std::vector<std::string>{"msg 0", "msg 1", "msg 2"}));
+}
+
+TEST(ReliableStreamTest, ReusesBufferAfterAcks) {
+  // Fits three messages at a time.
+  ReliableStream client{32};
+  ReliableStream server{32};
+  std::vector<std::string> messages{};
+  for (u32 i = 0; i < 20; i++) {
+    std::string message = "message " + std::to_string(i % 10);
+    client.send([&message](byte_span buffer) {
+      auto count = IoBuffer(buffer).write_byte_array(span_of_string(message), 0);
+      return buffer.first(count);
+    });
+    ASSERT_TRUE(client.has_pending_messages());
+    auto buffer = make_buffer();
+    client.write(kPacketId + i, buffer);
+    server.read(kPacketId + i, buffer, [&messages](byte_span payload) {
+      messages.push_back(string_of_span(payload));
+    });
+    // Every packet is acked a bit later, so the buffer wraps around.
+    if (i >= 1) {
+      client.on_packet_delivery_status(kPacketId + i - 1, PacketDeliveryStatus::ACK);
+    }
+  }
+  ASSERT_EQ(messages.size(), 20);
+  for (u32 i = 0; i < 20; i++) {
+    ASSERT_EQ(messages[i], "message " + std::to_string(i % 10));
+  }
+}
+
 TEST(ReliableStreamTest, SendMaliciousPacket_RandomBytes) {
   auto buffer = make_buffer();
   for (usize i = 0; i < buffer.size(); i++) {
@@ -0,0 +1,58 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NEPTUN_RTT_ESTIMATOR_H
+#define NEPTUN_NEPTUN_RTT_ESTIMATOR_H
+
+#include <algorithm>
+#include <optional>
+
+#include "common/types.h"
+
+namespace freezing::network {
+
+struct RttStats {
+  // The most recent sample.
+  nanoseconds latest;
+  // Exponentially weighted moving average of the samples.
+  nanoseconds smoothed;
+  // Mean deviation of the samples from [smoothed], i.e. the jitter.
+  nanoseconds variance;
+  // The smallest sample, which approximates the delay of the path without any queueing.
+  nanoseconds min;
+  usize sample_count;
+};
+
+// Estimates the round-trip time from RTT samples, as TCP does (RFC 6298, section 2):
+//   smoothed = 7/8 * smoothed + 1/8 * sample
+//   variance = 3/4 * variance + 1/4 * |smoothed - sample|
+// The first sample initializes [smoothed] to the sample and [variance] to half of it.
+class RttEstimator {
+public:
+  void add_sample(nanoseconds sample) {
+    if (!m_stats) {
+      m_stats = RttStats{sample, sample, sample / 2, sample, 1};
+      return;
+    }
+    auto &stats = *m_stats;
+    auto deviation = stats.smoothed > sample ? stats.smoothed - sample : sample - stats.smoothed;
+    stats.variance = (3 * stats.variance + deviation) / 4;
+    stats.smoothed = (7 * stats.smoothed + sample) / 8;
+    stats.latest = sample;
+    stats.min = std::min(stats.min, sample);
+    stats.sample_count++;
+  }
+
+  // Returns nothing until the first sample.
+  std::optional<RttStats> stats() const {
+    return m_stats;
+  }
+
+private:
+  std::optional<RttStats> m_stats{};
+};
+
+}
+
+#endif //NEPTUN_NEPTUN_RTT_ESTIMATOR_H
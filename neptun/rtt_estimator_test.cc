@@ -0,0 +1,46 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+
+#include "common/types.h"
+#include "neptun/rtt_estimator.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+TEST(RttEstimatorTest, FirstSample) {
+  RttEstimator estimator{};
+  ASSERT_FALSE(estimator.stats());
+
+  estimator.add_sample(milliseconds(100));
+  auto stats = estimator.stats();
+  ASSERT_TRUE(stats);
+  ASSERT_EQ(stats->latest, milliseconds(100));
+  ASSERT_EQ(stats->smoothed, milliseconds(100));
+  ASSERT_EQ(stats->variance, milliseconds(50));
+  ASSERT_EQ(stats->min, milliseconds(100));
+  ASSERT_EQ(stats->sample_count, 1);
+}
+
+TEST(RttEstimatorTest, SmoothsSamples) {
+  RttEstimator estimator{};
+  estimator.add_sample(milliseconds(100));
+  estimator.add_sample(milliseconds(20));
+  auto stats = estimator.stats();
+  ASSERT_EQ(stats->latest, milliseconds(20));
+  ASSERT_EQ(stats->smoothed, milliseconds(90));
+  ASSERT_EQ(stats->variance, milliseconds(57) + microseconds(500));
+  ASSERT_EQ(stats->min, milliseconds(20));
+
+  // A stable RTT converges to the sample, with no jitter.
+  for (usize i = 0; i < 200; i++) {
+    estimator.add_sample(milliseconds(40));
+  }
+  stats = estimator.stats();
+  ASSERT_LE(stats->smoothed - milliseconds(40), microseconds(1));
+  ASSERT_LE(stats->variance, microseconds(1));
+  ASSERT_EQ(stats->min, milliseconds(20));
+  ASSERT_EQ(stats->sample_count, 202);
+}
@@ -0,0 +1,245 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NEPTUN_SHARDED_NEPTUN_H
+#define NEPTUN_NEPTUN_SHARDED_NEPTUN_H
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/types.h"
+#include "network/event_loop.h"
+#include "network/ip_address.h"
+#include "neptun/neptun.h"
+#include "neptun/neptun_metrics.h"
+
+namespace freezing::network {
+
+// Runs [shard_count] Neptun instances (shards) on the same IP address, each with its own
+// SO_REUSEPORT socket. The kernel hashes the sender's address to pick the socket, so every peer
+// sticks to a single shard and the shards don't share any per-peer state.
+//
+// Shards either run on their own worker threads ([start]), or are ticked on the calling thread
+// ([tick]), which is how the tests drive them since [FakeNetwork] isn't thread-safe.
+// Messages can be sent to any peer from any thread: they are queued for the peer's shard and
+// written on its next tick.
+//
+// Only peers that connect to us are supported: a connection initiated by a shard could be
+// answered to any of the shards.
+template<typename Network, typename Clock>
+class ShardedNeptun {
+public:
+  ShardedNeptun(Network &network,
+                IpAddress ip,
+                ConnectionManagerConfig connection_manager_config,
+                usize shard_count,
+                milliseconds packet_timeout = detail::kDefaultPacketTimeout,
+                NeptunConfig config = {}) {
+    assert(shard_count > 0);
+    config.reuse_port = true;
+    for (usize i = 0; i < shard_count; i++) {
+      auto shard = std::make_unique<Shard>();
+      shard->neptun = std::make_unique<Neptun<Network, Clock>>(network,
+                                                               ip,
+                                                               connection_manager_config,
+                                                               packet_timeout,
+                                                               config);
+      shard->neptun->set_new_peer_callback([this, i](IpAddress peer_ip) {
+        std::unique_lock lock{m_peer_shards_mutex};
+        m_peer_shards[peer_ip.packed()] = i;
+      });
+      shard->neptun->set_peer_evicted_callback([this](IpAddress peer_ip) {
+        std::unique_lock lock{m_peer_shards_mutex};
+        m_peer_shards.erase(peer_ip.packed());
+      });
+      m_shards.push_back(std::move(shard));
+    }
+  }
+
+  ShardedNeptun(const ShardedNeptun &) = delete;
+  ShardedNeptun &operator=(const ShardedNeptun &) = delete;
+
+  ~ShardedNeptun() {
+    stop();
+  }
+
+  // Starts one worker thread per shard, which ticks the shard when its socket is readable or
+  // [Neptun::next_deadline] passes. Queued messages don't wake the worker up, so it also ticks
+  // at least every [tick_interval].
+  // The callbacks are copied to each worker and called on the worker threads.
+  template<typename OnReliableFn, typename OnUnreliableFn>
+  void start(nanoseconds tick_interval, OnReliableFn on_reliable, OnUnreliableFn on_unreliable) {
+    assert(m_workers.empty());
+    for (auto &shard : m_shards) {
+      shard->event_loop = std::make_unique<EventLoop<Clock>>(shard->neptun->socket_fd());
+    }
+    m_is_running = true;
+    for (usize i = 0; i < m_shards.size(); i++) {
+      m_workers.emplace_back([this, i, tick_interval, on_reliable, on_unreliable]() mutable {
+        auto &shard = *m_shards[i];
+        while (m_is_running.load(std::memory_order_relaxed)) {
+          auto now = Clock::now();
+          tick_shard(shard, now, on_reliable, on_unreliable);
+          time_point<Clock> deadline = now + tick_interval;
+          auto next_deadline = shard.neptun->next_deadline();
+          if (next_deadline && *next_deadline < deadline) {
+            deadline = *next_deadline;
+          }
+          shard.event_loop->wait(deadline);
+        }
+      });
+    }
+  }
+
+  void stop() {
+    m_is_running = false;
+    for (auto &worker : m_workers) {
+      worker.join();
+    }
+    m_workers.clear();
+  }
+
+  // Ticks all shards on the calling thread. Must not be called while the workers are running.
+  template<typename OnReliableFn = std::function<void(byte_span)>, typename OnUnreliableFn = std::function<
+      void(byte_span)>>
+  void tick(time_point<Clock> now,
+            OnReliableFn on_reliable = [](byte_span) {},
+            OnUnreliableFn on_unreliable = [](byte_span) {}) {
+    assert(m_workers.empty());
+    for (auto &shard : m_shards) {
+      tick_shard(*shard, now, on_reliable, on_unreliable);
+    }
+  }
+
+  // Thread-safe. Returns the shard that the peer has been assigned to by the kernel, if any.
+  std::optional<usize> shard_of(IpAddress ip) const {
+    std::shared_lock lock{m_peer_shards_mutex};
+    auto it = m_peer_shards.find(ip.packed());
+    if (it == m_peer_shards.end()) {
+      return {};
+    }
+    return it->second;
+  }
+
+  // Thread-safe. Queues a copy of [payload] for the peer's shard.
+  // Returns false if the peer is unknown. Messages to peers that aren't connected by the time
+  // the shard processes them are dropped.
+  bool send_reliable_to(IpAddress ip, const_byte_span payload) {
+    return enqueue(ip, MessageKind::RELIABLE, payload);
+  }
+
+  // Thread-safe. See [send_reliable_to].
+  bool send_unreliable_to(IpAddress ip, const_byte_span payload) {
+    return enqueue(ip, MessageKind::UNRELIABLE, payload);
+  }
+
+  // Thread-safe. Metrics summed across all shards, as of their last tick.
+  NeptunMetrics metrics() const {
+    NeptunMetrics metrics{"Neptun metrics"};
+    for (const auto &shard : m_shards) {
+      std::lock_guard lock{shard->mutex};
+      metrics.add(shard->metrics);
+    }
+    return metrics;
+  }
+
+  // Thread-safe. Number of queued messages that were dropped, because the peer wasn't connected
+  // or the peer's stream buffer was full.
+  u64 dropped_message_count() const {
+    return m_dropped_message_count.load(std::memory_order_relaxed);
+  }
+
+  usize shard_count() const {
+    return m_shards.size();
+  }
+
+private:
+  enum class MessageKind {
+    RELIABLE,
+    UNRELIABLE,
+  };
+
+  struct Message {
+    MessageKind kind;
+    IpAddress recipient;
+    std::vector<u8> payload;
+  };
+
+  struct Shard {
+    // Only used by the thread that ticks the shard.
+    std::unique_ptr<Neptun<Network, Clock>> neptun;
+    std::vector<Message> messages_to_send{};
+    // Only created when the workers are started.
+    std::unique_ptr<EventLoop<Clock>> event_loop{};
+
+    mutable std::mutex mutex{};
+    // Guarded by [mutex].
+    std::vector<Message> queued_messages{};
+    // Snapshot of the shard's metrics, guarded by [mutex].
+    NeptunMetrics metrics{"Neptun metrics"};
+  };
+
+  std::vector<std::unique_ptr<Shard>> m_shards{};
+  std::vector<std::thread> m_workers{};
+  std::atomic<bool> m_is_running{false};
+  std::atomic<u64> m_dropped_message_count{0};
+  mutable std::shared_mutex m_peer_shards_mutex{};
+  // Packed IP address to the shard index, guarded by [m_peer_shards_mutex].
+  std::unordered_map<u64, usize> m_peer_shards{};
+
+  bool enqueue(IpAddress ip, MessageKind kind, const_byte_span payload) {
+    auto shard_index = shard_of(ip);
+    if (!shard_index) {
+      return false;
+    }
+    auto &shard = *m_shards[*shard_index];
+    std::lock_guard lock{shard.mutex};
+    shard.queued_messages.push_back({kind, ip, std::vector<u8>(payload.begin(), payload.end())});
+    return true;
+  }
+
+  template<typename OnReliableFn, typename OnUnreliableFn>
+  void tick_shard(Shard &shard,
+                  time_point<Clock> now,
+                  OnReliableFn &on_reliable,
+                  OnUnreliableFn &on_unreliable) {
+    {
+      std::lock_guard lock{shard.mutex};
+      std::swap(shard.messages_to_send, shard.queued_messages);
+    }
+    for (auto &message : shard.messages_to_send) {
+      if (!shard.neptun->is_connected(message.recipient)) {
+        m_dropped_message_count.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      bool is_written = false;
+      auto write_to_buffer = copy_payload(message.payload, is_written);
+      if (message.kind == MessageKind::RELIABLE) {
+        shard.neptun->send_reliable_to(message.recipient, write_to_buffer, now);
+      } else {
+        shard.neptun->send_unreliable_to(message.recipient, write_to_buffer, now);
+      }
+      if (!is_written) {
+        // The sender has already been told that the message is queued, so the drop is counted.
+        m_dropped_message_count.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    shard.messages_to_send.clear();
+
+    shard.neptun->tick(now, on_reliable, on_unreliable);
+
+    std::lock_guard lock{shard.mutex};
+    shard.metrics = shard.neptun->metrics();
+  }
+};
+
+}
+
+#endif //NEPTUN_NEPTUN_SHARDED_NEPTUN_H
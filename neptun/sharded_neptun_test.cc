@@ -0,0 +1,139 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+#include "common/types.h"
+#include "common/fake_clock.h"
+#include "network/fake_network.h"
+#include "neptun/sharded_neptun.h"
+
+using namespace freezing;
+using namespace freezing::network;
+using namespace freezing::network::testing;
+
+namespace {
+const IpAddress kServerIp = IpAddress::from_ipv4("192.168.0.10", 1000);
+constexpr ConnectionManagerConfig kConnectionManagerConfig{5,
+                                                           BandwidthLimit{.max_read_packet_rate=0, .max_read_packet_size=1400, .max_send_packet_rate=0, .max_send_packet_size=800}};
+const FakeClock::time_point kNow = FakeClock::now();
+constexpr usize kNumShards = 4;
+constexpr usize kNumClients = 16;
+
+using TestNeptun = Neptun<FakeNetwork, FakeClock>;
+using TestShardedNeptun = ShardedNeptun<FakeNetwork, FakeClock>;
+
+IpAddress client_ip(usize i) {
+  return IpAddress::from_ipv4("192.168.1.1", 2000 + i);
+}
+
+std::vector<std::unique_ptr<TestNeptun>> connect_clients(TestShardedNeptun &server,
+                                                         FakeNetwork &fake_network) {
+  std::vector<std::unique_ptr<TestNeptun>> clients{};
+  for (usize i = 0; i < kNumClients; i++) {
+    clients.push_back(std::make_unique<TestNeptun>(fake_network, client_ip(i), kConnectionManagerConfig));
+    clients.back()->connect(kServerIp, kNow);
+  }
+  for (usize round = 0; round < 3; round++) {
+    auto now = kNow + milliseconds(100 * round);
+    for (auto &client : clients) {
+      client->tick(now);
+    }
+    server.tick(now);
+  }
+  return clients;
+}
+}
+
+TEST(ShardedNeptunTest, PeersStickToOneShard) {
+  FakeNetwork fake_network{};
+  TestShardedNeptun server{fake_network, kServerIp, kConnectionManagerConfig, kNumShards};
+  auto clients = connect_clients(server, fake_network);
+
+  std::set<usize> used_shards{};
+  for (usize i = 0; i < kNumClients; i++) {
+    ASSERT_TRUE(clients[i]->is_connected(kServerIp));
+    auto shard = server.shard_of(client_ip(i));
+    ASSERT_TRUE(shard);
+    ASSERT_LT(*shard, kNumShards);
+    used_shards.insert(*shard);
+  }
+  ASSERT_GT(used_shards.size(), 1);
+  ASSERT_FALSE(server.shard_of(IpAddress::from_ipv4("10.0.0.1", 1)));
+}
+
+TEST(ShardedNeptunTest, SendToAnyPeer) {
+  FakeNetwork fake_network{};
+  TestShardedNeptun server{fake_network, kServerIp, kConnectionManagerConfig, kNumShards};
+  auto clients = connect_clients(server, fake_network);
+
+  for (usize i = 0; i < kNumClients; i++) {
+    std::string message = "hello client " + std::to_string(i);
+    ASSERT_TRUE(server.send_reliable_to(client_ip(i), byte_span((u8 *) message.data(), message.size())));
+  }
+  ASSERT_FALSE(server.send_reliable_to(IpAddress::from_ipv4("10.0.0.1", 1), byte_span{}));
+  server.tick(kNow + seconds(1));
+
+  for (usize i = 0; i < kNumClients; i++) {
+    usize msg_count = 0;
+    clients[i]->tick(kNow + seconds(1), [&msg_count, i](IpAddress sender, byte_span payload) {
+      ASSERT_EQ(sender, kServerIp);
+      ASSERT_EQ(std::string(payload.begin(), payload.end()), "hello client " + std::to_string(i));
+      msg_count++;
+    });
+    ASSERT_EQ(msg_count, 1);
+  }
+  ASSERT_EQ(server.dropped_message_count(), 0);
+}
+
+TEST(ShardedNeptunTest, CountsMessagesThatDontFitStreamBuffer) {
+  FakeNetwork fake_network{};
+  TestShardedNeptun server{fake_network, kServerIp, kConnectionManagerConfig, kNumShards,
+                           freezing::network::detail::kDefaultPacketTimeout,
+                           NeptunConfig{.reliable_stream_capacity = 16}};
+  auto clients = connect_clients(server, fake_network);
+
+  // Only two messages fit into the reliable stream buffer until they are acked.
+  std::string message = "message";
+  for (usize i = 0; i < 3; i++) {
+    ASSERT_TRUE(server.send_reliable_to(client_ip(0), byte_span((u8 *) message.data(), message.size())));
+  }
+  server.tick(kNow + seconds(1));
+  ASSERT_EQ(server.dropped_message_count(), 1);
+}
+
+TEST(ShardedNeptunTest, AggregatesMetricsAcrossShards) {
+  FakeNetwork fake_network{};
+  TestShardedNeptun server{fake_network, kServerIp, kConnectionManagerConfig, kNumShards};
+  auto clients = connect_clients(server, fake_network);
+
+  // Every client's packets are read by exactly one shard.
+  u64 client_sent_packets = 0;
+  for (usize i = 0; i < kNumClients; i++) {
+    client_sent_packets += fake_network.stats(client_ip(i)).num_sent_packets;
+  }
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::READ_BATCH_PACKETS), client_sent_packets);
+  ASSERT_GT(server.metrics().value(NeptunMetricKey::PACKET_ACKS), 0);
+}
+
+TEST(ShardedNeptunTest, ForgetsEvictedPeers) {
+  FakeNetwork fake_network{};
+  TestShardedNeptun server{fake_network, kServerIp, kConnectionManagerConfig, kNumShards,
+                           freezing::network::detail::kDefaultPacketTimeout,
+                           NeptunConfig{.idle_timeout = seconds(1)}};
+  auto clients = connect_clients(server, fake_network);
+  ASSERT_TRUE(server.shard_of(client_ip(0)));
+
+  // The clients stop sending packets.
+  server.tick(kNow + seconds(2));
+  for (usize i = 0; i < kNumClients; i++) {
+    ASSERT_FALSE(server.shard_of(client_ip(i)));
+  }
+  ASSERT_FALSE(server.send_reliable_to(client_ip(0), byte_span{}));
+  ASSERT_EQ(server.metrics().value(NeptunMetricKey::PEERS_EVICTED), kNumClients);
+}
@@ -0,0 +1,169 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+// Compares [ShmNetwork] with [OsNetwork] on loopback between two processes: first by bouncing a
+// datagram between them, and then by running two [Neptun] peers, one in each process, where one
+// sends reliable messages to the other as fast as possible.
+// Usage: bin_shm_benchmark [round_trip_count]
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "network/network.h"
+#include "network/shm_network.h"
+#include "network/udp_socket.h"
+#include "neptun/neptun.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+
+constexpr usize kDatagramSize = 1200;
+constexpr usize kMessageSize = 100;
+constexpr usize kNeptunMessageCount = 200'000;
+
+// Every run needs its own ports, because [Neptun] doesn't close its socket.
+const IpAddress kOsPingIp = IpAddress::from_ipv4("127.0.0.1", 47401);
+const IpAddress kOsPongIp = IpAddress::from_ipv4("127.0.0.1", 47402);
+const IpAddress kShmPingIp = IpAddress::from_ipv4("127.0.0.1", 47403);
+const IpAddress kShmPongIp = IpAddress::from_ipv4("127.0.0.1", 47404);
+const IpAddress kOsNeptunClientIp = IpAddress::from_ipv4("127.0.0.1", 47405);
+const IpAddress kOsNeptunServerIp = IpAddress::from_ipv4("127.0.0.1", 47406);
+const IpAddress kShmNeptunClientIp = IpAddress::from_ipv4("127.0.0.1", 47407);
+const IpAddress kShmNeptunServerIp = IpAddress::from_ipv4("127.0.0.1", 47408);
+
+// Runs [child] in a new process that ends when [child] returns, and [parent] in this one.
+// [parent] is called with a function that tells whether the child process is still running.
+// Returns how long [parent] took, including the wait for the child process.
+template<typename ChildFn, typename ParentFn>
+std::chrono::nanoseconds run_in_two_processes(ChildFn child, ParentFn parent) {
+  pid_t pid = ::fork();
+  if (pid == -1) {
+    throw std::runtime_error("Failed to fork");
+  }
+  if (pid == 0) {
+    child();
+    // Skips the destructors of the static objects inherited from the parent.
+    ::_exit(0);
+  }
+  bool has_exited = false;
+  auto is_child_running = [pid, &has_exited]() {
+    has_exited = has_exited || ::waitpid(pid, nullptr, WNOHANG) == pid;
+    return !has_exited;
+  };
+  auto start = std::chrono::steady_clock::now();
+  parent(is_child_running);
+  if (!has_exited) {
+    ::waitpid(pid, nullptr, 0);
+  }
+  return std::chrono::steady_clock::now() - start;
+}
+
+// Busy-polls, like a game server's network thread would, but yields so that the other process
+// gets to run on machines with a single core.
+template<typename Network>
+void read_one(UdpSocket<Network> &socket, byte_span buffer) {
+  while (!socket.read(buffer)) {
+    std::this_thread::yield();
+  }
+}
+
+// The child process echoes [round_trip_count] datagrams back to the parent.
+template<typename Network>
+void run_ping_pong(const std::string &name,
+                   usize round_trip_count,
+                   IpAddress ping_ip,
+                   IpAddress pong_ip) {
+  auto elapsed = run_in_two_processes([&]() {
+    Network network{};
+    auto socket = UdpSocket<Network>::bind(pong_ip, network);
+    std::vector<u8> buffer(kDatagramSize);
+    for (usize i = 0; i < round_trip_count; i++) {
+      read_one(socket, buffer);
+      (void) socket.send_to(ping_ip, buffer);
+    }
+    network.close_socket(socket.fd());
+  }, [&](auto) {
+    Network network{};
+    auto socket = UdpSocket<Network>::bind(ping_ip, network);
+    std::vector<u8> buffer(kDatagramSize, 0xAB);
+    // Resend the first datagram until the child process has bound its socket.
+    while (true) {
+      (void) socket.send_to(pong_ip, buffer);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      if (socket.read(buffer)) {
+        break;
+      }
+    }
+    for (usize i = 1; i < round_trip_count; i++) {
+      (void) socket.send_to(pong_ip, buffer);
+      read_one(socket, buffer);
+    }
+    network.close_socket(socket.fd());
+  });
+  std::cout << name << ": " << round_trip_count << " round trips of " << kDatagramSize
+            << " bytes, " << std::chrono::duration<double, std::micro>(elapsed).count()
+                / static_cast<double>(round_trip_count) << " us per round trip" << std::endl;
+}
+
+// The child process runs the server, which receives [kNeptunMessageCount] reliable messages.
+template<typename Network>
+void run_neptun(const std::string &name, IpAddress client_ip, IpAddress server_ip) {
+  // Unlimited packet rate.
+  ConnectionManagerConfig config{5, BandwidthLimit{0, 1400, 0, 1400}};
+  auto elapsed = run_in_two_processes([&]() {
+    Network network{};
+    Neptun<Network, system_clock> server{network, server_ip, config};
+    usize received_count = 0;
+    while (received_count < kNeptunMessageCount) {
+      server.tick(system_clock::now(), [&received_count](byte_span) { received_count++; });
+      std::this_thread::yield();
+    }
+  }, [&](auto is_server_running) {
+    Network network{};
+    Neptun<Network, system_clock> client{network, client_ip, config};
+    client.connect(server_ip, system_clock::now());
+    while (!client.is_connected(server_ip)) {
+      client.tick(system_clock::now());
+    }
+    usize sent_count = 0;
+    auto write_message = [&sent_count](byte_span buffer) {
+      if (sent_count == kNeptunMessageCount || buffer.size() < kMessageSize) {
+        return byte_span{};
+      }
+      std::fill_n(buffer.begin(), kMessageSize, 42);
+      sent_count++;
+      return buffer.first(kMessageSize);
+    };
+    // Keeps resending the lost messages until the server has received all of them.
+    while (is_server_running()) {
+      auto now = system_clock::now();
+      client.send_reliable_to(server_ip, write_message, now);
+      client.tick(now);
+      std::this_thread::yield();
+    }
+  });
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  std::cout << name << ": " << kNeptunMessageCount << " reliable messages of " << kMessageSize
+            << " bytes in " << seconds * 1000.0 << " ms ("
+            << static_cast<double>(kNeptunMessageCount) / seconds << " messages/s)" << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+  usize round_trip_count = argc > 1 ? std::stoul(argv[1]) : 100'000;
+  run_ping_pong<OsNetwork>("OsNetwork", round_trip_count, kOsPingIp, kOsPongIp);
+  run_ping_pong<ShmNetwork>("ShmNetwork", round_trip_count, kShmPingIp, kShmPongIp);
+  run_neptun<OsNetwork>("Neptun on OsNetwork", kOsNeptunClientIp, kOsNeptunServerIp);
+  run_neptun<ShmNetwork>("Neptun on ShmNetwork", kShmNeptunClientIp, kShmNeptunServerIp);
+  return 0;
+}
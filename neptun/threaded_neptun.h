@@ -0,0 +1,265 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NEPTUN_THREADED_NEPTUN_H
+#define NEPTUN_NEPTUN_THREADED_NEPTUN_H
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common/types.h"
+#include "common/mpsc_queue.h"
+#include "common/spsc_queue.h"
+#include "network/ip_address.h"
+#include "neptun/neptun.h"
+#include "neptun/neptun_metrics.h"
+
+namespace freezing::network {
+
+struct ThreadedNeptunConfig {
+  // Maximum number of messages (and connects) queued by the user threads for the network thread.
+  usize outgoing_queue_capacity{4096};
+  // Maximum number of received messages queued by the network thread for the user thread.
+  usize incoming_queue_capacity{4096};
+  // Size of the payload buffer of each queued message. Larger messages can't be queued.
+  usize max_message_size{1400};
+};
+
+// Runs [Neptun] on a dedicated network thread, so that the threads that send and receive
+// messages don't pay for the syscalls and for building the packets.
+//
+// Any number of threads queue messages for the network thread through a lock-free MPSC queue,
+// and a single thread at a time takes the received messages from a lock-free SPSC queue with
+// [poll]. The payloads are copied into buffers that are allocated once per queue slot, so
+// queueing a message neither locks nor allocates.
+//
+// The network thread either runs on its own ([start]), or is ticked on the calling thread
+// ([tick]), which is how the tests drive it since [FakeNetwork] isn't thread-safe.
+template<typename Network, typename Clock>
+class ThreadedNeptun {
+public:
+  ThreadedNeptun(Network &network,
+                 IpAddress ip,
+                 ConnectionManagerConfig connection_manager_config,
+                 milliseconds packet_timeout = detail::kDefaultPacketTimeout,
+                 NeptunConfig config = {},
+                 ThreadedNeptunConfig threaded_config = {})
+      : m_neptun{std::make_unique<Neptun<Network, Clock>>(network,
+                                                          ip,
+                                                          connection_manager_config,
+                                                          packet_timeout,
+                                                          config)},
+        m_outgoing_messages{threaded_config.outgoing_queue_capacity,
+                            QueuedMessage{threaded_config.max_message_size}},
+        m_incoming_messages{threaded_config.incoming_queue_capacity,
+                            QueuedMessage{threaded_config.max_message_size}},
+        m_max_message_size{threaded_config.max_message_size} {}
+
+  ThreadedNeptun(const ThreadedNeptun &) = delete;
+  ThreadedNeptun &operator=(const ThreadedNeptun &) = delete;
+
+  ~ThreadedNeptun() {
+    stop();
+  }
+
+  // Starts the network thread, which ticks [Neptun] every [tick_interval].
+  void start(nanoseconds tick_interval) {
+    assert(!m_network_thread.joinable());
+    m_is_running = true;
+    m_network_thread = std::thread([this, tick_interval]() {
+      while (m_is_running.load(std::memory_order_relaxed)) {
+        tick(Clock::now());
+        std::this_thread::sleep_for(tick_interval);
+      }
+    });
+  }
+
+  void stop() {
+    m_is_running = false;
+    if (m_network_thread.joinable()) {
+      m_network_thread.join();
+    }
+  }
+
+  // Only called by the network thread, or by the tests while the network thread isn't running.
+  // Hands the queued messages to [Neptun], ticks it, and queues the received messages.
+  void tick(time_point<Clock> now) {
+    while (m_outgoing_messages.try_pop([this, now](QueuedMessage &message) {
+      handle_outgoing_message(message, now);
+    })) {}
+
+    auto on_message = [this](MessageKind kind) {
+      return [this, kind](IpAddress sender, byte_span payload) {
+        bool is_queued = payload.size() <= m_max_message_size
+            && m_incoming_messages.try_push([kind, sender, payload](QueuedMessage &message) {
+              message.kind = kind;
+              message.peer = sender;
+              message.payload.assign(payload.begin(), payload.end());
+            });
+        if (!is_queued) {
+          m_incoming_queue_full_count.fetch_add(1, std::memory_order_relaxed);
+        }
+      };
+    };
+    m_neptun->tick(now, on_message(MessageKind::RELIABLE), on_message(MessageKind::UNRELIABLE));
+
+    std::lock_guard lock{m_metrics_mutex};
+    m_metrics = m_neptun->metrics();
+  }
+
+  // Thread-safe. Queues a connect to [ip] for the network thread.
+  // Returns false if the outgoing queue is full.
+  bool connect(IpAddress ip) {
+    return enqueue(MessageKind::CONNECT, ip, {});
+  }
+
+  // Thread-safe. Queues a copy of [payload] for the network thread.
+  // Returns false if the outgoing queue is full or the message is too large. Messages to peers
+  // that aren't connected by the time the network thread processes them are dropped.
+  bool send_reliable_to(IpAddress ip, const_byte_span payload) {
+    return enqueue(MessageKind::RELIABLE, ip, payload);
+  }
+
+  // Thread-safe. See [send_reliable_to].
+  bool send_unreliable_to(IpAddress ip, const_byte_span payload) {
+    return enqueue(MessageKind::UNRELIABLE, ip, payload);
+  }
+
+  // Only one thread at a time. Calls the callbacks with up to [max_count] received messages, and
+  // returns the number of messages.
+  template<typename OnReliableFn, typename OnUnreliableFn>
+  usize poll(OnReliableFn on_reliable,
+             OnUnreliableFn on_unreliable,
+             usize max_count = std::numeric_limits<usize>::max()) {
+    usize count = 0;
+    while (count < max_count && m_incoming_messages.try_pop([&](QueuedMessage &message) {
+      if (message.kind == MessageKind::RELIABLE) {
+        on_reliable(message.peer, byte_span(message.payload));
+      } else {
+        on_unreliable(message.peer, byte_span(message.payload));
+      }
+    })) {
+      count++;
+    }
+    return count;
+  }
+
+  // Thread-safe. Metrics of [Neptun] as of its last tick, and the current state of the queues.
+  NeptunMetrics metrics() const {
+    NeptunMetrics metrics{"Neptun metrics"};
+    {
+      std::lock_guard lock{m_metrics_mutex};
+      metrics.add(m_metrics);
+    }
+    metrics.inc(NeptunMetricKey::OUTGOING_QUEUE_DEPTH, m_outgoing_messages.size());
+    metrics.inc(NeptunMetricKey::INCOMING_QUEUE_DEPTH, m_incoming_messages.size());
+    metrics.inc(NeptunMetricKey::OUTGOING_QUEUE_FULL,
+                m_outgoing_queue_full_count.load(std::memory_order_relaxed));
+    metrics.inc(NeptunMetricKey::INCOMING_QUEUE_FULL,
+                m_incoming_queue_full_count.load(std::memory_order_relaxed));
+    return metrics;
+  }
+
+  // Thread-safe. Number of queued messages that were dropped, because the peer wasn't connected
+  // or the peer's stream buffer was full.
+  u64 dropped_message_count() const {
+    return m_dropped_message_count.load(std::memory_order_relaxed);
+  }
+
+private:
+  enum class MessageKind {
+    CONNECT,
+    RELIABLE,
+    UNRELIABLE,
+  };
+
+  struct QueuedMessage {
+    explicit QueuedMessage(usize max_message_size = 0) {
+      payload.reserve(max_message_size);
+    }
+
+    // Copies the reserved capacity, so that every queue slot gets its own payload buffer.
+    QueuedMessage(const QueuedMessage &other) : QueuedMessage(other.payload.capacity()) {}
+
+    QueuedMessage &operator=(const QueuedMessage &other) {
+      payload.reserve(other.payload.capacity());
+      return *this;
+    }
+
+    MessageKind kind{MessageKind::RELIABLE};
+    IpAddress peer{sockaddr_in{}};
+    // Never grows beyond the reserved capacity.
+    std::vector<u8> payload{};
+  };
+
+  // Only used by the network thread.
+  std::unique_ptr<Neptun<Network, Clock>> m_neptun;
+  MpscQueue<QueuedMessage> m_outgoing_messages;
+  SpscQueue<QueuedMessage> m_incoming_messages;
+  usize m_max_message_size;
+  std::thread m_network_thread{};
+  std::atomic<bool> m_is_running{false};
+  std::atomic<u64> m_dropped_message_count{0};
+  std::atomic<u64> m_outgoing_queue_full_count{0};
+  std::atomic<u64> m_incoming_queue_full_count{0};
+  // Only taken once per tick to publish the metrics, never when queueing messages.
+  mutable std::mutex m_metrics_mutex{};
+  // Snapshot of [m_neptun]'s metrics, guarded by [m_metrics_mutex].
+  NeptunMetrics m_metrics{"Neptun metrics"};
+
+  bool enqueue(MessageKind kind, IpAddress ip, const_byte_span payload) {
+    if (payload.size() > m_max_message_size) {
+      return false;
+    }
+    bool is_queued = m_outgoing_messages.try_push([kind, ip, payload](QueuedMessage &message) {
+      message.kind = kind;
+      message.peer = ip;
+      message.payload.assign(payload.begin(), payload.end());
+    });
+    if (!is_queued) {
+      m_outgoing_queue_full_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    return is_queued;
+  }
+
+  void handle_outgoing_message(QueuedMessage &message, time_point<Clock> now) {
+    if (message.kind == MessageKind::CONNECT) {
+      if (m_neptun->is_connected(message.peer)) {
+        return;
+      }
+      try {
+        m_neptun->connect(message.peer, now);
+      } catch (const std::runtime_error &error) {
+        // TODO: Use proper logging.
+        std::cerr << error.what() << std::endl;
+      }
+      return;
+    }
+    if (!m_neptun->is_connected(message.peer)) {
+      m_dropped_message_count.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    bool is_written = false;
+    auto write_to_buffer = copy_payload(message.payload, is_written);
+    if (message.kind == MessageKind::RELIABLE) {
+      m_neptun->send_reliable_to(message.peer, write_to_buffer, now);
+    } else {
+      m_neptun->send_unreliable_to(message.peer, write_to_buffer, now);
+    }
+    if (!is_written) {
+      // The sender has already been told that the message is queued, so the drop is counted.
+      m_dropped_message_count.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+};
+
+}
+
+#endif //NEPTUN_NEPTUN_THREADED_NEPTUN_H
@@ -0,0 +1,150 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/types.h"
+#include "common/fake_clock.h"
+#include "network/fake_network.h"
+#include "neptun/threaded_neptun.h"
+
+using namespace freezing;
+using namespace freezing::network;
+using namespace freezing::network::testing;
+
+namespace {
+const IpAddress kServerIp = IpAddress::from_ipv4("192.168.0.10", 1000);
+const IpAddress kClientIp = IpAddress::from_ipv4("192.168.0.20", 2000);
+constexpr ConnectionManagerConfig kConnectionManagerConfig{5,
+                                                           BandwidthLimit{.max_read_packet_rate=0, .max_read_packet_size=1400, .max_send_packet_rate=0, .max_send_packet_size=1400}};
+const FakeClock::time_point kNow = FakeClock::now();
+
+using TestNeptun = Neptun<FakeNetwork, FakeClock>;
+using TestThreadedNeptun = ThreadedNeptun<FakeNetwork, FakeClock>;
+
+// Returns the time after the handshake.
+time_point<FakeClock> connect(TestThreadedNeptun &client, TestNeptun &server) {
+  EXPECT_TRUE(client.connect(kServerIp));
+  auto now = kNow;
+  for (usize round = 0; round < 3; round++, now += milliseconds(100)) {
+    client.tick(now);
+    server.tick(now);
+  }
+  EXPECT_TRUE(server.is_connected(kClientIp));
+  return now;
+}
+
+byte_span span_of_string(const std::string &s) {
+  return byte_span((u8 *) s.data(), s.size());
+}
+}
+
+TEST(ThreadedNeptunTest, SendsMessagesFromManyThreads) {
+  constexpr usize kProducerCount = 3;
+  constexpr usize kMessagesPerProducer = 100;
+  FakeNetwork fake_network{};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
+  TestThreadedNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  auto now = connect(client, server);
+
+  // E.g. the simulation, chat and matchmaking threads.
+  std::vector<std::thread> producers{};
+  for (usize producer = 0; producer < kProducerCount; producer++) {
+    producers.emplace_back([&client, producer]() {
+      for (usize i = 0; i < kMessagesPerProducer; i++) {
+        std::string message = std::to_string(producer) + " " + std::to_string(i);
+        ASSERT_TRUE(client.send_reliable_to(kServerIp, span_of_string(message)));
+      }
+    });
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  ASSERT_EQ(client.metrics().value(NeptunMetricKey::OUTGOING_QUEUE_DEPTH),
+            kProducerCount * kMessagesPerProducer);
+
+  // Messages of every producer arrive in the order they were sent.
+  std::vector<usize> next_messages(kProducerCount, 0);
+  for (usize i = 0; i < 20; i++, now += milliseconds(10)) {
+    client.tick(now);
+    server.tick(now, [&next_messages](IpAddress sender, byte_span payload) {
+      std::string message(payload.begin(), payload.end());
+      usize producer = std::stoul(message.substr(0, message.find(' ')));
+      ASSERT_EQ(message, std::to_string(producer) + " " + std::to_string(next_messages[producer]));
+      next_messages[producer]++;
+    });
+  }
+  ASSERT_EQ(next_messages, std::vector<usize>(kProducerCount, kMessagesPerProducer));
+  ASSERT_EQ(client.metrics().value(NeptunMetricKey::OUTGOING_QUEUE_DEPTH), 0);
+  ASSERT_EQ(client.dropped_message_count(), 0);
+}
+
+TEST(ThreadedNeptunTest, PollsReceivedMessages) {
+  FakeNetwork fake_network{};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
+  TestThreadedNeptun client{fake_network, kClientIp, kConnectionManagerConfig};
+  auto now = connect(client, server);
+
+  auto write_message = [](const std::string &message) {
+    return [message](byte_span buffer) {
+      std::copy(message.begin(), message.end(), buffer.begin());
+      return buffer.first(message.size());
+    };
+  };
+  server.send_reliable_to(kClientIp, write_message("reliable"), now);
+  server.send_unreliable_to(kClientIp, write_message("unreliable"), now);
+  server.tick(now);
+  client.tick(now);
+  ASSERT_EQ(client.metrics().value(NeptunMetricKey::INCOMING_QUEUE_DEPTH), 2);
+
+  std::vector<std::string> messages{};
+  auto on_message = [&messages](const std::string &kind) {
+    return [&messages, kind](IpAddress sender, byte_span payload) {
+      ASSERT_EQ(sender, kServerIp);
+      messages.push_back(kind + ": " + std::string(payload.begin(), payload.end()));
+    };
+  };
+  ASSERT_EQ(client.poll(on_message("reliable"), on_message("unreliable")), 2);
+  ASSERT_EQ(messages, (std::vector<std::string>{"reliable: reliable", "unreliable: unreliable"}));
+  ASSERT_EQ(client.metrics().value(NeptunMetricKey::INCOMING_QUEUE_DEPTH), 0);
+}
+
+TEST(ThreadedNeptunTest, OutgoingQueueIsBounded) {
+  FakeNetwork fake_network{};
+  TestThreadedNeptun client{fake_network, kClientIp, kConnectionManagerConfig,
+                            freezing::network::detail::kDefaultPacketTimeout, NeptunConfig{},
+                            ThreadedNeptunConfig{.outgoing_queue_capacity = 2, .max_message_size = 8}};
+  std::string message = "message";
+  ASSERT_TRUE(client.send_reliable_to(kServerIp, span_of_string(message)));
+  ASSERT_TRUE(client.send_unreliable_to(kServerIp, span_of_string(message)));
+  ASSERT_FALSE(client.send_reliable_to(kServerIp, span_of_string(message)));
+  ASSERT_EQ(client.metrics().value(NeptunMetricKey::OUTGOING_QUEUE_FULL), 1);
+
+  // The peer isn't connected, so the messages are dropped.
+  client.tick(kNow);
+  ASSERT_EQ(client.dropped_message_count(), 2);
+
+  std::string large_message = "large message";
+  ASSERT_FALSE(client.send_reliable_to(kServerIp, span_of_string(large_message)));
+}
+
+TEST(ThreadedNeptunTest, CountsMessagesThatDontFitStreamBuffer) {
+  FakeNetwork fake_network{};
+  TestNeptun server{fake_network, kServerIp, kConnectionManagerConfig};
+  TestThreadedNeptun client{fake_network, kClientIp, kConnectionManagerConfig,
+                            freezing::network::detail::kDefaultPacketTimeout,
+                            NeptunConfig{.reliable_stream_capacity = 16}};
+  auto now = connect(client, server);
+
+  // Only two messages fit into the reliable stream buffer until they are acked.
+  std::string message = "message";
+  ASSERT_TRUE(client.send_reliable_to(kServerIp, span_of_string(message)));
+  ASSERT_TRUE(client.send_reliable_to(kServerIp, span_of_string(message)));
+  ASSERT_TRUE(client.send_reliable_to(kServerIp, span_of_string(message)));
+  client.tick(now);
+  ASSERT_EQ(client.dropped_message_count(), 1);
+}
@@ -0,0 +1,139 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+// Measures the cost of [Neptun::tick] and [Neptun::next_deadline] on a server with many
+// connected, mostly idle peers: a few peers are sent a reliable message on every tick, and the
+// rest only get a keepalive.
+// The clients are disconnected from the network once the handshake is done, so that only the
+// server's work is measured.
+// Usage: bin_tick_benchmark [peer_count]
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "common/fake_clock.h"
+#include "network/fake_network.h"
+#include "neptun/neptun.h"
+
+using namespace freezing;
+using namespace freezing::network;
+using namespace freezing::network::testing;
+
+namespace {
+
+using BenchmarkNeptun = Neptun<FakeNetwork, FakeClock>;
+
+const IpAddress kServerIp = IpAddress::from_ipv4("10.0.0.1", 1000);
+constexpr usize kDefaultPeerCount = 50'000;
+// Fewer clients than the server reads per tick.
+constexpr usize kConnectChunkSize = 200;
+constexpr usize kTickCount = 2000;
+constexpr usize kActivePeersPerTick = 10;
+constexpr milliseconds kTickInterval{1};
+
+ConnectionManagerConfig server_config(u16 send_rate) {
+  return ConnectionManagerConfig{0, BandwidthLimit{.max_read_packet_rate=0, .max_read_packet_size=1400,
+      .max_send_packet_rate=send_rate, .max_send_packet_size=1400}};
+}
+
+IpAddress client_ip(usize i) {
+  return IpAddress::from_u32(0x0B000000 + static_cast<u32>(i / 1000), static_cast<u16>(10000 + i % 1000));
+}
+
+// Connects [peer_count] clients to the server and returns the time after the handshakes.
+time_point<FakeClock> connect_clients(BenchmarkNeptun &server,
+                                      FakeNetwork &fake_network,
+                                      usize peer_count) {
+  ConnectionManagerConfig client_config{0, BandwidthLimit{.max_read_packet_rate=0, .max_read_packet_size=1400,
+      .max_send_packet_rate=0, .max_send_packet_size=1400}};
+  // A single read buffer per client keeps the memory usage low.
+  NeptunConfig neptun_config{.read_batch_size = 1};
+  time_point<FakeClock> now = FakeClock::now();
+  for (usize first = 0; first < peer_count; first += kConnectChunkSize) {
+    std::vector<std::unique_ptr<BenchmarkNeptun>> clients{};
+    for (usize i = first; i < std::min(peer_count, first + kConnectChunkSize); i++) {
+      clients.push_back(std::make_unique<BenchmarkNeptun>(fake_network,
+                                                          client_ip(i),
+                                                          client_config,
+                                                          freezing::network::detail::kDefaultPacketTimeout,
+                                                          neptun_config));
+      clients.back()->connect(kServerIp, now);
+    }
+    for (usize round = 0; round < 3; round++) {
+      for (auto &client : clients) {
+        client->tick(now);
+      }
+      server.tick(now);
+      now += milliseconds(100);
+    }
+    for (usize i = first; i < first + clients.size(); i++) {
+      if (!server.is_connected(client_ip(i))) {
+        throw std::runtime_error("Client " + client_ip(i).to_string() + " failed to connect");
+      }
+    }
+  }
+  return now;
+}
+
+void run(usize peer_count, u16 send_rate) {
+  FakeNetwork fake_network{};
+  // The disconnected clients must not be evicted.
+  NeptunConfig neptun_config{.idle_timeout = std::chrono::hours(1)};
+  BenchmarkNeptun server{fake_network,
+                         kServerIp,
+                         server_config(send_rate),
+                         freezing::network::detail::kDefaultPacketTimeout,
+                         neptun_config};
+  auto now = connect_clients(server, fake_network, peer_count);
+  fake_network.drop_packets(true);
+  fake_network.clear_stats();
+
+  std::mt19937 rng{42};
+  std::string message = "state update";
+  auto write_message = [&message](byte_span buffer) {
+    std::copy(message.begin(), message.end(), buffer.begin());
+    return buffer.first(message.size());
+  };
+  double tick_ns = 0;
+  double next_deadline_ns = 0;
+  for (usize tick = 0; tick < kTickCount; tick++) {
+    now += kTickInterval;
+    for (usize i = 0; i < kActivePeersPerTick; i++) {
+      server.send_reliable_to(client_ip(rng() % peer_count), write_message, now);
+    }
+    auto start = std::chrono::steady_clock::now();
+    server.tick(now);
+    tick_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+        .count();
+    // An event loop asks for the next deadline after every tick.
+    start = std::chrono::steady_clock::now();
+    auto deadline = server.next_deadline();
+    next_deadline_ns +=
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (!deadline) {
+      throw std::runtime_error("No deadline with connected peers");
+    }
+  }
+  double sent_packets = static_cast<double>(fake_network.stats(kServerIp).num_sent_packets);
+  std::cout << peer_count << " peers, send rate " << static_cast<u32>(send_rate)
+            << "/s: tick " << tick_ns / kTickCount / 1000.0 << " us, next_deadline "
+            << next_deadline_ns / kTickCount / 1000.0 << " us, "
+            << sent_packets / kTickCount << " packets sent per tick" << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+  usize peer_count = argc > 1 ? std::stoul(argv[1]) : kDefaultPeerCount;
+  for (u16 send_rate : {1, 10}) {
+    run(peer_count, send_rate);
+  }
+  return 0;
+}
@@ -96,6 +96,10 @@ public:
     }
   }
 
+  bool has_pending_messages() const {
+    return !m_pending_messages.empty();
+  }
+
 private:
   FlipBuffer<u8> m_buffer;
   std::deque<byte_span> m_pending_messages;
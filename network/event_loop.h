@@ -0,0 +1,160 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NETWORK_EVENT_LOOP_H
+#define NEPTUN_NETWORK_EVENT_LOOP_H
+
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "common/types.h"
+#include "network/network.h"
+
+#if PLATFORM == PLATFORM_UNIX
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#elif PLATFORM == PLATFORM_MAC
+
+#include <poll.h>
+
+#endif
+
+namespace freezing::network {
+
+enum class WakeReason {
+  // The socket has data to read.
+  READABLE,
+  // The deadline has passed, or the wait was interrupted.
+  DEADLINE,
+};
+
+// Blocks the thread until a socket is readable or a deadline passes, so that a Neptun loop can
+// sleep instead of busy-polling:
+//
+//   EventLoop<system_clock> event_loop{neptun.socket_fd()};
+//   while (true) {
+//     neptun.tick(system_clock::now());
+//     event_loop.wait(neptun.next_deadline());
+//   }
+//
+// On Linux, it waits with epoll on the socket and a timerfd armed with the absolute deadline,
+// which has nanosecond precision. Elsewhere, it falls back to poll with millisecond precision,
+// rounded up so that it never wakes up before the deadline.
+template<typename Clock>
+class EventLoop {
+public:
+  explicit EventLoop(FileDescriptor socket_fd) : m_socket_fd{socket_fd} {
+#if PLATFORM == PLATFORM_UNIX
+    static_assert(std::is_same_v<Clock, std::chrono::system_clock>
+                      || std::is_same_v<Clock, std::chrono::steady_clock>,
+                  "timerfd supports only the system and the steady clock");
+    constexpr int kClockId =
+        std::is_same_v<Clock, std::chrono::steady_clock> ? CLOCK_MONOTONIC : CLOCK_REALTIME;
+    // https://man7.org/linux/man-pages/man2/timerfd_create.2.html
+    m_timer_fd = ::timerfd_create(kClockId, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_timer_fd == -1) {
+      throw std::runtime_error("Failed to create timerfd: " + std::to_string(errno));
+    }
+    // https://man7.org/linux/man-pages/man2/epoll_create.2.html
+    m_epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd == -1) {
+      ::close(m_timer_fd);
+      throw std::runtime_error("Failed to create epoll: " + std::to_string(errno));
+    }
+    add_to_epoll(m_socket_fd.value);
+    add_to_epoll(m_timer_fd);
+#endif
+  }
+
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator=(const EventLoop &) = delete;
+
+  ~EventLoop() {
+#if PLATFORM == PLATFORM_UNIX
+    ::close(m_epoll_fd);
+    ::close(m_timer_fd);
+#endif
+  }
+
+  // Blocks until the socket is readable or [deadline] passes. Without a deadline, it blocks
+  // until the socket is readable.
+  WakeReason wait(std::optional<time_point<Clock>> deadline) {
+    if (deadline && *deadline <= Clock::now()) {
+      return WakeReason::DEADLINE;
+    }
+#if PLATFORM == PLATFORM_UNIX
+    arm_timer(deadline);
+    std::array<epoll_event, 2> events{};
+    // https://man7.org/linux/man-pages/man2/epoll_wait.2.html
+    int event_count = ::epoll_wait(m_epoll_fd, events.data(), events.size(), -1);
+    if (event_count == -1 && errno == EINTR) {
+      return WakeReason::DEADLINE;
+    } else if (event_count == -1) {
+      throw std::runtime_error("Failed to wait for events: " + std::to_string(errno));
+    }
+    WakeReason reason = WakeReason::DEADLINE;
+    for (int i = 0; i < event_count; i++) {
+      if (events[i].data.fd == m_socket_fd.value) {
+        reason = WakeReason::READABLE;
+      } else if (events[i].data.fd == m_timer_fd) {
+        // Consume the expiration, otherwise the timerfd stays readable.
+        u64 expiration_count;
+        [[maybe_unused]] auto read_bytes = ::read(m_timer_fd, &expiration_count, sizeof(expiration_count));
+      }
+    }
+    return reason;
+#else
+    int timeout_ms = -1;
+    if (deadline) {
+      auto timeout = std::chrono::ceil<milliseconds>(*deadline - Clock::now());
+      timeout_ms = static_cast<int>(std::max<milliseconds::rep>(timeout.count(), 0));
+    }
+    pollfd poll_fd{m_socket_fd.value, POLLIN, 0};
+    int event_count = ::poll(&poll_fd, 1, timeout_ms);
+    if (event_count == -1 && errno != EINTR) {
+      throw std::runtime_error("Failed to wait for events: " + std::to_string(errno));
+    }
+    return event_count > 0 ? WakeReason::READABLE : WakeReason::DEADLINE;
+#endif
+  }
+
+private:
+  FileDescriptor m_socket_fd;
+#if PLATFORM == PLATFORM_UNIX
+  int m_epoll_fd{-1};
+  int m_timer_fd{-1};
+
+  void add_to_epoll(int fd) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (::epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+      throw std::runtime_error("Failed to add fd to epoll: " + std::to_string(fd));
+    }
+  }
+
+  // Arms the timer with the absolute [deadline], or disarms it.
+  void arm_timer(std::optional<time_point<Clock>> deadline) {
+    itimerspec timer_spec{};
+    if (deadline) {
+      auto since_epoch = std::chrono::duration_cast<nanoseconds>(deadline->time_since_epoch());
+      // A zero value disarms the timer, but the deadline is in the future so it's never zero.
+      timer_spec.it_value.tv_sec = std::chrono::duration_cast<seconds>(since_epoch).count();
+      timer_spec.it_value.tv_nsec = (since_epoch % seconds(1)).count();
+    }
+    // https://man7.org/linux/man-pages/man2/timerfd_settime.2.html
+    if (::timerfd_settime(m_timer_fd, TFD_TIMER_ABSTIME, &timer_spec, nullptr) == -1) {
+      throw std::runtime_error("Failed to arm timerfd: " + std::to_string(errno));
+    }
+  }
+#endif
+};
+
+}
+
+#endif //NEPTUN_NETWORK_EVENT_LOOP_H
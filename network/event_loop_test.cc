@@ -0,0 +1,64 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+
+#include "network.h"
+#include "event_loop.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+
+const auto kReceiverIp = IpAddress::from_ipv4("127.0.0.1", 47301);
+const auto kSenderIp = IpAddress::from_ipv4("127.0.0.1", 47302);
+
+using Clock = std::chrono::steady_clock;
+
+struct Sockets {
+  FileDescriptor receiver;
+  FileDescriptor sender;
+
+  Sockets() : receiver{OS_NETWORK.udp_socket_ipv4()}, sender{OS_NETWORK.udp_socket_ipv4()} {
+    OS_NETWORK.bind(receiver, kReceiverIp);
+    OS_NETWORK.set_non_blocking(receiver);
+    OS_NETWORK.bind(sender, kSenderIp);
+  }
+
+  ~Sockets() {
+    OS_NETWORK.close_socket(receiver);
+    OS_NETWORK.close_socket(sender);
+  }
+};
+
+}
+
+TEST(EventLoopTest, WakesUpAtDeadline) {
+  Sockets sockets{};
+  EventLoop<Clock> event_loop{sockets.receiver};
+
+  auto deadline = Clock::now() + milliseconds(20);
+  ASSERT_EQ(event_loop.wait(deadline), WakeReason::DEADLINE);
+  ASSERT_GE(Clock::now(), deadline);
+
+  // A deadline in the past doesn't block.
+  ASSERT_EQ(event_loop.wait(Clock::now() - milliseconds(1)), WakeReason::DEADLINE);
+}
+
+TEST(EventLoopTest, WakesUpWhenSocketIsReadable) {
+  Sockets sockets{};
+  EventLoop<Clock> event_loop{sockets.receiver};
+
+  std::vector<u8> payload(10);
+  OS_NETWORK.send_to(sockets.sender, kReceiverIp, payload);
+  auto start = Clock::now();
+  ASSERT_EQ(event_loop.wait(start + seconds(5)), WakeReason::READABLE);
+  ASSERT_LT(Clock::now(), start + seconds(1));
+
+  // Once the socket is drained, the loop waits for the deadline again.
+  std::vector<u8> buffer(1600);
+  ASSERT_TRUE(OS_NETWORK.read_from_socket(sockets.receiver, buffer));
+  ASSERT_EQ(event_loop.wait(Clock::now() + milliseconds(5)), WakeReason::DEADLINE);
+}
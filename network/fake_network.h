@@ -6,8 +6,10 @@
 #define NEPTUN__FAKE_NETWORK_H
 
 #include <algorithm>
+#include <map>
 #include <stdexcept>
 #include <queue>
+#include <set>
 #include <vector>
 
 #include "network/network.h"
@@ -18,6 +20,8 @@ namespace freezing::network::testing {
 namespace detail {
 
 constexpr int kReasonableMtu = 1400;
+// Linux coalesces at most 64 datagrams (UDP_MAX_SEGMENTS) into a single GRO buffer.
+constexpr usize kMaxCoalescedSegments = 64;
 
 struct PendingPacket {
   IpAddress sender;
@@ -28,21 +32,12 @@ struct UdpPackets {
   std::queue<PendingPacket> packets;
 };
 
-struct SocketPredicate {
-  FileDescriptor socket_fd;
-
-  bool operator()(std::pair<IpAddress, FileDescriptor> candidate) const {
-    return socket_fd.value == candidate.second.value;
-  };
-};
-
 struct IpAddressOrSocketPredicate {
   FileDescriptor socket_fd;
   IpAddress ip;
 
   bool operator()(std::pair<IpAddress, FileDescriptor> candidate) const {
-    return ip.to_string() == candidate.first.to_string()
-        || socket_fd.value == candidate.second.value;
+    return ip == candidate.first || socket_fd.value == candidate.second.value;
   };
 };
 
@@ -73,12 +68,16 @@ public:
         std::end(m_bind),
         detail::IpAddressOrSocketPredicate{fd, ip_address});
 
-    if (it != m_bind.end()) {
+    // Sockets can share the IP only if all of them have SO_REUSEPORT set.
+    bool can_share_ip = it != m_bind.end() && it->second.value != fd.value
+        && m_reuse_port_fds.contains(fd.value) && m_reuse_port_fds.contains(it->second.value);
+    if (it != m_bind.end() && !can_share_ip) {
       throw std::runtime_error("IP " + ip_address.to_string() + " is already bound to a socket "
                                    + std::to_string(fd.value));
     }
 
     m_bind.emplace_back(ip_address, fd);
+    m_bound_ips.insert_or_assign(fd.value, ip_address);
   }
 
   FileDescriptor udp_socket_ipv4() {
@@ -90,6 +89,15 @@ public:
     // Fake sockets are always non-blocking for now.
   }
 
+  // Sockets with SO_REUSEPORT that are bound to the same IP have their own receive queues.
+  // Packets are distributed across them by hashing the sender, like the kernel does.
+  void set_reuse_port(FileDescriptor fd) {
+    if (is_socket_bound(fd)) {
+      throw std::runtime_error("Cannot set SO_REUSEPORT on bound socket: " + std::to_string(fd.value));
+    }
+    m_reuse_port_fds.insert(fd.value);
+  }
+
   // TODO: Rename to [read_from].
   std::optional<ReadPacketInfo> read_from_socket(FileDescriptor fd,
                                                  std::span<std::uint8_t> buffer) {
@@ -98,7 +106,7 @@ public:
       throw std::runtime_error(
           "Failed to read data from unbound socket: " + std::to_string(fd.value));
     }
-    auto &udp_packets = m_buffers[*ip];
+    auto &udp_packets = receive_queue(fd);
     if (udp_packets.packets.empty()) {
       return {};
     }
@@ -121,6 +129,24 @@ public:
     return {{packet.sender, {buffer.subspan(0, idx)}}};
   }
 
+  usize read_batch(FileDescriptor fd,
+                   std::span<byte_span> buffers,
+                   std::vector<ReadPacketInfo> &packets) {
+    usize read_count = 0;
+    for (auto buffer : buffers) {
+      auto packet_info = read_from_socket(fd, buffer);
+      if (!packet_info) {
+        break;
+      }
+      if (enabled_udp_offload(fd).receive_coalescing) {
+        coalesce(fd, buffer, *packet_info);
+      }
+      packets.push_back(*packet_info);
+      read_count++;
+    }
+    return read_count;
+  }
+
   [[nodiscard]] std::size_t send_to(FileDescriptor sender_fd,
                                     IpAddress ip_address,
                                     const_byte_span payload) {
@@ -139,9 +165,9 @@ public:
       return payload.size();
     }
 
-    auto &buffer = m_buffers[ip_address];
     // Safety: sender exists because [is_socket_bound] is satisfied.
     auto sender = *find_ip(sender_fd);
+    auto &buffer = destination_queue(ip_address, sender);
     buffer.packets.push({sender, std::vector(payload.begin(), payload.end())});
     // Limit packet payload to the size of MTU.
     auto &pending_packet = buffer.packets.back();
@@ -161,6 +187,57 @@ public:
     return payload.size();
   }
 
+  usize send_batch(FileDescriptor sender_fd, std::span<const SendPacketInfo> packets) {
+    usize packet_count = packets.size();
+    if (m_max_packets_per_send_batch) {
+      // Pretend that the socket's send buffer is full after sending the first few packets.
+      packet_count = std::min(packet_count, *m_max_packets_per_send_batch);
+    }
+    for (usize i = 0; i < packet_count; i++) {
+      const auto &packet = packets[i];
+      if (m_failing_destinations.contains(packet.recipient)) {
+        // Dropped like [OsNetwork] drops datagrams that fail because of their destination.
+        OS_NETWORK_METRICS.inc(NetworkMetricKey::SEND_ERRORS);
+        continue;
+      }
+      if (packet.segment_size > 0 && !enabled_udp_offload(sender_fd).segmentation) {
+        throw std::runtime_error(
+            "Failed to send segmented payload via socket without GSO: "
+                + std::to_string(sender_fd.value));
+      }
+      // Segments are delivered as separate datagrams, like the kernel does.
+      usize segment_size = packet.segment_size == 0 ? packet.payload.size() : packet.segment_size;
+      usize offset = 0;
+      do {
+        auto segment = packet.payload.subspan(
+            offset, std::min(segment_size, packet.payload.size() - offset));
+        auto sent_count = send_to(sender_fd, packet.recipient, segment);
+        assert(sent_count == segment.size());
+        offset += segment_size;
+      } while (offset < packet.payload.size());
+    }
+    return packet_count;
+  }
+
+  // Fake sockets support the offloads passed to [set_supported_udp_offload], all by default.
+  UdpOffload enable_udp_offload(FileDescriptor fd, UdpOffload requested) {
+    UdpOffload enabled{requested.segmentation && m_supported_udp_offload.segmentation,
+                       requested.receive_coalescing
+                           && m_supported_udp_offload.receive_coalescing};
+    m_udp_offload[fd.value] = enabled;
+    return enabled;
+  }
+
+  // Simulates a kernel that doesn't support some of the offloads.
+  void set_supported_udp_offload(UdpOffload supported) {
+    m_supported_udp_offload = supported;
+  }
+
+  // Limits the number of packets sent by each [send_batch] call, which simulates partial sends.
+  void set_max_packets_per_send_batch(std::optional<usize> max_packets_per_send_batch) {
+    m_max_packets_per_send_batch = max_packets_per_send_batch;
+  }
+
   void log_packets(bool should_log) {
     m_should_log_packets = should_log;
   }
@@ -173,6 +250,12 @@ public:
     m_should_drop_packets = should_drop_packets;
   }
 
+  // Simulates a destination that the kernel refuses to send to, e.g. port 0 or an unroutable
+  // address. Batched sends to it fail, see [OsNetwork::send_batch].
+  void fail_sends_to(IpAddress ip_address) {
+    m_failing_destinations.insert(ip_address);
+  }
+
   Stats stats(IpAddress ip) const {
     auto it = m_stats.find(ip);
     if (it == m_stats.end()) {
@@ -191,10 +274,81 @@ private:
   int m_mtu;
   int m_next_fd{0};
   bool m_should_drop_packets{false};
+  std::set<IpAddress> m_failing_destinations{};
+  std::optional<usize> m_max_packets_per_send_batch{};
+  UdpOffload m_supported_udp_offload{true, true};
+  std::map<int, UdpOffload> m_udp_offload{};
   std::vector<std::pair<IpAddress, FileDescriptor>> m_bind{};
+  // Index of [m_bind] by the socket, because sockets are looked up on every read and send.
+  std::map<int, IpAddress> m_bound_ips{};
   std::map<IpAddress, detail::UdpPackets> m_buffers{};
+  std::set<int> m_reuse_port_fds{};
+  // Receive queues of the sockets with SO_REUSEPORT.
+  std::map<int, detail::UdpPackets> m_reuse_port_buffers{};
   std::map<IpAddress, Stats> m_stats;
 
+  [[nodiscard]] UdpOffload enabled_udp_offload(FileDescriptor fd) const {
+    auto it = m_udp_offload.find(fd.value);
+    return it == m_udp_offload.end() ? UdpOffload{} : it->second;
+  }
+
+  // Appends the datagrams from the same sender that follow [packet_info] to its payload, as long
+  // as they are the same size, like GRO does. Only the last datagram may be shorter.
+  void coalesce(FileDescriptor fd, byte_span buffer, ReadPacketInfo &packet_info) {
+    auto ip = *find_ip(fd);
+    auto &udp_packets = receive_queue(fd).packets;
+    usize segment_size = packet_info.payload.size();
+    usize size = segment_size;
+    usize segment_count = 1;
+    while (!udp_packets.empty() && segment_count < detail::kMaxCoalescedSegments) {
+      const auto &next = udp_packets.front();
+      if (next.sender != packet_info.sender || next.payload.empty()
+          || next.payload.size() > segment_size || size + next.payload.size() > buffer.size()) {
+        break;
+      }
+      std::copy(next.payload.begin(), next.payload.end(), buffer.begin() + size);
+      size += next.payload.size();
+      segment_count++;
+      bool is_shorter = next.payload.size() < segment_size;
+      auto &stats = m_stats[ip];
+      stats.num_read_packets++;
+      stats.num_read_bytes += next.payload.size();
+      udp_packets.pop();
+      if (is_shorter) {
+        // A shorter datagram ends the coalesced buffer.
+        break;
+      }
+    }
+    if (segment_count > 1) {
+      packet_info.payload = buffer.first(size);
+      packet_info.segment_size = static_cast<u16>(segment_size);
+    }
+  }
+
+  detail::UdpPackets &receive_queue(FileDescriptor fd) {
+    if (m_reuse_port_fds.contains(fd.value)) {
+      return m_reuse_port_buffers[fd.value];
+    }
+    return m_buffers[*find_ip(fd)];
+  }
+
+  detail::UdpPackets &destination_queue(IpAddress ip, IpAddress sender) {
+    if (m_reuse_port_fds.empty()) {
+      return m_buffers[ip];
+    }
+    std::vector<int> reuse_port_fds{};
+    for (const auto&[bound_ip, fd] : m_bind) {
+      if (bound_ip == ip && m_reuse_port_fds.contains(fd.value)) {
+        reuse_port_fds.push_back(fd.value);
+      }
+    }
+    if (reuse_port_fds.empty()) {
+      return m_buffers[ip];
+    }
+    usize hash = static_cast<usize>((sender.packed() * 0x9E3779B97F4A7C15ull) >> 32);
+    return m_reuse_port_buffers[reuse_port_fds[hash % reuse_port_fds.size()]];
+  }
+
   [[nodiscard]] bool is_socket_open(FileDescriptor fd) const {
     return fd.value < m_next_fd;
   }
@@ -204,13 +358,9 @@ private:
   }
 
   [[nodiscard]] std::optional<IpAddress> find_ip(FileDescriptor socket_fd) const {
-    auto it = std::find_if(
-        std::begin(m_bind),
-        std::end(m_bind),
-        detail::SocketPredicate{socket_fd});
-
-    if (it != m_bind.end()) {
-      return {it->first};
+    auto it = m_bound_ips.find(socket_fd.value);
+    if (it != m_bound_ips.end()) {
+      return {it->second};
     }
     return {};
   }
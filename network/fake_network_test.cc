@@ -71,4 +71,186 @@ TEST(FakeNetworkTest, SendAndReadTooLargePacket) {
   buffer.resize(1500);
   auto data = network.read_from_socket(receiver_socket, std::span(buffer));
   ASSERT_EQ(span_to_string(data->payload), "This is");
-}
\ No newline at end of file
+}
+TEST(FakeNetworkTest, ReadBatch) {
+  FakeNetwork network{};
+  auto sender_socket = network.udp_socket_ipv4();
+  network.bind(sender_socket, ip);
+
+  auto receiver_socket = network.udp_socket_ipv4();
+  network.bind(receiver_socket, destination);
+
+  for (int i = 0; i < 3; i++) {
+    std::size_t sent_count = network.send_to(sender_socket, destination, payload);
+    ASSERT_EQ(sent_count, kMessageSize);
+  }
+
+  std::vector<std::uint8_t> buffer(4 * 1500);
+  std::vector<std::span<std::uint8_t>> buffers{};
+  for (int i = 0; i < 4; i++) {
+    buffers.emplace_back(buffer.begin() + i * 1500, buffer.begin() + (i + 1) * 1500);
+  }
+  std::vector<ReadPacketInfo> packets{};
+  ASSERT_EQ(network.read_batch(receiver_socket, buffers, packets), 3);
+  ASSERT_EQ(packets.size(), 3);
+  for (const auto &packet : packets) {
+    ASSERT_EQ(span_to_string(packet.payload), "This is test message.");
+    ASSERT_EQ(packet.sender, ip);
+  }
+
+  packets.clear();
+  ASSERT_EQ(network.read_batch(receiver_socket, buffers, packets), 0);
+  ASSERT_TRUE(packets.empty());
+}
+
+TEST(FakeNetworkTest, SendBatch) {
+  FakeNetwork network{};
+  auto sender_socket = network.udp_socket_ipv4();
+  network.bind(sender_socket, ip);
+
+  auto receiver_socket = network.udp_socket_ipv4();
+  network.bind(receiver_socket, destination);
+
+  std::vector<SendPacketInfo> packets{};
+  for (int i = 0; i < 3; i++) {
+    packets.push_back({destination, payload});
+  }
+  ASSERT_EQ(network.send_batch(sender_socket, packets), 3);
+  ASSERT_EQ(network.stats(ip).num_sent_packets, 3);
+
+  // Pretend that the socket's send buffer is full after the first packet.
+  network.set_max_packets_per_send_batch(1);
+  ASSERT_EQ(network.send_batch(sender_socket, packets), 1);
+  ASSERT_EQ(network.stats(ip).num_sent_packets, 4);
+}
+
+TEST(FakeNetworkTest, SendBatchDropsDatagramsToFailingDestination) {
+  const auto failing_destination = IpAddress::from_ipv4("127.0.0.1", 0);
+  FakeNetwork network{};
+  auto sender_socket = network.udp_socket_ipv4();
+  network.bind(sender_socket, ip);
+  auto receiver_socket = network.udp_socket_ipv4();
+  network.bind(receiver_socket, destination);
+  network.fail_sends_to(failing_destination);
+
+  auto send_errors = OS_NETWORK_METRICS.value(NetworkMetricKey::SEND_ERRORS);
+  std::vector<SendPacketInfo> packets{{failing_destination, payload}, {destination, payload}};
+  // The datagram to the failing destination is consumed, and doesn't block the next one.
+  ASSERT_EQ(network.send_batch(sender_socket, packets), 2);
+  ASSERT_EQ(network.stats(ip).num_sent_packets, 1);
+  ASSERT_EQ(OS_NETWORK_METRICS.value(NetworkMetricKey::SEND_ERRORS), send_errors + 1);
+
+  std::vector<std::uint8_t> buffer(1500);
+  auto packet = network.read_from_socket(receiver_socket, buffer);
+  ASSERT_TRUE(packet);
+  ASSERT_EQ(packet->sender, ip);
+}
+
+TEST(FakeNetworkTest, SendSegmentedPayload) {
+  FakeNetwork network{};
+  auto sender_socket = network.udp_socket_ipv4();
+  network.bind(sender_socket, ip);
+
+  auto receiver_socket = network.udp_socket_ipv4();
+  network.bind(receiver_socket, destination);
+
+  // Segmented payloads can't be sent before GSO is enabled.
+  std::vector<SendPacketInfo> packets{{destination, payload, 8}};
+  ASSERT_THROW(network.send_batch(sender_socket, packets), std::runtime_error);
+
+  ASSERT_EQ(network.enable_udp_offload(sender_socket, {true, false}), (UdpOffload{true, false}));
+  ASSERT_EQ(network.send_batch(sender_socket, packets), 1);
+  ASSERT_EQ(network.stats(ip).num_sent_packets, 3);
+
+  std::vector<std::uint8_t> buffer(1500);
+  ASSERT_EQ(span_to_string(network.read_from_socket(receiver_socket, buffer)->payload), "This is ");
+  ASSERT_EQ(span_to_string(network.read_from_socket(receiver_socket, buffer)->payload), "test mes");
+  ASSERT_EQ(span_to_string(network.read_from_socket(receiver_socket, buffer)->payload), "sage.");
+}
+
+TEST(FakeNetworkTest, ReadBatchCoalescesDatagrams) {
+  FakeNetwork network{};
+  auto sender_socket = network.udp_socket_ipv4();
+  network.bind(sender_socket, ip);
+
+  auto receiver_socket = network.udp_socket_ipv4();
+  network.bind(receiver_socket, destination);
+  ASSERT_EQ(network.enable_udp_offload(receiver_socket, {false, true}), (UdpOffload{false, true}));
+
+  for (int i = 0; i < 3; i++) {
+    std::size_t sent_count = network.send_to(sender_socket, destination, payload);
+    ASSERT_EQ(sent_count, kMessageSize);
+  }
+  // A shorter datagram is the last one that is coalesced.
+  ASSERT_EQ(network.send_to(sender_socket, destination, payload.first(4)), 4);
+  ASSERT_EQ(network.send_to(sender_socket, destination, payload), kMessageSize);
+
+  std::vector<std::uint8_t> buffer(2 * 1500);
+  std::vector<std::span<std::uint8_t>> buffers{{buffer.begin(), buffer.begin() + 1500},
+                                               {buffer.begin() + 1500, buffer.end()}};
+  std::vector<ReadPacketInfo> packets{};
+  ASSERT_EQ(network.read_batch(receiver_socket, buffers, packets), 2);
+  ASSERT_EQ(packets[0].segment_size, kMessageSize);
+  ASSERT_EQ(span_to_string(packets[0].payload),
+            "This is test message.This is test message.This is test message.This");
+  ASSERT_EQ(packets[1].segment_size, 0);
+  ASSERT_EQ(span_to_string(packets[1].payload), "This is test message.");
+  ASSERT_EQ(network.stats(destination).num_read_packets, 5);
+}
+
+TEST(FakeNetworkTest, UnsupportedUdpOffload) {
+  FakeNetwork network{};
+  auto socket = network.udp_socket_ipv4();
+  network.bind(socket, ip);
+  network.set_supported_udp_offload({false, true});
+  ASSERT_EQ(network.enable_udp_offload(socket, {true, true}), (UdpOffload{false, true}));
+}
+
+TEST(FakeNetworkTest, ReusePortDistributesPacketsBySender) {
+  constexpr int kNumSockets = 4;
+  constexpr int kNumSenders = 32;
+
+  FakeNetwork network{};
+  std::vector<FileDescriptor> sockets{};
+  for (int i = 0; i < kNumSockets; i++) {
+    auto socket = network.udp_socket_ipv4();
+    network.set_reuse_port(socket);
+    network.bind(socket, destination);
+    sockets.push_back(socket);
+  }
+  // A socket without SO_REUSEPORT can't join the group.
+  auto other_socket = network.udp_socket_ipv4();
+  ASSERT_THROW(network.bind(other_socket, destination), std::runtime_error);
+
+  for (int i = 0; i < kNumSenders; i++) {
+    auto sender_ip = IpAddress::from_ipv4("192.168.1.1", 1000 + i);
+    auto sender_socket = network.udp_socket_ipv4();
+    network.bind(sender_socket, sender_ip);
+    // Send twice, to check that the same sender is always delivered to the same socket.
+    for (int j = 0; j < 2; j++) {
+      ASSERT_EQ(network.send_to(sender_socket, destination, payload), kMessageSize);
+    }
+  }
+
+  std::vector<std::uint8_t> buffer(1500);
+  int total_read_count = 0;
+  int used_socket_count = 0;
+  std::set<IpAddress> seen_senders{};
+  for (auto socket : sockets) {
+    std::set<IpAddress> senders{};
+    int read_count = 0;
+    while (auto packet_info = network.read_from_socket(socket, buffer)) {
+      senders.insert(packet_info->sender);
+      read_count++;
+    }
+    ASSERT_EQ(read_count, 2 * senders.size());
+    for (auto sender : senders) {
+      ASSERT_FALSE(seen_senders.contains(sender));
+      seen_senders.insert(sender);
+    }
+    total_read_count += read_count;
+    used_socket_count += read_count > 0 ? 1 : 0;
+  }
+  ASSERT_EQ(total_read_count, 2 * kNumSenders);
+  ASSERT_GT(used_socket_count, 1);
+}
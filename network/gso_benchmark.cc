@@ -0,0 +1,96 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+// Compares sending MTU-sized datagrams on loopback with one sendto per datagram, and with GSO,
+// where each send carries [kSegmentsPerSend] datagrams.
+// Usage: bin_gso_benchmark [datagram_count]
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "network/network.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+
+constexpr u16 kDatagramSize = 1400;
+constexpr usize kSegmentsPerSend = 32;
+
+const IpAddress kSenderIp = IpAddress::from_ipv4("127.0.0.1", 47001);
+const IpAddress kReceiverIp = IpAddress::from_ipv4("127.0.0.1", 47002);
+
+struct BenchmarkResult {
+  std::chrono::nanoseconds elapsed;
+  usize send_count;
+};
+
+// Sockets are left blocking, so that a full send buffer slows the sender down instead of
+// failing the send.
+template<typename SendFn>
+BenchmarkResult run(SendFn send) {
+  auto sender = OS_NETWORK.udp_socket_ipv4();
+  OS_NETWORK.bind(sender, kSenderIp);
+  // Nobody reads from the receiver, it's only needed so that the datagrams have a destination.
+  auto receiver = OS_NETWORK.udp_socket_ipv4();
+  OS_NETWORK.bind(receiver, kReceiverIp);
+
+  auto start = std::chrono::steady_clock::now();
+  usize send_count = send(sender);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  OS_NETWORK.close_socket(sender);
+  OS_NETWORK.close_socket(receiver);
+  return {elapsed, send_count};
+}
+
+void print(const std::string &name, usize datagram_count, BenchmarkResult result) {
+  double seconds = std::chrono::duration<double>(result.elapsed).count();
+  double megabytes = static_cast<double>(datagram_count * kDatagramSize) / 1024.0 / 1024.0;
+  std::cout << name << ": " << datagram_count << " datagrams, " << result.send_count
+            << " syscalls in " << seconds * 1000.0 << " ms ("
+            << static_cast<double>(datagram_count) / seconds << " datagrams/s, "
+            << megabytes / seconds << " MB/s)" << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+  usize datagram_count = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+  std::vector<u8> payload(kDatagramSize * kSegmentsPerSend, 0xAB);
+
+  auto per_packet = run([&](FileDescriptor fd) {
+    for (usize i = 0; i < datagram_count; i++) {
+      OS_NETWORK.send_to(fd, kReceiverIp, const_byte_span(payload).first(kDatagramSize));
+    }
+    return datagram_count;
+  });
+  print("sendto", datagram_count, per_packet);
+
+  bool gso_supported = true;
+  auto gso = run([&](FileDescriptor fd) {
+    gso_supported = OS_NETWORK.enable_udp_offload(fd, {true, false}).segmentation;
+    usize send_count = 0;
+    for (usize sent = 0; sent < datagram_count; sent += kSegmentsPerSend) {
+      usize segment_count = std::min(kSegmentsPerSend, datagram_count - sent);
+      SendPacketInfo packet{kReceiverIp,
+                            const_byte_span(payload).first(segment_count * kDatagramSize),
+                            kDatagramSize};
+      OS_NETWORK.send_batch(fd, std::span(&packet, 1));
+      send_count++;
+    }
+    return send_count;
+  });
+  if (!gso_supported) {
+    std::cout << "GSO isn't supported, segments are sent one at a time." << std::endl;
+  }
+  print("gso", datagram_count, gso);
+  std::cout << "speedup: "
+            << std::chrono::duration<double>(per_packet.elapsed).count()
+                / std::chrono::duration<double>(gso.elapsed).count() << "x" << std::endl;
+  return 0;
+}
@@ -121,7 +121,7 @@ public:
     return read_unsigned<std::uint32_t>(idx);
   }
 
-  std::uint32_t read_u64(usize idx) const {
+  std::uint64_t read_u64(usize idx) const {
     return read_unsigned<std::uint64_t>(idx);
   }
 
@@ -0,0 +1,587 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NETWORK_IO_URING_NETWORK_H
+#define NEPTUN_NETWORK_IO_URING_NETWORK_H
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/types.h"
+#include "network/ip_address.h"
+#include "network/network.h"
+#include "network/network_metrics.h"
+
+namespace freezing::network {
+
+namespace detail {
+
+// Minimal io_uring, without liburing: the submission and completion rings are mapped into
+// memory shared with the kernel, and [enter] is the only syscall needed to submit requests.
+// Completions are read from the shared memory, without a syscall.
+// See https://man7.org/linux/man-pages/man7/io_uring.7.html
+class IoUring {
+public:
+  explicit IoUring(u32 entry_count) {
+    io_uring_params params{};
+    // Completions of the sends and receives are posted when the thread enters the kernel anyway,
+    // instead of interrupting it.
+    params.flags = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entry_count, &params));
+    if (fd < 0 && errno == EINVAL) {
+      // Older kernels don't support the flags.
+      params = {};
+      fd = static_cast<int>(::syscall(__NR_io_uring_setup, entry_count, &params));
+    }
+    if (fd < 0) {
+      throw std::runtime_error("Failed to set up io_uring: " + std::string(strerror(errno)));
+    }
+    m_fd = fd;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+      ::close(m_fd);
+      throw std::runtime_error("io_uring requires Linux 5.4 or newer");
+    }
+    m_ring_size = std::max(params.sq_off.array + params.sq_entries * sizeof(u32),
+                           params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    m_ring = ::mmap(nullptr, m_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    m_fd, IORING_OFF_SQ_RING);
+    m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = static_cast<io_uring_sqe *>(::mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES));
+    if (m_ring == MAP_FAILED || m_sqes == MAP_FAILED) {
+      release();
+      throw std::runtime_error("Failed to map io_uring: " + std::string(strerror(errno)));
+    }
+    auto *ring = static_cast<u8 *>(m_ring);
+    m_sq_tail = reinterpret_cast<std::atomic<u32> *>(ring + params.sq_off.tail);
+    m_sq_mask = *reinterpret_cast<u32 *>(ring + params.sq_off.ring_mask);
+    m_sq_array = reinterpret_cast<u32 *>(ring + params.sq_off.array);
+    m_cq_head = reinterpret_cast<std::atomic<u32> *>(ring + params.cq_off.head);
+    m_cq_tail = reinterpret_cast<std::atomic<u32> *>(ring + params.cq_off.tail);
+    m_cq_mask = *reinterpret_cast<u32 *>(ring + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe *>(ring + params.cq_off.cqes);
+    m_sq_entry_count = params.sq_entries;
+  }
+
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  // The kernel cancels the requests that are still in flight asynchronously, so the memory that
+  // they point to isn't safe to free yet. See [IoUringNetwork::Socket].
+  ~IoUring() {
+    release();
+  }
+
+  // Registers [buffers] with the kernel, so that requests with fixed buffers don't have to map
+  // the buffer's pages on every request.
+  void register_buffers(std::span<const iovec> buffers) {
+    if (::syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, buffers.data(),
+                  buffers.size()) < 0) {
+      throw std::runtime_error("Failed to register io_uring buffers: "
+                                   + std::string(strerror(errno)));
+    }
+  }
+
+  // Whether the kernel supports [opcode]. Kernels older than 5.6 can't be probed, so nothing is
+  // reported as supported.
+  bool supports(u8 opcode) const {
+    constexpr usize kMaxOpCount = 256;
+    std::vector<u8> buffer(sizeof(io_uring_probe) + kMaxOpCount * sizeof(io_uring_probe_op));
+    auto *probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+    if (::syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, kMaxOpCount) < 0) {
+      return false;
+    }
+    return opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+  }
+
+  // Returns a zeroed submission queue entry, which is submitted by the next [submit].
+  // The caller must not have more than [sq_entry_count] requests pending submission.
+  io_uring_sqe &next_sqe() {
+    assert(m_pending_count < m_sq_entry_count);
+    u32 index = (m_sq_local_tail + m_pending_count) & m_sq_mask;
+    m_pending_count++;
+    auto &sqe = m_sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    m_sq_array[index] = index;
+    return sqe;
+  }
+
+  // Submits the pending requests, and waits for at least [wait_count] completions.
+  // Doesn't make a syscall if there is nothing to submit or wait for.
+  void submit(u32 wait_count = 0) {
+    if (m_pending_count == 0 && wait_count == 0) {
+      return;
+    }
+    m_sq_local_tail += m_pending_count;
+    m_sq_tail->store(m_sq_local_tail, std::memory_order_release);
+    u32 to_submit = m_pending_count;
+    m_pending_count = 0;
+    while (true) {
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::SYSCALLS);
+      int result = static_cast<int>(::syscall(__NR_io_uring_enter, m_fd, to_submit, wait_count,
+                                              wait_count > 0 ? IORING_ENTER_GETEVENTS : 0,
+                                              nullptr, 0));
+      if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        throw std::runtime_error("Failed to submit io_uring requests: "
+                                     + std::string(strerror(errno)));
+      }
+      // Retry until all requests have been consumed by the kernel, which stops early if it runs
+      // out of memory or completion queue space.
+      if (result >= 0 && static_cast<u32>(result) == to_submit) {
+        return;
+      }
+      if (result > 0) {
+        to_submit -= result;
+      }
+    }
+  }
+
+  // Calls [on_completion] for every completion that is available, without a syscall.
+  template<typename OnCompletionFn>
+  void reap(OnCompletionFn on_completion) {
+    u32 head = m_cq_head->load(std::memory_order_relaxed);
+    u32 tail = m_cq_tail->load(std::memory_order_acquire);
+    while (head != tail) {
+      io_uring_cqe cqe = m_cqes[head & m_cq_mask];
+      // The entry is released before the callback, so that it isn't seen again if it throws.
+      m_cq_head->store(++head, std::memory_order_release);
+      on_completion(cqe);
+    }
+  }
+
+private:
+  int m_fd{-1};
+  void *m_ring{MAP_FAILED};
+  usize m_ring_size{0};
+  io_uring_sqe *m_sqes{static_cast<io_uring_sqe *>(MAP_FAILED)};
+  usize m_sqes_size{0};
+  std::atomic<u32> *m_sq_tail{nullptr};
+  u32 m_sq_mask{0};
+  u32 *m_sq_array{nullptr};
+  std::atomic<u32> *m_cq_head{nullptr};
+  std::atomic<u32> *m_cq_tail{nullptr};
+  u32 m_cq_mask{0};
+  io_uring_cqe *m_cqes{nullptr};
+  u32 m_sq_entry_count{0};
+  // Only the submitting thread writes the tail, so it's tracked locally.
+  u32 m_sq_local_tail{0};
+  // Entries that have been filled in, but not submitted yet.
+  u32 m_pending_count{0};
+
+  void release() {
+    if (m_sqes != MAP_FAILED) {
+      ::munmap(m_sqes, m_sqes_size);
+    }
+    if (m_ring != MAP_FAILED) {
+      ::munmap(m_ring, m_ring_size);
+    }
+    if (m_fd >= 0) {
+      ::close(m_fd);
+    }
+  }
+};
+
+}
+
+struct IoUringNetworkConfig {
+  // Number of receives that are kept in flight on each socket, each with its own buffer.
+  // Also the maximum number of datagrams that a socket can receive between two reads.
+  usize receive_buffer_count{256};
+  // Datagrams larger than this are truncated.
+  usize receive_buffer_size{2048};
+  // Number of sends that can be in flight on each socket, each with its own buffer.
+  usize send_buffer_count{256};
+  // Payloads larger than this can't be sent.
+  usize send_buffer_size{2048};
+  // Sends with IORING_OP_SEND_ZC from the registered buffers, instead of copying the payload
+  // into the socket's buffer. Only pays off for large datagrams on a real NIC.
+  // Requires Linux 6.0 or newer, otherwise creating a socket throws.
+  bool zero_copy_send{false};
+};
+
+// Network backend on top of io_uring (Linux 5.4 or newer), which can be used instead of
+// [OsNetwork] with [UdpSocket] and [Neptun].
+//
+// Every socket has its own ring with [receive_buffer_count] receives that are always in flight,
+// so reading datagrams that have arrived doesn't need a syscall. Sends are copied into the
+// socket's registered send buffers and submitted together with the receives that are rearmed,
+// with a single io_uring_enter per batch. Rearmed receives are only submitted on their own once
+// fewer than half of the receives are in flight.
+//
+// Unlike [OsNetwork], the datagrams returned by [read_batch] point into the socket's receive
+// buffers instead of the given buffers, and stay valid until the next read from the socket.
+// Sends complete asynchronously, so a send that fails in the kernel is only counted in
+// [NetworkMetricKey::SEND_ERRORS]. Sockets are always non-blocking from the caller's point of
+// view, since no syscall waits for the network.
+//
+// The ring takes the datagrams off the socket as they arrive, so the socket never becomes
+// readable for [EventLoop]. Not thread-safe: each thread needs its own instance.
+class IoUringNetwork {
+public:
+  explicit IoUringNetwork(IoUringNetworkConfig config = {}) : m_config{config} {}
+
+  IoUringNetwork(const IoUringNetwork &) = delete;
+  IoUringNetwork &operator=(const IoUringNetwork &) = delete;
+
+  void initialize() {}
+
+  void shutdown() {}
+
+  FileDescriptor udp_socket_ipv4() {
+    auto fd = m_os_network.udp_socket_ipv4();
+    try {
+      m_sockets.emplace(fd.value, std::make_unique<Socket>(fd, m_config));
+    } catch (...) {
+      m_os_network.close_socket(fd);
+      throw;
+    }
+    return fd;
+  }
+
+  void bind(FileDescriptor fd, IpAddress ip_address) {
+    m_os_network.bind(fd, ip_address);
+  }
+
+  // The socket stays blocking, so that the requests wait for the socket in the kernel instead of
+  // failing with EAGAIN.
+  void set_non_blocking(FileDescriptor) {}
+
+  void set_reuse_port(FileDescriptor fd) {
+    m_os_network.set_reuse_port(fd);
+  }
+
+  // Datagrams are sent and received one at a time, so no offloads are enabled.
+  UdpOffload enable_udp_offload(FileDescriptor, UdpOffload) {
+    return {};
+  }
+
+  void close_socket(FileDescriptor fd) {
+    // Destroying the socket cancels the requests that are in flight, and waits for them.
+    m_sockets.erase(fd.value);
+    m_os_network.close_socket(fd);
+  }
+
+  std::optional<ReadPacketInfo> read_from_socket(FileDescriptor fd, byte_span buffer) {
+    std::vector<ReadPacketInfo> packets{};
+    if (read_batch(fd, std::span(&buffer, 1), packets) == 0) {
+      return {};
+    }
+    return packets.front();
+  }
+
+  // Returns up to [buffers.size()] datagrams that have been received, and rearms the receives
+  // of the datagrams returned by the previous read.
+  usize read_batch(FileDescriptor fd,
+                   std::span<byte_span> buffers,
+                   std::vector<ReadPacketInfo> &packets) {
+    auto &socket = socket_of(fd);
+    socket.rearm_returned_receives();
+    if (socket.armed_count() < socket.receives.size() / 2) {
+      // Otherwise the rearmed receives are submitted together with the next sends.
+      socket.submit();
+    }
+    socket.reap_completions();
+
+    usize read_count = 0;
+    while (read_count < buffers.size() && !socket.received.empty()) {
+      usize index = socket.received.front();
+      socket.received.pop_front();
+      socket.returned.push_back(index);
+      auto &receive = socket.receives[index];
+      packets.push_back({IpAddress(receive.sender), receive.buffer.first(receive.size)});
+      read_count++;
+    }
+    if (read_count > 0) {
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::BATCHED_READS);
+    }
+    return read_count;
+  }
+
+  std::size_t send_to(FileDescriptor fd, IpAddress ip_address, const_byte_span payload) {
+    SendPacketInfo packet{ip_address, payload};
+    auto &socket = socket_of(fd);
+    while (send_batch(fd, std::span(&packet, 1)) == 0) {
+      // All send buffers are in flight, so wait for one of them.
+      socket.submit(1);
+      socket.reap_completions();
+    }
+    return payload.size();
+  }
+
+  // Queues the packets for sending, and submits them with a single syscall.
+  // Returns the number of packets that have been queued. If it's smaller than [packets.size()],
+  // all send buffers are in flight and the remaining packets must be sent later.
+  usize send_batch(FileDescriptor fd, std::span<const SendPacketInfo> packets) {
+    auto &socket = socket_of(fd);
+    socket.reap_completions();
+    usize sent_count = 0;
+    for (const auto &packet : packets) {
+      usize segment_size = packet.segment_size == 0 ? std::max<usize>(packet.payload.size(), 1)
+                                                    : packet.segment_size;
+      usize segment_count = std::max<usize>((packet.payload.size() + segment_size - 1) / segment_size, 1);
+      if (socket.free_sends.size() < segment_count) {
+        break;
+      }
+      for (usize offset = 0; offset < std::max<usize>(packet.payload.size(), 1); offset += segment_size) {
+        socket.send(packet.recipient,
+                    packet.payload.subspan(offset, std::min(segment_size, packet.payload.size() - offset)),
+                    m_config.zero_copy_send);
+      }
+      sent_count++;
+    }
+    if (sent_count > 0) {
+      socket.submit();
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::BATCHED_SENDS);
+    }
+    return sent_count;
+  }
+
+private:
+  enum class RequestKind : u32 {
+    RECEIVE = 1,
+    SEND = 2,
+    CANCEL = 3,
+  };
+
+  struct Receive {
+    byte_span buffer;
+    sockaddr_in sender{};
+    iovec iov{};
+    msghdr header{};
+    usize size{0};
+  };
+
+  struct Send {
+    byte_span buffer;
+    sockaddr_in recipient{};
+    iovec iov{};
+    msghdr header{};
+  };
+
+  struct Socket {
+    Socket(FileDescriptor fd, const IoUringNetworkConfig &config)
+        : fd{fd},
+          receive_pool(config.receive_buffer_count * config.receive_buffer_size),
+          send_pool(config.send_buffer_count * config.send_buffer_size),
+          receives(config.receive_buffer_count),
+          sends(config.send_buffer_count),
+          ring{static_cast<u32>(config.receive_buffer_count + config.send_buffer_count)} {
+      assert(config.receive_buffer_count > 0 && config.send_buffer_count > 0);
+      // Older kernels don't have the opcode, and would fail every send asynchronously.
+      if (config.zero_copy_send && !ring.supports(IORING_OP_SEND_ZC)) {
+        throw std::runtime_error("Zero-copy sends with io_uring require Linux 6.0 or newer");
+      }
+      for (usize i = 0; i < receives.size(); i++) {
+        receives[i].buffer = byte_span(receive_pool).subspan(i * config.receive_buffer_size,
+                                                             config.receive_buffer_size);
+        returned.push_back(i);
+      }
+      for (usize i = 0; i < sends.size(); i++) {
+        sends[i].buffer = byte_span(send_pool).subspan(i * config.send_buffer_size,
+                                                       config.send_buffer_size);
+        free_sends.push_back(i);
+      }
+      std::array<iovec, 1> registered{iovec{send_pool.data(), send_pool.size()}};
+      ring.register_buffers(registered);
+    }
+
+    Socket(const Socket &) = delete;
+    Socket &operator=(const Socket &) = delete;
+
+    // The requests in flight point into the buffers, so they must have completed before the
+    // buffers are freed. Closing the ring doesn't wait for them.
+    ~Socket() {
+      try {
+        cancel_requests();
+      } catch (const std::exception &e) {
+        // Freeing the buffers while the kernel may still write to them would corrupt memory.
+        std::cerr << "Failed to cancel the io_uring requests of the socket " << fd.value << ": "
+                  << e.what() << std::endl;
+        std::abort();
+      }
+    }
+
+    FileDescriptor fd;
+    std::vector<u8> receive_pool;
+    std::vector<u8> send_pool;
+    std::vector<Receive> receives;
+    std::vector<Send> sends;
+    // Receives that have completed, but haven't been read yet.
+    std::deque<usize> received{};
+    // Receives whose datagrams have been read, and which are rearmed on the next read.
+    std::vector<usize> returned{};
+    std::vector<usize> free_sends{};
+    // Receives that have been rearmed, but not submitted yet.
+    usize unsubmitted_receive_count{0};
+    // Declared last, so that it's destroyed before the buffers that its requests point into.
+    detail::IoUring ring;
+
+    // Number of receives that are in flight in the kernel.
+    usize armed_count() const {
+      return receives.size() - received.size() - returned.size() - unsubmitted_receive_count;
+    }
+
+    void rearm_returned_receives() {
+      for (usize index : returned) {
+        auto &receive = receives[index];
+        receive.iov = {receive.buffer.data(), receive.buffer.size()};
+        receive.header = {};
+        receive.header.msg_name = &receive.sender;
+        receive.header.msg_namelen = sizeof(receive.sender);
+        receive.header.msg_iov = &receive.iov;
+        receive.header.msg_iovlen = 1;
+        auto &sqe = ring.next_sqe();
+        sqe.opcode = IORING_OP_RECVMSG;
+        sqe.fd = fd.value;
+        sqe.addr = reinterpret_cast<u64>(&receive.header);
+        sqe.len = 1;
+        sqe.user_data = user_data(RequestKind::RECEIVE, index);
+      }
+      unsubmitted_receive_count += returned.size();
+      returned.clear();
+    }
+
+    void submit(u32 wait_count = 0) {
+      ring.submit(wait_count);
+      unsubmitted_receive_count = 0;
+    }
+
+    void send(IpAddress recipient, const_byte_span payload, bool zero_copy) {
+      if (payload.size() > sends.front().buffer.size()) {
+        throw std::runtime_error("Failed to send " + std::to_string(payload.size())
+                                     + " bytes to " + recipient.to_string()
+                                     + ": larger than the send buffer");
+      }
+      usize index = free_sends.back();
+      free_sends.pop_back();
+      auto &send = sends[index];
+      std::copy(payload.begin(), payload.end(), send.buffer.begin());
+      send.recipient = *reinterpret_cast<const sockaddr_in *>(recipient.as_sockaddr());
+      auto &sqe = ring.next_sqe();
+      sqe.fd = fd.value;
+      if (zero_copy) {
+        sqe.opcode = IORING_OP_SEND_ZC;
+        sqe.addr = reinterpret_cast<u64>(send.buffer.data());
+        sqe.len = payload.size();
+        sqe.addr2 = reinterpret_cast<u64>(&send.recipient);
+        sqe.addr_len = sizeof(send.recipient);
+        sqe.ioprio = IORING_RECVSEND_FIXED_BUF;
+        sqe.buf_index = 0;
+      } else {
+        // IORING_OP_SEND only takes the recipient since Linux 6.0, unlike IORING_OP_SENDMSG.
+        send.iov = {send.buffer.data(), payload.size()};
+        send.header = {};
+        send.header.msg_name = &send.recipient;
+        send.header.msg_namelen = sizeof(send.recipient);
+        send.header.msg_iov = &send.iov;
+        send.header.msg_iovlen = 1;
+        sqe.opcode = IORING_OP_SENDMSG;
+        sqe.addr = reinterpret_cast<u64>(&send.header);
+        sqe.len = 1;
+      }
+      sqe.user_data = user_data(RequestKind::SEND, index);
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::PACKETS_SENT);
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::PAYLOAD_EGRESS, payload.size());
+    }
+
+    void reap_completions() {
+      ring.reap([this](const io_uring_cqe &cqe) {
+        auto kind = static_cast<RequestKind>(cqe.user_data >> 32);
+        usize index = cqe.user_data & 0xFFFFFFFF;
+        if (kind == RequestKind::SEND) {
+          // A zero-copy send completes twice: once it's sent, and once the buffer is released.
+          if (cqe.res < 0) {
+            OS_NETWORK_METRICS.inc(NetworkMetricKey::SEND_ERRORS);
+          }
+          if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            free_sends.push_back(index);
+          }
+          return;
+        }
+        if (cqe.res < 0) {
+          returned.push_back(index);
+          throw std::runtime_error("Failed to read data from the socket: "
+                                       + std::to_string(fd.value) + " "
+                                       + std::string(strerror(-cqe.res)));
+        }
+        if (cqe.res == 0) {
+          // Same as [OsNetwork], empty datagrams are ignored.
+          returned.push_back(index);
+          return;
+        }
+        auto &receive = receives[index];
+        receive.size = std::min<usize>(cqe.res, receive.buffer.size());
+        OS_NETWORK_METRICS.inc(NetworkMetricKey::PACKETS_READ);
+        OS_NETWORK_METRICS.inc(NetworkMetricKey::PAYLOAD_INGRESS, receive.size);
+        received.push_back(index);
+      });
+    }
+
+    // Cancels the receives that are in flight, and waits until they and the sends have completed.
+    void cancel_requests() {
+      submit();
+      std::vector<bool> is_armed(receives.size(), true);
+      for (usize index : received) {
+        is_armed[index] = false;
+      }
+      for (usize index : returned) {
+        is_armed[index] = false;
+      }
+      usize in_flight_count = armed_count() + sends.size() - free_sends.size();
+      for (usize index = 0; index < receives.size(); index++) {
+        if (is_armed[index]) {
+          auto &sqe = ring.next_sqe();
+          sqe.opcode = IORING_OP_ASYNC_CANCEL;
+          sqe.addr = user_data(RequestKind::RECEIVE, index);
+          sqe.user_data = user_data(RequestKind::CANCEL, index);
+        }
+      }
+      ring.submit();
+      while (in_flight_count > 0) {
+        ring.submit(1);
+        ring.reap([&in_flight_count](const io_uring_cqe &cqe) {
+          auto kind = static_cast<RequestKind>(cqe.user_data >> 32);
+          // A zero-copy send completes for the last time once the buffer is released.
+          if (kind == RequestKind::RECEIVE
+              || (kind == RequestKind::SEND && !(cqe.flags & IORING_CQE_F_MORE))) {
+            in_flight_count--;
+          }
+        });
+      }
+    }
+
+    static u64 user_data(RequestKind kind, usize index) {
+      return (static_cast<u64>(kind) << 32) | index;
+    }
+  };
+
+  IoUringNetworkConfig m_config;
+  OsNetwork m_os_network{};
+  std::unordered_map<int, std::unique_ptr<Socket>> m_sockets{};
+
+  Socket &socket_of(FileDescriptor fd) {
+    auto it = m_sockets.find(fd.value);
+    assert(it != m_sockets.end());
+    return *it->second;
+  }
+};
+
+}
+
+#endif //NEPTUN_NETWORK_IO_URING_NETWORK_H
@@ -0,0 +1,149 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "network/io_uring_network.h"
+#include "network/udp_socket.h"
+#include "testing_helpers.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+
+const auto kSenderIp = IpAddress::from_ipv4("127.0.0.1", 47101);
+const auto kReceiverIp = IpAddress::from_ipv4("127.0.0.1", 47102);
+
+// io_uring can be disabled, e.g. by a seccomp filter in containers.
+bool is_io_uring_available() {
+  try {
+    detail::IoUring ring{1};
+    return true;
+  } catch (const std::runtime_error &) {
+    return false;
+  }
+}
+
+// Reads until [count] datagrams have been received. The datagrams arrive asynchronously.
+std::vector<std::string> read_datagrams(UdpSocket<IoUringNetwork> &socket, usize count) {
+  std::vector<u8> buffer(1600);
+  std::vector<byte_span> buffers(count, byte_span(buffer));
+  std::vector<std::string> datagrams{};
+  for (usize attempt = 0; attempt < 1000 && datagrams.size() < count; attempt++) {
+    std::vector<ReadPacketInfo> packets{};
+    socket.read_batch(std::span(buffers).first(count - datagrams.size()), packets);
+    for (const auto &packet : packets) {
+      EXPECT_EQ(packet.sender, kSenderIp);
+      datagrams.push_back(span_to_string(packet.payload));
+    }
+  }
+  return datagrams;
+}
+
+}
+
+TEST(IoUringNetworkTest, SendAndReceiveBatches) {
+  if (!is_io_uring_available()) {
+    GTEST_SKIP() << "io_uring isn't available";
+  }
+  IoUringNetwork network{};
+  auto sender = UdpSocket<IoUringNetwork>::bind(kSenderIp, network);
+  auto receiver = UdpSocket<IoUringNetwork>::bind(kReceiverIp, network);
+  // Arms the receives.
+  ASSERT_EQ(read_datagrams(receiver, 0).size(), 0);
+
+  std::vector<std::string> messages{"first", "second", "third"};
+  std::vector<SendPacketInfo> packets{};
+  for (const auto &message : messages) {
+    packets.push_back({kReceiverIp, const_byte_span((u8 *) message.data(), message.size())});
+  }
+  ASSERT_EQ(sender.send_batch(packets), messages.size());
+  ASSERT_EQ(read_datagrams(receiver, messages.size()), messages);
+
+  ASSERT_EQ(sender.send_to(kReceiverIp, const_byte_span((u8 *) messages[0].data(), messages[0].size())),
+            messages[0].size());
+  ASSERT_EQ(read_datagrams(receiver, 1), std::vector<std::string>{"first"});
+
+  network.close_socket(sender.fd());
+  network.close_socket(receiver.fd());
+}
+
+TEST(IoUringNetworkTest, ZeroCopySend) {
+  if (!is_io_uring_available()) {
+    GTEST_SKIP() << "io_uring isn't available";
+  }
+  IoUringNetwork network{IoUringNetworkConfig{.zero_copy_send = true}};
+  if (!detail::IoUring{1}.supports(IORING_OP_SEND_ZC)) {
+    // The socket can't be created, instead of failing every send.
+    ASSERT_THROW(UdpSocket<IoUringNetwork>::bind(kSenderIp, network), std::runtime_error);
+    return;
+  }
+  auto sender = UdpSocket<IoUringNetwork>::bind(kSenderIp, network);
+  auto receiver = UdpSocket<IoUringNetwork>::bind(kReceiverIp, network);
+  ASSERT_EQ(read_datagrams(receiver, 0).size(), 0);
+
+  std::string message = "zero-copy";
+  ASSERT_EQ(sender.send_to(kReceiverIp, const_byte_span((u8 *) message.data(), message.size())),
+            message.size());
+  ASSERT_EQ(read_datagrams(receiver, 1), std::vector<std::string>{message});
+
+  network.close_socket(sender.fd());
+  network.close_socket(receiver.fd());
+}
+
+TEST(IoUringNetworkTest, SendBuffersAreBounded) {
+  if (!is_io_uring_available()) {
+    GTEST_SKIP() << "io_uring isn't available";
+  }
+  IoUringNetwork network{IoUringNetworkConfig{.receive_buffer_count = 4, .send_buffer_count = 2}};
+  auto sender = UdpSocket<IoUringNetwork>::bind(kSenderIp, network);
+  auto receiver = UdpSocket<IoUringNetwork>::bind(kReceiverIp, network);
+  ASSERT_EQ(read_datagrams(receiver, 0).size(), 0);
+
+  std::string message = "message";
+  std::vector<SendPacketInfo> packets(4, {kReceiverIp, const_byte_span((u8 *) message.data(), message.size())});
+  // Sends to loopback complete as soon as they are submitted, so the buffers are reused.
+  usize sent_count = 0;
+  for (usize attempt = 0; attempt < 1000 && sent_count < packets.size(); attempt++) {
+    usize count = sender.send_batch(std::span(packets).subspan(sent_count));
+    ASSERT_LE(count, 2);
+    sent_count += count;
+  }
+  ASSERT_EQ(sent_count, packets.size());
+  ASSERT_EQ(read_datagrams(receiver, packets.size()).size(), packets.size());
+
+  std::vector<u8> large_payload(4096);
+  ASSERT_THROW((void) sender.send_to(kReceiverIp, large_payload), std::runtime_error);
+
+  network.close_socket(sender.fd());
+  network.close_socket(receiver.fd());
+}
+
+TEST(IoUringNetworkTest, CloseSocketWithArmedReceives) {
+  if (!is_io_uring_available()) {
+    GTEST_SKIP() << "io_uring isn't available";
+  }
+  IoUringNetwork network{};
+  auto sender = UdpSocket<IoUringNetwork>::bind(kSenderIp, network);
+  auto receiver = UdpSocket<IoUringNetwork>::bind(kReceiverIp, network);
+  ASSERT_EQ(read_datagrams(receiver, 0).size(), 0);
+  // One datagram is read and one is left unread, and the rest of the receives stay armed.
+  std::string message = "message";
+  std::vector<SendPacketInfo> packets(2, {kReceiverIp, const_byte_span((u8 *) message.data(), message.size())});
+  ASSERT_EQ(sender.send_batch(packets), packets.size());
+  ASSERT_EQ(read_datagrams(receiver, 1), std::vector<std::string>{message});
+
+  // The receives are cancelled before their buffers are freed, so the address can be reused.
+  network.close_socket(receiver.fd());
+  auto new_receiver = UdpSocket<IoUringNetwork>::bind(kReceiverIp, network);
+  ASSERT_EQ(read_datagrams(new_receiver, 0).size(), 0);
+  ASSERT_EQ(sender.send_batch(std::span(packets).first(1)), 1);
+  ASSERT_EQ(read_datagrams(new_receiver, 1), std::vector<std::string>{message});
+
+  network.close_socket(sender.fd());
+  network.close_socket(new_receiver.fd());
+}
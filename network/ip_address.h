@@ -90,13 +90,24 @@ public:
     return ntohs(m_socket_address.sin_port);
   }
 
+  // IPv4 address and port packed into 64 bits, in network byte order.
+  // Cheaper than [operator<] for hashing and equality, but doesn't preserve the ordering.
+  [[nodiscard]] u64 packed() const {
+    return (static_cast<u64>(m_socket_address.sin_addr.s_addr) << 16) | m_socket_address.sin_port;
+  }
+
+  // IPv4 address without the port, in network byte order.
+  [[nodiscard]] u32 address() const {
+    return m_socket_address.sin_addr.s_addr;
+  }
+
   bool operator< (const IpAddress& other) const {
     return ip_as_host_long() < other.ip_as_host_long()
       || (ip_as_host_long() == other.ip_as_host_long() && port() < other.port());
   }
 
   bool operator== (const IpAddress& other) const {
-    return !(*this < other) && !(other < *this);
+    return packed() == other.packed();
   }
 
 private:
@@ -27,11 +27,21 @@
 
 #endif
 
+#if PLATFORM == PLATFORM_UNIX
+
+#include <netinet/udp.h>
+
+#endif
+
+#include <array>
+#include <cassert>
+#include <cerrno>
 #include <span>
 #include <compare>
 #include <string>
 #include <memory>
 #include <memory.h>
+#include <vector>
 
 #include "common/types.h"
 #include "network/ip_address.h"
@@ -43,6 +53,39 @@ namespace detail {
 
 const int kNoFlags = 0;
 
+// Maximum number of datagrams passed to a single recvmmsg call.
+constexpr usize kMaxReadBatchSize = 64;
+// Maximum number of datagrams passed to a single sendmmsg call.
+constexpr usize kMaxSendBatchSize = 64;
+
+// Whether a failed send is caused by the datagram's destination rather than the socket, e.g. an
+// unroutable or forbidden address, or an ICMP error from an earlier datagram to it. Such a
+// datagram is dropped, so that a single bad destination doesn't block the rest of the sends.
+// Invalid arguments and oversized datagrams are bugs on our side, so they aren't.
+inline bool is_destination_error(int error_code) {
+  switch (error_code) {
+    case EACCES:
+    case EPERM:
+    case ENETUNREACH:
+    case EHOSTUNREACH:
+    case ENETDOWN:
+    case EHOSTDOWN:
+    case EADDRNOTAVAIL:
+    case ECONNREFUSED:
+      return true;
+    default:
+      return false;
+  }
+}
+
+#if PLATFORM == PLATFORM_UNIX
+// Control message buffer for the UDP_SEGMENT (u16) and UDP_GRO (int) socket options.
+union UdpOffloadControlBuffer {
+  char buffer[CMSG_SPACE(sizeof(int))];
+  cmsghdr align;
+};
+#endif
+
 }
 
 struct FileDescriptor {
@@ -51,12 +94,39 @@ struct FileDescriptor {
   auto operator<=>(const FileDescriptor &other) const = default;
 };
 
+// Maximum payload of a single UDP datagram, which is also the limit for the payload
+// of the coalesced and segmented datagrams.
+constexpr usize kMaxUdpPayloadSize = 65507;
+
+// UDP offloads move splitting and coalescing of datagrams into the kernel (or the NIC).
+// Generic segmentation offload (GSO) sends many datagrams to the same address with one syscall.
+// Generic receive offload (GRO) coalesces datagrams from the same sender into one buffer.
+struct UdpOffload {
+  bool segmentation{false};
+  bool receive_coalescing{false};
+
+  bool operator==(const UdpOffload &) const = default;
+};
+
 struct ReadPacketInfo {
   IpAddress sender;
   byte_span payload;
+  // If non-zero, [payload] holds the datagrams coalesced by GRO, each [segment_size] bytes long
+  // except the last one, which may be shorter.
+  u16 segment_size{0};
+};
+
+struct SendPacketInfo {
+  IpAddress recipient;
+  const_byte_span payload;
+  // If non-zero, [payload] is split into datagrams of [segment_size] bytes (the last one may be
+  // shorter). It's sent with GSO if the socket supports it, and one datagram at a time otherwise.
+  u16 segment_size{0};
 };
 
-static NetworkMetrics OS_NETWORK_METRICS{"Network Metrics"};
+// Each thread counts its own socket operations, so that sockets can be used from multiple
+// threads (e.g. one [SO_REUSEPORT] socket per thread) without synchronizing the counters.
+static thread_local NetworkMetrics OS_NETWORK_METRICS{"Network Metrics"};
 
 class OsNetwork {
 public:
@@ -110,6 +180,46 @@ public:
 #endif
   }
 
+  // Allows multiple sockets to bind to the same address. Must be called before [bind].
+  // The kernel distributes incoming datagrams across the sockets by hashing the sender's
+  // address, so all datagrams from the same sender are delivered to the same socket.
+  void set_reuse_port(FileDescriptor fd) {
+#if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
+    // https://man7.org/linux/man-pages/man7/socket.7.html
+    int enable = 1;
+    if (::setsockopt(fd.value, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1) {
+      throw std::runtime_error("Failed to set SO_REUSEPORT on socket: " + std::to_string(fd.value));
+    }
+#else
+    throw std::runtime_error("SO_REUSEPORT is not supported on this platform");
+#endif
+  }
+
+  // Enables the [requested] offloads that the kernel supports and returns which ones have been
+  // enabled. It's safe to call on any platform: unsupported offloads are reported as disabled.
+  UdpOffload enable_udp_offload(FileDescriptor fd, UdpOffload requested) {
+    UdpOffload enabled{};
+#if PLATFORM == PLATFORM_UNIX
+    // https://man7.org/linux/man-pages/man7/udp.7.html
+    // Setting UDP_SEGMENT to 0 doesn't segment datagrams by default, but fails with ENOPROTOOPT
+    // if the kernel doesn't support GSO (Linux < 4.18).
+    int no_default_segment_size = 0;
+    if (requested.segmentation && ::setsockopt(fd.value,
+                                               SOL_UDP,
+                                               UDP_SEGMENT,
+                                               &no_default_segment_size,
+                                               sizeof(no_default_segment_size)) == 0) {
+      enabled.segmentation = true;
+    }
+    int enable_gro = 1;
+    if (requested.receive_coalescing
+        && ::setsockopt(fd.value, SOL_UDP, UDP_GRO, &enable_gro, sizeof(enable_gro)) == 0) {
+      enabled.receive_coalescing = true;
+    }
+#endif
+    return enabled;
+  }
+
   void close_socket(FileDescriptor fd) {
 #if PLATFORM == PLATFORM_WINDOWS
     if (closesocket(fd.value) == SOCKET_ERROR) {
@@ -131,6 +241,7 @@ public:
     sockaddr_in sender_ip{};
     socklen_t sender_ip_length = sizeof(struct sockaddr_in);
 
+    OS_NETWORK_METRICS.inc(NetworkMetricKey::SYSCALLS);
     ssize_t read_bytes = ::recvfrom(fd.value,
                                     static_cast<void *>(buffer.data()),
                                     buffer.size(),
@@ -153,10 +264,46 @@ public:
     }
   }
 
+  // Reads up to [buffers.size()] datagrams, one per buffer, and appends them to [packets].
+  // Returns the number of datagrams appended to [packets]. If it's smaller than
+  // [buffers.size()], the socket's receive queue has been drained.
+  usize read_batch(FileDescriptor fd,
+                   std::span<byte_span> buffers,
+                   std::vector<ReadPacketInfo> &packets) {
+#if PLATFORM == PLATFORM_UNIX
+    usize initial_packet_count = packets.size();
+    usize total_read_count = 0;
+    while (total_read_count < buffers.size()) {
+      auto batch = buffers.subspan(total_read_count,
+                                   std::min(buffers.size() - total_read_count,
+                                            detail::kMaxReadBatchSize));
+      usize read_count = read_mmsg(fd, batch, packets);
+      total_read_count += read_count;
+      if (read_count < batch.size()) {
+        break;
+      }
+    }
+    return packets.size() - initial_packet_count;
+#else
+    // There is no recvmmsg, so fallback to reading one datagram at a time.
+    usize read_count = 0;
+    for (auto buffer : buffers) {
+      auto packet_info = read_from_socket(fd, buffer);
+      if (!packet_info) {
+        break;
+      }
+      packets.push_back(*packet_info);
+      read_count++;
+    }
+    return read_count;
+#endif
+  }
+
   std::size_t send_to(FileDescriptor fd,
                       IpAddress ip_address,
                       std::span<const std::uint8_t> payload) {
     // https://linux.die.net/man/2/sendto
+    OS_NETWORK_METRICS.inc(NetworkMetricKey::SYSCALLS);
     ssize_t sent_bytes = ::sendto(fd.value,
                                   static_cast<const void *>(payload.data()),
                                   payload.size(),
@@ -180,6 +327,200 @@ public:
     OS_NETWORK_METRICS.inc(NetworkMetricKey::PAYLOAD_EGRESS, sent_bytes);
     return static_cast<std::size_t>(sent_bytes);
   }
+
+  // Sends [packets] in order and returns the number of packets that have been consumed, i.e.
+  // sent or dropped because of an error specific to their destination (counted as
+  // [NetworkMetricKey::SEND_ERRORS]). If it's smaller than [packets.size()], the socket's send
+  // buffer is full (EWOULDBLOCK) and the remaining packets must be sent later.
+  usize send_batch(FileDescriptor fd, std::span<const SendPacketInfo> packets) {
+#if PLATFORM == PLATFORM_UNIX
+    usize total_sent_count = 0;
+    while (total_sent_count < packets.size()) {
+      auto batch = packets.subspan(total_sent_count,
+                                   std::min(packets.size() - total_sent_count,
+                                            detail::kMaxSendBatchSize));
+      usize sent_count = send_mmsg(fd, batch);
+      if (sent_count == 0) {
+        break;
+      }
+      total_sent_count += sent_count;
+    }
+    return total_sent_count;
+#else
+    // There is no sendmmsg, so fallback to sending one datagram at a time.
+    for (usize i = 0; i < packets.size(); i++) {
+      if (!send_segments(fd, packets[i])) {
+        return i;
+      }
+    }
+    return packets.size();
+#endif
+  }
+
+private:
+  // Returns false if the datagram couldn't be sent because the socket's send buffer is full.
+  // Datagrams that fail because of their destination are dropped.
+  bool try_send_to(FileDescriptor fd, IpAddress ip_address, std::span<const std::uint8_t> payload) {
+    OS_NETWORK_METRICS.inc(NetworkMetricKey::SYSCALLS);
+    ssize_t sent_bytes = ::sendto(fd.value,
+                                  static_cast<const void *>(payload.data()),
+                                  payload.size(),
+                                  detail::kNoFlags,
+                                  ip_address.as_sockaddr(),
+                                  sizeof(sockaddr_in));
+    if (sent_bytes == -1 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
+      return false;
+    } else if (sent_bytes == -1 && detail::is_destination_error(errno)) {
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::SEND_ERRORS);
+      return true;
+    } else if (sent_bytes != payload.size()) {
+      throw std::runtime_error("Failed to sent bytes to: " + ip_address.to_string()
+                                   + " unknown code: " + std::to_string(errno));
+    }
+    OS_NETWORK_METRICS.inc(NetworkMetricKey::PACKETS_SENT);
+    OS_NETWORK_METRICS.inc(NetworkMetricKey::PAYLOAD_EGRESS, sent_bytes);
+    return true;
+  }
+
+  // Sends [packet] one segment at a time, without GSO.
+  // Returns false if the first segment couldn't be sent because the socket's send buffer is full.
+  // The remaining segments are best-effort: UDP doesn't guarantee delivery anyway.
+  bool send_segments(FileDescriptor fd, const SendPacketInfo &packet) {
+    usize segment_size = packet.segment_size == 0 ? packet.payload.size() : packet.segment_size;
+    for (usize offset = 0; offset < packet.payload.size(); offset += segment_size) {
+      auto segment =
+          packet.payload.subspan(offset, std::min(segment_size, packet.payload.size() - offset));
+      if (!try_send_to(fd, packet.recipient, segment) && offset == 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+#if PLATFORM == PLATFORM_UNIX
+  // Returns the number of datagrams that have been consumed, which is 0 if the socket's send
+  // buffer is full. The first datagram is dropped if it fails because of its destination.
+  usize send_mmsg(FileDescriptor fd, std::span<const SendPacketInfo> packets) {
+    assert(packets.size() <= detail::kMaxSendBatchSize);
+    std::array<mmsghdr, detail::kMaxSendBatchSize> headers{};
+    std::array<iovec, detail::kMaxSendBatchSize> iovecs{};
+    std::array<detail::UdpOffloadControlBuffer, detail::kMaxSendBatchSize> controls{};
+    for (usize i = 0; i < packets.size(); i++) {
+      iovecs[i].iov_base = const_cast<u8 *>(packets[i].payload.data());
+      iovecs[i].iov_len = packets[i].payload.size();
+      headers[i].msg_hdr.msg_name = packets[i].recipient.as_sockaddr();
+      headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+      headers[i].msg_hdr.msg_iov = &iovecs[i];
+      headers[i].msg_hdr.msg_iovlen = 1;
+      if (packets[i].segment_size > 0 && packets[i].payload.size() > packets[i].segment_size) {
+        // The kernel splits the payload into datagrams of [segment_size] bytes.
+        headers[i].msg_hdr.msg_control = controls[i].buffer;
+        headers[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(u16));
+        cmsghdr *control_message = CMSG_FIRSTHDR(&headers[i].msg_hdr);
+        control_message->cmsg_level = SOL_UDP;
+        control_message->cmsg_type = UDP_SEGMENT;
+        control_message->cmsg_len = CMSG_LEN(sizeof(u16));
+        u16 segment_size = packets[i].segment_size;
+        memcpy(CMSG_DATA(control_message), &segment_size, sizeof(segment_size));
+      }
+    }
+
+    // https://man7.org/linux/man-pages/man2/sendmmsg.2.html
+    // If a datagram other than the first one fails, sendmmsg returns the number of datagrams
+    // sent so far, and the error is reported by the next call that starts with the failed one.
+    OS_NETWORK_METRICS.inc(NetworkMetricKey::SYSCALLS);
+    int sent_count = ::sendmmsg(fd.value, headers.data(), packets.size(), detail::kNoFlags);
+    if (sent_count == -1 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
+      return 0;
+    } else if (sent_count == -1 && headers[0].msg_hdr.msg_control != nullptr
+        && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+      // GSO isn't supported for this route (e.g. the device has no checksum offload), or the
+      // payload has too many segments. Fallback to sending the segments one by one.
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::SEGMENTATION_FALLBACKS);
+      return send_segments(fd, packets[0]) ? 1 : 0;
+    } else if (sent_count == -1 && detail::is_destination_error(errno)) {
+      // The rest of the batch is sent by the next call.
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::SEND_ERRORS);
+      return 1;
+    } else if (sent_count == -1) {
+      throw std::runtime_error("Failed to send a batch of " + std::to_string(packets.size())
+                                   + " datagrams, first to: " + packets[0].recipient.to_string()
+                                   + " unknown code: " + std::to_string(errno));
+    }
+
+    OS_NETWORK_METRICS.inc(NetworkMetricKey::BATCHED_SENDS);
+    for (int i = 0; i < sent_count; i++) {
+      usize segment_size = packets[i].segment_size == 0 ? packets[i].payload.size()
+                                                        : packets[i].segment_size;
+      usize datagram_count = (packets[i].payload.size() + segment_size - 1) / segment_size;
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::PACKETS_SENT, std::max<usize>(datagram_count, 1));
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::PAYLOAD_EGRESS, headers[i].msg_len);
+    }
+    return static_cast<usize>(sent_count);
+  }
+
+  // Returns the number of datagrams consumed from the socket, including the empty ones.
+  usize read_mmsg(FileDescriptor fd,
+                  std::span<byte_span> buffers,
+                  std::vector<ReadPacketInfo> &packets) {
+    assert(buffers.size() <= detail::kMaxReadBatchSize);
+    std::array<mmsghdr, detail::kMaxReadBatchSize> headers{};
+    std::array<iovec, detail::kMaxReadBatchSize> iovecs{};
+    std::array<sockaddr_in, detail::kMaxReadBatchSize> senders{};
+    std::array<detail::UdpOffloadControlBuffer, detail::kMaxReadBatchSize> controls{};
+    for (usize i = 0; i < buffers.size(); i++) {
+      iovecs[i].iov_base = buffers[i].data();
+      iovecs[i].iov_len = buffers[i].size();
+      headers[i].msg_hdr.msg_name = &senders[i];
+      headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+      headers[i].msg_hdr.msg_iov = &iovecs[i];
+      headers[i].msg_hdr.msg_iovlen = 1;
+      // Only used if GRO is enabled on the socket.
+      headers[i].msg_hdr.msg_control = controls[i].buffer;
+      headers[i].msg_hdr.msg_controllen = sizeof(controls[i].buffer);
+    }
+
+    // https://man7.org/linux/man-pages/man2/recvmmsg.2.html
+    OS_NETWORK_METRICS.inc(NetworkMetricKey::SYSCALLS);
+    int read_count = ::recvmmsg(fd.value,
+                                headers.data(),
+                                buffers.size(),
+                                detail::kNoFlags,
+                                nullptr /* timeout */);
+    if (read_count == -1 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
+      return 0;
+    } else if (read_count == -1) {
+      throw std::runtime_error("Failed to read data from the socket: " + std::to_string(fd.value));
+    }
+
+    OS_NETWORK_METRICS.inc(NetworkMetricKey::BATCHED_READS);
+    for (int i = 0; i < read_count; i++) {
+      usize read_bytes = headers[i].msg_len;
+      if (read_bytes == 0) {
+        // Same as [read_from_socket], empty datagrams are ignored.
+        continue;
+      }
+      u16 segment_size = 0;
+      for (cmsghdr *control_message = CMSG_FIRSTHDR(&headers[i].msg_hdr);
+           control_message != nullptr;
+           control_message = CMSG_NXTHDR(&headers[i].msg_hdr, control_message)) {
+        if (control_message->cmsg_level == SOL_UDP && control_message->cmsg_type == UDP_GRO) {
+          int gro_segment_size = 0;
+          memcpy(&gro_segment_size, CMSG_DATA(control_message), sizeof(gro_segment_size));
+          // A single datagram may also be reported with its own size as the segment size.
+          if (gro_segment_size > 0 && static_cast<usize>(gro_segment_size) < read_bytes) {
+            segment_size = static_cast<u16>(gro_segment_size);
+          }
+        }
+      }
+      usize datagram_count = segment_size == 0 ? 1 : (read_bytes + segment_size - 1) / segment_size;
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::PACKETS_READ, datagram_count);
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::PAYLOAD_INGRESS, read_bytes);
+      packets.push_back({IpAddress(senders[i]), buffers[i].first(read_bytes), segment_size});
+    }
+    return static_cast<usize>(read_count);
+  }
+#endif
 };
 
 static OsNetwork OS_NETWORK{};
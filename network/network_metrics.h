@@ -18,6 +18,17 @@ enum NetworkMetricKey {
   PACKETS_READ,
   PAYLOAD_INGRESS,
   PAYLOAD_EGRESS,
+  // Number of successful batched reads, i.e. recvmmsg calls that returned at least one datagram.
+  BATCHED_READS,
+  // Number of successful batched sends, i.e. sendmmsg calls that sent at least one datagram.
+  BATCHED_SENDS,
+  // Number of segmented sends that fell back to one datagram at a time because GSO failed.
+  SEGMENTATION_FALLBACKS,
+  // Number of syscalls that read or send datagrams, including the ones that didn't transfer any.
+  SYSCALLS,
+  // Number of datagrams that have been dropped because sending them failed, either
+  // asynchronously after they had been accepted, or because of their destination.
+  SEND_ERRORS,
 };
 
 using NetworkMetrics = Metrics<NetworkMetricKey, u64>;
@@ -26,30 +37,34 @@ using NetworkMetrics = Metrics<NetworkMetricKey, u64>;
 
 namespace freezing {
 
-// TODO: Warning: explicit specialization cannot have a storage class.
 template<>
-static constexpr usize metric_key_count<network::NetworkMetricKey>() {
-  return 4;
+constexpr usize metric_key_count<network::NetworkMetricKey>() {
+  return 9;
 }
 
 template<>
-static constexpr usize metric_key_index<network::NetworkMetricKey>(network::NetworkMetricKey key) {
+constexpr usize metric_key_index<network::NetworkMetricKey>(network::NetworkMetricKey key) {
   return key;
 }
 
 template<>
-static std::string metric_key_name<network::NetworkMetricKey>(network::NetworkMetricKey key) {
+inline std::string metric_key_name<network::NetworkMetricKey>(network::NetworkMetricKey key) {
   switch (key) {
   case network::PACKETS_SENT:return "packets_sent";
   case network::PACKETS_READ:return "packets_read";
   case network::PAYLOAD_INGRESS:return "payload_ingress";
   case network::PAYLOAD_EGRESS:return "payload_egress";
+  case network::BATCHED_READS:return "batched_reads";
+  case network::BATCHED_SENDS:return "batched_sends";
+  case network::SEGMENTATION_FALLBACKS:return "segmentation_fallbacks";
+  case network::SYSCALLS:return "syscalls";
+  case network::SEND_ERRORS:return "send_errors";
   default:throw std::runtime_error("unknown key: " + std::to_string(key));
   }
 }
 
 template<>
-static std::string metric_key_unit<network::NetworkMetricKey>(network::NetworkMetricKey key) {
+inline std::string metric_key_unit<network::NetworkMetricKey>(network::NetworkMetricKey key) {
   switch (key) {
   case network::PAYLOAD_INGRESS:
   case network::PAYLOAD_EGRESS:return "MB";
@@ -58,7 +73,7 @@ static std::string metric_key_unit<network::NetworkMetricKey>(network::NetworkMe
 }
 
 template<>
-static double metric_key_unit_scale<network::NetworkMetricKey, double>(network::NetworkMetricKey key, double value) {
+inline double metric_key_unit_scale<network::NetworkMetricKey, double>(network::NetworkMetricKey key, double value) {
   switch (key) {
   case network::PAYLOAD_INGRESS:
   case network::PAYLOAD_EGRESS:return static_cast<double>(value) / 1024.0 / 1024.0;
@@ -67,7 +82,7 @@ static double metric_key_unit_scale<network::NetworkMetricKey, double>(network::
 }
 
 template<>
-static void foreach_key<network::NetworkMetricKey>(const std::function<void(network::NetworkMetricKey)> &fn) {
+inline void foreach_key<network::NetworkMetricKey>(const std::function<void(network::NetworkMetricKey)> &fn) {
   for (usize i = 0; i < metric_key_count<network::NetworkMetricKey>(); i++) {
     auto key = static_cast<network::NetworkMetricKey>(i);
     fn(key);
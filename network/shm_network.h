@@ -0,0 +1,440 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#ifndef NEPTUN_NETWORK_SHM_NETWORK_H
+#define NEPTUN_NETWORK_SHM_NETWORK_H
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/spsc_queue.h"
+#include "common/types.h"
+#include "network/ip_address.h"
+#include "network/network.h"
+#include "network/network_metrics.h"
+
+namespace freezing::network {
+
+namespace detail {
+
+// Changes whenever the layout of the segment changes, so that processes built from different
+// versions don't misread each other's segments.
+constexpr u64 kShmSegmentMagic = 0x4e505455'4e534d01;
+
+// The atomics are shared between processes, which only works if they don't use a lock.
+static_assert(std::atomic<u64>::is_always_lock_free);
+static_assert(std::atomic<u32>::is_always_lock_free);
+
+struct ShmSegmentHeader {
+  // Written last by the owner, once the rest of the segment is initialized.
+  std::atomic<u64> magic;
+  u64 slot_count;
+  u64 slot_size;
+  u64 max_datagram_size;
+  pid_t owner_pid;
+  // Set by the owner when it closes the socket, so that the senders drop their mapping.
+  std::atomic<u32> is_closed;
+  // Written by the owner.
+  alignas(kCacheLineSize) std::atomic<u64> head;
+  // Written by the senders.
+  alignas(kCacheLineSize) std::atomic<u64> tail;
+};
+
+struct ShmSlotHeader {
+  std::atomic<u64> sequence;
+  sockaddr_in sender;
+  u32 size;
+};
+
+// Receive queue of a socket in a shared-memory segment, which any number of processes send
+// datagrams to, and only the process that owns the socket reads from.
+//
+// Same algorithm as [MpscQueue], except that the slots have a fixed size and live in shared
+// memory. A sender that dies after claiming a slot blocks the queue for good, just like a
+// producer thread that never finishes writing its element.
+class ShmSegment {
+public:
+  // Creates the segment of the socket that is bound to [name]. Returns nothing if another live
+  // process owns it already. A segment left behind by a process that has died is replaced.
+  static std::unique_ptr<ShmSegment> create(const std::string &name,
+                                            usize slot_count,
+                                            usize max_datagram_size) {
+    slot_count = std::bit_ceil(slot_count);
+    usize slot_size = (sizeof(ShmSlotHeader) + max_datagram_size + kCacheLineSize - 1)
+        / kCacheLineSize * kCacheLineSize;
+    usize size = sizeof(ShmSegmentHeader) + slot_count * slot_size;
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1 && errno == EEXIST) {
+      auto existing = open(name);
+      if (existing && existing->is_owner_alive()) {
+        return nullptr;
+      }
+      if (existing) {
+        // The owner has died without closing the segment, so it's closed on its behalf, otherwise
+        // the senders that have it mapped would never notice that it has been replaced.
+        existing->m_header->is_closed.store(1, std::memory_order_release);
+      }
+      ::shm_unlink(name.c_str());
+      fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+    if (fd == -1) {
+      throw std::runtime_error("Failed to create shared memory " + name + ": "
+                                   + std::string(strerror(errno)));
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size)) == -1) {
+      ::close(fd);
+      ::shm_unlink(name.c_str());
+      throw std::runtime_error("Failed to size shared memory " + name + ": "
+                                   + std::string(strerror(errno)));
+    }
+    auto segment = map(fd, size);
+    if (!segment) {
+      ::shm_unlink(name.c_str());
+      throw std::runtime_error("Failed to map shared memory " + name + ": "
+                                   + std::string(strerror(errno)));
+    }
+    // The memory is zeroed by ftruncate, the atomics only have to be constructed.
+    auto *header = new(segment->m_memory) ShmSegmentHeader{};
+    header->slot_count = slot_count;
+    header->slot_size = slot_size;
+    header->max_datagram_size = max_datagram_size;
+    header->owner_pid = ::getpid();
+    segment->m_header = header;
+    for (u64 i = 0; i < slot_count; i++) {
+      auto *slot = new(segment->slot(i)) ShmSlotHeader{};
+      slot->sequence.store(i, std::memory_order_relaxed);
+    }
+    header->magic.store(kShmSegmentMagic, std::memory_order_release);
+    segment->m_name = name;
+    return segment;
+  }
+
+  // Maps the segment of the socket that is bound to [name]. Returns nothing if no socket is
+  // bound to it.
+  static std::unique_ptr<ShmSegment> open(const std::string &name) {
+    int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd == -1) {
+      return nullptr;
+    }
+    struct stat info{};
+    if (::fstat(fd, &info) == -1 || static_cast<usize>(info.st_size) < sizeof(ShmSegmentHeader)) {
+      // The owner hasn't sized the segment yet.
+      ::close(fd);
+      return nullptr;
+    }
+    auto segment = map(fd, info.st_size);
+    if (!segment) {
+      return nullptr;
+    }
+    auto *header = static_cast<ShmSegmentHeader *>(segment->m_memory);
+    if (header->magic.load(std::memory_order_acquire) != kShmSegmentMagic) {
+      return nullptr;
+    }
+    segment->m_header = header;
+    return segment;
+  }
+
+  ShmSegment(const ShmSegment &) = delete;
+  ShmSegment &operator=(const ShmSegment &) = delete;
+
+  // Only the owner unlinks the segment. Senders that still have it mapped notice that it's
+  // closed on their next send.
+  ~ShmSegment() {
+    if (!m_name.empty()) {
+      m_header->is_closed.store(1, std::memory_order_release);
+      ::shm_unlink(m_name.c_str());
+    }
+    ::munmap(m_memory, m_size);
+  }
+
+  // Any process. Returns false if the queue is full.
+  bool try_push(IpAddress sender, const_byte_span payload) {
+    assert(payload.size() <= m_header->max_datagram_size);
+    u64 tail = m_header->tail.load(std::memory_order_relaxed);
+    ShmSlotHeader *slot_header;
+    while (true) {
+      slot_header = slot(tail & (m_header->slot_count - 1));
+      u64 sequence = slot_header->sequence.load(std::memory_order_acquire);
+      if (sequence == tail) {
+        if (m_header->tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (sequence < tail) {
+        return false;
+      } else {
+        tail = m_header->tail.load(std::memory_order_relaxed);
+      }
+    }
+    slot_header->sender = *reinterpret_cast<const sockaddr_in *>(sender.as_sockaddr());
+    slot_header->size = static_cast<u32>(payload.size());
+    std::copy(payload.begin(), payload.end(), payload_of(slot_header));
+    slot_header->sequence.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Owner only. Copies the oldest datagram into [buffer], and truncates it if it doesn't fit.
+  std::optional<ReadPacketInfo> try_pop(byte_span buffer) {
+    u64 head = m_header->head.load(std::memory_order_relaxed);
+    auto *slot_header = slot(head & (m_header->slot_count - 1));
+    if (slot_header->sequence.load(std::memory_order_acquire) != head + 1) {
+      return {};
+    }
+    usize size = std::min<usize>(slot_header->size, buffer.size());
+    std::copy_n(payload_of(slot_header), size, buffer.begin());
+    ReadPacketInfo packet{IpAddress(slot_header->sender), buffer.first(size)};
+    slot_header->sequence.store(head + m_header->slot_count, std::memory_order_release);
+    m_header->head.store(head + 1, std::memory_order_release);
+    return packet;
+  }
+
+  usize max_datagram_size() const {
+    return m_header->max_datagram_size;
+  }
+
+  bool is_closed() const {
+    return m_header->is_closed.load(std::memory_order_acquire) != 0;
+  }
+
+private:
+  void *m_memory;
+  usize m_size;
+  ShmSegmentHeader *m_header{nullptr};
+  // Only set for the owner.
+  std::string m_name{};
+
+  ShmSegment(void *memory, usize size) : m_memory{memory}, m_size{size} {}
+
+  static std::unique_ptr<ShmSegment> map(int fd, usize size) {
+    void *memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping keeps the segment alive.
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+      return nullptr;
+    }
+    return std::unique_ptr<ShmSegment>(new ShmSegment(memory, size));
+  }
+
+  bool is_owner_alive() const {
+    return ::kill(m_header->owner_pid, 0) == 0 || errno == EPERM;
+  }
+
+  ShmSlotHeader *slot(u64 index) {
+    return reinterpret_cast<ShmSlotHeader *>(static_cast<u8 *>(m_memory) + sizeof(ShmSegmentHeader)
+                                                 + index * m_header->slot_size);
+  }
+
+  static u8 *payload_of(ShmSlotHeader *slot_header) {
+    return reinterpret_cast<u8 *>(slot_header) + sizeof(ShmSlotHeader);
+  }
+};
+
+}
+
+struct ShmNetworkConfig {
+  // Number of datagrams that can be queued for each socket. Datagrams sent to a socket whose
+  // queue is full are dropped, like the kernel does when a socket's receive buffer is full.
+  usize receive_queue_capacity{1024};
+  // Size of the largest datagram that can be sent to the sockets of this network.
+  usize max_datagram_size{2048};
+  // Prefix of the names of the shared-memory segments. Only processes that use the same prefix
+  // can talk to each other.
+  std::string name_prefix{"neptun"};
+};
+
+// Network backend for processes on the same host, which can be used instead of [OsNetwork]
+// with [UdpSocket] and [Neptun].
+//
+// Sockets are bound to ordinary [IpAddress]es. Every bound socket owns a receive queue in a
+// POSIX shared-memory segment named after its address, and sending a datagram copies it straight
+// into the recipient's queue, without a syscall. Segments of the recipients are opened on the
+// first send to them and stay mapped until the recipient closes its socket.
+//
+// Like UDP, datagrams to addresses that nobody is bound to, or to sockets with a full queue, are
+// silently dropped. The sockets have no file descriptor that could be waited on, so [EventLoop]
+// doesn't work and the sockets have to be polled. Not thread-safe: each thread needs its own
+// instance.
+class ShmNetwork {
+public:
+  explicit ShmNetwork(ShmNetworkConfig config = {}) : m_config{std::move(config)} {}
+
+  ShmNetwork(const ShmNetwork &) = delete;
+  ShmNetwork &operator=(const ShmNetwork &) = delete;
+
+  void initialize() {}
+
+  void shutdown() {}
+
+  FileDescriptor udp_socket_ipv4() {
+    int fd = m_next_fd++;
+    m_sockets.emplace(fd, Socket{});
+    return FileDescriptor{fd};
+  }
+
+  void bind(FileDescriptor fd, IpAddress ip_address) {
+    auto &socket = socket_of(fd);
+    if (socket.segment) {
+      throw std::runtime_error("Socket " + std::to_string(fd.value) + " is already bound");
+    }
+    socket.segment = detail::ShmSegment::create(segment_name(ip_address),
+                                                m_config.receive_queue_capacity,
+                                                m_config.max_datagram_size);
+    if (!socket.segment) {
+      throw std::runtime_error("Failed to bind the socket: " + ip_address.to_string()
+                                   + " is already bound");
+    }
+    socket.ip = ip_address;
+  }
+
+  // Sockets never block.
+  void set_non_blocking(FileDescriptor) {}
+
+  void set_reuse_port(FileDescriptor) {
+    throw std::runtime_error("SO_REUSEPORT isn't supported by shared-memory sockets");
+  }
+
+  // Datagrams are copied one at a time, so there is nothing to offload.
+  UdpOffload enable_udp_offload(FileDescriptor, UdpOffload) {
+    return {};
+  }
+
+  void close_socket(FileDescriptor fd) {
+    m_sockets.erase(fd.value);
+  }
+
+  std::optional<ReadPacketInfo> read_from_socket(FileDescriptor fd, byte_span buffer) {
+    auto &socket = socket_of(fd);
+    if (!socket.segment) {
+      throw std::runtime_error(
+          "Failed to read data from unbound socket: " + std::to_string(fd.value));
+    }
+    auto packet = socket.segment->try_pop(buffer);
+    if (packet) {
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::PACKETS_READ);
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::PAYLOAD_INGRESS, packet->payload.size());
+    }
+    return packet;
+  }
+
+  usize read_batch(FileDescriptor fd,
+                   std::span<byte_span> buffers,
+                   std::vector<ReadPacketInfo> &packets) {
+    usize read_count = 0;
+    for (auto buffer : buffers) {
+      auto packet = read_from_socket(fd, buffer);
+      if (!packet) {
+        break;
+      }
+      packets.push_back(*packet);
+      read_count++;
+    }
+    if (read_count > 0) {
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::BATCHED_READS);
+    }
+    return read_count;
+  }
+
+  std::size_t send_to(FileDescriptor fd, IpAddress ip_address, const_byte_span payload) {
+    auto &socket = socket_of(fd);
+    if (!socket.ip) {
+      throw std::runtime_error(
+          "Failed to send data via unbound socket: " + std::to_string(fd.value));
+    }
+    auto *segment = find_segment(ip_address);
+    if (segment && payload.size() > segment->max_datagram_size()) {
+      throw std::runtime_error("Failed to send " + std::to_string(payload.size()) + " bytes to "
+                                   + ip_address.to_string() + ": larger than "
+                                   + std::to_string(segment->max_datagram_size()) + " bytes");
+    }
+    if (segment) {
+      // A full queue drops the datagram.
+      segment->try_push(*socket.ip, payload);
+    }
+    OS_NETWORK_METRICS.inc(NetworkMetricKey::PACKETS_SENT);
+    OS_NETWORK_METRICS.inc(NetworkMetricKey::PAYLOAD_EGRESS, payload.size());
+    return payload.size();
+  }
+
+  // Segmented payloads are sent one datagram at a time.
+  usize send_batch(FileDescriptor fd, std::span<const SendPacketInfo> packets) {
+    for (const auto &packet : packets) {
+      usize segment_size = packet.segment_size == 0 ? packet.payload.size() : packet.segment_size;
+      usize offset = 0;
+      do {
+        auto segment = packet.payload.subspan(
+            offset, std::min(segment_size, packet.payload.size() - offset));
+        send_to(fd, packet.recipient, segment);
+        offset += segment_size;
+      } while (offset < packet.payload.size());
+    }
+    if (!packets.empty()) {
+      OS_NETWORK_METRICS.inc(NetworkMetricKey::BATCHED_SENDS);
+    }
+    return packets.size();
+  }
+
+private:
+  struct Socket {
+    std::optional<IpAddress> ip{};
+    // The socket's receive queue, once it's bound.
+    std::unique_ptr<detail::ShmSegment> segment{};
+  };
+
+  ShmNetworkConfig m_config;
+  int m_next_fd{0};
+  std::unordered_map<int, Socket> m_sockets{};
+  // Receive queues of the recipients, by [IpAddress::packed].
+  std::unordered_map<u64, std::unique_ptr<detail::ShmSegment>> m_recipients{};
+
+  Socket &socket_of(FileDescriptor fd) {
+    auto it = m_sockets.find(fd.value);
+    if (it == m_sockets.end()) {
+      throw std::runtime_error("Unknown socket: " + std::to_string(fd.value));
+    }
+    return it->second;
+  }
+
+  std::string segment_name(IpAddress ip) const {
+    return "/" + m_config.name_prefix + "-" + ip.to_string();
+  }
+
+  // Returns nothing if no socket is bound to [ip]. Remaps the segment if its socket has been
+  // closed, in case another socket has been bound to [ip] since.
+  detail::ShmSegment *find_segment(IpAddress ip) {
+    auto it = m_recipients.find(ip.packed());
+    if (it != m_recipients.end() && !it->second->is_closed()) {
+      return it->second.get();
+    }
+    auto segment = detail::ShmSegment::open(segment_name(ip));
+    if (!segment) {
+      if (it != m_recipients.end()) {
+        m_recipients.erase(it);
+      }
+      return nullptr;
+    }
+    auto *result = segment.get();
+    m_recipients.insert_or_assign(ip.packed(), std::move(segment));
+    return result;
+  }
+};
+
+}
+
+#endif //NEPTUN_NETWORK_SHM_NETWORK_H
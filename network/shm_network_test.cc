@@ -0,0 +1,151 @@
+//
+// Created by freezing on 17/10/2026.
+//
+
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "network/shm_network.h"
+#include "network/udp_socket.h"
+#include "testing_helpers.h"
+
+using namespace freezing;
+using namespace freezing::network;
+
+namespace {
+
+const auto kSenderIp = IpAddress::from_ipv4("127.0.0.1", 47301);
+const auto kReceiverIp = IpAddress::from_ipv4("127.0.0.1", 47302);
+
+// Every test process gets its own segments, so that tests running in parallel don't collide.
+ShmNetworkConfig test_config(usize receive_queue_capacity = 16) {
+  return ShmNetworkConfig{receive_queue_capacity, 64, "neptun-test-" + std::to_string(::getpid())};
+}
+
+const_byte_span as_span(std::string &s) {
+  return {reinterpret_cast<u8 *>(s.data()), s.size()};
+}
+
+}
+
+// Each [ShmNetwork] stands in for a separate process.
+TEST(ShmNetworkTest, SendAndReceiveBetweenNetworks) {
+  ShmNetwork sender_network{test_config()};
+  ShmNetwork receiver_network{test_config()};
+  auto sender = UdpSocket<ShmNetwork>::bind(kSenderIp, sender_network);
+  auto receiver = UdpSocket<ShmNetwork>::bind(kReceiverIp, receiver_network);
+
+  std::string first = "first";
+  std::string second = "second";
+  std::vector<SendPacketInfo> packets{{kReceiverIp, as_span(first)}, {kReceiverIp, as_span(second)}};
+  ASSERT_EQ(sender.send_batch(packets), 2);
+
+  std::vector<u8> buffer(100);
+  auto packet = receiver.read(buffer);
+  ASSERT_TRUE(packet.has_value());
+  ASSERT_EQ(packet->sender, kSenderIp);
+  ASSERT_EQ(span_to_string(packet->payload), "first");
+
+  // Datagrams that don't fit are truncated.
+  packet = receiver.read(std::span(buffer).first(3));
+  ASSERT_TRUE(packet.has_value());
+  ASSERT_EQ(span_to_string(packet->payload), "sec");
+  ASSERT_FALSE(receiver.read(buffer).has_value());
+
+  sender_network.close_socket(sender.fd());
+  receiver_network.close_socket(receiver.fd());
+}
+
+TEST(ShmNetworkTest, DropsDatagramsToUnboundAddressesAndFullQueues) {
+  ShmNetwork sender_network{test_config()};
+  ShmNetwork receiver_network{test_config(2)};
+  auto sender = UdpSocket<ShmNetwork>::bind(kSenderIp, sender_network);
+  std::string message = "message";
+  ASSERT_EQ(sender.send_to(kReceiverIp, as_span(message)), message.size());
+
+  auto receiver = UdpSocket<ShmNetwork>::bind(kReceiverIp, receiver_network);
+  for (usize i = 0; i < 3; i++) {
+    ASSERT_EQ(sender.send_to(kReceiverIp, as_span(message)), message.size());
+  }
+  std::vector<u8> buffer(100);
+  std::vector<byte_span> buffers(4, byte_span(buffer));
+  std::vector<ReadPacketInfo> read_packets{};
+  ASSERT_EQ(receiver.read_batch(buffers, read_packets), 2);
+
+  std::string large_message(65, 'x');
+  ASSERT_THROW((void) sender.send_to(kReceiverIp, as_span(large_message)), std::runtime_error);
+
+  sender_network.close_socket(sender.fd());
+  receiver_network.close_socket(receiver.fd());
+}
+
+TEST(ShmNetworkTest, AddressCanOnlyBeBoundOnce) {
+  ShmNetwork network{test_config()};
+  ShmNetwork other_network{test_config()};
+  auto socket = UdpSocket<ShmNetwork>::bind(kReceiverIp, network);
+  ASSERT_THROW(UdpSocket<ShmNetwork>::bind(kReceiverIp, other_network), std::runtime_error);
+  ASSERT_THROW(UdpSocket<ShmNetwork>::bind(kReceiverIp, network, true), std::runtime_error);
+
+  network.close_socket(socket.fd());
+  auto rebound_socket = UdpSocket<ShmNetwork>::bind(kReceiverIp, other_network);
+  other_network.close_socket(rebound_socket.fd());
+}
+
+TEST(ShmNetworkTest, SendersFollowRebindOfRecipient) {
+  ShmNetwork sender_network{test_config()};
+  ShmNetwork receiver_network{test_config()};
+  auto sender = UdpSocket<ShmNetwork>::bind(kSenderIp, sender_network);
+  auto receiver = UdpSocket<ShmNetwork>::bind(kReceiverIp, receiver_network);
+  std::string message = "message";
+  ASSERT_EQ(sender.send_to(kReceiverIp, as_span(message)), message.size());
+
+  receiver_network.close_socket(receiver.fd());
+  auto new_receiver = UdpSocket<ShmNetwork>::bind(kReceiverIp, receiver_network);
+  ASSERT_EQ(sender.send_to(kReceiverIp, as_span(message)), message.size());
+  std::vector<u8> buffer(100);
+  auto packet = new_receiver.read(buffer);
+  ASSERT_TRUE(packet.has_value());
+  ASSERT_EQ(span_to_string(packet->payload), "message");
+
+  sender_network.close_socket(sender.fd());
+  receiver_network.close_socket(new_receiver.fd());
+}
+
+TEST(ShmNetworkTest, SendersFollowRebindAfterOwnerDied) {
+  // The owner is a child process that exits without closing its socket. The config is taken
+  // before the fork, since its name prefix depends on the pid.
+  auto config = test_config();
+  pid_t pid = ::fork();
+  ASSERT_NE(pid, -1);
+  if (pid == 0) {
+    ShmNetwork owner_network{config};
+    auto socket = UdpSocket<ShmNetwork>::bind(kReceiverIp, owner_network);
+    // Skips the destructors, like a crash.
+    ::_exit(0);
+  }
+  int status = 0;
+  ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+
+  // The sender maps the segment that has been left behind.
+  ShmNetwork sender_network{config};
+  ShmNetwork receiver_network{config};
+  auto sender = UdpSocket<ShmNetwork>::bind(kSenderIp, sender_network);
+  std::string message = "message";
+  ASSERT_EQ(sender.send_to(kReceiverIp, as_span(message)), message.size());
+
+  // Rebinding the address replaces the segment, and the sender follows.
+  auto receiver = UdpSocket<ShmNetwork>::bind(kReceiverIp, receiver_network);
+  ASSERT_EQ(sender.send_to(kReceiverIp, as_span(message)), message.size());
+  std::vector<u8> buffer(100);
+  auto packet = receiver.read(buffer);
+  ASSERT_TRUE(packet.has_value());
+  ASSERT_EQ(span_to_string(packet->payload), "message");
+  ASSERT_FALSE(receiver.read(buffer).has_value());
+
+  sender_network.close_socket(sender.fd());
+  receiver_network.close_socket(receiver.fd());
+}
@@ -16,9 +16,14 @@ namespace freezing::network {
 template<typename Network>
 class UdpSocket {
 public:
-  static UdpSocket bind(IpAddress ip, Network &network) {
+  // If [reuse_port] is set, other sockets with [reuse_port] can bind to the same [ip] and the
+  // incoming datagrams are distributed across them by the sender.
+  static UdpSocket bind(IpAddress ip, Network &network, bool reuse_port = false) {
     auto fd = network.udp_socket_ipv4();
     UdpSocket socket{network, fd, ip};
+    if (reuse_port) {
+      network.set_reuse_port(fd);
+    }
     network.bind(fd, ip);
     network.set_non_blocking(fd);
     return socket;
@@ -28,11 +33,27 @@ public:
     return m_network.read_from_socket(m_fd, buffer);
   }
 
+  usize read_batch(std::span<byte_span> buffers, std::vector<ReadPacketInfo> &packets) {
+    return m_network.read_batch(m_fd, buffers, packets);
+  }
+
   [[nodiscard]] std::size_t send_to(IpAddress ip_address,
                                     const_byte_span payload) const {
     return m_network.send_to(m_fd, ip_address, payload);
   }
 
+  usize send_batch(std::span<const SendPacketInfo> packets) const {
+    return m_network.send_batch(m_fd, packets);
+  }
+
+  [[nodiscard]] FileDescriptor fd() const {
+    return m_fd;
+  }
+
+  UdpOffload enable_udp_offload(UdpOffload requested) {
+    return m_network.enable_udp_offload(m_fd, requested);
+  }
+
 private:
   UdpSocket(Network &network, FileDescriptor fd, IpAddress ip)
       : m_network{network}, m_fd{fd}, m_ip{ip} {}
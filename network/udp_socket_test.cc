@@ -35,3 +35,13 @@ TEST(UdpSocket, SendAndReceivePacket) {
   auto read_data = udp_client.read(buffer);
   ASSERT_EQ(span_to_string(read_data->payload), "This is test message.");
 }
+
+TEST(UdpSocket, OversizedDatagramIsFatal) {
+  const auto ip = IpAddress::from_ipv4("127.0.0.1", 47201);
+  auto udp_socket = UdpSocket<OsNetwork>::bind(ip, OS_NETWORK);
+  // Larger than any UDP datagram, so it fails with EMSGSIZE instead of being dropped silently.
+  std::vector<std::uint8_t> oversized(kMaxUdpPayloadSize + 1);
+  std::vector<SendPacketInfo> packets{{ip, oversized}};
+  ASSERT_THROW(udp_socket.send_batch(packets), std::runtime_error);
+  OS_NETWORK.close_socket(udp_socket.fd());
+}